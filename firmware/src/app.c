@@ -23,13 +23,24 @@
 #include "app.h"
 
 #include "app_command.h"
+#include "app_ethmac.h"
+#include "app_hid_bridge.h"
+#include "app_log.h"
+#include "app_metrics.h"
 #include "app_network.h"
+#include "app_ota.h"
+#include "app_profile.h"
+#include "app_tcp_tuner.h"
+#include "app_tls.h"
+#include "app_trace.h"
+#include "app_udp_rx.h"
 #include "app_usb_hid.h"
 
 static bool app_greetings(AppData* app_data) {
   SYS_CONSOLE_MESSAGE("====================================\r\n");
   SYS_CONSOLE_MESSAGE("***  Ethernet/Wi-Fi TCP/IP Demo  ***\r\n");
   SYS_CONSOLE_MESSAGE("====================================\r\n\r\n");
+  APP_Profile_BootPrint(NULL);
   app_data->state = APP_RUN_SERVICES;
   return true;
 }
@@ -37,9 +48,20 @@ static bool app_greetings(AppData* app_data) {
 void APP_Initialize(AppData* app_data, SYSTEM_OBJECTS* system_objects) {
   app_data->system_objects = system_objects;
   app_data->state = APP_GREETINGS;
+  APP_Log_Initialize();
+  APP_Trace_Initialize();
   APP_Command_Initialize(app_data);
+  APP_ETHMAC_Initialize();
   APP_Network_Initialize(&app_data->network, app_data->system_objects);
   APP_USB_HID_Initialize(&app_data->usb_hid);
+  APP_Bench_Initialize(&app_data->bench);
+  APP_HTTP_Initialize(&app_data->http, app_data->system_objects);
+  APP_TCP_Tuner_Initialize();
+  APP_UDP_RX_Initialize();
+  APP_Metrics_Initialize(app_data);
+  APP_HID_Bridge_Initialize(app_data->system_objects);
+  APP_TLS_Initialize(app_data->system_objects);
+  APP_OTA_Initialize(app_data->system_objects);
 }
 
 void APP_Tasks(AppData* app_data) {
@@ -49,8 +71,19 @@ void APP_Tasks(AppData* app_data) {
         break;
       }
     case APP_RUN_SERVICES:
-      APP_Network_Tasks(&app_data->network);
-      APP_USB_HID_Tasks(&app_data->usb_hid);
+      APP_TRACE_CALL(APP_TRACE_TASK_NETWORK,
+                     APP_Network_Tasks(&app_data->network));
+      APP_TRACE_CALL(APP_TRACE_TASK_ETHMAC, APP_ETHMAC_Tasks());
+      APP_TRACE_CALL(APP_TRACE_TASK_USB_HID,
+                     APP_USB_HID_Tasks(&app_data->usb_hid));
+      APP_TRACE_CALL(APP_TRACE_TASK_HID_BRIDGE, APP_HID_Bridge_Tasks());
+      APP_TRACE_CALL(APP_TRACE_TASK_BENCH, APP_Bench_Tasks(&app_data->bench));
+      APP_TRACE_CALL(APP_TRACE_TASK_HTTP, APP_HTTP_Tasks(&app_data->http));
+      APP_TRACE_CALL(APP_TRACE_TASK_TLS, APP_TLS_Tasks());
+      APP_TRACE_CALL(APP_TRACE_TASK_OTA, APP_OTA_Tasks());
+      APP_TRACE_CALL(APP_TRACE_TASK_TCP_TUNER, APP_TCP_Tuner_Tasks());
+      APP_TRACE_CALL(APP_TRACE_TASK_LOG, APP_Log_Tasks());
+      APP_Trace_Tasks();
       break;
     case APP_ERROR:
       // TODO(sergey): Do we need to do something here?
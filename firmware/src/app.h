@@ -30,6 +30,8 @@
 #include "system_config.h"
 #include "system_definitions.h"
 
+#include "app_bench.h"
+#include "app_http.h"
 #include "app_network.h"
 #include "app_usb_hid.h"
 
@@ -48,6 +50,8 @@ typedef struct {
   AppState state;
   AppNetworkData network;
   AppUSBHIDData usb_hid;
+  AppBenchData bench;
+  AppHTTPData http;
 } AppData;
 
 
@@ -0,0 +1,761 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_bench.h"
+
+#include <string.h>
+
+#include "app_checksum.h"
+#include "app_command.h"
+#include "app_compress.h"
+#include "app_crypto.h"
+#include "app_ethmac.h"
+#include "app_hid_bridge.h"
+#include "app_kv.h"
+#include "app_profile.h"
+#include "app_tcp_tuner.h"
+#include "app_trace.h"
+
+static const char* g_bench_test_names[APP_BENCH_NUM_TESTS] = {
+  "tcp_tx",
+  "udp_tx",
+  "tcp_rx",
+  "udp_rx",
+  "udp_pps",
+};
+
+// Payload which is sent by transmit tests.
+static uint8_t g_bench_payload[APP_BENCH_UDP_DATAGRAM_SIZE];
+
+static void app_bench_payload_fill(void) {
+  int i;
+  for (i = 0; i < (int)sizeof(g_bench_payload); ++i) {
+    g_bench_payload[i] = '0' + (i % 10);
+  }
+}
+
+static uint32_t app_bench_ms_since(uint32_t tick) {
+  const uint32_t delta = SYS_TMR_TickCountGet() - tick;
+  return (uint32_t)((uint64_t)delta * 1000 / SYS_TMR_TickCounterFrequencyGet());
+}
+
+static bool app_bench_test_is_tcp(AppBenchTest test) {
+  return test == APP_BENCH_TEST_TCP_TX || test == APP_BENCH_TEST_TCP_RX;
+}
+
+static void app_bench_state_set(AppBenchData* app_bench_data,
+                                AppBenchState state) {
+  app_bench_data->state = state;
+  app_bench_data->state_tick = SYS_TMR_TickCountGet();
+  APP_TRACE_COUNTER(APP_TRACE_STATE_BENCH, state);
+}
+
+static void app_bench_sockets_close(AppBenchData* app_bench_data) {
+  if (app_bench_data->tcp_socket != INVALID_SOCKET) {
+    APP_TCP_Tuner_Unregister(app_bench_data->tcp_socket);
+    TCPIP_TCP_Close(app_bench_data->tcp_socket);
+    app_bench_data->tcp_socket = INVALID_SOCKET;
+  }
+  if (app_bench_data->udp_socket != INVALID_SOCKET) {
+    TCPIP_UDP_Close(app_bench_data->udp_socket);
+    app_bench_data->udp_socket = INVALID_SOCKET;
+  }
+}
+
+static void app_bench_next_test(AppBenchData* app_bench_data) {
+  app_bench_sockets_close(app_bench_data);
+  if (++app_bench_data->test == APP_BENCH_NUM_TESTS) {
+    app_bench_data->test = 0;
+    ++app_bench_data->iface_index;
+  }
+  app_bench_state_set(app_bench_data, APP_BENCH_STATE_TEST_OPEN);
+}
+
+static bool app_bench_socket_open(AppBenchData* app_bench_data,
+                                  TCPIP_NET_HANDLE net) {
+  IP_MULTI_ADDRESS peer_address;
+  peer_address.v4Add = app_bench_data->peer_address;
+  switch (app_bench_data->test) {
+    case APP_BENCH_TEST_TCP_TX:
+      app_bench_data->tcp_socket =
+          TCPIP_TCP_ClientOpen(IP_ADDRESS_TYPE_IPV4, 0, NULL);
+      if (app_bench_data->tcp_socket == INVALID_SOCKET) {
+        return false;
+      }
+      TCPIP_TCP_SocketNetSet(app_bench_data->tcp_socket, net);
+      APP_TCP_Tuner_Register(app_bench_data->tcp_socket);
+      TCPIP_TCP_RemoteBind(app_bench_data->tcp_socket,
+                           IP_ADDRESS_TYPE_IPV4,
+                           APP_BENCH_PEER_PORT,
+                           &peer_address);
+      return TCPIP_TCP_Connect(app_bench_data->tcp_socket);
+    case APP_BENCH_TEST_UDP_TX:
+      app_bench_data->udp_socket =
+          TCPIP_UDP_ClientOpen(IP_ADDRESS_TYPE_IPV4,
+                               APP_BENCH_PEER_PORT,
+                               &peer_address);
+      if (app_bench_data->udp_socket == INVALID_SOCKET) {
+        return false;
+      }
+      TCPIP_UDP_SocketNetSet(app_bench_data->udp_socket, net);
+      return TCPIP_UDP_OptionsSet(
+          app_bench_data->udp_socket,
+          UDP_OPTION_TX_BUFF,
+          (void*)(uintptr_t)APP_BENCH_UDP_DATAGRAM_SIZE);
+    case APP_BENCH_TEST_TCP_RX:
+      app_bench_data->tcp_socket =
+          TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE_IPV4,
+                               APP_BENCH_LOCAL_PORT,
+                               NULL);
+      if (app_bench_data->tcp_socket == INVALID_SOCKET) {
+        return false;
+      }
+      APP_TCP_Tuner_Register(app_bench_data->tcp_socket);
+      return TCPIP_TCP_SocketNetSet(app_bench_data->tcp_socket, net);
+    case APP_BENCH_TEST_UDP_RX:
+    case APP_BENCH_TEST_UDP_PPS:
+      app_bench_data->udp_socket =
+          TCPIP_UDP_ServerOpen(IP_ADDRESS_TYPE_IPV4,
+                               APP_BENCH_LOCAL_PORT,
+                               NULL);
+      if (app_bench_data->udp_socket == INVALID_SOCKET) {
+        return false;
+      }
+      return TCPIP_UDP_SocketNetSet(app_bench_data->udp_socket, net);
+    case APP_BENCH_NUM_TESTS:
+      break;
+  }
+  return false;
+}
+
+static void app_bench_test_open(AppBenchData* app_bench_data) {
+  if (app_bench_data->iface_index >= TCPIP_STACK_NumberOfNetworksGet()) {
+    SYS_CONSOLE_MESSAGE("BENCH DONE\r\n");
+    app_bench_state_set(app_bench_data, APP_BENCH_STATE_IDLE);
+    return;
+  }
+  TCPIP_NET_HANDLE net = TCPIP_STACK_IndexToNet(app_bench_data->iface_index);
+  const char* net_name = TCPIP_STACK_NetNameGet(net);
+  const char* test_name = g_bench_test_names[app_bench_data->test];
+  IPV4_ADDR address;
+  address.Val = TCPIP_STACK_NetAddress(net);
+  if (!TCPIP_STACK_NetIsUp(net) || address.Val == 0) {
+    SYS_CONSOLE_PRINT("BENCH SKIP iface=%s reason=down\r\n", net_name);
+    app_bench_data->test = APP_BENCH_NUM_TESTS - 1;
+    app_bench_next_test(app_bench_data);
+    return;
+  }
+  if (!app_bench_socket_open(app_bench_data, net)) {
+    SYS_CONSOLE_PRINT("BENCH ERROR iface=%s test=%s reason=socket\r\n",
+                      net_name, test_name);
+    app_bench_next_test(app_bench_data);
+    return;
+  }
+  if (app_bench_data->test == APP_BENCH_TEST_TCP_RX ||
+      app_bench_data->test == APP_BENCH_TEST_UDP_RX ||
+      app_bench_data->test == APP_BENCH_TEST_UDP_PPS) {
+    SYS_CONSOLE_PRINT("BENCH READY iface=%s test=%s address=%d.%d.%d.%d "
+                      "port=%d\r\n",
+                      net_name, test_name,
+                      address.v[0], address.v[1], address.v[2], address.v[3],
+                      APP_BENCH_LOCAL_PORT);
+  }
+  app_bench_state_set(app_bench_data, APP_BENCH_STATE_TEST_WAIT);
+}
+
+static bool app_bench_test_is_started(AppBenchData* app_bench_data) {
+  switch (app_bench_data->test) {
+    case APP_BENCH_TEST_TCP_TX:
+      return TCPIP_TCP_IsConnected(app_bench_data->tcp_socket);
+    case APP_BENCH_TEST_UDP_TX:
+      return true;
+    case APP_BENCH_TEST_TCP_RX:
+      return TCPIP_TCP_GetIsReady(app_bench_data->tcp_socket) != 0;
+    case APP_BENCH_TEST_UDP_RX:
+    case APP_BENCH_TEST_UDP_PPS:
+      return TCPIP_UDP_GetIsReady(app_bench_data->udp_socket) != 0;
+    case APP_BENCH_NUM_TESTS:
+      break;
+  }
+  return false;
+}
+
+static uint32_t app_bench_eth_interrupts(void) {
+  AppEthmacStats stats;
+  APP_ETHMAC_StatsGet(&stats);
+  return stats.num_interrupts;
+}
+
+static void app_bench_test_wait(AppBenchData* app_bench_data) {
+  if (app_bench_test_is_started(app_bench_data)) {
+    app_bench_data->num_bytes = 0;
+    app_bench_data->udp_sequence = 0;
+    app_bench_data->num_packets = 0;
+    app_bench_data->max_udp_sequence = -1;
+    app_bench_data->num_eth_interrupts = app_bench_eth_interrupts();
+    app_bench_data->start_tick = SYS_TMR_TickCountGet();
+    APP_Profile_LoopStatsReset();
+    app_bench_state_set(app_bench_data, APP_BENCH_STATE_TEST_RUN);
+    return;
+  }
+  if (app_bench_ms_since(app_bench_data->state_tick) >=
+      APP_BENCH_START_TIMEOUT * 1000) {
+    TCPIP_NET_HANDLE net =
+        TCPIP_STACK_IndexToNet(app_bench_data->iface_index);
+    SYS_CONSOLE_PRINT("BENCH ERROR iface=%s test=%s reason=timeout\r\n",
+                      TCPIP_STACK_NetNameGet(net),
+                      g_bench_test_names[app_bench_data->test]);
+    app_bench_next_test(app_bench_data);
+  }
+}
+
+// Send single datagram with iperf compatible header, so stock iperf server
+// reports loss and jitter on its side.
+static bool app_bench_udp_send(AppBenchData* app_bench_data, int32_t id) {
+  UDP_SOCKET udp_socket = app_bench_data->udp_socket;
+  const uint32_t ms = app_bench_ms_since(app_bench_data->start_tick);
+  uint32_t* header = (uint32_t*)g_bench_payload;
+  if (TCPIP_UDP_TxPutIsReady(udp_socket, APP_BENCH_UDP_DATAGRAM_SIZE) <
+      APP_BENCH_UDP_DATAGRAM_SIZE) {
+    return false;
+  }
+  header[0] = TCPIP_Helper_htonl((uint32_t)id);
+  header[1] = TCPIP_Helper_htonl(ms / 1000);
+  header[2] = TCPIP_Helper_htonl((ms % 1000) * 1000);
+  TCPIP_UDP_ArrayPut(udp_socket, g_bench_payload, APP_BENCH_UDP_DATAGRAM_SIZE);
+  TCPIP_UDP_Flush(udp_socket);
+  return true;
+}
+
+static void app_bench_test_run(AppBenchData* app_bench_data) {
+  TCP_SOCKET tcp_socket = app_bench_data->tcp_socket;
+  UDP_SOCKET udp_socket = app_bench_data->udp_socket;
+  uint16_t num_bytes;
+  switch (app_bench_data->test) {
+    case APP_BENCH_TEST_TCP_TX:
+      num_bytes = TCPIP_TCP_PutIsReady(tcp_socket);
+      if (num_bytes > sizeof(g_bench_payload)) {
+        num_bytes = sizeof(g_bench_payload);
+      }
+      if (num_bytes != 0) {
+        num_bytes = TCPIP_TCP_ArrayPut(tcp_socket, g_bench_payload, num_bytes);
+        APP_TCP_Tuner_Account(tcp_socket, num_bytes, 0);
+        app_bench_data->num_bytes += num_bytes;
+      }
+      break;
+    case APP_BENCH_TEST_UDP_TX:
+      if (app_bench_udp_send(app_bench_data, app_bench_data->udp_sequence)) {
+        ++app_bench_data->udp_sequence;
+        app_bench_data->num_bytes += APP_BENCH_UDP_DATAGRAM_SIZE;
+      }
+      break;
+    case APP_BENCH_TEST_TCP_RX:
+      num_bytes = TCPIP_TCP_Discard(tcp_socket);
+      APP_TCP_Tuner_Account(tcp_socket, 0, num_bytes);
+      app_bench_data->num_bytes += num_bytes;
+      break;
+    case APP_BENCH_TEST_UDP_RX:
+      while (TCPIP_UDP_GetIsReady(udp_socket) != 0) {
+        app_bench_data->num_bytes += TCPIP_UDP_Discard(udp_socket);
+      }
+      break;
+    case APP_BENCH_TEST_UDP_PPS:
+      while ((num_bytes = TCPIP_UDP_GetIsReady(udp_socket)) != 0) {
+        uint32_t sequence = 0;
+        TCPIP_UDP_ArrayGet(udp_socket, (uint8_t*)&sequence, sizeof(sequence));
+        sequence = TCPIP_Helper_ntohl(sequence);
+        if ((int32_t)sequence > app_bench_data->max_udp_sequence) {
+          app_bench_data->max_udp_sequence = sequence;
+        }
+        TCPIP_UDP_Discard(udp_socket);
+        app_bench_data->num_bytes += num_bytes;
+        ++app_bench_data->num_packets;
+      }
+      break;
+    case APP_BENCH_NUM_TESTS:
+      break;
+  }
+  if (app_bench_test_is_tcp(app_bench_data->test) &&
+      !TCPIP_TCP_IsConnected(tcp_socket)) {
+    // Peer closed connection earlier than expected, report what we've got.
+    app_bench_state_set(app_bench_data, APP_BENCH_STATE_TEST_FINISH);
+  }
+  if (app_bench_ms_since(app_bench_data->start_tick) >=
+      app_bench_data->duration_ms) {
+    app_bench_state_set(app_bench_data, APP_BENCH_STATE_TEST_FINISH);
+  }
+}
+
+static void app_bench_test_finish(AppBenchData* app_bench_data) {
+  TCPIP_NET_HANDLE net = TCPIP_STACK_IndexToNet(app_bench_data->iface_index);
+  const uint32_t ms = app_bench_ms_since(app_bench_data->start_tick);
+  const uint32_t kbps = (ms != 0)
+      ? (uint32_t)((uint64_t)app_bench_data->num_bytes * 8 / ms)
+      : 0;
+  AppLoopStats loop_stats;
+  uint32_t loop_ticks, cpu = 0;
+  APP_Profile_LoopStatsGet(&loop_stats);
+  loop_ticks = APP_Profile_LoopAverageTicks(&loop_stats);
+  // Super-loop is always busy, so CPU time taken by the test is how much
+  // longer iterations became compared to the unloaded ones.
+  if (loop_ticks > app_bench_data->idle_loop_ticks) {
+    cpu = 100 - (uint32_t)((uint64_t)app_bench_data->idle_loop_ticks * 100 /
+                           loop_ticks);
+  }
+  // CPU time spent on the test, per megabyte.
+  const uint32_t us_per_mb = (app_bench_data->num_bytes != 0)
+      ? (uint32_t)((uint64_t)cpu * ms * 10 * (1024 * 1024) /
+                   app_bench_data->num_bytes)
+      : 0;
+  if (app_bench_data->test == APP_BENCH_TEST_UDP_TX) {
+    // Negative sequence number tells iperf server test is over.
+    app_bench_udp_send(app_bench_data, -app_bench_data->udp_sequence);
+  }
+  if (app_bench_data->test == APP_BENCH_TEST_UDP_PPS) {
+    // Datagrams peer has sent but board never received, including the ones
+    // dropped by the controller and by the stack.
+    const uint32_t num_sent = app_bench_data->max_udp_sequence + 1;
+    const uint32_t num_lost = (num_sent > app_bench_data->num_packets)
+        ? num_sent - app_bench_data->num_packets
+        : 0;
+    const uint32_t pps = (ms != 0)
+        ? (uint32_t)((uint64_t)app_bench_data->num_packets * 1000 / ms)
+        : 0;
+    SYS_CONSOLE_PRINT("BENCH RESULT iface=%s test=%s bytes=%u ms=%u kbps=%u "
+                      "cpu=%u us_per_mb=%u pps=%u lost=%u irq=%u\r\n",
+                      TCPIP_STACK_NetNameGet(net),
+                      g_bench_test_names[app_bench_data->test],
+                      app_bench_data->num_bytes, ms, kbps, cpu, us_per_mb,
+                      pps, num_lost,
+                      app_bench_eth_interrupts() -
+                          app_bench_data->num_eth_interrupts);
+  } else {
+    SYS_CONSOLE_PRINT("BENCH RESULT iface=%s test=%s bytes=%u ms=%u kbps=%u "
+                      "cpu=%u us_per_mb=%u\r\n",
+                      TCPIP_STACK_NetNameGet(net),
+                      g_bench_test_names[app_bench_data->test],
+                      app_bench_data->num_bytes, ms, kbps, cpu, us_per_mb);
+  }
+  app_bench_next_test(app_bench_data);
+}
+
+void APP_Bench_Initialize(AppBenchData* app_bench_data) {
+  app_bench_data->state = APP_BENCH_STATE_IDLE;
+  app_bench_data->tcp_socket = INVALID_SOCKET;
+  app_bench_data->udp_socket = INVALID_SOCKET;
+  app_bench_payload_fill();
+}
+
+void APP_Bench_Tasks(AppBenchData* app_bench_data) {
+  switch (app_bench_data->state) {
+    case APP_BENCH_STATE_IDLE:
+      break;
+    case APP_BENCH_STATE_CALIBRATE:
+      if (app_bench_ms_since(app_bench_data->state_tick) >=
+          APP_BENCH_CALIBRATE_DURATION * 1000) {
+        AppLoopStats loop_stats;
+        APP_Profile_LoopStatsGet(&loop_stats);
+        app_bench_data->idle_loop_ticks =
+            APP_Profile_LoopAverageTicks(&loop_stats);
+        SYS_CONSOLE_PRINT("BENCH CALIBRATE loop_us=%u\r\n",
+                          app_bench_data->idle_loop_ticks /
+                              APP_PROFILE_CORE_TICKS_PER_US);
+        app_bench_state_set(app_bench_data, APP_BENCH_STATE_TEST_OPEN);
+      }
+      break;
+    case APP_BENCH_STATE_TEST_OPEN:
+      app_bench_test_open(app_bench_data);
+      break;
+    case APP_BENCH_STATE_TEST_WAIT:
+      app_bench_test_wait(app_bench_data);
+      break;
+    case APP_BENCH_STATE_TEST_RUN:
+      app_bench_test_run(app_bench_data);
+      break;
+    case APP_BENCH_STATE_TEST_FINISH:
+      app_bench_test_finish(app_bench_data);
+      break;
+  }
+}
+
+bool APP_Bench_NetStart(AppBenchData* app_bench_data,
+                        IPV4_ADDR peer_address,
+                        uint32_t duration) {
+  if (app_bench_data->state != APP_BENCH_STATE_IDLE) {
+    return false;
+  }
+  app_bench_data->peer_address = peer_address;
+  app_bench_data->duration_ms = duration * 1000;
+  app_bench_data->iface_index = 0;
+  app_bench_data->test = 0;
+  SYS_CONSOLE_PRINT("BENCH START peer=%d.%d.%d.%d duration=%u\r\n",
+                    peer_address.v[0], peer_address.v[1],
+                    peer_address.v[2], peer_address.v[3],
+                    duration);
+  APP_Profile_LoopStatsReset();
+  app_bench_state_set(app_bench_data, APP_BENCH_STATE_CALIBRATE);
+  return true;
+}
+
+void APP_Bench_Stop(AppBenchData* app_bench_data) {
+  if (app_bench_data->state == APP_BENCH_STATE_IDLE) {
+    return;
+  }
+  app_bench_sockets_close(app_bench_data);
+  SYS_CONSOLE_MESSAGE("BENCH DONE\r\n");
+  app_bench_state_set(app_bench_data, APP_BENCH_STATE_IDLE);
+}
+
+typedef uint16_t (*AppBenchChecksumFunc)(const uint8_t* buffer,
+                                         uint16_t count,
+                                         uint16_t seed);
+
+static void app_bench_checksum_time(SYS_CMD_DEVICE_NODE* cmd_io,
+                                    const char* name,
+                                    AppBenchChecksumFunc checksum_func) {
+  uint32_t num_bytes, start_tick, ticks;
+  volatile uint16_t checksum = 0;
+  start_tick = _CP0_GET_COUNT();
+  // Datagram sized blocks, same as the stack checksums received packets.
+  for (num_bytes = 0;
+       num_bytes < APP_BENCH_CHECKSUM_SIZE;
+       num_bytes += sizeof(g_bench_payload)) {
+    checksum += checksum_func(g_bench_payload, sizeof(g_bench_payload), 0);
+  }
+  ticks = _CP0_GET_COUNT() - start_tick;
+  // Core timer runs at half of the CPU clock.
+  APP_CMD_PRINT(cmd_io, "BENCH CKSUM impl=%s bytes=%u us=%u us_per_mb=%u "
+                "cycles_per_kb=%u\r\n",
+                name, num_bytes, ticks / APP_PROFILE_CORE_TICKS_PER_US,
+                (uint32_t)((uint64_t)ticks * (1024 * 1024) /
+                           APP_PROFILE_CORE_TICKS_PER_US / num_bytes),
+                (uint32_t)((uint64_t)ticks * 2 * 1024 / num_bytes));
+}
+
+// Compare optimized checksum against the reference one on random buffers of
+// random length, alignment and seed.
+static bool app_bench_checksum_verify(void) {
+  bool is_ok = true;
+  int i, j;
+  for (i = 0; i < APP_BENCH_CHECKSUM_NUM_CHECKS && is_ok; ++i) {
+    const uint32_t offset = SYS_RANDOM_PseudoGet() % 4;
+    const uint16_t count =
+        SYS_RANDOM_PseudoGet() % (sizeof(g_bench_payload) - offset + 1);
+    const uint16_t seed = SYS_RANDOM_PseudoGet();
+    for (j = 0; j < count; ++j) {
+      g_bench_payload[offset + j] = SYS_RANDOM_PseudoGet();
+    }
+    is_ok = APP_Checksum_Calc(g_bench_payload + offset, count, seed) ==
+            APP_Checksum_Reference(g_bench_payload + offset, count, seed);
+  }
+  app_bench_payload_fill();
+  return is_ok;
+}
+
+void APP_Bench_Checksum(SYS_CMD_DEVICE_NODE* cmd_io) {
+  APP_CMD_PRINT(cmd_io, "BENCH CKSUM check=%s\r\n",
+                app_bench_checksum_verify() ? "ok" : "fail");
+  app_bench_checksum_time(cmd_io, "reference", APP_Checksum_Reference);
+  app_bench_checksum_time(cmd_io, "optimized", APP_Checksum_Calc);
+}
+
+typedef enum {
+  APP_BENCH_TRAFFIC_IDLE,
+  APP_BENCH_TRAFFIC_SENSOR,
+  APP_BENCH_TRAFFIC_RANDOM,
+
+  APP_BENCH_NUM_TRAFFICS,
+} AppBenchTraffic;
+
+static const char* g_bench_traffic_names[APP_BENCH_NUM_TRAFFICS] = {
+  "idle",
+  "sensor",
+  "random",
+};
+
+#define APP_BENCH_FRAME_SIZE \
+    (APP_HID_BRIDGE_HEADER_SIZE + APP_HID_BRIDGE_RECORD_SIZE)
+
+static AppCompressStream g_bench_compress;
+static uint8_t g_bench_compressed[
+    APP_COMPRESS_BOUND(APP_BENCH_FRAME_SIZE * APP_BENCH_COMPRESS_NUM_CHECKS)];
+
+// Framed bridge record of the given traffic type. Traffic is generated from
+// the record index only, so it can be regenerated for verification.
+static void app_bench_hid_frame(AppBenchTraffic traffic,
+                                uint32_t index,
+                                uint8_t* frame) {
+  uint8_t* report = frame + APP_HID_BRIDGE_HEADER_SIZE;
+  uint32_t random = index * 2654435761u;
+  int i;
+  frame[0] = index;
+  frame[1] = index >> 8;
+  frame[2] = index >> 16;
+  frame[3] = index >> 24;
+  frame[4] = APP_HID_BRIDGE_RECORD_SIZE;
+  frame[5] = 0;
+  memset(report, 0, APP_HID_BRIDGE_RECORD_SIZE);
+  report[0] = 1;  // Report ID.
+  switch (traffic) {
+    case APP_BENCH_TRAFFIC_IDLE:
+      break;
+    case APP_BENCH_TRAFFIC_SENSOR:
+      // Buttons change rarely, eight 16-bit axes drift slowly and have a
+      // couple of noisy low bits.
+      report[1] = (index >> 6) & 0x0f;
+      for (i = 0; i < 8; ++i) {
+        const uint16_t axis = 0x8000 + ((index + i * 37) & 0xff) * 16 +
+                              ((random >> (i * 2)) & 3);
+        report[2 + i * 2] = axis;
+        report[3 + i * 2] = axis >> 8;
+      }
+      break;
+    case APP_BENCH_TRAFFIC_RANDOM:
+      for (i = 1; i < APP_HID_BRIDGE_RECORD_SIZE; ++i) {
+        random = random * 1664525 + 1013904223;
+        report[i] = random >> 24;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Compress first records into a buffer, decompress them back into the
+// payload buffer and compare against regenerated ones.
+static bool app_bench_compress_verify(AppBenchTraffic traffic) {
+  uint8_t frame[APP_BENCH_FRAME_SIZE];
+  uint32_t size = 0;
+  bool is_ok = true;
+  int i;
+  APP_Compress_Reset(&g_bench_compress);
+  for (i = 0; i < APP_BENCH_COMPRESS_NUM_CHECKS; ++i) {
+    app_bench_hid_frame(traffic, i, frame);
+    size += APP_Compress_Update(&g_bench_compress, frame, sizeof(frame),
+                                g_bench_compressed + size);
+    if (i % APP_BENCH_COMPRESS_BATCH == APP_BENCH_COMPRESS_BATCH - 1) {
+      size += APP_Compress_Flush(&g_bench_compress, g_bench_compressed + size);
+    }
+  }
+  size += APP_Compress_Flush(&g_bench_compress, g_bench_compressed + size);
+  if (APP_Compress_Decode(g_bench_compressed, size,
+                          g_bench_payload, sizeof(g_bench_payload)) !=
+      APP_BENCH_FRAME_SIZE * APP_BENCH_COMPRESS_NUM_CHECKS) {
+    is_ok = false;
+  }
+  for (i = 0; i < APP_BENCH_COMPRESS_NUM_CHECKS && is_ok; ++i) {
+    app_bench_hid_frame(traffic, i, frame);
+    is_ok = memcmp(g_bench_payload + i * APP_BENCH_FRAME_SIZE,
+                   frame, sizeof(frame)) == 0;
+  }
+  app_bench_payload_fill();
+  return is_ok;
+}
+
+static void app_bench_compress_time(SYS_CMD_DEVICE_NODE* cmd_io,
+                                    AppBenchTraffic traffic) {
+  uint8_t frame[APP_BENCH_FRAME_SIZE];
+  uint32_t num_bytes = 0, num_compressed = 0, ticks = 0, index = 0;
+  const bool is_ok = app_bench_compress_verify(traffic);
+  APP_Compress_Reset(&g_bench_compress);
+  while (num_bytes < APP_BENCH_COMPRESS_SIZE) {
+    uint32_t start_tick;
+    // Generation of records is not timed, only what bridge drain does.
+    app_bench_hid_frame(traffic, index, frame);
+    start_tick = _CP0_GET_COUNT();
+    num_compressed += APP_Compress_Update(&g_bench_compress,
+                                          frame, sizeof(frame),
+                                          g_bench_compressed);
+    if (++index % APP_BENCH_COMPRESS_BATCH == 0) {
+      num_compressed += APP_Compress_Flush(&g_bench_compress,
+                                           g_bench_compressed);
+    }
+    ticks += _CP0_GET_COUNT() - start_tick;
+    num_bytes += sizeof(frame);
+  }
+  APP_CMD_PRINT(cmd_io, "BENCH COMPRESS traffic=%s bytes=%u compressed=%u "
+                "ratio_pct=%u us_per_kb=%u cycles_per_kb=%u check=%s\r\n",
+                g_bench_traffic_names[traffic], num_bytes, num_compressed,
+                (uint32_t)((uint64_t)num_compressed * 100 / num_bytes),
+                (uint32_t)((uint64_t)ticks * 1024 /
+                           APP_PROFILE_CORE_TICKS_PER_US / num_bytes),
+                (uint32_t)((uint64_t)ticks * 2 * 1024 / num_bytes),
+                is_ok ? "ok" : "fail");
+}
+
+void APP_Bench_Compress(SYS_CMD_DEVICE_NODE* cmd_io) {
+  int traffic;
+  for (traffic = 0; traffic < APP_BENCH_NUM_TRAFFICS; ++traffic) {
+    app_bench_compress_time(cmd_io, traffic);
+  }
+}
+
+typedef enum {
+  APP_BENCH_CRYPTO_CHACHA20,
+  APP_BENCH_CRYPTO_POLY1305,
+  APP_BENCH_CRYPTO_AEAD,
+  APP_BENCH_CRYPTO_AES128_CTR,
+  APP_BENCH_CRYPTO_AES256_CTR,
+
+  APP_BENCH_NUM_CRYPTO_KERNELS,
+} AppBenchCryptoKernel;
+
+static const char* g_bench_crypto_kernel_names[APP_BENCH_NUM_CRYPTO_KERNELS] = {
+  "chacha20",
+  "poly1305",
+  "chacha20_poly1305",
+  "aes128_ctr",
+  "aes256_ctr",
+};
+
+static void app_bench_crypto_time(SYS_CMD_DEVICE_NODE* cmd_io,
+                                  AppBenchCryptoKernel kernel) {
+  static const uint8_t key[32] = {0};
+  static const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE] = {0};
+  uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE] = {0};
+  uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE];
+  uint32_t num_bytes, start_tick, ticks;
+  AppCryptoPoly1305 poly;
+  AppCryptoAES aes;
+  if (kernel == APP_BENCH_CRYPTO_AES128_CTR) {
+    APP_Crypto_AESKeySet(&aes, key, 16);
+  } else if (kernel == APP_BENCH_CRYPTO_AES256_CTR) {
+    APP_Crypto_AESKeySet(&aes, key, 32);
+  }
+  start_tick = _CP0_GET_COUNT();
+  for (num_bytes = 0;
+       num_bytes < APP_BENCH_CRYPTO_SIZE;
+       num_bytes += sizeof(g_bench_payload)) {
+    switch (kernel) {
+      case APP_BENCH_CRYPTO_CHACHA20:
+        APP_Crypto_ChaCha20(key, nonce, 1, g_bench_payload, g_bench_payload,
+                            sizeof(g_bench_payload));
+        break;
+      case APP_BENCH_CRYPTO_POLY1305:
+        APP_Crypto_Poly1305Init(&poly, key);
+        APP_Crypto_Poly1305Update(&poly, g_bench_payload,
+                                  sizeof(g_bench_payload));
+        APP_Crypto_Poly1305Final(&poly, tag);
+        break;
+      case APP_BENCH_CRYPTO_AEAD:
+        APP_Crypto_AEADEncrypt(key, nonce, NULL, 0, g_bench_payload,
+                               g_bench_payload, sizeof(g_bench_payload), tag);
+        break;
+      case APP_BENCH_CRYPTO_AES128_CTR:
+      case APP_BENCH_CRYPTO_AES256_CTR:
+        APP_Crypto_AESCTR(&aes, counter, g_bench_payload, g_bench_payload,
+                          sizeof(g_bench_payload));
+        break;
+      case APP_BENCH_NUM_CRYPTO_KERNELS:
+        break;
+    }
+  }
+  ticks = _CP0_GET_COUNT() - start_tick;
+  // Core timer runs at half of the CPU clock.
+  APP_CMD_PRINT(cmd_io, "BENCH CRYPTO kernel=%s bytes=%u us=%u kbps=%u "
+                "cycles_per_byte=%u\r\n",
+                g_bench_crypto_kernel_names[kernel],
+                num_bytes, ticks / APP_PROFILE_CORE_TICKS_PER_US,
+                (uint32_t)((uint64_t)num_bytes * 8 * 1000 *
+                           APP_PROFILE_CORE_TICKS_PER_US / ticks),
+                ticks * 2 / num_bytes);
+}
+
+void APP_Bench_Crypto(SYS_CMD_DEVICE_NODE* cmd_io) {
+  int kernel;
+  APP_CMD_PRINT(cmd_io, "BENCH CRYPTO check=%s\r\n",
+                APP_Crypto_SelfTest() ? "ok" : "fail");
+  for (kernel = 0; kernel < APP_BENCH_NUM_CRYPTO_KERNELS; ++kernel) {
+    app_bench_crypto_time(cmd_io, kernel);
+  }
+  app_bench_payload_fill();
+}
+
+#define APP_BENCH_KV_KEY "bench.kv"
+#define APP_BENCH_KV_NUM_MOUNTS 4
+#define APP_BENCH_KV_NUM_SETS 64
+#define APP_BENCH_KV_NUM_GETS 256
+#define APP_BENCH_KV_VALUE_SIZE 32
+
+typedef struct {
+  uint32_t count;
+  uint32_t total_ticks;
+  uint32_t max_ticks;
+} AppBenchKVTiming;
+
+static void app_bench_kv_account(AppBenchKVTiming* timing,
+                                 uint32_t start_tick) {
+  const uint32_t ticks = _CP0_GET_COUNT() - start_tick;
+  ++timing->count;
+  timing->total_ticks += ticks;
+  if (ticks > timing->max_ticks) {
+    timing->max_ticks = ticks;
+  }
+}
+
+static void app_bench_kv_print(SYS_CMD_DEVICE_NODE* cmd_io,
+                               const char* op,
+                               const AppBenchKVTiming* timing) {
+  APP_CMD_PRINT(cmd_io, "BENCH KV op=%s count=%u avg_us=%u max_us=%u\r\n",
+                op, timing->count,
+                timing->total_ticks / timing->count /
+                    APP_PROFILE_CORE_TICKS_PER_US,
+                timing->max_ticks / APP_PROFILE_CORE_TICKS_PER_US);
+}
+
+void APP_Bench_KV(SYS_CMD_DEVICE_NODE* cmd_io) {
+  AppBenchKVTiming mount = {0}, set = {0}, get = {0};
+  uint8_t value[APP_BENCH_KV_VALUE_SIZE];
+  AppKVStats stats_before, stats_after;
+  bool is_ok = true;
+  int i;
+  APP_KV_StatsGet(&stats_before);
+  for (i = 0; i < APP_BENCH_KV_NUM_MOUNTS; ++i) {
+    const uint32_t start_tick = _CP0_GET_COUNT();
+    is_ok &= APP_KV_Initialize();
+    app_bench_kv_account(&mount, start_tick);
+  }
+  for (i = 0; i < APP_BENCH_KV_NUM_SETS; ++i) {
+    uint32_t start_tick;
+    memset(value, i, sizeof(value));
+    start_tick = _CP0_GET_COUNT();
+    is_ok &= APP_KV_Set(APP_BENCH_KV_KEY, value, sizeof(value));
+    app_bench_kv_account(&set, start_tick);
+  }
+  for (i = 0; i < APP_BENCH_KV_NUM_GETS; ++i) {
+    const uint32_t start_tick = _CP0_GET_COUNT();
+    is_ok &= APP_KV_Get(APP_BENCH_KV_KEY, value, sizeof(value)) ==
+             sizeof(value);
+    app_bench_kv_account(&get, start_tick);
+  }
+  is_ok &= value[0] == APP_BENCH_KV_NUM_SETS - 1;
+  is_ok &= APP_KV_Delete(APP_BENCH_KV_KEY);
+  APP_KV_StatsGet(&stats_after);
+  app_bench_kv_print(cmd_io, "mount", &mount);
+  app_bench_kv_print(cmd_io, "set", &set);
+  app_bench_kv_print(cmd_io, "get", &get);
+  APP_CMD_PRINT(cmd_io, "BENCH KV compactions=%u max_compaction_us=%u "
+                "check=%s\r\n",
+                stats_after.num_compactions - stats_before.num_compactions,
+                stats_after.max_compaction_us,
+                is_ok ? "ok" : "fail");
+}
@@ -0,0 +1,159 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_BENCH_H
+#define _APP_BENCH_H
+
+#include "tcpip/tcpip.h"
+
+#include "system_definitions.h"
+
+// Port of the iperf server running on the host peer (iperf -s [-u]).
+#define APP_BENCH_PEER_PORT 5001
+// Port the board listens on during receive tests (iperf -c <board> -p).
+#define APP_BENCH_LOCAL_PORT 5002
+#define APP_BENCH_DEFAULT_DURATION 10 /* seconds */
+// Time given to a peer to connect or start sending.
+#define APP_BENCH_START_TIMEOUT 15 /* seconds */
+#define APP_BENCH_CALIBRATE_DURATION 1 /* seconds */
+#define APP_BENCH_UDP_DATAGRAM_SIZE 1470
+// Amount of data checksummed by the checksum benchmark.
+#define APP_BENCH_CHECKSUM_SIZE (1024 * 1024)
+// Number of random buffers optimized checksum is verified on.
+#define APP_BENCH_CHECKSUM_NUM_CHECKS 1000
+// Amount of HID bridge records compressed per traffic type.
+#define APP_BENCH_COMPRESS_SIZE (64 * 1024)
+// Records per bridge drain, stream is flushed after every drain.
+#define APP_BENCH_COMPRESS_BATCH 4
+// Records which are decompressed back to verify compression, they are to
+// fit into the payload buffer.
+#define APP_BENCH_COMPRESS_NUM_CHECKS 16
+// Amount of data every crypto kernel processes.
+#define APP_BENCH_CRYPTO_SIZE (256 * 1024)
+
+typedef enum {
+  APP_BENCH_TEST_TCP_TX,
+  APP_BENCH_TEST_UDP_TX,
+  APP_BENCH_TEST_TCP_RX,
+  APP_BENCH_TEST_UDP_RX,
+  // Flood of small datagrams from peer, measures packet rate.
+  APP_BENCH_TEST_UDP_PPS,
+
+  APP_BENCH_NUM_TESTS,
+} AppBenchTest;
+
+typedef enum {
+  // No benchmark is running.
+  APP_BENCH_STATE_IDLE,
+  // Measure super-loop duration when there is no load.
+  APP_BENCH_STATE_CALIBRATE,
+  // Open socket for the current test.
+  APP_BENCH_STATE_TEST_OPEN,
+  // Wait for connection or first data from peer.
+  APP_BENCH_STATE_TEST_WAIT,
+  // Test is running.
+  APP_BENCH_STATE_TEST_RUN,
+  // Report result and advance to the next test.
+  APP_BENCH_STATE_TEST_FINISH,
+} AppBenchState;
+
+typedef struct {
+  AppBenchState state;
+
+  IPV4_ADDR peer_address;
+  uint32_t duration_ms;
+
+  int iface_index;
+  AppBenchTest test;
+
+  TCP_SOCKET tcp_socket;
+  UDP_SOCKET udp_socket;
+
+  // System timer ticks of the current state and test start.
+  uint32_t state_tick;
+  uint32_t start_tick;
+
+  uint32_t num_bytes;
+  int32_t udp_sequence;
+  // Received datagrams and highest iperf sequence number seen.
+  uint32_t num_packets;
+  int32_t max_udp_sequence;
+  uint32_t num_eth_interrupts;
+
+  // Average super-loop duration without load, core timer ticks.
+  uint32_t idle_loop_ticks;
+} AppBenchData;
+
+void APP_Bench_Initialize(AppBenchData* app_bench_data);
+void APP_Bench_Tasks(AppBenchData* app_bench_data);
+
+// Run all network tests on all interfaces which have an address.
+// Results are printed to the console as machine-readable lines:
+//
+//   BENCH RESULT iface=<name> test=<test> bytes=<n> ms=<n> kbps=<n> cpu=<%>
+//                us_per_mb=<n>
+//
+// Where us_per_mb is CPU time spent per megabyte of transferred data.
+//
+// Packet rate test adds "pps=<n> lost=<n> irq=<n>" to the result line.
+//
+// Receive tests print a "BENCH READY" line when the board is ready to
+// accept peer's traffic.
+bool APP_Bench_NetStart(AppBenchData* app_bench_data,
+                        IPV4_ADDR peer_address,
+                        uint32_t duration);
+
+void APP_Bench_Stop(AppBenchData* app_bench_data);
+
+// Verify optimized Internet checksum against the reference implementation
+// and measure CPU time both take per megabyte of data, which is what every
+// received UDP and TCP byte costs on top of copying.
+//
+//   BENCH CKSUM check=<ok|fail>
+//   BENCH CKSUM impl=<name> bytes=<n> us=<n> us_per_mb=<n> cycles_per_kb=<n>
+void APP_Bench_Checksum(SYS_CMD_DEVICE_NODE* cmd_io);
+
+// Measure compression ratio and CPU time per kilobyte of HID bridge stream
+// compression on synthetic traffic: unchanged reports of an idle device,
+// slowly changing sensor axes with noise, and random data as the worst case.
+//
+//   BENCH COMPRESS traffic=<name> bytes=<n> compressed=<n> ratio_pct=<n>
+//                  us_per_kb=<n> cycles_per_kb=<n> check=<ok|fail>
+void APP_Bench_Compress(SYS_CMD_DEVICE_NODE* cmd_io);
+
+// Run known answer tests of the symmetric crypto kernels and measure their
+// throughput on datagram sized buffers, which is what a TLS record or a
+// session ticket costs per byte.
+//
+//   BENCH CRYPTO check=<ok|fail>
+//   BENCH CRYPTO kernel=<name> bytes=<n> us=<n> kbps=<n> cycles_per_byte=<n>
+void APP_Bench_Crypto(SYS_CMD_DEVICE_NODE* cmd_io);
+
+// Measure key-value store operations on the store itself: re-mount, set of
+// a key with a changing value (which goes through page switches and
+// compactions), and get. The key is deleted afterwards.
+//
+//   BENCH KV op=<mount|set|get> count=<n> avg_us=<n> max_us=<n>
+//   BENCH KV compactions=<n> max_compaction_us=<n> check=<ok|fail>
+void APP_Bench_KV(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_BENCH_H
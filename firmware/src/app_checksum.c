@@ -0,0 +1,218 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_checksum.h"
+
+#include "tcpip/tcpip.h"
+
+// Fold 32-bit one's complement sum to 16 bits.
+static uint32_t app_checksum_fold(uint32_t sum) {
+  sum = (sum & 0xffff) + (sum >> 16);
+  return (sum & 0xffff) + (sum >> 16);
+}
+
+// Sum of the buffer as native-order 16-bit words, not folded.
+//
+// MIPS32 has no carry flag, so 32-bit words are added to the sum and carries
+// out of it are counted separately (addu + sltu + addu per word). Since
+// 2^32 = 1 (mod 2^16 - 1) carries are simply added to the folded sum.
+static uint32_t app_checksum_sum(const uint8_t* buffer, size_t count) {
+  uint32_t sum = 0, carry = 0, word;
+  const uint32_t* words;
+  if (count >= 2 && ((uintptr_t)buffer & 2) != 0) {
+    sum = *(const uint16_t*)buffer;
+    buffer += 2;
+    count -= 2;
+  }
+  words = (const uint32_t*)buffer;
+  while (count >= 32) {
+    word = words[0]; sum += word; carry += (sum < word);
+    word = words[1]; sum += word; carry += (sum < word);
+    word = words[2]; sum += word; carry += (sum < word);
+    word = words[3]; sum += word; carry += (sum < word);
+    word = words[4]; sum += word; carry += (sum < word);
+    word = words[5]; sum += word; carry += (sum < word);
+    word = words[6]; sum += word; carry += (sum < word);
+    word = words[7]; sum += word; carry += (sum < word);
+    words += 8;
+    count -= 32;
+  }
+  while (count >= 4) {
+    word = *words++;
+    sum += word;
+    carry += (sum < word);
+    count -= 4;
+  }
+  buffer = (const uint8_t*)words;
+  if (count >= 2) {
+    word = *(const uint16_t*)buffer;
+    sum += word;
+    carry += (sum < word);
+    buffer += 2;
+    count -= 2;
+  }
+  if (count != 0) {
+    // Trailing byte is the low byte of the last word on little endian.
+    word = *buffer;
+    sum += word;
+    carry += (sum < word);
+  }
+  return app_checksum_fold(sum) + carry;
+}
+
+uint16_t APP_Checksum_Calc(const uint8_t* buffer, uint16_t count, uint16_t seed) {
+  uint32_t sum = seed;
+  if (((uintptr_t)buffer & 1) != 0 && count != 0) {
+    // Summing from the next, even, address swaps bytes within every word.
+    // Byte swap commutes with one's complement addition, so swap the sum
+    // back. First byte is the low byte of the first word.
+    uint32_t odd_sum = app_checksum_fold(app_checksum_sum(buffer + 1,
+                                                          count - 1));
+    sum += ((odd_sum & 0xff) << 8) | (odd_sum >> 8);
+    sum += *buffer;
+  } else {
+    sum += app_checksum_sum(buffer, count);
+  }
+  return ~app_checksum_fold(sum);
+}
+
+void APP_Checksum_Start(AppChecksumState* state, uint16_t seed) {
+  state->sum = seed;
+  state->is_odd = false;
+}
+
+void APP_Checksum_Add(AppChecksumState* state,
+                      const uint8_t* buffer,
+                      uint16_t count) {
+  // Folded sum of the buffer on its own.
+  uint32_t sum = (uint16_t)~APP_Checksum_Calc(buffer, count, 0);
+  if (state->is_odd) {
+    // Buffer's words are shifted by one byte in the whole data.
+    sum = ((sum & 0xff) << 8) | (sum >> 8);
+  }
+  state->sum = app_checksum_fold(state->sum + sum);
+  state->is_odd ^= (count & 1);
+}
+
+uint16_t APP_Checksum_Finish(const AppChecksumState* state) {
+  return ~app_checksum_fold(state->sum);
+}
+
+uint16_t APP_Checksum_FromTotal(uint16_t total,
+                                const uint8_t* data,
+                                uint16_t size,
+                                uint16_t start,
+                                uint16_t count,
+                                uint16_t seed) {
+  static const uint8_t zero = 0;
+  const uint16_t end = start + count;
+  AppChecksumState outside;
+  uint32_t sum;
+  // Bytes before and after the range, the latter at their position in the
+  // whole data: a zero byte shifts them when the range has odd length.
+  APP_Checksum_Start(&outside, 0);
+  APP_Checksum_Add(&outside, data, start);
+  if ((count & 1) != 0) {
+    APP_Checksum_Add(&outside, &zero, 1);
+  }
+  APP_Checksum_Add(&outside, data + end, size - end);
+  // Sum of the whole data minus the outside one, one's complement
+  // subtraction is addition of the complement.
+  sum = app_checksum_fold((uint16_t)~total + APP_Checksum_Finish(&outside));
+  if ((start & 1) != 0) {
+    // Range's words are shifted by one byte in the whole data.
+    sum = ((sum & 0xff) << 8) | (sum >> 8);
+  }
+  return ~app_checksum_fold(sum + seed);
+}
+
+uint16_t APP_Checksum_Reference(const uint8_t* buffer,
+                                uint16_t count,
+                                uint16_t seed) {
+  uint32_t sum = seed;
+  uint16_t i;
+  for (i = 0; i + 1 < count; i += 2) {
+    sum += (uint32_t)buffer[i] | ((uint32_t)buffer[i + 1] << 8);
+  }
+  if ((count & 1) != 0) {
+    sum += buffer[count - 1];
+  }
+  return ~app_checksum_fold(sum);
+}
+
+static const uint32_t g_checksum_crc32_table[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+  0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+  0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t APP_Checksum_CRC32(uint32_t crc, const uint8_t* buffer, size_t count) {
+  crc = ~crc;
+  while (count-- != 0) {
+    crc ^= *buffer++;
+    crc = (crc >> 4) ^ g_checksum_crc32_table[crc & 0x0f];
+    crc = (crc >> 4) ^ g_checksum_crc32_table[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+// Linker redirects all calls of TCPIP_Helper_CalcIPChecksum() here.
+uint16_t __wrap_TCPIP_Helper_CalcIPChecksum(const uint8_t* buffer,
+                                            uint16_t count,
+                                            uint16_t seed) {
+  return APP_Checksum_Calc(buffer, count, seed);
+}
+
+// Linker redirects all calls of TCPIP_Helper_PacketChecksum() here: checksum
+// of len bytes starting at start_address, which may continue through the
+// following data segments of the packet.
+uint16_t __wrap_TCPIP_Helper_PacketChecksum(TCPIP_MAC_PACKET* packet,
+                                            uint8_t* start_address,
+                                            uint16_t len,
+                                            uint16_t seed) {
+  TCPIP_MAC_DATA_SEGMENT* segment = packet->pDSeg;
+  AppChecksumState state;
+  while (segment != NULL &&
+         !(start_address >= segment->segLoad &&
+           start_address < segment->segLoad + segment->segLen)) {
+    segment = segment->next;
+  }
+  if (segment == NULL) {
+    return 0;
+  }
+  APP_Checksum_Start(&state, seed);
+  while (segment != NULL && len != 0) {
+    uint16_t count =
+        segment->segLen - (uint16_t)(start_address - segment->segLoad);
+    if (count > len) {
+      count = len;
+    }
+    APP_Checksum_Add(&state, start_address, count);
+    len -= count;
+    segment = segment->next;
+    if (segment != NULL) {
+      start_address = segment->segLoad;
+    }
+  }
+  return APP_Checksum_Finish(&state);
+}
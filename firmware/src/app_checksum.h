@@ -0,0 +1,80 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_CHECKSUM_H
+#define _APP_CHECKSUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Internet (one's complement) checksum, drop-in replacement for
+// TCPIP_Helper_CalcIPChecksum(): words are summed in native byte order,
+// seed is added to the sum and the complement of the folded sum is returned.
+//
+// The stack is linked with --wrap=TCPIP_Helper_CalcIPChecksum and
+// --wrap=TCPIP_Helper_PacketChecksum, so calls of both generic routines from
+// the stack modules (IPv4 header, ICMP, TCP and UDP over whole packets) end
+// up here. --wrap does not redirect calls within tcpip_helpers.c itself, so
+// TCPIP_Helper_PacketChecksum() is replaced as a whole rather than relying
+// on it calling the wrapped routine.
+uint16_t APP_Checksum_Calc(const uint8_t* buffer, uint16_t count, uint16_t seed);
+
+// Checksum of data which is split into several buffers, same as of all the
+// buffers concatenated. Buffers may have odd lengths.
+typedef struct {
+  uint32_t sum;
+  // Data added so far has odd length, next buffer starts at the high byte.
+  bool is_odd;
+} AppChecksumState;
+
+void APP_Checksum_Start(AppChecksumState* state, uint16_t seed);
+void APP_Checksum_Add(AppChecksumState* state,
+                      const uint8_t* buffer,
+                      uint16_t count);
+uint16_t APP_Checksum_Finish(const AppChecksumState* state);
+
+// Checksum of count bytes at offset start within data of the given size,
+// same as APP_Checksum_Calc() of them, from the checksum of the whole data
+// (total is APP_Checksum_Calc(data, size, 0)). Only bytes outside the range
+// are summed, which makes checksum offload of hardware which sums whole
+// frames cheap. Zero sums may come out as 0xffff instead of 0 and the other
+// way round, data with a valid checksum gives 0 either way.
+uint16_t APP_Checksum_FromTotal(uint16_t total,
+                                const uint8_t* data,
+                                uint16_t size,
+                                uint16_t start,
+                                uint16_t count,
+                                uint16_t seed);
+
+// Straightforward 16-bit at a time implementation, same as the one in the
+// stack. Used to verify and benchmark the optimized one.
+uint16_t APP_Checksum_Reference(const uint8_t* buffer,
+                                uint16_t count,
+                                uint16_t seed);
+
+// CRC-32 (IEEE 802.3, same as zlib's crc32()) continuing from the given CRC,
+// 0 to start. Half-byte table, for flash images and records where 64 bytes
+// of table matter more than speed.
+uint32_t APP_Checksum_CRC32(uint32_t crc, const uint8_t* buffer, size_t count);
+
+#endif  // _APP_CHECKSUM_H
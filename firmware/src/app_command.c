@@ -22,12 +22,345 @@
 
 #include "app_command.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_bench.h"
+#include "app_ethmac.h"
+#include "app_hid_bridge.h"
+#include "app_irq_latency.h"
+#include "app_kv.h"
+#include "app_log.h"
 #include "app_network.h"
+#include "app_ota.h"
+#include "app_profile.h"
+#include "app_stack.h"
+#include "app_tcp_tuner.h"
+#include "app_tls.h"
+#include "app_trace.h"
 #include "system_definitions.h"
 
 static AppData* g_app_data;
 
+static int app_command_boottime(SYS_CMD_DEVICE_NODE* cmd_io,
+                                int argc,
+                                char** argv) {
+  APP_Profile_BootPrint(cmd_io);
+  return 0;
+}
+
+static int app_command_log(SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc,
+                           char** argv) {
+  AppLogStats stats;
+  APP_Log_StatsGet(&stats);
+  APP_CMD_PRINT(cmd_io, "Log: written %u, dropped %u, pending %u, "
+                "max pending %u of %u\r\n",
+                stats.num_written, stats.num_dropped, stats.num_pending,
+                stats.max_pending, APP_LOG_RING_SIZE);
+  return 0;
+}
+
+static int app_command_loop(SYS_CMD_DEVICE_NODE* cmd_io,
+                            int argc,
+                            char** argv) {
+  APP_Profile_LoopPrint(cmd_io);
+  if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+    APP_Profile_LoopStatsReset();
+  }
+  return 0;
+}
+
+static int app_command_stack(SYS_CMD_DEVICE_NODE* cmd_io,
+                             int argc,
+                             char** argv) {
+  APP_Stack_Print(cmd_io);
+  if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+    APP_Stack_Reset();
+  }
+  return 0;
+}
+
+static int app_command_bench(SYS_CMD_DEVICE_NODE* cmd_io,
+                             int argc,
+                             char** argv) {
+  AppBenchData* app_bench_data = &g_app_data->bench;
+  if (argc >= 3 && strcmp(argv[1], "net") == 0) {
+    IPV4_ADDR peer_address;
+    uint32_t duration = APP_BENCH_DEFAULT_DURATION;
+    if (!TCPIP_Helper_StringToIPAddress(argv[2], &peer_address)) {
+      APP_CMD_PRINT(cmd_io, "Invalid peer address: %s\r\n", argv[2]);
+      return 0;
+    }
+    if (argc >= 4) {
+      duration = atoi(argv[3]);
+    }
+    if (!APP_Bench_NetStart(app_bench_data, peer_address, duration)) {
+      APP_CMD_PRINT(cmd_io, "Benchmark is already running\r\n");
+    }
+    return 0;
+  }
+  if (argc >= 2 && strcmp(argv[1], "stop") == 0) {
+    APP_Bench_Stop(app_bench_data);
+    return 0;
+  }
+  if (argc >= 2 && strcmp(argv[1], "cksum") == 0) {
+    APP_Bench_Checksum(cmd_io);
+    return 0;
+  }
+  if (argc >= 2 && strcmp(argv[1], "compress") == 0) {
+    APP_Bench_Compress(cmd_io);
+    return 0;
+  }
+  if (argc >= 2 && strcmp(argv[1], "crypto") == 0) {
+    APP_Bench_Crypto(cmd_io);
+    return 0;
+  }
+  if (argc >= 2 && strcmp(argv[1], "kv") == 0) {
+    APP_Bench_KV(cmd_io);
+    return 0;
+  }
+  APP_CMD_PRINT(cmd_io, "Usage: bench net <peer address> [seconds]\r\n"
+                        "       bench stop\r\n"
+                        "       bench cksum\r\n"
+                        "       bench compress\r\n"
+                        "       bench crypto\r\n"
+                        "       bench kv\r\n");
+  return 0;
+}
+
+static int app_command_tcptune(SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc,
+                               char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "on") == 0) {
+    APP_TCP_Tuner_Enable(true);
+  } else if (argc >= 2 && strcmp(argv[1], "off") == 0) {
+    APP_TCP_Tuner_Enable(false);
+  }
+  APP_TCP_Tuner_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_hidbridge(SYS_CMD_DEVICE_NODE* cmd_io,
+                                 int argc,
+                                 char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+    APP_HID_Bridge_StatsReset();
+  } else if (argc >= 3 && strcmp(argv[1], "compress") == 0) {
+    APP_HID_Bridge_CompressEnable(strcmp(argv[2], "on") == 0);
+  } else if (argc >= 3 && strcmp(argv[1], "flow") == 0) {
+    APP_HID_Bridge_FlowControlEnable(strcmp(argv[2], "on") == 0);
+  } else if (argc >= 3 && strcmp(argv[1], "slow") == 0) {
+    APP_HID_Bridge_SlowPolicySet((strcmp(argv[2], "drop") == 0)
+                                     ? APP_HID_BRIDGE_SLOW_DISCONNECT
+                                     : APP_HID_BRIDGE_SLOW_LAG);
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: hidbridge [reset]\r\n"
+                          "       hidbridge compress <on|off>\r\n"
+                          "       hidbridge flow <on|off>\r\n"
+                          "       hidbridge slow <lag|drop>\r\n");
+    return 0;
+  }
+  APP_HID_Bridge_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_eth(SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc,
+                           char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "off") == 0) {
+    APP_ETHMAC_CoalesceSet(0, APP_ETHMAC_COALESCE_TIMEOUT);
+  } else if (argc >= 4 && strcmp(argv[1], "coalesce") == 0) {
+    char* frames_end;
+    char* timeout_end;
+    const unsigned long num_frames = strtoul(argv[2], &frames_end, 10);
+    const unsigned long timeout = strtoul(argv[3], &timeout_end, 10);
+    if (*argv[2] == '\0' || *frames_end != '\0' ||
+        *argv[3] == '\0' || *timeout_end != '\0' ||
+        !APP_ETHMAC_CoalesceSet(num_frames, timeout)) {
+      APP_CMD_PRINT(cmd_io, "Frames must be 0..%u, timeout 1..%u us\r\n",
+                    (uint32_t)APP_ETHMAC_COALESCE_MAX_FRAMES,
+                    (uint32_t)APP_ETHMAC_COALESCE_MAX_TIMEOUT);
+      return 0;
+    }
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: eth [coalesce <frames> <microseconds>]\r\n"
+                          "       eth off\r\n");
+    return 0;
+  }
+  APP_ETHMAC_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_tls(SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc,
+                           char** argv) {
+  if (argc >= 4 && strcmp(argv[1], "psk") == 0) {
+    if (!APP_TLS_PSKSet(argv[2], argv[3])) {
+      APP_CMD_PRINT(cmd_io, "Invalid identity or key\r\n");
+      return 0;
+    }
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: tls\r\n"
+                          "       tls psk <identity> <hex key>\r\n");
+    return 0;
+  }
+  APP_TLS_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_ota(SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc,
+                           char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "arm") == 0) {
+    APP_OTA_Arm(argc >= 3 ? atoi(argv[2]) : APP_OTA_DEFAULT_ARM_TIMEOUT);
+  } else if (argc >= 2 && strcmp(argv[1], "disarm") == 0) {
+    APP_OTA_Disarm();
+  } else if (argc >= 2 && strcmp(argv[1], "install") == 0) {
+    if (!APP_OTA_Install()) {
+      APP_CMD_PRINT(cmd_io, "No staged image\r\n");
+      return 0;
+    }
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: ota\r\n"
+                          "       ota arm [seconds]\r\n"
+                          "       ota disarm\r\n"
+                          "       ota install\r\n");
+    return 0;
+  }
+  APP_OTA_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_kv(SYS_CMD_DEVICE_NODE* cmd_io,
+                          int argc,
+                          char** argv) {
+  if (argc >= 3 && strcmp(argv[1], "get") == 0) {
+    char value[APP_KV_MAX_VALUE_SIZE + 1];
+    const int size = APP_KV_Get(argv[2], value, APP_KV_MAX_VALUE_SIZE);
+    if (size < 0) {
+      APP_CMD_PRINT(cmd_io, "No such key\r\n");
+    } else {
+      value[size] = '\0';
+      APP_CMD_PRINT(cmd_io, "%s\r\n", value);
+    }
+    return 0;
+  } else if (argc >= 4 && strcmp(argv[1], "set") == 0) {
+    if (!APP_KV_Set(argv[2], argv[3], strlen(argv[3]))) {
+      APP_CMD_PRINT(cmd_io, "Failed to set key\r\n");
+      return 0;
+    }
+  } else if (argc >= 3 && strcmp(argv[1], "del") == 0) {
+    if (!APP_KV_Delete(argv[2])) {
+      APP_CMD_PRINT(cmd_io, "Failed to delete key\r\n");
+      return 0;
+    }
+  } else if (argc >= 2 && strcmp(argv[1], "format") == 0) {
+    if (!APP_KV_Format()) {
+      APP_CMD_PRINT(cmd_io, "Failed to format\r\n");
+      return 0;
+    }
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: kv\r\n"
+                          "       kv get <key>\r\n"
+                          "       kv set <key> <value>\r\n"
+                          "       kv del <key>\r\n"
+                          "       kv format\r\n");
+    return 0;
+  }
+  APP_KV_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_net(SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc,
+                           char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "save") == 0) {
+    APP_CMD_PRINT(cmd_io, APP_Network_ConfigSave()
+                              ? "Saved, is used from the next boot\r\n"
+                              : "Failed to save configuration\r\n");
+  } else if (argc >= 2 && strcmp(argv[1], "forget") == 0) {
+    APP_CMD_PRINT(cmd_io, APP_Network_ConfigForget()
+                              ? "Defaults are used from the next boot\r\n"
+                              : "Failed to delete configuration\r\n");
+  } else {
+    APP_CMD_PRINT(cmd_io, "Usage: net save\r\n"
+                          "       net forget\r\n");
+  }
+  return 0;
+}
+
+static int app_command_trace(SYS_CMD_DEVICE_NODE* cmd_io,
+                             int argc,
+                             char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "on") == 0) {
+    APP_Trace_Enable(true);
+  } else if (argc >= 2 && strcmp(argv[1], "off") == 0) {
+    APP_Trace_Enable(false);
+  } else if (argc >= 2 && strcmp(argv[1], "clear") == 0) {
+    APP_Trace_Clear();
+  } else if (argc >= 2 && strcmp(argv[1], "dump") == 0) {
+    IPV4_ADDR peer_address;
+    if (argc >= 3 &&
+        !TCPIP_Helper_StringToIPAddress(argv[2], &peer_address)) {
+      APP_CMD_PRINT(cmd_io, "Invalid peer address: %s\r\n", argv[2]);
+      return 0;
+    }
+    if (!APP_Trace_DumpStart(argc >= 3 ? &peer_address : NULL,
+                             argc >= 4 ? atoi(argv[3])
+                                       : APP_TRACE_DEFAULT_PORT)) {
+      APP_CMD_PRINT(cmd_io, "Failed to start dump\r\n");
+    }
+    return 0;
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: trace [on|off|clear]\r\n"
+                          "       trace dump [<peer address> [port]]\r\n");
+    return 0;
+  }
+  APP_Trace_Print(cmd_io);
+  return 0;
+}
+
+static int app_command_irqlat(SYS_CMD_DEVICE_NODE* cmd_io,
+                              int argc,
+                              char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "start") == 0) {
+    const int level = (argc >= 3) ? atoi(argv[2]) : 0;
+    if (!APP_IRQ_Latency_Start(level)) {
+      APP_CMD_PRINT(cmd_io, "Invalid priority level %s\r\n", argv[2]);
+    }
+    return 0;
+  } else if (argc >= 2 && strcmp(argv[1], "stop") == 0) {
+    APP_IRQ_Latency_Stop();
+  } else if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+    APP_IRQ_Latency_StatsReset();
+    return 0;
+  } else if (argc >= 2 && strcmp(argv[1], "isr") == 0) {
+    APP_IRQ_Latency_RoundtripPrint(cmd_io);
+    return 0;
+  } else if (argc >= 2) {
+    APP_CMD_PRINT(cmd_io, "Usage: irqlat [start [<level 1..7>]|stop|reset|isr]\r\n");
+    return 0;
+  }
+  APP_IRQ_Latency_Print(cmd_io);
+  return 0;
+}
+
 static const SYS_CMD_DESCRIPTOR commands[] = {
+  {"boottime", app_command_boottime, ": show boot phases timing"},
+  {"log", app_command_log, ": show deferred logger statistics"},
+  {"loop", app_command_loop, ": show super-loop timing [reset]"},
+  {"stack", app_command_stack, ": show stack usage [reset]"},
+  {"irqlat", app_command_irqlat, ": interrupt latency probe [start|stop|reset|isr]"},
+  {"bench", app_command_bench, ": run network benchmark"},
+  {"eth", app_command_eth, ": Ethernet interrupt coalescing and counters"},
+  {"tcptune", app_command_tcptune, ": TCP buffer tuner [on|off]"},
+  {"hidbridge", app_command_hidbridge, ": HID bridge [reset|compress|flow|slow]"},
+  {"tls", app_command_tls, ": TLS handshake statistics [psk]"},
+  {"ota", app_command_ota, ": firmware update [arm|disarm|install]"},
+  {"kv", app_command_kv, ": key-value store [get|set|del|format]"},
+  {"net", app_command_net, ": network configuration [save|forget]"},
+  {"trace", app_command_trace, ": event tracer [on|off|clear|dump]"},
 };
 
 void APP_Command_Initialize(AppData* app_data) {
@@ -25,6 +25,17 @@
 
 #include "app.h"
 
+// Print formatted message to the command I/O which invoked the command.
+// When cmd_io is NULL the message goes to the system console.
+#define APP_CMD_PRINT(cmd_io, ...)                                    \
+  do {                                                                \
+    if ((cmd_io) != NULL) {                                           \
+      (*(cmd_io)->pCmdApi->print)((cmd_io)->cmdIoParam, __VA_ARGS__); \
+    } else {                                                          \
+      SYS_CONSOLE_PRINT(__VA_ARGS__);                                 \
+    }                                                                 \
+  } while (0)
+
 void APP_Command_Initialize(AppData* app_data);
 
 #endif  // _APP_COMMAND_H
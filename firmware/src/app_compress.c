@@ -0,0 +1,179 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_compress.h"
+
+#include <string.h>
+
+#define APP_COMPRESS_WINDOW_MASK (APP_COMPRESS_WINDOW_SIZE - 1)
+
+static uint32_t app_compress_hash(const uint8_t* data) {
+  const uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+  return (value * 2654435761u) >> (32 - APP_COMPRESS_HASH_BITS);
+}
+
+// Append item to the group, write the group out once it is complete.
+static uint32_t app_compress_item_add(AppCompressStream* stream,
+                                      const uint8_t* item,
+                                      int item_size,
+                                      bool is_match,
+                                      uint8_t* output) {
+  uint32_t size = 0;
+  if (stream->num_group_items == 0) {
+    stream->group[0] = 0;
+    stream->group_size = 1;
+  }
+  if (is_match) {
+    stream->group[0] |= 1 << stream->num_group_items;
+  }
+  memcpy(stream->group + stream->group_size, item, item_size);
+  stream->group_size += item_size;
+  if (++stream->num_group_items == 8) {
+    memcpy(output, stream->group, stream->group_size);
+    size = stream->group_size;
+    stream->num_group_items = 0;
+  }
+  return size;
+}
+
+static uint32_t app_compress_match_add(AppCompressStream* stream,
+                                       uint32_t distance,
+                                       uint32_t length,
+                                       uint8_t* output) {
+  const uint32_t value =
+      (distance << 5) | (length - APP_COMPRESS_MIN_MATCH);
+  const uint8_t item[2] = {value >> 8, value & 0xff};
+  return app_compress_item_add(stream, item, 2, true, output);
+}
+
+void APP_Compress_Reset(AppCompressStream* stream) {
+  memset(stream->hash_table, 0, sizeof(stream->hash_table));
+  stream->position = 0;
+  stream->group_size = 0;
+  stream->num_group_items = 0;
+}
+
+uint32_t APP_Compress_Update(AppCompressStream* stream,
+                             const uint8_t* input,
+                             uint32_t input_size,
+                             uint8_t* output) {
+  uint8_t* window = stream->window;
+  uint32_t size = 0;
+  uint32_t i = 0;
+  while (i < input_size) {
+    const uint32_t position = stream->position;
+    uint32_t length = 0, distance = 0, j;
+    if (input_size - i >= APP_COMPRESS_MIN_MATCH) {
+      const uint32_t hash = app_compress_hash(input + i);
+      distance = (uint16_t)(position - stream->hash_table[hash]);
+      stream->hash_table[hash] = position;
+      if (distance != 0 && distance < APP_COMPRESS_WINDOW_SIZE &&
+          distance <= position) {
+        uint32_t max_length = input_size - i;
+        if (max_length > APP_COMPRESS_MAX_MATCH) {
+          max_length = APP_COMPRESS_MAX_MATCH;
+        }
+        // Source of the match runs from the window into the input when the
+        // match overlaps itself.
+        while (length < max_length) {
+          const uint8_t source =
+              (length < distance)
+                  ? window[(position - distance + length) &
+                           APP_COMPRESS_WINDOW_MASK]
+                  : input[i + length - distance];
+          if (source != input[i + length]) {
+            break;
+          }
+          ++length;
+        }
+      }
+    }
+    if (length < APP_COMPRESS_MIN_MATCH) {
+      length = 1;
+      size += app_compress_item_add(stream, input + i, 1, false,
+                                    output + size);
+    } else {
+      size += app_compress_match_add(stream, distance, length,
+                                     output + size);
+    }
+    for (j = 0; j < length; ++j) {
+      window[(position + j) & APP_COMPRESS_WINDOW_MASK] = input[i + j];
+    }
+    stream->position += length;
+    i += length;
+  }
+  return size;
+}
+
+uint32_t APP_Compress_Flush(AppCompressStream* stream, uint8_t* output) {
+  uint32_t size;
+  if (stream->num_group_items == 0) {
+    return 0;
+  }
+  // Sync marker always fits: complete groups are written out immediately.
+  size = app_compress_match_add(stream, 0, APP_COMPRESS_MIN_MATCH, output);
+  if (size == 0) {
+    memcpy(output, stream->group, stream->group_size);
+    size = stream->group_size;
+    stream->num_group_items = 0;
+  }
+  return size;
+}
+
+int32_t APP_Compress_Decode(const uint8_t* input,
+                            uint32_t input_size,
+                            uint8_t* output,
+                            uint32_t output_size) {
+  uint32_t i = 0, size = 0;
+  while (i < input_size) {
+    const uint8_t flags = input[i++];
+    int item;
+    for (item = 0; item < 8 && i < input_size; ++item) {
+      uint32_t value, distance, length;
+      if ((flags & (1 << item)) == 0) {
+        if (size == output_size) {
+          return -1;
+        }
+        output[size++] = input[i++];
+        continue;
+      }
+      if (i + 2 > input_size) {
+        return -1;
+      }
+      value = (input[i] << 8) | input[i + 1];
+      i += 2;
+      distance = value >> 5;
+      length = (value & 31) + APP_COMPRESS_MIN_MATCH;
+      if (distance == 0) {
+        break;
+      }
+      if (distance > size || size + length > output_size) {
+        return -1;
+      }
+      // Byte at a time, source might overlap the destination.
+      for (; length != 0; --length, ++size) {
+        output[size] = output[size - distance];
+      }
+    }
+  }
+  return size;
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_COMPRESS_H
+#define _APP_COMPRESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming LZSS compression of outbound application streams.
+//
+// Designed for small RAM and CPU budget rather than ratio: history window is
+// 2 KB, and match search does a single probe of a hash table of recent
+// positions. Matches may reference any data compressed since the stream
+// started, so repetitive traffic like HID reports compresses well even when
+// it is fed a record at a time.
+//
+// Stream format: items go in groups of up to eight, every group starts with
+// a flags byte whose bits (LSB first) tell whether the item is a literal
+// byte (0) or a match (1). Match is two big-endian bytes of
+// (distance << 5) | (length - 3), distance is 1..2047 and length is 3..34.
+// Match with zero distance is a sync marker which terminates the group
+// early, it is emitted on flush so the receiver can decode everything sent
+// so far. tools/hid_bridge_client.py has the matching decoder.
+
+#define APP_COMPRESS_WINDOW_BITS 11
+#define APP_COMPRESS_WINDOW_SIZE (1 << APP_COMPRESS_WINDOW_BITS)
+#define APP_COMPRESS_HASH_BITS 9
+#define APP_COMPRESS_MIN_MATCH 3
+#define APP_COMPRESS_MAX_MATCH (APP_COMPRESS_MIN_MATCH + 31)
+
+// Flags byte and eight two-byte items.
+#define APP_COMPRESS_GROUP_SIZE 17
+
+// Worst case size of output of compressing the given number of bytes and
+// flushing afterwards, including output of data which was buffered before.
+#define APP_COMPRESS_BOUND(size) \
+    ((size) + (size) / 8 + 2 * APP_COMPRESS_GROUP_SIZE)
+
+typedef struct {
+  uint8_t window[APP_COMPRESS_WINDOW_SIZE];
+  // Low 16 bits of stream position where every hash was last seen.
+  uint16_t hash_table[1 << APP_COMPRESS_HASH_BITS];
+  // Number of bytes compressed since the stream started.
+  uint32_t position;
+
+  // Group which is being formed.
+  uint8_t group[APP_COMPRESS_GROUP_SIZE];
+  uint8_t group_size;
+  uint8_t num_group_items;
+} AppCompressStream;
+
+// Start new stream, the receiver is to start a new decoder as well.
+void APP_Compress_Reset(AppCompressStream* stream);
+
+// Compress input into the output buffer, which is to have room for
+// APP_COMPRESS_BOUND(input_size) bytes. Some of the output might be kept
+// in the stream until the group is complete or the stream is flushed.
+// Returns number of bytes written to the output.
+uint32_t APP_Compress_Update(AppCompressStream* stream,
+                             const uint8_t* input,
+                             uint32_t input_size,
+                             uint8_t* output);
+
+// Write out buffered output, which takes up to APP_COMPRESS_GROUP_SIZE
+// bytes. Returns number of bytes written.
+uint32_t APP_Compress_Flush(AppCompressStream* stream, uint8_t* output);
+
+// Decompress complete stream into the output buffer.
+// Returns size of decompressed data, or -1 if the stream is malformed or
+// doesn't fit into the output.
+int32_t APP_Compress_Decode(const uint8_t* input,
+                            uint32_t input_size,
+                            uint8_t* output,
+                            uint32_t output_size);
+
+#endif  // _APP_COMPRESS_H
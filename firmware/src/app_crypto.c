@@ -0,0 +1,783 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_crypto.h"
+
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#  error "Crypto kernels assume little-endian byte order"
+#endif
+
+#ifdef __XC32
+#  include <sys/attribs.h>
+#  define APP_CRYPTO_RAMFUNC __longramfunc__
+#else
+#  define APP_CRYPTO_RAMFUNC
+#endif
+
+#define APP_CRYPTO_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define APP_CRYPTO_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// Compiles to LWL/LWR and SWL/SWR pairs, so buffers need no alignment.
+static inline uint32_t app_crypto_load32(const uint8_t* buffer) {
+  uint32_t word;
+  memcpy(&word, buffer, sizeof(word));
+  return word;
+}
+
+static inline void app_crypto_store32(uint8_t* buffer, uint32_t word) {
+  memcpy(buffer, &word, sizeof(word));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ChaCha20.
+
+#define APP_CRYPTO_QUARTER_ROUND(a, b, c, d) \
+  do {                                       \
+    a += b; d ^= a; d = APP_CRYPTO_ROTL(d, 16); \
+    c += d; b ^= c; b = APP_CRYPTO_ROTL(b, 12); \
+    a += b; d ^= a; d = APP_CRYPTO_ROTL(d, 8);  \
+    c += d; b ^= c; b = APP_CRYPTO_ROTL(b, 7);  \
+  } while (0)
+
+// XOR one block of up to 64 bytes with the key stream of the given state.
+APP_CRYPTO_RAMFUNC
+static void app_crypto_chacha20_block(const uint32_t state[16],
+                                      const uint8_t* input,
+                                      uint8_t* output,
+                                      size_t size) {
+  uint32_t x0 = state[0], x1 = state[1], x2 = state[2], x3 = state[3];
+  uint32_t x4 = state[4], x5 = state[5], x6 = state[6], x7 = state[7];
+  uint32_t x8 = state[8], x9 = state[9], x10 = state[10], x11 = state[11];
+  uint32_t x12 = state[12], x13 = state[13], x14 = state[14];
+  uint32_t x15 = state[15];
+  uint32_t stream[16];
+  size_t i;
+  for (i = 0; i < 10; ++i) {
+    APP_CRYPTO_QUARTER_ROUND(x0, x4, x8, x12);
+    APP_CRYPTO_QUARTER_ROUND(x1, x5, x9, x13);
+    APP_CRYPTO_QUARTER_ROUND(x2, x6, x10, x14);
+    APP_CRYPTO_QUARTER_ROUND(x3, x7, x11, x15);
+    APP_CRYPTO_QUARTER_ROUND(x0, x5, x10, x15);
+    APP_CRYPTO_QUARTER_ROUND(x1, x6, x11, x12);
+    APP_CRYPTO_QUARTER_ROUND(x2, x7, x8, x13);
+    APP_CRYPTO_QUARTER_ROUND(x3, x4, x9, x14);
+  }
+  stream[0] = x0 + state[0];
+  stream[1] = x1 + state[1];
+  stream[2] = x2 + state[2];
+  stream[3] = x3 + state[3];
+  stream[4] = x4 + state[4];
+  stream[5] = x5 + state[5];
+  stream[6] = x6 + state[6];
+  stream[7] = x7 + state[7];
+  stream[8] = x8 + state[8];
+  stream[9] = x9 + state[9];
+  stream[10] = x10 + state[10];
+  stream[11] = x11 + state[11];
+  stream[12] = x12 + state[12];
+  stream[13] = x13 + state[13];
+  stream[14] = x14 + state[14];
+  stream[15] = x15 + state[15];
+  if (size == 64) {
+    for (i = 0; i < 16; ++i) {
+      app_crypto_store32(output + i * 4,
+                         app_crypto_load32(input + i * 4) ^ stream[i]);
+    }
+  } else {
+    const uint8_t* stream_bytes = (const uint8_t*)stream;
+    for (i = 0; i < size; ++i) {
+      output[i] = input[i] ^ stream_bytes[i];
+    }
+  }
+}
+
+void APP_Crypto_ChaCha20(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                         const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                         uint32_t counter,
+                         const uint8_t* input,
+                         uint8_t* output,
+                         size_t size) {
+  uint32_t state[16];
+  int i;
+  // "expand 32-byte k"
+  state[0] = 0x61707865;
+  state[1] = 0x3320646e;
+  state[2] = 0x79622d32;
+  state[3] = 0x6b206574;
+  for (i = 0; i < 8; ++i) {
+    state[4 + i] = app_crypto_load32(key + i * 4);
+  }
+  state[12] = counter;
+  state[13] = app_crypto_load32(nonce);
+  state[14] = app_crypto_load32(nonce + 4);
+  state[15] = app_crypto_load32(nonce + 8);
+  while (size != 0) {
+    const size_t block_size = size < 64 ? size : 64;
+    app_crypto_chacha20_block(state, input, output, block_size);
+    ++state[12];
+    input += block_size;
+    output += block_size;
+    size -= block_size;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Poly1305.
+
+#define APP_CRYPTO_LIMB_MASK 0x3ffffff
+
+static void app_crypto_poly1305_blocks(AppCryptoPoly1305* poly,
+                                       const uint8_t* data,
+                                       size_t size,
+                                       uint32_t hibit) {
+  const uint32_t r0 = poly->r[0], r1 = poly->r[1], r2 = poly->r[2];
+  const uint32_t r3 = poly->r[3], r4 = poly->r[4];
+  const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0 = poly->h[0], h1 = poly->h[1], h2 = poly->h[2];
+  uint32_t h3 = poly->h[3], h4 = poly->h[4];
+  while (size >= 16) {
+    uint64_t d0, d1, d2, d3, d4;
+    uint32_t c;
+    h0 += app_crypto_load32(data) & APP_CRYPTO_LIMB_MASK;
+    h1 += (app_crypto_load32(data + 3) >> 2) & APP_CRYPTO_LIMB_MASK;
+    h2 += (app_crypto_load32(data + 6) >> 4) & APP_CRYPTO_LIMB_MASK;
+    h3 += (app_crypto_load32(data + 9) >> 6) & APP_CRYPTO_LIMB_MASK;
+    h4 += (app_crypto_load32(data + 12) >> 8) | hibit;
+    // Limbs are below 2^27 and multipliers below 2^29, every product and
+    // the sum of five fits 64 bits: a MULTU and four MADDU per row.
+    d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 +
+         (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+    d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 +
+         (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+    d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 +
+         (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+    d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 +
+         (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+    d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 +
+         (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+    c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & APP_CRYPTO_LIMB_MASK;
+    d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & APP_CRYPTO_LIMB_MASK;
+    d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & APP_CRYPTO_LIMB_MASK;
+    d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & APP_CRYPTO_LIMB_MASK;
+    d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & APP_CRYPTO_LIMB_MASK;
+    h0 += c * 5; c = h0 >> 26; h0 &= APP_CRYPTO_LIMB_MASK;
+    h1 += c;
+    data += 16;
+    size -= 16;
+  }
+  poly->h[0] = h0;
+  poly->h[1] = h1;
+  poly->h[2] = h2;
+  poly->h[3] = h3;
+  poly->h[4] = h4;
+}
+
+void APP_Crypto_Poly1305Init(AppCryptoPoly1305* poly,
+                             const uint8_t key[APP_CRYPTO_POLY1305_KEY_SIZE]) {
+  int i;
+  // Clamped r, split into 26 bit limbs.
+  poly->r[0] = app_crypto_load32(key) & 0x3ffffff;
+  poly->r[1] = (app_crypto_load32(key + 3) >> 2) & 0x3ffff03;
+  poly->r[2] = (app_crypto_load32(key + 6) >> 4) & 0x3ffc0ff;
+  poly->r[3] = (app_crypto_load32(key + 9) >> 6) & 0x3f03fff;
+  poly->r[4] = (app_crypto_load32(key + 12) >> 8) & 0x00fffff;
+  for (i = 0; i < 5; ++i) {
+    poly->h[i] = 0;
+  }
+  for (i = 0; i < 4; ++i) {
+    poly->pad[i] = app_crypto_load32(key + 16 + i * 4);
+  }
+  poly->buffer_size = 0;
+}
+
+void APP_Crypto_Poly1305Update(AppCryptoPoly1305* poly,
+                               const uint8_t* data,
+                               size_t size) {
+  // Empty AAD may come as a NULL pointer.
+  if (size == 0) {
+    return;
+  }
+  if (poly->buffer_size != 0) {
+    size_t num_bytes = 16 - poly->buffer_size;
+    if (num_bytes > size) {
+      num_bytes = size;
+    }
+    memcpy(poly->buffer + poly->buffer_size, data, num_bytes);
+    poly->buffer_size += num_bytes;
+    data += num_bytes;
+    size -= num_bytes;
+    if (poly->buffer_size < 16) {
+      return;
+    }
+    app_crypto_poly1305_blocks(poly, poly->buffer, 16, 1 << 24);
+    poly->buffer_size = 0;
+  }
+  if (size >= 16) {
+    const size_t num_bytes = size & ~(size_t)15;
+    app_crypto_poly1305_blocks(poly, data, num_bytes, 1 << 24);
+    data += num_bytes;
+    size -= num_bytes;
+  }
+  memcpy(poly->buffer, data, size);
+  poly->buffer_size = size;
+}
+
+void APP_Crypto_Poly1305Final(AppCryptoPoly1305* poly,
+                              uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]) {
+  uint32_t h0, h1, h2, h3, h4, g0, g1, g2, g3, g4, c, mask;
+  uint64_t f;
+  if (poly->buffer_size != 0) {
+    // Partial block is padded with 1 followed by zeros instead of the
+    // 2^128 bit.
+    poly->buffer[poly->buffer_size] = 1;
+    memset(poly->buffer + poly->buffer_size + 1,
+           0,
+           16 - poly->buffer_size - 1);
+    app_crypto_poly1305_blocks(poly, poly->buffer, 16, 0);
+  }
+  h0 = poly->h[0];
+  h1 = poly->h[1];
+  h2 = poly->h[2];
+  h3 = poly->h[3];
+  h4 = poly->h[4];
+  // Fully carry h.
+  c = h1 >> 26; h1 &= APP_CRYPTO_LIMB_MASK;
+  h2 += c; c = h2 >> 26; h2 &= APP_CRYPTO_LIMB_MASK;
+  h3 += c; c = h3 >> 26; h3 &= APP_CRYPTO_LIMB_MASK;
+  h4 += c; c = h4 >> 26; h4 &= APP_CRYPTO_LIMB_MASK;
+  h0 += c * 5; c = h0 >> 26; h0 &= APP_CRYPTO_LIMB_MASK;
+  h1 += c;
+  // g = h + 5 - 2^130, select it without branches when h >= p.
+  g0 = h0 + 5; c = g0 >> 26; g0 &= APP_CRYPTO_LIMB_MASK;
+  g1 = h1 + c; c = g1 >> 26; g1 &= APP_CRYPTO_LIMB_MASK;
+  g2 = h2 + c; c = g2 >> 26; g2 &= APP_CRYPTO_LIMB_MASK;
+  g3 = h3 + c; c = g3 >> 26; g3 &= APP_CRYPTO_LIMB_MASK;
+  g4 = h4 + c - (1 << 26);
+  mask = (g4 >> 31) - 1;
+  h0 = (h0 & ~mask) | (g0 & mask);
+  h1 = (h1 & ~mask) | (g1 & mask);
+  h2 = (h2 & ~mask) | (g2 & mask);
+  h3 = (h3 & ~mask) | (g3 & mask);
+  h4 = (h4 & ~mask) | (g4 & mask);
+  // h = (h + pad) mod 2^128.
+  h0 = h0 | (h1 << 26);
+  h1 = (h1 >> 6) | (h2 << 20);
+  h2 = (h2 >> 12) | (h3 << 14);
+  h3 = (h3 >> 18) | (h4 << 8);
+  f = (uint64_t)h0 + poly->pad[0];
+  app_crypto_store32(tag, (uint32_t)f);
+  f = (uint64_t)h1 + poly->pad[1] + (f >> 32);
+  app_crypto_store32(tag + 4, (uint32_t)f);
+  f = (uint64_t)h2 + poly->pad[2] + (f >> 32);
+  app_crypto_store32(tag + 8, (uint32_t)f);
+  f = (uint64_t)h3 + poly->pad[3] + (f >> 32);
+  app_crypto_store32(tag + 12, (uint32_t)f);
+  memset(poly, 0, sizeof(*poly));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ChaCha20-Poly1305 AEAD.
+
+static void app_crypto_aead_tag(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                                const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                                const uint8_t* aad,
+                                size_t aad_size,
+                                const uint8_t* ciphertext,
+                                size_t size,
+                                uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]) {
+  static const uint8_t zeros[16] = {0};
+  uint8_t poly_key[APP_CRYPTO_POLY1305_KEY_SIZE] = {0};
+  uint8_t sizes[16];
+  AppCryptoPoly1305 poly;
+  // One time key is the first half of the key stream block 0.
+  APP_Crypto_ChaCha20(key, nonce, 0, poly_key, poly_key, sizeof(poly_key));
+  APP_Crypto_Poly1305Init(&poly, poly_key);
+  APP_Crypto_Poly1305Update(&poly, aad, aad_size);
+  APP_Crypto_Poly1305Update(&poly, zeros, (16 - aad_size % 16) % 16);
+  APP_Crypto_Poly1305Update(&poly, ciphertext, size);
+  APP_Crypto_Poly1305Update(&poly, zeros, (16 - size % 16) % 16);
+  app_crypto_store32(sizes, (uint32_t)aad_size);
+  app_crypto_store32(sizes + 4, 0);
+  app_crypto_store32(sizes + 8, (uint32_t)size);
+  app_crypto_store32(sizes + 12, 0);
+  APP_Crypto_Poly1305Update(&poly, sizes, sizeof(sizes));
+  APP_Crypto_Poly1305Final(&poly, tag);
+  memset(poly_key, 0, sizeof(poly_key));
+}
+
+void APP_Crypto_AEADEncrypt(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                            const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                            const uint8_t* aad,
+                            size_t aad_size,
+                            const uint8_t* input,
+                            uint8_t* output,
+                            size_t size,
+                            uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]) {
+  APP_Crypto_ChaCha20(key, nonce, 1, input, output, size);
+  app_crypto_aead_tag(key, nonce, aad, aad_size, output, size, tag);
+}
+
+bool APP_Crypto_AEADDecrypt(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                            const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                            const uint8_t* aad,
+                            size_t aad_size,
+                            const uint8_t* input,
+                            uint8_t* output,
+                            size_t size,
+                            const uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]) {
+  uint8_t expected_tag[APP_CRYPTO_POLY1305_TAG_SIZE];
+  uint8_t difference = 0;
+  int i;
+  app_crypto_aead_tag(key, nonce, aad, aad_size, input, size, expected_tag);
+  // Constant time, so timing tells nothing about how much of a forged tag
+  // matched.
+  for (i = 0; i < APP_CRYPTO_POLY1305_TAG_SIZE; ++i) {
+    difference |= expected_tag[i] ^ tag[i];
+  }
+  if (difference != 0) {
+    return false;
+  }
+  APP_Crypto_ChaCha20(key, nonce, 1, input, output, size);
+  return true;
+}
+
+void APP_Crypto_AEADSeal(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                         const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                         const uint8_t* aad,
+                         size_t aad_size,
+                         uint8_t* data,
+                         size_t size,
+                         uint8_t* mac,
+                         size_t mac_size) {
+  APP_Crypto_AEADEncrypt(key, nonce, aad, aad_size, data, data, size, mac);
+  memset(mac + APP_CRYPTO_POLY1305_TAG_SIZE, 0,
+         mac_size - APP_CRYPTO_POLY1305_TAG_SIZE);
+}
+
+bool APP_Crypto_AEADOpen(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                         const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                         const uint8_t* aad,
+                         size_t aad_size,
+                         uint8_t* data,
+                         size_t size,
+                         const uint8_t* mac,
+                         size_t mac_size) {
+  uint8_t padding = 0;
+  size_t i;
+  for (i = APP_CRYPTO_POLY1305_TAG_SIZE; i < mac_size; ++i) {
+    padding |= mac[i];
+  }
+  return padding == 0 &&
+         APP_Crypto_AEADDecrypt(key, nonce, aad, aad_size, data, data, size,
+                                mac);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AES.
+
+// Column words are little-endian, row 0 in the low byte. T0 holds one
+// MixColumns column of the S-box output (2s, s, s, 3s); rows 1..3 are
+// rotations of it, so one 1 KB table in RAM serves all of them. The S-box
+// itself is byte 1 of T0.
+static uint32_t g_crypto_aes_table[256];
+static bool g_crypto_aes_table_ready = false;
+
+static inline uint8_t app_crypto_xtime(uint8_t x) {
+  return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static inline uint32_t app_crypto_aes_sbox(uint32_t x) {
+  return (g_crypto_aes_table[x] >> 8) & 0xff;
+}
+
+// S-box is computed rather than stored: walk the multiplicative group with
+// generator 3 and its inverse together, then apply the affine transform.
+static void app_crypto_aes_table_init(void) {
+  uint8_t p = 1, q = 1;
+  int i;
+  g_crypto_aes_table[0] = 0x63;
+  do {
+    uint8_t s;
+    p = p ^ app_crypto_xtime(p);
+    q ^= q << 1;
+    q ^= q << 2;
+    q ^= q << 4;
+    if (q & 0x80) {
+      q ^= 0x09;
+    }
+    s = q ^ (uint8_t)((q << 1) | (q >> 7)) ^ (uint8_t)((q << 2) | (q >> 6)) ^
+        (uint8_t)((q << 3) | (q >> 5)) ^ (uint8_t)((q << 4) | (q >> 4));
+    g_crypto_aes_table[p] = s ^ 0x63;
+  } while (p != 1);
+  for (i = 0; i < 256; ++i) {
+    const uint32_t s = g_crypto_aes_table[i];
+    const uint32_t s2 = app_crypto_xtime(s);
+    g_crypto_aes_table[i] = s2 | (s << 8) | (s << 16) | ((s2 ^ s) << 24);
+  }
+  g_crypto_aes_table_ready = true;
+}
+
+static inline uint32_t app_crypto_aes_sub_word(uint32_t word) {
+  return app_crypto_aes_sbox(word & 0xff) |
+         (app_crypto_aes_sbox((word >> 8) & 0xff) << 8) |
+         (app_crypto_aes_sbox((word >> 16) & 0xff) << 16) |
+         (app_crypto_aes_sbox(word >> 24) << 24);
+}
+
+bool APP_Crypto_AESKeySet(AppCryptoAES* aes, const uint8_t* key, size_t size) {
+  const int key_words = size / 4;
+  int num_words, i;
+  uint8_t rcon = 1;
+  if (size != 16 && size != 24 && size != 32) {
+    return false;
+  }
+  if (!g_crypto_aes_table_ready) {
+    app_crypto_aes_table_init();
+  }
+  aes->num_rounds = key_words + 6;
+  num_words = 4 * (aes->num_rounds + 1);
+  for (i = 0; i < key_words; ++i) {
+    aes->round_keys[i] = app_crypto_load32(key + i * 4);
+  }
+  for (i = key_words; i < num_words; ++i) {
+    uint32_t word = aes->round_keys[i - 1];
+    if (i % key_words == 0) {
+      // RotWord moves byte 1 to byte 0, which is a right rotation of a
+      // little-endian word.
+      word = app_crypto_aes_sub_word(APP_CRYPTO_ROTR(word, 8)) ^ rcon;
+      rcon = app_crypto_xtime(rcon);
+    } else if (key_words > 6 && i % key_words == 4) {
+      word = app_crypto_aes_sub_word(word);
+    }
+    aes->round_keys[i] = aes->round_keys[i - key_words] ^ word;
+  }
+  return true;
+}
+
+#define APP_CRYPTO_AES_COLUMN(a, b, c, d, round_key)              \
+  (g_crypto_aes_table[(a) & 0xff] ^                              \
+   APP_CRYPTO_ROTL(g_crypto_aes_table[((b) >> 8) & 0xff], 8) ^   \
+   APP_CRYPTO_ROTL(g_crypto_aes_table[((c) >> 16) & 0xff], 16) ^ \
+   APP_CRYPTO_ROTL(g_crypto_aes_table[(d) >> 24], 24) ^          \
+   (round_key))
+
+#define APP_CRYPTO_AES_FINAL_COLUMN(a, b, c, d, round_key) \
+  ((app_crypto_aes_sbox((a) & 0xff) |                     \
+    (app_crypto_aes_sbox(((b) >> 8) & 0xff) << 8) |       \
+    (app_crypto_aes_sbox(((c) >> 16) & 0xff) << 16) |     \
+    (app_crypto_aes_sbox((d) >> 24) << 24)) ^             \
+   (round_key))
+
+APP_CRYPTO_RAMFUNC
+static void app_crypto_aes_encrypt_block(const AppCryptoAES* aes,
+                                         const uint8_t input[16],
+                                         uint8_t output[16]) {
+  const uint32_t* round_key = aes->round_keys;
+  uint32_t s0 = app_crypto_load32(input) ^ round_key[0];
+  uint32_t s1 = app_crypto_load32(input + 4) ^ round_key[1];
+  uint32_t s2 = app_crypto_load32(input + 8) ^ round_key[2];
+  uint32_t s3 = app_crypto_load32(input + 12) ^ round_key[3];
+  uint32_t t0, t1, t2, t3;
+  int round;
+  for (round = 1; round < aes->num_rounds; ++round) {
+    round_key += 4;
+    // ShiftRows: row r of column j comes from column j + r.
+    t0 = APP_CRYPTO_AES_COLUMN(s0, s1, s2, s3, round_key[0]);
+    t1 = APP_CRYPTO_AES_COLUMN(s1, s2, s3, s0, round_key[1]);
+    t2 = APP_CRYPTO_AES_COLUMN(s2, s3, s0, s1, round_key[2]);
+    t3 = APP_CRYPTO_AES_COLUMN(s3, s0, s1, s2, round_key[3]);
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+  round_key += 4;
+  app_crypto_store32(output,
+                     APP_CRYPTO_AES_FINAL_COLUMN(s0, s1, s2, s3, round_key[0]));
+  app_crypto_store32(output + 4,
+                     APP_CRYPTO_AES_FINAL_COLUMN(s1, s2, s3, s0, round_key[1]));
+  app_crypto_store32(output + 8,
+                     APP_CRYPTO_AES_FINAL_COLUMN(s2, s3, s0, s1, round_key[2]));
+  app_crypto_store32(output + 12,
+                     APP_CRYPTO_AES_FINAL_COLUMN(s3, s0, s1, s2, round_key[3]));
+}
+
+void APP_Crypto_AESCTR(const AppCryptoAES* aes,
+                       uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE],
+                       const uint8_t* input,
+                       uint8_t* output,
+                       size_t size) {
+  uint8_t stream[APP_CRYPTO_AES_BLOCK_SIZE];
+  while (size != 0) {
+    const size_t block_size = size < sizeof(stream) ? size : sizeof(stream);
+    size_t i;
+    int j;
+    app_crypto_aes_encrypt_block(aes, counter, stream);
+    for (j = APP_CRYPTO_AES_BLOCK_SIZE - 1; j >= 0; --j) {
+      if (++counter[j] != 0) {
+        break;
+      }
+    }
+    if (block_size == sizeof(stream)) {
+      for (i = 0; i < sizeof(stream); i += 4) {
+        app_crypto_store32(output + i,
+                           app_crypto_load32(input + i) ^
+                           app_crypto_load32(stream + i));
+      }
+    } else {
+      for (i = 0; i < block_size; ++i) {
+        output[i] = input[i] ^ stream[i];
+      }
+    }
+    input += block_size;
+    output += block_size;
+    size -= block_size;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Self test.
+
+// RFC 8439 section 2.4.2.
+static const uint8_t g_crypto_test_chacha20_key[32] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+  0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+static const uint8_t g_crypto_test_chacha20_nonce[12] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00,
+};
+static const uint8_t g_crypto_test_chacha20_ciphertext[114] = {
+  0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80,
+  0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+  0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2,
+  0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+  0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab,
+  0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+  0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab,
+  0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+  0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61,
+  0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+  0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06,
+  0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+  0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6,
+  0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+  0x87, 0x4d,
+};
+
+// Plain text of RFC 8439 sections 2.4.2 and 2.8.2.
+static const char g_crypto_test_plaintext[] =
+    "Ladies and Gentlemen of the class of '99: If I could offer you only "
+    "one tip for the future, sunscreen would be it.";
+
+// RFC 8439 section 2.5.2.
+static const uint8_t g_crypto_test_poly1305_key[32] = {
+  0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33,
+  0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06, 0xa8,
+  0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd,
+  0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49, 0xf5, 0x1b,
+};
+static const char g_crypto_test_poly1305_message[] =
+    "Cryptographic Forum Research Group";
+static const uint8_t g_crypto_test_poly1305_tag[16] = {
+  0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6,
+  0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27, 0xa9,
+};
+
+// RFC 8439 section 2.8.2.
+static const uint8_t g_crypto_test_aead_key[32] = {
+  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+  0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
+};
+static const uint8_t g_crypto_test_aead_nonce[12] = {
+  0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43,
+  0x44, 0x45, 0x46, 0x47,
+};
+static const uint8_t g_crypto_test_aead_aad[12] = {
+  0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7,
+};
+static const uint8_t g_crypto_test_aead_ciphertext[114] = {
+  0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb,
+  0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef, 0x7e, 0xc2,
+  0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe,
+  0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6,
+  0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12,
+  0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+  0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29,
+  0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36,
+  0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c,
+  0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58,
+  0xfa, 0xb3, 0x24, 0xe4, 0xfa, 0xd6, 0x75, 0x94,
+  0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+  0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d,
+  0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+  0x61, 0x16,
+};
+static const uint8_t g_crypto_test_aead_tag[16] = {
+  0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a,
+  0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91,
+};
+
+// NIST SP 800-38A sections F.5.1 and F.5.5.
+static const uint8_t g_crypto_test_aes128_key[16] = {
+  0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+  0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+static const uint8_t g_crypto_test_aes256_key[32] = {
+  0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+  0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+  0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+  0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4,
+};
+static const uint8_t g_crypto_test_aes_counter[16] = {
+  0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+  0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff,
+};
+static const uint8_t g_crypto_test_aes_plaintext[64] = {
+  0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+  0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+  0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+  0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+  0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+  0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+  0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+  0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+static const uint8_t g_crypto_test_aes128_ciphertext[64] = {
+  0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+  0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+  0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+  0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+  0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e,
+  0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+  0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1,
+  0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee,
+};
+static const uint8_t g_crypto_test_aes256_ciphertext[64] = {
+  0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5,
+  0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+  0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a,
+  0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+  0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c,
+  0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+  0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6,
+  0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6,
+};
+
+#define APP_CRYPTO_TEST_PLAINTEXT_SIZE (sizeof(g_crypto_test_plaintext) - 1)
+
+static bool app_crypto_test_aes(const uint8_t* key,
+                                size_t key_size,
+                                const uint8_t* ciphertext) {
+  uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE];
+  uint8_t output[sizeof(g_crypto_test_aes_plaintext)];
+  AppCryptoAES aes;
+  if (!APP_Crypto_AESKeySet(&aes, key, key_size)) {
+    return false;
+  }
+  // Split in the middle of the stream to cover counter carry over calls.
+  memcpy(counter, g_crypto_test_aes_counter, sizeof(counter));
+  APP_Crypto_AESCTR(&aes, counter, g_crypto_test_aes_plaintext, output, 32);
+  APP_Crypto_AESCTR(&aes,
+                    counter,
+                    g_crypto_test_aes_plaintext + 32,
+                    output + 32,
+                    sizeof(output) - 32);
+  return memcmp(output, ciphertext, sizeof(output)) == 0;
+}
+
+bool APP_Crypto_SelfTest(void) {
+  uint8_t buffer[APP_CRYPTO_TEST_PLAINTEXT_SIZE];
+  uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE];
+  AppCryptoPoly1305 poly;
+  // ChaCha20, two full blocks and a partial one.
+  APP_Crypto_ChaCha20(g_crypto_test_chacha20_key,
+                      g_crypto_test_chacha20_nonce,
+                      1,
+                      (const uint8_t*)g_crypto_test_plaintext,
+                      buffer,
+                      sizeof(buffer));
+  if (memcmp(buffer,
+             g_crypto_test_chacha20_ciphertext,
+             sizeof(buffer)) != 0) {
+    return false;
+  }
+  // Poly1305, fed in uneven pieces to cover buffering.
+  APP_Crypto_Poly1305Init(&poly, g_crypto_test_poly1305_key);
+  APP_Crypto_Poly1305Update(&poly,
+                            (const uint8_t*)g_crypto_test_poly1305_message,
+                            5);
+  APP_Crypto_Poly1305Update(&poly,
+                            (const uint8_t*)g_crypto_test_poly1305_message + 5,
+                            sizeof(g_crypto_test_poly1305_message) - 1 - 5);
+  APP_Crypto_Poly1305Final(&poly, tag);
+  if (memcmp(tag, g_crypto_test_poly1305_tag, sizeof(tag)) != 0) {
+    return false;
+  }
+  // AEAD both ways, and a forged tag must be rejected.
+  APP_Crypto_AEADEncrypt(g_crypto_test_aead_key,
+                         g_crypto_test_aead_nonce,
+                         g_crypto_test_aead_aad,
+                         sizeof(g_crypto_test_aead_aad),
+                         (const uint8_t*)g_crypto_test_plaintext,
+                         buffer,
+                         sizeof(buffer),
+                         tag);
+  if (memcmp(buffer, g_crypto_test_aead_ciphertext, sizeof(buffer)) != 0 ||
+      memcmp(tag, g_crypto_test_aead_tag, sizeof(tag)) != 0) {
+    return false;
+  }
+  if (!APP_Crypto_AEADDecrypt(g_crypto_test_aead_key,
+                              g_crypto_test_aead_nonce,
+                              g_crypto_test_aead_aad,
+                              sizeof(g_crypto_test_aead_aad),
+                              g_crypto_test_aead_ciphertext,
+                              buffer,
+                              sizeof(buffer),
+                              g_crypto_test_aead_tag) ||
+      memcmp(buffer, g_crypto_test_plaintext, sizeof(buffer)) != 0) {
+    return false;
+  }
+  tag[0] ^= 1;
+  if (APP_Crypto_AEADDecrypt(g_crypto_test_aead_key,
+                             g_crypto_test_aead_nonce,
+                             g_crypto_test_aead_aad,
+                             sizeof(g_crypto_test_aead_aad),
+                             g_crypto_test_aead_ciphertext,
+                             buffer,
+                             sizeof(buffer),
+                             tag)) {
+    return false;
+  }
+  return app_crypto_test_aes(g_crypto_test_aes128_key,
+                             sizeof(g_crypto_test_aes128_key),
+                             g_crypto_test_aes128_ciphertext) &&
+         app_crypto_test_aes(g_crypto_test_aes256_key,
+                             sizeof(g_crypto_test_aes256_key),
+                             g_crypto_test_aes256_ciphertext);
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_CRYPTO_H
+#define _APP_CRYPTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Symmetric crypto kernels tuned for the MIPS32 M4K core, which has no
+// crypto engine.
+//
+// - ChaCha20 keeps the whole 16 word state in registers, a double round is
+//   unrolled.
+// - Poly1305 uses 26 bit limbs, so products are accumulated with MADDU into
+//   HI/LO without intermediate carries.
+// - AES uses a single 1 KB T-table with rotations (ROTR is one instruction
+//   on MIPS32r2), which is built in RAM on first use: flash has wait states
+//   and table lookups are data dependent, so they miss the prefetch cache.
+//
+// Block functions run from RAM as well, their unrolled rounds don't fit the
+// prefetch cache. Code is plain C and builds on a little-endian host too.
+
+#define APP_CRYPTO_CHACHA20_KEY_SIZE 32
+#define APP_CRYPTO_CHACHA20_NONCE_SIZE 12
+#define APP_CRYPTO_POLY1305_KEY_SIZE 32
+#define APP_CRYPTO_POLY1305_TAG_SIZE 16
+#define APP_CRYPTO_AES_BLOCK_SIZE 16
+#define APP_CRYPTO_AES_MAX_ROUNDS 14
+
+typedef struct {
+  uint32_t r[5];
+  uint32_t h[5];
+  uint32_t pad[4];
+  uint8_t buffer[16];
+  size_t buffer_size;
+} AppCryptoPoly1305;
+
+typedef struct {
+  uint32_t round_keys[4 * (APP_CRYPTO_AES_MAX_ROUNDS + 1)];
+  int num_rounds;
+} AppCryptoAES;
+
+// XOR size bytes with ChaCha20 key stream starting at the given block
+// counter (RFC 8439). In-place operation is allowed.
+void APP_Crypto_ChaCha20(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                         const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                         uint32_t counter,
+                         const uint8_t* input,
+                         uint8_t* output,
+                         size_t size);
+
+void APP_Crypto_Poly1305Init(AppCryptoPoly1305* poly,
+                             const uint8_t key[APP_CRYPTO_POLY1305_KEY_SIZE]);
+void APP_Crypto_Poly1305Update(AppCryptoPoly1305* poly,
+                               const uint8_t* data,
+                               size_t size);
+void APP_Crypto_Poly1305Final(AppCryptoPoly1305* poly,
+                              uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]);
+
+// ChaCha20-Poly1305 AEAD (RFC 8439). Decrypt verifies the tag before
+// decrypting and returns false, leaving output untouched, on mismatch.
+void APP_Crypto_AEADEncrypt(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                            const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                            const uint8_t* aad,
+                            size_t aad_size,
+                            const uint8_t* input,
+                            uint8_t* output,
+                            size_t size,
+                            uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]);
+bool APP_Crypto_AEADDecrypt(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                            const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                            const uint8_t* aad,
+                            size_t aad_size,
+                            const uint8_t* input,
+                            uint8_t* output,
+                            size_t size,
+                            const uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE]);
+
+// AEAD in place with the tag in a field of mac_size bytes, at least the tag
+// size, as in formats which leave room for longer MACs (TLS session
+// tickets). Seal zeroes the rest of the field, open checks all of it.
+void APP_Crypto_AEADSeal(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                         const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                         const uint8_t* aad,
+                         size_t aad_size,
+                         uint8_t* data,
+                         size_t size,
+                         uint8_t* mac,
+                         size_t mac_size);
+bool APP_Crypto_AEADOpen(const uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE],
+                         const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE],
+                         const uint8_t* aad,
+                         size_t aad_size,
+                         uint8_t* data,
+                         size_t size,
+                         const uint8_t* mac,
+                         size_t mac_size);
+
+// Key of 16, 24 or 32 bytes.
+bool APP_Crypto_AESKeySet(AppCryptoAES* aes, const uint8_t* key, size_t size);
+
+// XOR size bytes with AES-CTR key stream. Counter is a big-endian 128 bit
+// number, it is advanced by every block used, including a partial last one,
+// so a stream is to be split at block boundaries.
+void APP_Crypto_AESCTR(const AppCryptoAES* aes,
+                       uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE],
+                       const uint8_t* input,
+                       uint8_t* output,
+                       size_t size);
+
+// Known answer tests of all the kernels.
+bool APP_Crypto_SelfTest(void);
+
+#endif  // _APP_CRYPTO_H
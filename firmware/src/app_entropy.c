@@ -0,0 +1,122 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_entropy.h"
+
+#include <string.h>
+#include <xc.h>
+
+#include "wolfssl/wolfcrypt/sha256.h"
+
+#include "app_kv.h"
+
+typedef struct {
+  bool is_pool_ready;
+  uint8_t pool[SHA256_DIGEST_SIZE];
+  uint32_t num_blocks;
+} AppEntropy;
+
+static AppEntropy g_entropy;
+
+// Time of one conversion in core timer ticks, with the converted value in
+// the upper half.
+static uint32_t app_entropy_sample(void) {
+  const uint32_t start = _CP0_GET_COUNT();
+  AD1CON1SET = _AD1CON1_SAMP_MASK;
+  while ((AD1CON1 & _AD1CON1_DONE_MASK) == 0) {
+  }
+  AD1CON1CLR = _AD1CON1_DONE_MASK;
+  return (_CP0_GET_COUNT() - start) ^ (ADC1BUF0 << 16);
+}
+
+// ADC is not used otherwise, it is only on while samples are taken, and its
+// configuration is restored afterwards.
+static void app_entropy_collect(Sha256* sha, int num_samples) {
+  const uint32_t ad1con1 = AD1CON1;
+  const uint32_t ad1con2 = AD1CON2;
+  const uint32_t ad1con3 = AD1CON3;
+  int i;
+  AD1CON1 = 0;
+  AD1CON2 = 0;
+  // Internal RC clock, shortest sampling, conversion starts automatically
+  // once sampling is over.
+  AD1CON3 = _AD1CON3_ADRC_MASK | (1 << _AD1CON3_SAMC_POSITION);
+  AD1CON1 = (7 << _AD1CON1_SSRC_POSITION) | _AD1CON1_ON_MASK;
+  for (i = 0; i < num_samples; ++i) {
+    const uint32_t sample = app_entropy_sample();
+    wc_Sha256Update(sha, (const byte*)&sample, sizeof(sample));
+  }
+  AD1CON1 = 0;
+  AD1CON3 = ad1con3;
+  AD1CON2 = ad1con2;
+  AD1CON1 = ad1con1;
+}
+
+static void app_entropy_pool_init(void) {
+  uint8_t seed[APP_ENTROPY_SEED_SIZE];
+  Sha256 sha;
+  int size = APP_KV_Get(APP_ENTROPY_KV_KEY, seed, sizeof(seed));
+  wc_InitSha256(&sha);
+  if (size > 0) {
+    wc_Sha256Update(&sha, seed, size);
+  } else {
+    SYS_CONSOLE_MESSAGE("APP entropy: No stored seed\r\n");
+  }
+  app_entropy_collect(&sha, APP_ENTROPY_NUM_BOOT_SAMPLES);
+  wc_Sha256Final(&sha, g_entropy.pool);
+  g_entropy.is_pool_ready = true;
+  // Seed of the next boot is a one-way function of the pool.
+  wc_InitSha256(&sha);
+  wc_Sha256Update(&sha, (const byte*)APP_ENTROPY_KV_KEY,
+                  sizeof(APP_ENTROPY_KV_KEY));
+  wc_Sha256Update(&sha, g_entropy.pool, sizeof(g_entropy.pool));
+  wc_Sha256Final(&sha, seed);
+  if (!APP_KV_Set(APP_ENTROPY_KV_KEY, seed, sizeof(seed))) {
+    SYS_CONSOLE_MESSAGE("APP entropy: Failed to store seed\r\n");
+  }
+  memset(seed, 0, sizeof(seed));
+}
+
+int APP_Entropy_Seed(uint8_t* output, unsigned int size) {
+  uint8_t block[SHA256_DIGEST_SIZE];
+  Sha256 sha;
+  if (!g_entropy.is_pool_ready) {
+    app_entropy_pool_init();
+  }
+  // Every block hashes the pool, block counter and fresh samples.
+  while (size > 0) {
+    const unsigned int block_size =
+        (size < sizeof(block)) ? size : sizeof(block);
+    ++g_entropy.num_blocks;
+    wc_InitSha256(&sha);
+    wc_Sha256Update(&sha, g_entropy.pool, sizeof(g_entropy.pool));
+    wc_Sha256Update(&sha, (const byte*)&g_entropy.num_blocks,
+                    sizeof(g_entropy.num_blocks));
+    app_entropy_collect(&sha, APP_ENTROPY_NUM_BLOCK_SAMPLES);
+    wc_Sha256Final(&sha, block);
+    memcpy(output, block, block_size);
+    output += block_size;
+    size -= block_size;
+  }
+  memset(block, 0, sizeof(block));
+  return 0;
+}
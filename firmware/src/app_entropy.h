@@ -0,0 +1,51 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_ENTROPY_H
+#define _APP_ENTROPY_H
+
+#include "system_definitions.h"
+
+// Seed source of the wolfCrypt DRBG (CUSTOM_RAND_GENERATE_SEED).
+//
+// The chip has no hardware RNG, and the core timer alone is predictable at
+// boot. Noise comes from timing of ADC conversions clocked by the ADC's own
+// RC oscillator, measured with the core timer which runs from the crystal:
+// the two clocks drift and jitter independently. Low bits of the converted
+// values are mixed in as well.
+//
+// A seed kept in the KV store is mixed with the noise on the first request
+// after boot, and is replaced right away by one derived from the result. So
+// even with little noise every boot starts from a different state, and a
+// seed read out of flash doesn't tell the state it was derived from.
+
+#define APP_ENTROPY_KV_KEY "rng.seed"
+#define APP_ENTROPY_SEED_SIZE 32
+// ADC conversions timed for the pool at boot, and for every seed block.
+#define APP_ENTROPY_NUM_BOOT_SAMPLES 256
+#define APP_ENTROPY_NUM_BLOCK_SAMPLES 64
+
+// Fill the output with seed bytes. Returns zero on success, as wolfCrypt
+// expects from CUSTOM_RAND_GENERATE_SEED.
+int APP_Entropy_Seed(uint8_t* output, unsigned int size);
+
+#endif  // _APP_ENTROPY_H
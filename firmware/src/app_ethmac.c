@@ -0,0 +1,305 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_ethmac.h"
+
+#include "app_command.h"
+#include "peripheral/eth/plib_eth.h"
+#include "peripheral/tmr/plib_tmr.h"
+#include "tcpip/tcpip.h"
+
+// Events which may wait for the timer, everything else goes to the driver
+// right away.
+#define APP_ETHMAC_DEFERRABLE_EVENTS (ETH_RECEIVE_DONE | ETH_PACKET_PENDING)
+
+typedef struct {
+  volatile uint32_t num_frames;
+  volatile uint16_t timer_period;
+  // Receive events are disabled in the controller, waiting for the timer.
+  volatile bool is_deferred;
+  // Events which were enabled by the driver and are disabled by deferral.
+  volatile ETH_INTERRUPT_SOURCES deferred_events;
+  // Timer expired, next Ethernet interrupt goes to the driver as-is.
+  volatile bool is_flush;
+
+  volatile uint32_t num_interrupts;
+  volatile uint32_t num_deferred;
+  volatile uint32_t num_timeouts;
+  volatile uint32_t num_watermarks;
+  // Full watermark the driver has set, while it is replaced by the
+  // deferral.
+  uint8_t watermark;
+
+  uint32_t rate_tick;
+  uint32_t rate_num_interrupts;
+  uint32_t interrupt_rate;
+  uint32_t max_interrupt_rate;
+  uint32_t num_rx_overflows;
+  uint32_t num_backlog_passes;
+} AppEthmac;
+
+// Ring of the latest received packets with their payload sums.
+typedef struct {
+  const TCPIP_MAC_PACKET* packets[APP_ETHMAC_RX_CHECKSUMS];
+  uint16_t sums[APP_ETHMAC_RX_CHECKSUMS];
+  int head;
+} AppEthmacRxChecksums;
+
+static AppEthmac g_ethmac;
+static AppEthmacRxChecksums g_ethmac_rx_checksums;
+
+TCPIP_MAC_OBJECT APP_ETHMAC_MACObject;
+
+static void app_ethmac_timer_start(void) {
+  PLIB_TMR_Counter16BitClear(APP_ETHMAC_TIMER_ID);
+  PLIB_TMR_Period16BitSet(APP_ETHMAC_TIMER_ID, g_ethmac.timer_period);
+  PLIB_TMR_Start(APP_ETHMAC_TIMER_ID);
+}
+
+// Both the timer and the watermark end deferral, whichever comes first. Is
+// called from the handlers of either, which have the same priority.
+static void app_ethmac_deferral_end(void) {
+  PLIB_TMR_Stop(APP_ETHMAC_TIMER_ID);
+  SYS_INT_SourceStatusClear(APP_ETHMAC_TIMER_INT_SOURCE);
+  PLIB_ETH_InterruptSourceDisable(ETH_ID_0, ETH_FULL_WATERMARK);
+  PLIB_ETH_InterruptClear(ETH_ID_0, ETH_FULL_WATERMARK);
+  PLIB_ETH_RxFullWmarkSet(ETH_ID_0, g_ethmac.watermark);
+  g_ethmac.is_deferred = false;
+  PLIB_ETH_InterruptSourceEnable(ETH_ID_0, g_ethmac.deferred_events);
+  g_ethmac.deferred_events = 0;
+}
+
+static TCPIP_MAC_PACKET* app_ethmac_packet_rx(
+    DRV_HANDLE mac,
+    TCPIP_MAC_RES* result,
+    const TCPIP_MAC_PACKET_RX_STAT** status) {
+  AppEthmacRxChecksums* rx_checksums = &g_ethmac_rx_checksums;
+  const TCPIP_MAC_PACKET_RX_STAT* rx_status = NULL;
+  TCPIP_MAC_PACKET* packet = (*DRV_ETHMAC_PIC32MACObject.TCPIP_MAC_PacketRx)(
+      mac, result, &rx_status);
+  if (packet != NULL && rx_status != NULL) {
+    rx_checksums->packets[rx_checksums->head] = packet;
+    rx_checksums->sums[rx_checksums->head] = rx_status->pktChecksum;
+    rx_checksums->head = (rx_checksums->head + 1) % APP_ETHMAC_RX_CHECKSUMS;
+  }
+  if (status != NULL) {
+    *status = rx_status;
+  }
+  return packet;
+}
+
+void APP_ETHMAC_MACObjectInitialize(void) {
+  APP_ETHMAC_MACObject = DRV_ETHMAC_PIC32MACObject;
+  APP_ETHMAC_MACObject.TCPIP_MAC_PacketRx = app_ethmac_packet_rx;
+}
+
+void APP_ETHMAC_Initialize(void) {
+  g_ethmac.is_deferred = false;
+  g_ethmac.deferred_events = 0;
+  g_ethmac.is_flush = false;
+  g_ethmac.num_interrupts = 0;
+  g_ethmac.num_deferred = 0;
+  g_ethmac.num_timeouts = 0;
+  g_ethmac.num_watermarks = 0;
+  g_ethmac.rate_tick = SYS_TMR_TickCountGet();
+  g_ethmac.rate_num_interrupts = 0;
+  g_ethmac.interrupt_rate = 0;
+  g_ethmac.max_interrupt_rate = 0;
+  g_ethmac.num_rx_overflows = 0;
+  g_ethmac.num_backlog_passes = 0;
+
+  PLIB_TMR_Stop(APP_ETHMAC_TIMER_ID);
+  PLIB_TMR_ClockSourceSelect(APP_ETHMAC_TIMER_ID,
+                             TMR_CLOCK_SOURCE_PERIPHERAL_CLOCK);
+  PLIB_TMR_PrescaleSelect(APP_ETHMAC_TIMER_ID, TMR_PRESCALE_VALUE_8);
+  PLIB_TMR_Mode16BitEnable(APP_ETHMAC_TIMER_ID);
+  // Same priority as Ethernet interrupt, so the handlers never preempt each
+  // other.
+  SYS_INT_VectorPrioritySet(APP_ETHMAC_TIMER_INT_VECTOR, INT_PRIORITY_LEVEL5);
+  SYS_INT_VectorSubprioritySet(APP_ETHMAC_TIMER_INT_VECTOR,
+                               INT_SUBPRIORITY_LEVEL1);
+  SYS_INT_SourceStatusClear(APP_ETHMAC_TIMER_INT_SOURCE);
+  SYS_INT_SourceEnable(APP_ETHMAC_TIMER_INT_SOURCE);
+
+  APP_ETHMAC_CoalesceSet(APP_ETHMAC_COALESCE_FRAMES,
+                         APP_ETHMAC_COALESCE_TIMEOUT);
+}
+
+void APP_ETHMAC_Tasks(void) {
+  const uint32_t tick = SYS_TMR_TickCountGet();
+  int num_passes = 0;
+  while (num_passes < APP_ETHMAC_BACKLOG_MAX_PASSES &&
+         PLIB_ETH_RxPacketCountGet(ETH_ID_0) >= APP_ETHMAC_BACKLOG_FRAMES) {
+    TCPIP_STACK_Task(sysObj.tcpip);
+    ++num_passes;
+  }
+  g_ethmac.num_backlog_passes += num_passes;
+  if (tick - g_ethmac.rate_tick < SYS_TMR_TickCounterFrequencyGet()) {
+    return;
+  }
+  const uint32_t num_interrupts = g_ethmac.num_interrupts;
+  g_ethmac.interrupt_rate = num_interrupts - g_ethmac.rate_num_interrupts;
+  if (g_ethmac.interrupt_rate > g_ethmac.max_interrupt_rate) {
+    g_ethmac.max_interrupt_rate = g_ethmac.interrupt_rate;
+  }
+  g_ethmac.rate_num_interrupts = num_interrupts;
+  g_ethmac.rate_tick = tick;
+  // Hardware counter saturates, so accumulate it in software.
+  g_ethmac.num_rx_overflows += PLIB_ETH_RxOverflowCountGet(ETH_ID_0);
+  PLIB_ETH_RxOverflowCountClear(ETH_ID_0);
+}
+
+bool APP_ETHMAC_ISR(void) {
+  const ETH_INTERRUPT_SOURCES enabled_events =
+      PLIB_ETH_InterruptSourcesGet(ETH_ID_0);
+  const ETH_INTERRUPT_SOURCES events =
+      PLIB_ETH_InterruptsGet(ETH_ID_0) & enabled_events;
+  ++g_ethmac.num_interrupts;
+  if (g_ethmac.is_flush) {
+    g_ethmac.is_flush = false;
+    return true;
+  }
+  if (g_ethmac.is_deferred && (events & ETH_FULL_WATERMARK) != 0) {
+    // Enough frames before the timeout, the driver takes them right away
+    // together with whatever else is raised.
+    ++g_ethmac.num_watermarks;
+    app_ethmac_deferral_end();
+    return true;
+  }
+  if (g_ethmac.num_frames == 0 ||
+      (events & ~APP_ETHMAC_DEFERRABLE_EVENTS) != 0 ||
+      PLIB_ETH_RxPacketCountGet(ETH_ID_0) >= g_ethmac.num_frames) {
+    // Driver handles all raised events, including receive ones while they
+    // are deferred, the timer still enables them back.
+    return true;
+  }
+  // Events stay raised in ETHIRQ, so the interrupt fires again as soon as
+  // the timer enables them. With them disabled the flag stays clear.
+  g_ethmac.deferred_events |= enabled_events & APP_ETHMAC_DEFERRABLE_EVENTS;
+  PLIB_ETH_InterruptSourceDisable(ETH_ID_0, APP_ETHMAC_DEFERRABLE_EVENTS);
+  SYS_INT_SourceStatusClear(INT_SOURCE_ETH_1);
+  if (!g_ethmac.is_deferred) {
+    // Timeout counts from the first deferred frame, later deferrals don't
+    // push it further.
+    g_ethmac.is_deferred = true;
+    ++g_ethmac.num_deferred;
+    g_ethmac.watermark = PLIB_ETH_RxFullWmarkGet(ETH_ID_0);
+    PLIB_ETH_RxFullWmarkSet(ETH_ID_0, g_ethmac.num_frames);
+    PLIB_ETH_InterruptClear(ETH_ID_0, ETH_FULL_WATERMARK);
+    PLIB_ETH_InterruptSourceEnable(ETH_ID_0, ETH_FULL_WATERMARK);
+    app_ethmac_timer_start();
+    // Frame which arrived since the count was read doesn't raise the
+    // watermark event, which was not enabled yet.
+    if (PLIB_ETH_RxPacketCountGet(ETH_ID_0) >= g_ethmac.num_frames) {
+      ++g_ethmac.num_watermarks;
+      app_ethmac_deferral_end();
+      return true;
+    }
+  }
+  return false;
+}
+
+void APP_ETHMAC_TimerISR(void) {
+  PLIB_TMR_Stop(APP_ETHMAC_TIMER_ID);
+  SYS_INT_SourceStatusClear(APP_ETHMAC_TIMER_INT_SOURCE);
+  if (!g_ethmac.is_deferred) {
+    return;
+  }
+  ++g_ethmac.num_timeouts;
+  g_ethmac.is_flush = true;
+  // Same priority as the Ethernet interrupt, so it runs right after this
+  // handler, or once the driver leaves its critical section.
+  app_ethmac_deferral_end();
+}
+
+bool APP_ETHMAC_CoalesceSet(uint32_t num_frames, uint32_t timeout_us) {
+  const uint32_t timer_period = timeout_us * APP_ETHMAC_TIMER_TICKS_PER_US;
+  if (num_frames > APP_ETHMAC_COALESCE_MAX_FRAMES ||
+      timeout_us == 0 || timeout_us > APP_ETHMAC_COALESCE_MAX_TIMEOUT) {
+    return false;
+  }
+  // Pending deferral, if any, is finished by the timer with old settings.
+  g_ethmac.timer_period = timer_period;
+  g_ethmac.num_frames = num_frames;
+  return true;
+}
+
+bool APP_ETHMAC_RxChecksumGet(const TCPIP_MAC_PACKET* packet,
+                              uint16_t* checksum) {
+  AppEthmacRxChecksums* rx_checksums = &g_ethmac_rx_checksums;
+  int n;
+  // Newest first, the ring may still have an older reception of the packet.
+  for (n = 1; n <= APP_ETHMAC_RX_CHECKSUMS; ++n) {
+    const int i = (rx_checksums->head + APP_ETHMAC_RX_CHECKSUMS - n) %
+                  APP_ETHMAC_RX_CHECKSUMS;
+    if (rx_checksums->packets[i] == packet) {
+      // Packets are reused, a sum is only good for one reception.
+      rx_checksums->packets[i] = NULL;
+      // Hardware gives the plain sum.
+      *checksum = ~rx_checksums->sums[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void APP_ETHMAC_StatsGet(AppEthmacStats* stats) {
+  stats->num_interrupts = g_ethmac.num_interrupts;
+  stats->num_deferred = g_ethmac.num_deferred;
+  stats->num_timeouts = g_ethmac.num_timeouts;
+  stats->num_watermarks = g_ethmac.num_watermarks;
+  stats->interrupt_rate = g_ethmac.interrupt_rate;
+  stats->max_interrupt_rate = g_ethmac.max_interrupt_rate;
+  stats->num_rx_overflows = g_ethmac.num_rx_overflows;
+  stats->num_backlog_passes = g_ethmac.num_backlog_passes;
+}
+
+void APP_ETHMAC_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  TCPIP_NET_HANDLE net = TCPIP_STACK_NetHandleGet("PIC32INT");
+  TCPIP_MAC_RX_STATISTICS rx_stats;
+  TCPIP_MAC_TX_STATISTICS tx_stats;
+  if (g_ethmac.num_frames != 0) {
+    APP_CMD_PRINT(cmd_io, "Coalescing: %u frames or %u us\r\n",
+                  g_ethmac.num_frames,
+                  g_ethmac.timer_period / APP_ETHMAC_TIMER_TICKS_PER_US);
+  } else {
+    APP_CMD_PRINT(cmd_io, "Coalescing: disabled\r\n");
+  }
+  APP_CMD_PRINT(cmd_io, "Interrupts: %u, deferred %u, timeouts %u, "
+                "watermarks %u, rate %u/s, max rate %u/s\r\n",
+                g_ethmac.num_interrupts, g_ethmac.num_deferred,
+                g_ethmac.num_timeouts, g_ethmac.num_watermarks,
+                g_ethmac.interrupt_rate, g_ethmac.max_interrupt_rate);
+  APP_CMD_PRINT(cmd_io, "RX overflows: %u, backlog passes %u\r\n",
+                g_ethmac.num_rx_overflows, g_ethmac.num_backlog_passes);
+  if (net != NULL &&
+      TCPIP_STACK_NetMACStatisticsGet(net, &rx_stats, &tx_stats)) {
+    APP_CMD_PRINT(cmd_io, "RX: ok %d, errors %d, fragment errors %d, "
+                  "pending buffers %d, scheduled buffers %d\r\n",
+                  rx_stats.nRxOkPackets, rx_stats.nRxErrorPackets,
+                  rx_stats.nRxFragmentErrors,
+                  rx_stats.nRxPendBuffers, rx_stats.nRxSchedBuffers);
+    APP_CMD_PRINT(cmd_io, "TX: ok %d, errors %d, queue full %d\r\n",
+                  tx_stats.nTxOkPackets, tx_stats.nTxErrorPackets,
+                  tx_stats.nTxQueueFull);
+  }
+}
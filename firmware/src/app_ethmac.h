@@ -0,0 +1,128 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_ETHMAC_H
+#define _APP_ETHMAC_H
+
+#include "system_definitions.h"
+
+// Interrupt coalescing for the PIC32 internal Ethernet controller.
+//
+// Driver's interrupt fires on every frame event, so a flood of small packets
+// keeps CPU in the interrupt handler. With coalescing enabled an interrupt
+// which only reports received frames, and comes with less than
+// APP_ETHMAC_COALESCE_FRAMES of them pending, is deferred: receive events
+// are disabled in the controller's own interrupt enable register (ETHIEN) and
+// a one-shot timer enables them again after APP_ETHMAC_COALESCE_TIMEOUT,
+// handing all frames which arrived meanwhile to the driver at once. Until
+// then the controller's full watermark (ETHRXWM.RXFWM) is set to the number
+// of frames, so its event ends the deferral as soon as that many frames are
+// pending, whatever the timeout. The driver doesn't use the watermark, its
+// value is restored afterwards anyway.
+//
+// The interrupt controller's mask of the Ethernet source is left to the
+// driver, which uses it for its own critical sections. Transmit completion
+// and error events are never deferred, and the timeout runs from the first
+// deferred interrupt, so no frame waits longer than the timeout.
+
+#define APP_ETHMAC_COALESCE_FRAMES 4
+#define APP_ETHMAC_COALESCE_TIMEOUT 100 /* microseconds */
+// Driver has this many RX buffers posted, more frames than that never are
+// pending at once.
+#define APP_ETHMAC_COALESCE_MAX_FRAMES TCPIP_EMAC_RX_DESCRIPTORS
+#define APP_ETHMAC_COALESCE_MAX_TIMEOUT \
+  (0xffff / APP_ETHMAC_TIMER_TICKS_PER_US)
+
+// Timer used for the coalescing timeout, runs from the peripheral bus clock
+// with 1:8 prescaler.
+#define APP_ETHMAC_TIMER_ID TMR_ID_3
+#define APP_ETHMAC_TIMER_INT_SOURCE INT_SOURCE_TIMER_3
+#define APP_ETHMAC_TIMER_INT_VECTOR INT_VECTOR_T3
+#define APP_ETHMAC_TIMER_TICKS_PER_US (SYS_CLK_BUS_PERIPHERAL_1 / 8 / 1000000)
+
+// Receive buffer replenishment under load.
+//
+// Descriptors only get their buffers back once the stack is done with the
+// packets, and the driver's own replenishment (TCPIP_EMAC_RX_LOW_THRESHOLD
+// and TCPIP_EMAC_RX_LOW_FILL) is fixed when it is initialized. When at least
+// APP_ETHMAC_BACKLOG_FRAMES frames hold descriptors, the stack task runs
+// again right away, up to APP_ETHMAC_BACKLOG_MAX_PASSES times per loop, so
+// the rate at which buffers return follows the receive rate and the
+// controller doesn't run out of descriptors while other tasks run.
+#define APP_ETHMAC_BACKLOG_FRAMES (TCPIP_EMAC_RX_DESCRIPTORS / 2)
+#define APP_ETHMAC_BACKLOG_MAX_PASSES 4
+
+// Receive checksum offload.
+//
+// The controller sums the payload of every received frame, everything after
+// the Ethernet header, into the receive status vector, which the stack
+// drops. The interface runs on APP_ETHMAC_MACObject, a copy of the driver's
+// MAC object whose packet receive keeps the sums of the last
+// APP_ETHMAC_RX_CHECKSUMS packets, until the receive hook of the stack (see
+// app_udp_rx.h) takes them.
+#define APP_ETHMAC_RX_CHECKSUMS 8
+
+typedef struct {
+  // Total number of Ethernet interrupts.
+  uint32_t num_interrupts;
+  // Interrupts which were deferred, and deferrals which were ended by the
+  // timer and by the frame count.
+  uint32_t num_deferred;
+  uint32_t num_timeouts;
+  uint32_t num_watermarks;
+  // Interrupts during the last full second, and maximum of it.
+  uint32_t interrupt_rate;
+  uint32_t max_interrupt_rate;
+  // Frames dropped by the controller because of no free RX descriptor.
+  uint32_t num_rx_overflows;
+  // Extra stack passes for a receive backlog.
+  uint32_t num_backlog_passes;
+} AppEthmacStats;
+
+extern TCPIP_MAC_OBJECT APP_ETHMAC_MACObject;
+
+// Set up APP_ETHMAC_MACObject, is called before the stack is initialized.
+void APP_ETHMAC_MACObjectInitialize(void);
+
+void APP_ETHMAC_Initialize(void);
+void APP_ETHMAC_Tasks(void);
+
+// Called from the Ethernet interrupt handler, returns true when the driver's
+// interrupt handler is to be invoked.
+bool APP_ETHMAC_ISR(void);
+// Called from the coalescing timer interrupt handler.
+void APP_ETHMAC_TimerISR(void);
+
+// Zero number of frames disables coalescing. Returns false when the values
+// are out of range, settings are not changed then.
+bool APP_ETHMAC_CoalesceSet(uint32_t num_frames, uint32_t timeout_us);
+
+// Take payload sum the controller gave for the received packet, in the form
+// APP_Checksum_Calc() returns it. Returns false for packets of other
+// interfaces, and when the sum is gone already.
+bool APP_ETHMAC_RxChecksumGet(const TCPIP_MAC_PACKET* packet,
+                              uint16_t* checksum);
+
+void APP_ETHMAC_StatsGet(AppEthmacStats* stats);
+void APP_ETHMAC_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_ETHMAC_H
@@ -0,0 +1,615 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_hid_bridge.h"
+
+#include <string.h>
+
+#include "app_command.h"
+#include "app_compress.h"
+#include "app_log.h"
+#include "app_profile.h"
+#include "app_tcp_tuner.h"
+#include "app_udp_rx.h"
+
+typedef struct {
+  uint32_t sequence;
+  // Core timer at the time the record was pushed.
+  uint32_t timestamp;
+  uint16_t length;
+  uint8_t data[APP_HID_BRIDGE_RECORD_SIZE];
+} AppHIDBridgeRecord;
+
+// Records are shared by all subscribers, every one of them keeps its own
+// position in the ring. A record is released once every connected subscriber
+// has sent it, which makes the oldest subscriber position the tail of the
+// ring.
+typedef struct {
+  AppHIDBridgeRecord* records;
+  uint16_t num_records;
+  // Sequence numbers of the oldest record in the ring and of the next record
+  // to be pushed.
+  uint32_t tail_sequence;
+  uint32_t sequence;
+} AppHIDBridgeRing;
+
+typedef struct {
+  TCP_SOCKET socket;
+  bool is_client_connected;
+  bool is_link_up;
+  bool is_receive_stalled;
+  // Sequence numbers of the next record of every lane to be sent to the
+  // subscriber.
+  uint32_t sequence[APP_USB_HID_NUM_LANES];
+  // Records the subscriber missed because it was lagging behind.
+  uint32_t num_lagged;
+  uint32_t num_stream_bytes;
+  // Compressor of the current connection from the pool, NULL when the
+  // stream is not compressed.
+  AppCompressStream* compress;
+} AppHIDBridgeSubscriber;
+
+typedef struct {
+  SYSTEM_OBJECTS* system_objects;
+  bool is_open;
+  bool is_udp_open;
+  bool is_flow_control_enabled;
+  bool is_compress_enabled;
+  AppHIDBridgeSlowPolicy slow_policy;
+  bool is_push_stalled;
+
+  AppHIDBridgeRing rings[APP_USB_HID_NUM_LANES];
+  AppHIDBridgeRecord control_records[APP_HID_BRIDGE_NUM_CONTROL_RECORDS];
+  AppHIDBridgeRecord bulk_records[APP_HID_BRIDGE_NUM_RECORDS];
+
+  AppHIDBridgeSubscriber subscribers[APP_HID_BRIDGE_MAX_SUBSCRIBERS];
+  AppCompressStream compress_streams[APP_HID_BRIDGE_NUM_COMPRESS_STREAMS];
+  bool is_compress_stream_used[APP_HID_BRIDGE_NUM_COMPRESS_STREAMS];
+
+  AppHIDBridgeStats stats;
+} AppHIDBridge;
+
+static AppHIDBridge g_bridge;
+
+static uint8_t g_bridge_frame[APP_HID_BRIDGE_HEADER_SIZE +
+                              APP_HID_BRIDGE_RECORD_SIZE];
+static uint8_t g_bridge_compressed[
+    APP_COMPRESS_BOUND(sizeof(g_bridge_frame))];
+
+static AppHIDBridgeRecord* app_hid_bridge_record_get(
+    const AppHIDBridgeRing* ring, uint32_t sequence) {
+  return &ring->records[sequence % ring->num_records];
+}
+
+static bool app_hid_bridge_open(void) {
+  int i;
+  if (TCPIP_STACK_Status(g_bridge.system_objects->tcpip) !=
+      SYS_STATUS_READY) {
+    return false;
+  }
+  g_bridge.is_open = true;
+  // All subscriber sockets listen on the same port, every one of them takes
+  // one client.
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    AppHIDBridgeSubscriber* subscriber = &g_bridge.subscribers[i];
+    subscriber->socket = TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE_IPV4,
+                                              APP_HID_BRIDGE_PORT,
+                                              NULL);
+    if (subscriber->socket == INVALID_SOCKET) {
+      APP_LOG("APP HID bridge: Failed to open socket\r\n");
+      continue;
+    }
+  }
+  g_bridge.is_udp_open = APP_UDP_RX_Open(APP_HID_BRIDGE_PORT);
+  if (!g_bridge.is_udp_open) {
+    APP_LOG("APP HID bridge: Failed to open UDP port\r\n");
+  }
+  APP_LOG("APP HID bridge: Listening on port %d\r\n", APP_HID_BRIDGE_PORT);
+  return true;
+}
+
+// Records can only be forwarded when there is a client and the interface it
+// is connected through is up.
+static bool app_hid_bridge_is_link_ready(
+    const AppHIDBridgeSubscriber* subscriber) {
+  TCPIP_NET_HANDLE net;
+  if (!subscriber->is_client_connected) {
+    return false;
+  }
+  net = TCPIP_TCP_SocketNetGet(subscriber->socket);
+  return net != NULL && TCPIP_STACK_NetIsUp(net);
+}
+
+static uint32_t app_hid_bridge_num_behind(
+    const AppHIDBridgeSubscriber* subscriber) {
+  uint32_t num_behind = 0;
+  int lane;
+  for (lane = 0; lane < APP_USB_HID_NUM_LANES; ++lane) {
+    num_behind += g_bridge.rings[lane].sequence - subscriber->sequence[lane];
+  }
+  return num_behind;
+}
+
+static AppCompressStream* app_hid_bridge_compress_get(void) {
+  int i;
+  for (i = 0; i < APP_HID_BRIDGE_NUM_COMPRESS_STREAMS; ++i) {
+    if (!g_bridge.is_compress_stream_used[i]) {
+      g_bridge.is_compress_stream_used[i] = true;
+      return &g_bridge.compress_streams[i];
+    }
+  }
+  return NULL;
+}
+
+static void app_hid_bridge_compress_release(AppCompressStream* stream) {
+  g_bridge.is_compress_stream_used[stream - g_bridge.compress_streams] = false;
+}
+
+static void app_hid_bridge_stream_start(AppHIDBridgeSubscriber* subscriber) {
+  uint8_t preamble[6] = {'H', 'I', 'D', 'B', APP_HID_BRIDGE_VERSION, 0};
+  int lane;
+  // New subscriber gets everything which is still in the rings, which is the
+  // whole backlog when it is the only one.
+  for (lane = 0; lane < APP_USB_HID_NUM_LANES; ++lane) {
+    subscriber->sequence[lane] = g_bridge.rings[lane].tail_sequence;
+  }
+  subscriber->num_lagged = 0;
+  subscriber->num_stream_bytes = sizeof(preamble);
+  subscriber->is_receive_stalled = false;
+  if (g_bridge.is_compress_enabled) {
+    subscriber->compress = app_hid_bridge_compress_get();
+    if (subscriber->compress != NULL) {
+      preamble[5] |= APP_HID_BRIDGE_FLAG_COMPRESSED;
+      APP_Compress_Reset(subscriber->compress);
+    } else {
+      ++g_bridge.stats.num_compress_refused;
+    }
+  }
+  // TX FIFO of a new connection is empty.
+  TCPIP_TCP_ArrayPut(subscriber->socket, preamble, sizeof(preamble));
+  g_bridge.stats.num_stream_bytes += sizeof(preamble);
+  // Only connected subscribers take a tuner slot and budget, listening
+  // sockets waiting for a client don't need bigger buffers.
+  APP_TCP_Tuner_Register(subscriber->socket);
+}
+
+static void app_hid_bridge_stream_stop(AppHIDBridgeSubscriber* subscriber) {
+  subscriber->is_client_connected = false;
+  if (subscriber->compress != NULL) {
+    app_hid_bridge_compress_release(subscriber->compress);
+    subscriber->compress = NULL;
+  }
+  APP_TCP_Tuner_Unregister(subscriber->socket);
+}
+
+static void app_hid_bridge_frame(AppUSBHIDLane lane,
+                                 const AppHIDBridgeRecord* record) {
+  uint8_t* frame = g_bridge_frame;
+  uint16_t length = record->length;
+  if (lane == APP_USB_HID_LANE_CONTROL) {
+    length |= APP_HID_BRIDGE_FRAME_CONTROL;
+  }
+  frame[0] = record->sequence;
+  frame[1] = record->sequence >> 8;
+  frame[2] = record->sequence >> 16;
+  frame[3] = record->sequence >> 24;
+  frame[4] = length;
+  frame[5] = length >> 8;
+  memcpy(frame + APP_HID_BRIDGE_HEADER_SIZE, record->data, record->length);
+}
+
+// Put records of the lane into the socket while there is room for them and
+// the socket holds less than the backlog. Returns number of stream bytes put.
+static uint32_t app_hid_bridge_drain_lane(AppHIDBridgeSubscriber* subscriber,
+                                          AppUSBHIDLane lane,
+                                          uint32_t backlog) {
+  const TCP_SOCKET socket = subscriber->socket;
+  AppCompressStream* compress = subscriber->compress;
+  const AppHIDBridgeRing* ring = &g_bridge.rings[lane];
+  AppHIDBridgeLaneStats* lane_stats = &g_bridge.stats.lanes[lane];
+  uint32_t num_bytes = 0;
+  while (subscriber->sequence[lane] != ring->sequence &&
+         TCPIP_TCP_FifoTxFullGet(socket) < backlog) {
+    const AppHIDBridgeRecord* record =
+        app_hid_bridge_record_get(ring, subscriber->sequence[lane]);
+    const uint32_t frame_size =
+        APP_HID_BRIDGE_HEADER_SIZE + record->length;
+    uint32_t size;
+    // Records go into the socket as a whole, so the stream is never left
+    // with a partial record when the connection drops.
+    if (TCPIP_TCP_PutIsReady(socket) <
+        (compress != NULL ? APP_COMPRESS_BOUND(frame_size) : frame_size)) {
+      break;
+    }
+    app_hid_bridge_frame(lane, record);
+    if (compress != NULL) {
+      size = APP_Compress_Update(compress,
+                                 g_bridge_frame, frame_size,
+                                 g_bridge_compressed);
+      TCPIP_TCP_ArrayPut(socket, g_bridge_compressed, size);
+    } else {
+      size = frame_size;
+      TCPIP_TCP_ArrayPut(socket, g_bridge_frame, size);
+    }
+    if (lane == APP_USB_HID_LANE_CONTROL) {
+      const uint32_t latency_us = (_CP0_GET_COUNT() - record->timestamp) /
+                                  APP_PROFILE_CORE_TICKS_PER_US;
+      if (latency_us > g_bridge.stats.control_latency_max_us) {
+        g_bridge.stats.control_latency_max_us = latency_us;
+      }
+    }
+    num_bytes += size;
+    g_bridge.stats.num_record_bytes += frame_size;
+    ++subscriber->sequence[lane];
+    ++lane_stats->num_forwarded;
+  }
+  return num_bytes;
+}
+
+static void app_hid_bridge_drain(AppHIDBridgeSubscriber* subscriber) {
+  const TCP_SOCKET socket = subscriber->socket;
+  const AppHIDBridgeRing* control_ring =
+      &g_bridge.rings[APP_USB_HID_LANE_CONTROL];
+  uint32_t num_bytes;
+  // Strict priority: bulk records only go after all control ones.
+  num_bytes = app_hid_bridge_drain_lane(subscriber,
+                                        APP_USB_HID_LANE_CONTROL,
+                                        UINT32_MAX);
+  if (subscriber->sequence[APP_USB_HID_LANE_CONTROL] ==
+      control_ring->sequence) {
+    num_bytes += app_hid_bridge_drain_lane(subscriber,
+                                           APP_USB_HID_LANE_BULK,
+                                           APP_HID_BRIDGE_BULK_BACKLOG);
+  }
+  if (subscriber->compress != NULL && num_bytes != 0) {
+    // Bound of the last record leaves room for the flush.
+    const uint32_t size = APP_Compress_Flush(subscriber->compress,
+                                             g_bridge_compressed);
+    TCPIP_TCP_ArrayPut(socket, g_bridge_compressed, size);
+    num_bytes += size;
+  }
+  if (num_bytes != 0) {
+    TCPIP_TCP_Flush(socket);
+    APP_TCP_Tuner_Account(socket, num_bytes, 0);
+    subscriber->num_stream_bytes += num_bytes;
+    g_bridge.stats.num_stream_bytes += num_bytes;
+  }
+}
+
+// Forward complete records from the client to USB HID while their lane has
+// credits. Records are taken in stream order, so the first record whose lane
+// has no credits stops the connection, whatever lane the records behind it
+// are in.
+static void app_hid_bridge_receive(AppHIDBridgeSubscriber* subscriber) {
+  const TCP_SOCKET socket = subscriber->socket;
+  uint8_t header[APP_HID_BRIDGE_HEADER_SIZE];
+  uint8_t report[APP_USB_HID_REPORT_SIZE];
+  AppUSBHIDLane lane;
+  uint16_t length;
+  while (TCPIP_TCP_GetIsReady(socket) >= sizeof(header)) {
+    TCPIP_TCP_ArrayPeek(socket, header, sizeof(header), 0);
+    length = header[4] | (header[5] << 8);
+    lane = (length & APP_HID_BRIDGE_FRAME_CONTROL) ? APP_USB_HID_LANE_CONTROL
+                                                   : APP_USB_HID_LANE_BULK;
+    length &= ~APP_HID_BRIDGE_FRAME_CONTROL;
+    if (APP_USB_HID_SendCredits(lane) == 0) {
+      if (!subscriber->is_receive_stalled) {
+        subscriber->is_receive_stalled = true;
+        ++g_bridge.stats.num_receive_stalls;
+      }
+      return;
+    }
+    subscriber->is_receive_stalled = false;
+    if (length > sizeof(report)) {
+      ++g_bridge.stats.num_protocol_errors;
+      APP_LOG("APP HID bridge: Invalid record length %u\r\n", length);
+      TCPIP_TCP_Disconnect(socket);
+      return;
+    }
+    if (TCPIP_TCP_GetIsReady(socket) < sizeof(header) + length) {
+      return;
+    }
+    TCPIP_TCP_ArrayGet(socket, NULL, sizeof(header));
+    TCPIP_TCP_ArrayGet(socket, report, length);
+    APP_TCP_Tuner_Account(socket, 0, sizeof(header) + length);
+    APP_USB_HID_SendQueue(lane, report, length);
+    ++g_bridge.stats.num_received;
+  }
+}
+
+// Forward records which arrive as UDP datagrams, one record per datagram,
+// parsed in place in the MAC RX buffer. Datagrams are only taken while both
+// lanes have credits, until then they wait in the port queue.
+static void app_hid_bridge_receive_udp(void) {
+  AppUDPView view;
+  while (APP_USB_HID_SendCredits(APP_USB_HID_LANE_CONTROL) != 0 &&
+         APP_USB_HID_SendCredits(APP_USB_HID_LANE_BULK) != 0 &&
+         APP_UDP_RX_Get(APP_HID_BRIDGE_PORT, &view)) {
+    const uint8_t* header = view.data;
+    uint16_t length = 0;
+    AppUSBHIDLane lane = APP_USB_HID_LANE_BULK;
+    if (view.length >= APP_HID_BRIDGE_HEADER_SIZE) {
+      length = header[4] | (header[5] << 8);
+      if (length & APP_HID_BRIDGE_FRAME_CONTROL) {
+        lane = APP_USB_HID_LANE_CONTROL;
+      }
+      length &= ~APP_HID_BRIDGE_FRAME_CONTROL;
+    }
+    if (view.length < APP_HID_BRIDGE_HEADER_SIZE ||
+        length > APP_USB_HID_REPORT_SIZE ||
+        view.length != APP_HID_BRIDGE_HEADER_SIZE + length) {
+      ++g_bridge.stats.num_protocol_errors;
+    } else {
+      APP_USB_HID_SendQueue(lane, header + APP_HID_BRIDGE_HEADER_SIZE,
+                            length);
+      ++g_bridge.stats.num_received;
+      ++g_bridge.stats.num_datagrams_received;
+    }
+    APP_UDP_RX_Release(&view);
+  }
+}
+
+// Release records which all connected subscribers have sent. Without
+// subscribers records are kept for the next one to connect.
+static void app_hid_bridge_release(AppUSBHIDLane lane) {
+  AppHIDBridgeRing* ring = &g_bridge.rings[lane];
+  uint32_t tail_sequence = ring->sequence;
+  bool has_subscribers = false;
+  int i;
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    const AppHIDBridgeSubscriber* subscriber = &g_bridge.subscribers[i];
+    if (!subscriber->is_client_connected) {
+      continue;
+    }
+    has_subscribers = true;
+    if ((int32_t)(subscriber->sequence[lane] - tail_sequence) < 0) {
+      tail_sequence = subscriber->sequence[lane];
+    }
+  }
+  if (has_subscribers) {
+    ring->tail_sequence = tail_sequence;
+  }
+  g_bridge.stats.lanes[lane].num_pending =
+      ring->sequence - ring->tail_sequence;
+}
+
+// Free the oldest record of the full ring of the lane. Returns false when the
+// caller is to hold its record instead.
+//
+// When some subscribers have sent the oldest record already, the ones which
+// haven't are the slow ones, and they are handled according to the policy
+// without affecting others. Otherwise the ring is full because the network
+// is slow for everyone (or there are no subscribers), which is what flow
+// control is for.
+static bool app_hid_bridge_make_room(AppUSBHIDLane lane) {
+  AppHIDBridgeRing* ring = &g_bridge.rings[lane];
+  AppHIDBridgeLaneStats* lane_stats = &g_bridge.stats.lanes[lane];
+  const uint32_t tail_sequence = ring->tail_sequence;
+  bool has_fast_subscribers = false;
+  int i;
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    const AppHIDBridgeSubscriber* subscriber = &g_bridge.subscribers[i];
+    if (subscriber->is_client_connected &&
+        subscriber->sequence[lane] != tail_sequence) {
+      has_fast_subscribers = true;
+      break;
+    }
+  }
+  if (!has_fast_subscribers && g_bridge.is_flow_control_enabled) {
+    return false;
+  }
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    AppHIDBridgeSubscriber* subscriber = &g_bridge.subscribers[i];
+    if (!subscriber->is_client_connected ||
+        subscriber->sequence[lane] != tail_sequence) {
+      continue;
+    }
+    if (has_fast_subscribers &&
+        g_bridge.slow_policy == APP_HID_BRIDGE_SLOW_DISCONNECT) {
+      // Graceful close would wait behind data the subscriber doesn't read,
+      // abort puts the socket back to listening right away.
+      APP_LOG("APP HID bridge: Disconnecting slow subscriber %d\r\n", i);
+      TCPIP_TCP_Abort(subscriber->socket, false);
+      app_hid_bridge_stream_stop(subscriber);
+      ++g_bridge.stats.num_slow_disconnects;
+    } else {
+      ++subscriber->sequence[lane];
+      ++subscriber->num_lagged;
+    }
+  }
+  ++ring->tail_sequence;
+  --lane_stats->num_pending;
+  ++lane_stats->num_dropped;
+  return true;
+}
+
+void APP_HID_Bridge_Initialize(SYSTEM_OBJECTS* system_objects) {
+  int i;
+  memset(&g_bridge, 0, sizeof(g_bridge));
+  g_bridge.system_objects = system_objects;
+  g_bridge.is_flow_control_enabled = true;
+  g_bridge.slow_policy = APP_HID_BRIDGE_SLOW_LAG;
+  g_bridge.rings[APP_USB_HID_LANE_CONTROL].records = g_bridge.control_records;
+  g_bridge.rings[APP_USB_HID_LANE_CONTROL].num_records =
+      APP_HID_BRIDGE_NUM_CONTROL_RECORDS;
+  g_bridge.rings[APP_USB_HID_LANE_BULK].records = g_bridge.bulk_records;
+  g_bridge.rings[APP_USB_HID_LANE_BULK].num_records =
+      APP_HID_BRIDGE_NUM_RECORDS;
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    g_bridge.subscribers[i].socket = INVALID_SOCKET;
+  }
+}
+
+void APP_HID_Bridge_Tasks(void) {
+  int i, num_subscribers = 0;
+  if (!g_bridge.is_open && !app_hid_bridge_open()) {
+    return;
+  }
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    AppHIDBridgeSubscriber* subscriber = &g_bridge.subscribers[i];
+    bool is_connected;
+    if (subscriber->socket == INVALID_SOCKET) {
+      continue;
+    }
+    is_connected = TCPIP_TCP_IsConnected(subscriber->socket);
+    if (is_connected && !subscriber->is_client_connected) {
+      app_hid_bridge_stream_start(subscriber);
+    } else if (!is_connected && subscriber->is_client_connected) {
+      app_hid_bridge_stream_stop(subscriber);
+    }
+    subscriber->is_client_connected = is_connected;
+    is_connected = app_hid_bridge_is_link_ready(subscriber);
+    if (is_connected != subscriber->is_link_up) {
+      subscriber->is_link_up = is_connected;
+      APP_LOG("APP HID bridge: Subscriber %d link %s, %u records pending\r\n",
+              i, is_connected ? "up" : "down",
+              app_hid_bridge_num_behind(subscriber));
+    }
+    if (is_connected) {
+      app_hid_bridge_drain(subscriber);
+      ++num_subscribers;
+    }
+    if (subscriber->is_client_connected) {
+      app_hid_bridge_receive(subscriber);
+    }
+  }
+  g_bridge.stats.num_subscribers = num_subscribers;
+  if (g_bridge.is_udp_open) {
+    app_hid_bridge_receive_udp();
+  }
+  app_hid_bridge_release(APP_USB_HID_LANE_CONTROL);
+  app_hid_bridge_release(APP_USB_HID_LANE_BULK);
+}
+
+bool APP_HID_Bridge_Push(const uint8_t* data, uint16_t length) {
+  const AppUSBHIDLane lane = APP_USB_HID_ReportLane(data, length);
+  AppHIDBridgeRing* ring = &g_bridge.rings[lane];
+  AppHIDBridgeLaneStats* lane_stats = &g_bridge.stats.lanes[lane];
+  AppHIDBridgeRecord* record;
+  if (lane_stats->num_pending == ring->num_records &&
+      !app_hid_bridge_make_room(lane)) {
+    if (!g_bridge.is_push_stalled) {
+      g_bridge.is_push_stalled = true;
+      ++g_bridge.stats.num_push_stalls;
+    }
+    return false;
+  }
+  g_bridge.is_push_stalled = false;
+  if (length > APP_HID_BRIDGE_RECORD_SIZE) {
+    length = APP_HID_BRIDGE_RECORD_SIZE;
+    ++g_bridge.stats.num_truncated;
+  }
+  record = app_hid_bridge_record_get(ring, ring->sequence);
+  record->sequence = ring->sequence++;
+  record->timestamp = _CP0_GET_COUNT();
+  record->length = length;
+  memcpy(record->data, data, length);
+  ++lane_stats->num_queued;
+  if (++lane_stats->num_pending > lane_stats->high_water) {
+    lane_stats->high_water = lane_stats->num_pending;
+  }
+  return true;
+}
+
+void APP_HID_Bridge_FlowControlEnable(bool enable) {
+  g_bridge.is_flow_control_enabled = enable;
+}
+
+void APP_HID_Bridge_SlowPolicySet(AppHIDBridgeSlowPolicy policy) {
+  g_bridge.slow_policy = policy;
+}
+
+void APP_HID_Bridge_CompressEnable(bool enable) {
+  g_bridge.is_compress_enabled = enable;
+}
+
+void APP_HID_Bridge_StatsGet(AppHIDBridgeStats* stats) {
+  *stats = g_bridge.stats;
+}
+
+void APP_HID_Bridge_StatsReset(void) {
+  int lane;
+  for (lane = 0; lane < APP_USB_HID_NUM_LANES; ++lane) {
+    AppHIDBridgeLaneStats* lane_stats = &g_bridge.stats.lanes[lane];
+    lane_stats->num_queued = 0;
+    lane_stats->num_forwarded = 0;
+    lane_stats->num_dropped = 0;
+    lane_stats->high_water = lane_stats->num_pending;
+  }
+  g_bridge.stats.control_latency_max_us = 0;
+  g_bridge.stats.num_truncated = 0;
+  g_bridge.stats.num_push_stalls = 0;
+  g_bridge.stats.num_slow_disconnects = 0;
+  g_bridge.stats.num_received = 0;
+  g_bridge.stats.num_datagrams_received = 0;
+  g_bridge.stats.num_receive_stalls = 0;
+  g_bridge.stats.num_protocol_errors = 0;
+  g_bridge.stats.num_record_bytes = 0;
+  g_bridge.stats.num_stream_bytes = 0;
+  g_bridge.stats.num_compress_refused = 0;
+}
+
+void APP_HID_Bridge_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  static const char* lane_names[APP_USB_HID_NUM_LANES] = {"control", "bulk"};
+  const AppHIDBridgeStats* stats = &g_bridge.stats;
+  int i, lane;
+  APP_CMD_PRINT(cmd_io, "HID bridge: subscribers %u, "
+                "control latency max %u us\r\n",
+                stats->num_subscribers, stats->control_latency_max_us);
+  APP_CMD_PRINT(cmd_io, "  compression %s (refused %u), flow control %s, "
+                "slow subscribers are %s\r\n",
+                g_bridge.is_compress_enabled ? "on" : "off",
+                stats->num_compress_refused,
+                g_bridge.is_flow_control_enabled ? "on" : "off",
+                (g_bridge.slow_policy == APP_HID_BRIDGE_SLOW_LAG)
+                    ? "lagged" : "disconnected");
+  for (lane = 0; lane < APP_USB_HID_NUM_LANES; ++lane) {
+    const AppHIDBridgeLaneStats* lane_stats = &stats->lanes[lane];
+    APP_CMD_PRINT(cmd_io, "  %s: pending %u/%u, high water %u, "
+                  "queued %u, forwarded %u, dropped %u\r\n",
+                  lane_names[lane],
+                  lane_stats->num_pending, g_bridge.rings[lane].num_records,
+                  lane_stats->high_water, lane_stats->num_queued,
+                  lane_stats->num_forwarded, lane_stats->num_dropped);
+  }
+  APP_CMD_PRINT(cmd_io, "  truncated %u, slow disconnects %u\r\n",
+                stats->num_truncated, stats->num_slow_disconnects);
+  APP_CMD_PRINT(cmd_io, "  record bytes %u, stream bytes %u, "
+                "USB stalls %u\r\n",
+                stats->num_record_bytes, stats->num_stream_bytes,
+                stats->num_push_stalls);
+  APP_CMD_PRINT(cmd_io, "  received %u (%u datagrams), receive stalls %u, "
+                "protocol errors %u\r\n",
+                stats->num_received, stats->num_datagrams_received,
+                stats->num_receive_stalls, stats->num_protocol_errors);
+  for (i = 0; i < APP_HID_BRIDGE_MAX_SUBSCRIBERS; ++i) {
+    const AppHIDBridgeSubscriber* subscriber = &g_bridge.subscribers[i];
+    if (!subscriber->is_client_connected) {
+      continue;
+    }
+    APP_CMD_PRINT(cmd_io, "  subscriber %d: link %s, behind %u, "
+                  "lagged %u, stream bytes %u\r\n",
+                  i, subscriber->is_link_up ? "up" : "down",
+                  app_hid_bridge_num_behind(subscriber),
+                  subscriber->num_lagged, subscriber->num_stream_bytes);
+  }
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_HID_BRIDGE_H
+#define _APP_HID_BRIDGE_H
+
+#include "tcpip/tcpip.h"
+
+#include "system_definitions.h"
+
+#include "app_usb_hid.h"
+
+// Store-and-forward of USB HID reports to the network.
+//
+// Reports received from the USB host are queued in a RAM ring and forwarded
+// to every TCP client (subscriber) connected to APP_HID_BRIDGE_PORT. Records
+// are stored once and shared by all subscribers, each of which drains the
+// ring at its own pace. While there are no subscribers or their interface is
+// down (for example, during Wi-Fi reset and reconnect) records stay in the
+// ring, and are drained in order as fast as sockets accept them once the
+// link is back.
+//
+// When the ring is full and some subscribers are ahead of others, the ones
+// which hold the oldest record are slow: depending on the policy they either
+// lag (skip the oldest record, which shows up as a sequence gap) or get
+// disconnected. Either way the others are not stalled.
+//
+// When all subscribers are equally behind, with flow control (the default)
+// a full ring refuses new records, and USB HID holds the report and doesn't
+// re-arm its OUT endpoint, so the USB host is slowed down to the network
+// speed and nothing is lost. Without flow control the oldest record is
+// dropped instead.
+//
+// Control reports (see APP_USB_HID_CONTROL_FLAG) have a lane of their own:
+// a separate small ring with its own sequence numbers, which is drained into
+// the socket strictly before the bulk ring. Bulk records are only put into
+// the socket while its TX FIFO holds less than APP_HID_BRIDGE_BULK_BACKLOG
+// bytes, so a control record never waits behind more than that amount of
+// bulk data, whatever the depth of the bulk ring is.
+//
+// Records sent by the client in the same framing are forwarded to the USB
+// host as IN reports. They are only taken from the socket while USB HID has
+// room in the send queue of their lane, otherwise they stay in the socket RX
+// FIFO and the TCP window closes on the client.
+//
+// Clients can send records as UDP datagrams to the same port number as well,
+// one record per datagram, in the same framing and without a preamble. They
+// are parsed right in the network buffer (see app_udp_rx.h) and forwarded
+// while both lanes of the USB send queue have room. Queued datagrams beyond
+// APP_UDP_RX_QUEUE_SIZE are dropped.
+//
+// Lanes only exist on the USB side of this direction: records of one
+// connection are forwarded strictly in stream order, and a control record
+// behind a bulk record which waits for the bulk send queue waits as well
+// (together with everything the client sent after it). Clients which send
+// bulk records faster than the USB host takes them and need low control
+// latency have to send control records over a connection of their own.
+// Every connection is received independently, and once queued control
+// reports overtake bulk ones on the USB side.
+//
+// Every connection starts with a preamble of "HIDB" magic, protocol version
+// and flags byte. Then every record goes to the stream as a 6 byte
+// little-endian header (32 bit sequence number, 16 bit payload length)
+// followed by the payload. Highest bit of the length marks control lane
+// records, every lane has its own sequence numbers which let the receiver
+// detect dropped records.
+//
+// When compression is enabled (APP_HID_BRIDGE_FLAG_COMPRESSED is set in the
+// preamble) everything after the preamble is an app_compress.h stream.
+// Compressor state is 3 KB, so connections take it from a pool of
+// APP_HID_BRIDGE_NUM_COMPRESS_STREAMS, and ones which find it empty go
+// uncompressed. Client to board direction is never compressed.
+// tools/hid_bridge_client.py is the reference receiver.
+
+#define APP_HID_BRIDGE_PORT 5003
+// Every subscriber takes a socket out of TCPIP_TCP_MAX_SOCKETS.
+#define APP_HID_BRIDGE_MAX_SUBSCRIBERS 4
+#define APP_HID_BRIDGE_NUM_COMPRESS_STREAMS 2
+#define APP_HID_BRIDGE_NUM_RECORDS 64
+#define APP_HID_BRIDGE_NUM_CONTROL_RECORDS 8
+#define APP_HID_BRIDGE_RECORD_SIZE 64
+#define APP_HID_BRIDGE_HEADER_SIZE 6
+#define APP_HID_BRIDGE_FRAME_CONTROL 0x8000
+// Bytes of the subscriber's TX FIFO above which bulk records wait. It is
+// several times of what USB full speed HID delivers during a LAN round trip,
+// so bulk throughput is not affected.
+#define APP_HID_BRIDGE_BULK_BACKLOG 1024
+
+#define APP_HID_BRIDGE_VERSION 2
+#define APP_HID_BRIDGE_FLAG_COMPRESSED (1 << 0)
+
+typedef enum {
+  // Slow subscriber skips records it didn't manage to send.
+  APP_HID_BRIDGE_SLOW_LAG,
+  // Slow subscriber is disconnected.
+  APP_HID_BRIDGE_SLOW_DISCONNECT,
+} AppHIDBridgeSlowPolicy;
+
+typedef struct {
+  uint32_t num_queued;
+  // Records sent, summed over all subscribers.
+  uint32_t num_forwarded;
+  // Records which were dropped from a full ring before all subscribers sent
+  // them.
+  uint32_t num_dropped;
+  // Records currently in the ring, and the highest number ever seen.
+  uint16_t num_pending;
+  uint16_t high_water;
+} AppHIDBridgeLaneStats;
+
+typedef struct {
+  AppHIDBridgeLaneStats lanes[APP_USB_HID_NUM_LANES];
+  // Longest time a control record spent in the ring before it went to the
+  // socket.
+  uint32_t control_latency_max_us;
+  uint32_t num_slow_disconnects;
+  // Records which didn't fit into the record size and were truncated.
+  uint32_t num_truncated;
+  // Number of times USB OUT reports were held because of a full ring.
+  uint32_t num_push_stalls;
+  // Records received from the client and forwarded to the USB host, and
+  // number of times receiving waited for USB send queue.
+  uint32_t num_received;
+  uint32_t num_receive_stalls;
+  // Records of num_received which arrived as UDP datagrams.
+  uint32_t num_datagrams_received;
+  // Client records with length above the report size, connection is closed
+  // on them. Datagrams which are not exactly one record count as well.
+  uint32_t num_protocol_errors;
+  // Bytes of framed records, and bytes which went to the socket after
+  // compression.
+  uint32_t num_record_bytes;
+  uint32_t num_stream_bytes;
+  // Connections which went uncompressed because all compressor streams were
+  // taken.
+  uint32_t num_compress_refused;
+  // Subscribers which are connected and whose link is up.
+  uint16_t num_subscribers;
+} AppHIDBridgeStats;
+
+void APP_HID_Bridge_Initialize(SYSTEM_OBJECTS* system_objects);
+void APP_HID_Bridge_Tasks(void);
+
+// Queue record for sending to the lane given by its first byte. Returns false
+// when flow control is enabled and the ring of the lane is full, the caller
+// is to hold the record and retry later.
+bool APP_HID_Bridge_Push(const uint8_t* data, uint16_t length);
+
+void APP_HID_Bridge_FlowControlEnable(bool enable);
+void APP_HID_Bridge_SlowPolicySet(AppHIDBridgeSlowPolicy policy);
+
+// Compress streams of connections which are established afterwards.
+void APP_HID_Bridge_CompressEnable(bool enable);
+
+void APP_HID_Bridge_StatsGet(AppHIDBridgeStats* stats);
+void APP_HID_Bridge_StatsReset(void);
+void APP_HID_Bridge_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_HID_BRIDGE_H
@@ -0,0 +1,567 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_http.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_ethmac.h"
+#include "app_http_assets.h"
+#include "app_log.h"
+#include "app_metrics.h"
+#include "app_profile.h"
+#include "app_tcp_tuner.h"
+
+static AppHTTPData* g_app_http_data;
+
+// Response headers are formatted here, and put into the socket at once.
+static char g_http_scratch[256];
+static char g_http_request[APP_HTTP_REQUEST_SIZE];
+
+static uint32_t app_http_seconds_since(uint32_t tick) {
+  return (SYS_TMR_TickCountGet() - tick) / SYS_TMR_TickCounterFrequencyGet();
+}
+
+static const char* app_http_status_text(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 406: return "Not Acceptable";
+    case 431: return "Request Header Fields Too Large";
+  }
+  return "Internal Server Error";
+}
+
+static size_t app_http_heap_free(void) {
+  TCPIP_STACK_HEAP_HANDLE heap =
+      TCPIP_STACK_HeapHandleGet(TCPIP_STACK_HEAP_TYPE_INTERNAL_HEAP, 0);
+  return (heap != NULL) ? TCPIP_HEAP_FreeSize(heap) : 0;
+}
+
+static int app_http_render_stats(char* buffer, int size) {
+  AppLoopStats loop_stats;
+  AppLogStats log_stats;
+  AppEthmacStats eth_stats;
+  int i, length;
+  const int num_nets = TCPIP_STACK_NumberOfNetworksGet();
+  APP_Profile_LoopStatsGet(&loop_stats);
+  APP_Log_StatsGet(&log_stats);
+  APP_ETHMAC_StatsGet(&eth_stats);
+  length = snprintf(
+      buffer, size,
+      "{\"uptime_s\":%u,"
+      "\"loop\":{\"count\":%u,\"avg_us\":%u,\"max_us\":%u},"
+      "\"heap_free\":%u,"
+      "\"log\":{\"written\":%u,\"dropped\":%u},"
+      "\"eth\":{\"interrupts\":%u,\"rate\":%u,\"rx_overflows\":%u},"
+      "\"http\":{\"connections\":%u,\"requests\":%u,\"errors\":%u},"
+      "\"interfaces\":[",
+      SYS_TMR_TickCountGet() / SYS_TMR_TickCounterFrequencyGet(),
+      loop_stats.num_loops,
+      APP_Profile_LoopAverageTicks(&loop_stats) / APP_PROFILE_CORE_TICKS_PER_US,
+      loop_stats.max_ticks / APP_PROFILE_CORE_TICKS_PER_US,
+      app_http_heap_free(),
+      log_stats.num_written, log_stats.num_dropped,
+      eth_stats.num_interrupts, eth_stats.interrupt_rate,
+      eth_stats.num_rx_overflows,
+      g_app_http_data->num_connections, g_app_http_data->num_requests,
+      g_app_http_data->num_errors);
+  for (i = 0; i < num_nets && length < size; ++i) {
+    TCPIP_NET_HANDLE net = TCPIP_STACK_IndexToNet(i);
+    IPV4_ADDR address;
+    address.Val = TCPIP_STACK_NetAddress(net);
+    length += snprintf(buffer + length, size - length,
+                       "%s{\"name\":\"%s\",\"up\":%s,"
+                       "\"address\":\"%d.%d.%d.%d\"}",
+                       (i != 0) ? "," : "",
+                       TCPIP_STACK_NetNameGet(net),
+                       TCPIP_STACK_NetIsUp(net) ? "true" : "false",
+                       address.v[0], address.v[1],
+                       address.v[2], address.v[3]);
+  }
+  if (length < size) {
+    length += snprintf(buffer + length, size - length, "]}");
+  }
+  return length;
+}
+
+static void app_http_respond(AppHTTPConnection* connection,
+                             int status,
+                             const char* content_type,
+                             const uint8_t* body,
+                             uint32_t body_size) {
+  connection->status = status;
+  connection->content_type = content_type;
+  connection->is_gzip = false;
+  connection->body = body;
+  connection->body_size = body_size;
+  connection->body_offset = 0;
+  connection->generate = NULL;
+  connection->state = APP_HTTP_CONNECTION_STATE_HEADER;
+}
+
+static void app_http_respond_error(AppHTTPConnection* connection, int status) {
+  const int length = snprintf(connection->buffer, sizeof(connection->buffer),
+                              "%d %s\n",
+                              status, app_http_status_text(status));
+  ++g_app_http_data->num_errors;
+  // Request stream can't be trusted after an error.
+  connection->is_keep_alive = false;
+  app_http_respond(connection, status, "text/plain",
+                   (const uint8_t*)connection->buffer, length);
+}
+
+static void app_http_respond_render(AppHTTPConnection* connection,
+                                    const char* content_type,
+                                    int (*render)(char* buffer, int size)) {
+  const int length = render(connection->buffer, sizeof(connection->buffer));
+  if (length >= (int)sizeof(connection->buffer)) {
+    app_http_respond_error(connection, 500);
+    return;
+  }
+  app_http_respond(connection, 200, content_type,
+                   (const uint8_t*)connection->buffer, length);
+}
+
+static void app_http_respond_asset(AppHTTPConnection* connection,
+                                   const AppHTTPAsset* asset) {
+  app_http_respond(connection, 200, asset->content_type,
+                   asset->data, asset->size);
+  connection->is_gzip = true;
+}
+
+static void app_http_respond_generate(AppHTTPConnection* connection,
+                                      const char* content_type,
+                                      AppHTTPGenerateFunc generate) {
+  app_http_respond(connection, 200, content_type, NULL, 0);
+  connection->generate = generate;
+  memset(&connection->generate_cursor, 0, sizeof(connection->generate_cursor));
+  // Without chunked encoding end of the body is the end of connection.
+  if (connection->is_http10) {
+    connection->is_keep_alive = false;
+  }
+}
+
+static const AppHTTPAsset* app_http_asset_find(const char* path) {
+  int i;
+  if (strcmp(path, "/") == 0) {
+    path = "/index.htm";
+  }
+  for (i = 0; i < app_http_num_assets; ++i) {
+    if (strcmp(app_http_assets[i].path, path) == 0) {
+      return &app_http_assets[i];
+    }
+  }
+  return NULL;
+}
+
+// Case-insensitive lookup of the request header with the given lowercase
+// name, returns start of its value and sets end to the end of the line.
+static const char* app_http_header_find(const char* request,
+                                        const char* name,
+                                        const char** end) {
+  const int name_length = strlen(name);
+  const char* line = strstr(request, "\r\n");
+  while (line != NULL && line[2] != '\r' && line[2] != '\0') {
+    const char* value = line + 2;
+    int i;
+    for (i = 0; i < name_length; ++i) {
+      if (tolower((unsigned char)value[i]) != name[i]) {
+        break;
+      }
+    }
+    line = strstr(value, "\r\n");
+    if (i == name_length && value[i] == ':' && line != NULL) {
+      *end = line;
+      return value + name_length + 1;
+    }
+  }
+  return NULL;
+}
+
+static bool app_http_token_equal(const char* value,
+                                 int length,
+                                 const char* token) {
+  int i;
+  for (i = 0; i < length && token[i] != '\0'; ++i) {
+    if (tolower((unsigned char)value[i]) != token[i]) {
+      return false;
+    }
+  }
+  return i == length && token[i] == '\0';
+}
+
+// Case-insensitive check whether request has header with the given name
+// whose value contains the given token.
+static bool app_http_header_has(const char* request,
+                                const char* name,
+                                const char* token) {
+  const int token_length = strlen(token);
+  const char* end;
+  const char* value = app_http_header_find(request, name, &end);
+  for (; value != NULL && value + token_length <= end; ++value) {
+    if (app_http_token_equal(value, token_length, token)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether client accepts gzip content coding. Request without
+// Accept-Encoding accepts any coding (RFC 7231 5.3.4), otherwise gzip or
+// "*" has to be listed without "q=0"; explicit gzip entry overrides "*".
+static bool app_http_gzip_accepted(const char* request) {
+  const char* end;
+  const char* value = app_http_header_find(request, "accept-encoding", &end);
+  int gzip = -1, any = -1;
+  if (value == NULL) {
+    return true;
+  }
+  while (value < end) {
+    const char* coding;
+    int length;
+    bool accepted = true;
+    while (value < end && (*value == ' ' || *value == '\t' || *value == ',')) {
+      ++value;
+    }
+    coding = value;
+    while (value < end && *value != ',' && *value != ';' && *value != ' ' &&
+           *value != '\t') {
+      ++value;
+    }
+    length = value - coding;
+    // Parameters, only the weight matters: "q=0", "q=0.0" and so on.
+    while (value < end && *value != ',') {
+      if ((*value == 'q' || *value == 'Q') && value[1] == '=' &&
+          (value[-1] == ';' || value[-1] == ' ' || value[-1] == '\t')) {
+        const char* weight = value + 2;
+        accepted = false;
+        if (*weight == '1') {
+          accepted = true;
+        } else if (*weight == '0') {
+          for (++weight; weight < end && (*weight == '.' ||
+                         (*weight >= '0' && *weight <= '9')); ++weight) {
+            if (*weight >= '1' && *weight <= '9') {
+              accepted = true;
+            }
+          }
+        }
+        value += 2;
+        continue;
+      }
+      ++value;
+    }
+    if (app_http_token_equal(coding, length, "gzip") ||
+        app_http_token_equal(coding, length, "x-gzip")) {
+      gzip = accepted;
+    } else if (app_http_token_equal(coding, length, "*")) {
+      any = accepted;
+    }
+  }
+  return (gzip >= 0) ? (gzip != 0) : (any > 0);
+}
+
+static void app_http_request_handle(AppHTTPConnection* connection,
+                                    char* request) {
+  char* method = request;
+  char* path;
+  char* version;
+  char* query;
+  const AppHTTPAsset* asset;
+  ++g_app_http_data->num_requests;
+  path = strchr(method, ' ');
+  version = (path != NULL) ? strchr(path + 1, ' ') : NULL;
+  if (version == NULL || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+    app_http_respond_error(connection, 400);
+    return;
+  }
+  *path++ = '\0';
+  *version++ = '\0';
+  if ((query = strchr(path, '?')) != NULL) {
+    *query = '\0';
+  }
+  // HTTP/1.1 connections are persistent unless client says otherwise,
+  // HTTP/1.0 ones only when asked for.
+  connection->is_http10 = (version[7] == '0');
+  if (connection->is_http10) {
+    connection->is_keep_alive =
+        app_http_header_has(version, "connection", "keep-alive");
+  } else {
+    connection->is_keep_alive =
+        !app_http_header_has(version, "connection", "close");
+  }
+  connection->is_head = (strcmp(method, "HEAD") == 0);
+  if (strcmp(method, "GET") != 0 && !connection->is_head) {
+    app_http_respond_error(connection, 405);
+    return;
+  }
+  if (strcmp(path, "/api/stats") == 0) {
+    app_http_respond_render(connection, "application/json",
+                            app_http_render_stats);
+    return;
+  }
+  if (strcmp(path, "/metrics") == 0) {
+    app_http_respond_generate(connection, "text/plain; version=0.0.4",
+                              APP_Metrics_Render);
+    return;
+  }
+  if ((asset = app_http_asset_find(path)) != NULL) {
+    // Assets are stored gzip-only, there is no identity body to fall back to.
+    if (!app_http_gzip_accepted(version)) {
+      app_http_respond_error(connection, 406);
+      return;
+    }
+    app_http_respond_asset(connection, asset);
+    return;
+  }
+  app_http_respond_error(connection, 404);
+}
+
+static void app_http_request_receive(AppHTTPConnection* connection) {
+  const TCP_SOCKET socket = connection->socket;
+  uint16_t end, length;
+  if (TCPIP_TCP_GetIsReady(socket) == 0) {
+    if (app_http_seconds_since(connection->activity_tick) >=
+        APP_HTTP_IDLE_TIMEOUT) {
+      TCPIP_TCP_Disconnect(socket);
+      connection->state = APP_HTTP_CONNECTION_STATE_LISTEN;
+    }
+    return;
+  }
+  connection->activity_tick = SYS_TMR_TickCountGet();
+  end = TCPIP_TCP_ArrayFind(socket, (const uint8_t*)"\r\n\r\n", 4, 0, 0,
+                            false);
+  if (end == 0xffff) {
+    if (TCPIP_TCP_FifoRxFreeGet(socket) == 0) {
+      // Headers don't fit into the RX FIFO.
+      TCPIP_TCP_Discard(socket);
+      app_http_respond_error(connection, 431);
+    }
+    return;
+  }
+  end += 4;
+  length = (end < sizeof(g_http_request)) ? end : sizeof(g_http_request) - 1;
+  TCPIP_TCP_ArrayGet(socket, (uint8_t*)g_http_request, length);
+  g_http_request[length] = '\0';
+  if (end > length) {
+    // Skip headers which don't fit, the ones which matter come first.
+    TCPIP_TCP_ArrayGet(socket, NULL, end - length);
+  }
+  app_http_request_handle(connection, g_http_request);
+}
+
+static void app_http_response_finish(AppHTTPConnection* connection) {
+  TCPIP_TCP_Flush(connection->socket);
+  connection->activity_tick = SYS_TMR_TickCountGet();
+  if (connection->is_keep_alive) {
+    connection->state = APP_HTTP_CONNECTION_STATE_REQUEST;
+  } else {
+    TCPIP_TCP_Disconnect(connection->socket);
+    connection->state = APP_HTTP_CONNECTION_STATE_LISTEN;
+  }
+}
+
+static void app_http_response_header_send(AppHTTPConnection* connection) {
+  const TCP_SOCKET socket = connection->socket;
+  int length = snprintf(
+      g_http_scratch, sizeof(g_http_scratch),
+      "HTTP/1.1 %d %s\r\n"
+      "Content-Type: %s\r\n"
+      "%s"
+      "Connection: %s\r\n",
+      connection->status,
+      app_http_status_text(connection->status),
+      connection->content_type,
+      connection->is_gzip ? "Content-Encoding: gzip\r\n"
+                            "Vary: Accept-Encoding\r\n"
+                            "Cache-Control: max-age=3600\r\n"
+                          : "Cache-Control: no-cache\r\n",
+      connection->is_keep_alive ? "keep-alive" : "close");
+  if (connection->generate == NULL) {
+    length += snprintf(g_http_scratch + length,
+                       sizeof(g_http_scratch) - length,
+                       "Content-Length: %u\r\n\r\n",
+                       connection->body_size);
+  } else if (!connection->is_http10) {
+    length += snprintf(g_http_scratch + length,
+                       sizeof(g_http_scratch) - length,
+                       "Transfer-Encoding: chunked\r\n\r\n");
+  } else {
+    length += snprintf(g_http_scratch + length,
+                       sizeof(g_http_scratch) - length,
+                       "\r\n");
+  }
+  // Headers go into the socket at once, so they are never interleaved with
+  // partial writes.
+  if (TCPIP_TCP_PutIsReady(socket) < length) {
+    return;
+  }
+  TCPIP_TCP_ArrayPut(socket, (const uint8_t*)g_http_scratch, length);
+  if (connection->is_head) {
+    app_http_response_finish(connection);
+  } else if (connection->generate != NULL) {
+    connection->state = APP_HTTP_CONNECTION_STATE_GENERATE;
+  } else {
+    connection->state = APP_HTTP_CONNECTION_STATE_BODY;
+  }
+}
+
+static void app_http_response_body_send(AppHTTPConnection* connection) {
+  const TCP_SOCKET socket = connection->socket;
+  uint32_t length = connection->body_size - connection->body_offset;
+  const uint16_t free_space = TCPIP_TCP_PutIsReady(socket);
+  if (length > free_space) {
+    length = free_space;
+  }
+  if (length != 0) {
+    length = TCPIP_TCP_ArrayPut(socket,
+                                connection->body + connection->body_offset,
+                                length);
+    connection->body_offset += length;
+    APP_TCP_Tuner_Account(socket, length, 0);
+  }
+  if (connection->body_offset == connection->body_size) {
+    app_http_response_finish(connection);
+  }
+}
+
+// Chunk size line and trailing CRLF around every chunk of generated body.
+#define APP_HTTP_CHUNK_OVERHEAD 8
+
+static void app_http_response_generate_send(AppHTTPConnection* connection) {
+  const TCP_SOCKET socket = connection->socket;
+  const int overhead = connection->is_http10 ? 0 : APP_HTTP_CHUNK_OVERHEAD;
+  int size = (int)TCPIP_TCP_PutIsReady(socket) - overhead;
+  int length;
+  if (size > (int)sizeof(connection->buffer)) {
+    size = sizeof(connection->buffer);
+  }
+  if (size <= 0) {
+    return;
+  }
+  length = connection->generate(&connection->generate_cursor,
+                                connection->buffer, size);
+  if (length < 0) {
+    if (!connection->is_http10) {
+      // Last chunk always fits, the overhead is reserved for it.
+      TCPIP_TCP_StringPut(socket, (const uint8_t*)"0\r\n\r\n");
+    }
+    app_http_response_finish(connection);
+    return;
+  }
+  if (length == 0) {
+    // Wait for more space in the TX FIFO.
+    return;
+  }
+  if (!connection->is_http10) {
+    char chunk_size[APP_HTTP_CHUNK_OVERHEAD];
+    snprintf(chunk_size, sizeof(chunk_size), "%x\r\n", length);
+    TCPIP_TCP_StringPut(socket, (const uint8_t*)chunk_size);
+  }
+  TCPIP_TCP_ArrayPut(socket, (const uint8_t*)connection->buffer, length);
+  if (!connection->is_http10) {
+    TCPIP_TCP_StringPut(socket, (const uint8_t*)"\r\n");
+  }
+  APP_TCP_Tuner_Account(socket, length + overhead, 0);
+}
+
+static void app_http_connection_tasks(AppHTTPConnection* connection) {
+  if (!TCPIP_TCP_IsConnected(connection->socket)) {
+    // Server socket goes back to listening when connection is closed.
+    connection->state = APP_HTTP_CONNECTION_STATE_LISTEN;
+    return;
+  }
+  switch (connection->state) {
+    case APP_HTTP_CONNECTION_STATE_LISTEN:
+      ++g_app_http_data->num_connections;
+      connection->activity_tick = SYS_TMR_TickCountGet();
+      connection->state = APP_HTTP_CONNECTION_STATE_REQUEST;
+      // Fall through.
+    case APP_HTTP_CONNECTION_STATE_REQUEST:
+      app_http_request_receive(connection);
+      break;
+    case APP_HTTP_CONNECTION_STATE_HEADER:
+      app_http_response_header_send(connection);
+      break;
+    case APP_HTTP_CONNECTION_STATE_BODY:
+      app_http_response_body_send(connection);
+      break;
+    case APP_HTTP_CONNECTION_STATE_GENERATE:
+      app_http_response_generate_send(connection);
+      break;
+  }
+}
+
+static bool app_http_open(AppHTTPData* app_http_data) {
+  int i;
+  for (i = 0; i < APP_HTTP_MAX_CONNECTIONS; ++i) {
+    AppHTTPConnection* connection = &app_http_data->connections[i];
+    connection->socket = TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE_IPV4,
+                                              APP_HTTP_PORT,
+                                              NULL);
+    if (connection->socket == INVALID_SOCKET) {
+      APP_LOG("APP HTTP: Failed to open socket\r\n");
+      return false;
+    }
+    connection->state = APP_HTTP_CONNECTION_STATE_LISTEN;
+    APP_TCP_Tuner_Register(connection->socket);
+  }
+  return true;
+}
+
+void APP_HTTP_Initialize(AppHTTPData* app_http_data,
+                         SYSTEM_OBJECTS* system_objects) {
+  int i;
+  app_http_data->system_objects = system_objects;
+  app_http_data->is_open = false;
+  app_http_data->num_connections = 0;
+  app_http_data->num_requests = 0;
+  app_http_data->num_errors = 0;
+  for (i = 0; i < APP_HTTP_MAX_CONNECTIONS; ++i) {
+    app_http_data->connections[i].socket = INVALID_SOCKET;
+  }
+  g_app_http_data = app_http_data;
+}
+
+void APP_HTTP_Tasks(AppHTTPData* app_http_data) {
+  int i;
+  if (!app_http_data->is_open) {
+    // Sockets can only be opened once the stack is up.
+    if (TCPIP_STACK_Status(app_http_data->system_objects->tcpip) !=
+        SYS_STATUS_READY) {
+      return;
+    }
+    app_http_data->is_open = true;
+    if (!app_http_open(app_http_data)) {
+      return;
+    }
+  }
+  for (i = 0; i < APP_HTTP_MAX_CONNECTIONS; ++i) {
+    if (app_http_data->connections[i].socket != INVALID_SOCKET) {
+      app_http_connection_tasks(&app_http_data->connections[i]);
+    }
+  }
+}
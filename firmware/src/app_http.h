@@ -0,0 +1,115 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_HTTP_H
+#define _APP_HTTP_H
+
+#include "tcpip/tcpip.h"
+
+#include "system_definitions.h"
+
+#include "app_profile.h"
+
+// Small HTTP/1.1 status server.
+//
+// Serves gzip-precompressed static assets straight from flash (see
+// app_http_assets.h), JSON with runtime statistics and Prometheus metrics.
+// Connections are kept alive between requests.
+
+#define APP_HTTP_PORT 80
+#define APP_HTTP_MAX_CONNECTIONS 2
+// Request line and headers which don't fit are ignored.
+#define APP_HTTP_REQUEST_SIZE 256
+// Dynamic bodies (JSON) are rendered into a per-connection buffer.
+#define APP_HTTP_BODY_SIZE 512
+// Keep-alive connection without requests is closed after this time.
+#define APP_HTTP_IDLE_TIMEOUT 10 /* seconds */
+
+typedef enum {
+  // Waiting for a client to connect.
+  APP_HTTP_CONNECTION_STATE_LISTEN,
+  // Waiting for complete request headers.
+  APP_HTTP_CONNECTION_STATE_REQUEST,
+  // Sending response headers.
+  APP_HTTP_CONNECTION_STATE_HEADER,
+  // Streaming response body.
+  APP_HTTP_CONNECTION_STATE_BODY,
+  // Streaming generated response body of unknown size.
+  APP_HTTP_CONNECTION_STATE_GENERATE,
+} AppHTTPConnectionState;
+
+// Progress of a generated response body, zeroed when the response starts.
+// Kept per connection so concurrent responses don't share it.
+typedef struct {
+  uint32_t position;
+  // Snapshot for generators which render several related lines from the
+  // same statistics, such as histogram buckets.
+  AppLoopStats loop_stats;
+} AppHTTPGenerateCursor;
+
+// Generates next part of a response body into the buffer and advances the
+// cursor. Returns number of characters written, zero if the buffer is too
+// small for the next part, or -1 when the body is complete.
+typedef int (*AppHTTPGenerateFunc)(AppHTTPGenerateCursor* cursor,
+                                   char* buffer,
+                                   int size);
+
+typedef struct {
+  TCP_SOCKET socket;
+  AppHTTPConnectionState state;
+  // System timer tick of the last activity on the connection.
+  uint32_t activity_tick;
+  bool is_keep_alive;
+  bool is_head;
+  // HTTP/1.0 clients don't understand chunked transfer encoding.
+  bool is_http10;
+
+  // Response which is being sent.
+  int status;
+  const char* content_type;
+  bool is_gzip;
+  // Either static asset in flash or the buffer below.
+  const uint8_t* body;
+  uint32_t body_size;
+  uint32_t body_offset;
+  // Generated bodies are sent in chunks rendered into the buffer below.
+  AppHTTPGenerateFunc generate;
+  AppHTTPGenerateCursor generate_cursor;
+
+  char buffer[APP_HTTP_BODY_SIZE];
+} AppHTTPConnection;
+
+typedef struct {
+  SYSTEM_OBJECTS* system_objects;
+  bool is_open;
+  AppHTTPConnection connections[APP_HTTP_MAX_CONNECTIONS];
+
+  uint32_t num_connections;
+  uint32_t num_requests;
+  uint32_t num_errors;
+} AppHTTPData;
+
+void APP_HTTP_Initialize(AppHTTPData* app_http_data,
+                         SYSTEM_OBJECTS* system_objects);
+void APP_HTTP_Tasks(AppHTTPData* app_http_data);
+
+#endif  // _APP_HTTP_H
@@ -0,0 +1,88 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+// Generated by tools/http_assets.py, do not edit.
+
+#include "app_http_assets.h"
+
+// /index.htm
+static const uint8_t g_asset_index_htm[623] = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x54,
+  0x4d, 0x6f, 0x9b, 0x40, 0x10, 0xbd, 0xf3, 0x2b, 0xa6, 0xee, 0x01, 0x5b,
+  0xb1, 0xc1, 0xcd, 0xa1, 0xaa, 0x0c, 0xa1, 0x52, 0x53, 0x4b, 0xb1, 0x94,
+  0xb6, 0x69, 0xe5, 0x1e, 0x7a, 0x8a, 0xd6, 0x30, 0x98, 0x6d, 0x61, 0x97,
+  0xee, 0x0e, 0x49, 0xac, 0xc8, 0xff, 0xbd, 0xb3, 0x0b, 0x38, 0x69, 0x95,
+  0x72, 0x60, 0xe1, 0xcd, 0x7b, 0xf3, 0xb1, 0x33, 0xbb, 0xe9, 0xab, 0x8f,
+  0x5f, 0x2e, 0xb7, 0x3f, 0x6e, 0xd6, 0x50, 0x51, 0x53, 0x67, 0x41, 0x3a,
+  0x2e, 0x28, 0x0a, 0x5e, 0x1a, 0x24, 0x01, 0x79, 0x25, 0x8c, 0x45, 0xba,
+  0x98, 0x74, 0x54, 0x2e, 0xde, 0x4d, 0x18, 0x26, 0x49, 0x35, 0x66, 0x57,
+  0xc2, 0x34, 0x5a, 0x1d, 0xe0, 0x66, 0x73, 0x09, 0x9f, 0x91, 0xee, 0xb5,
+  0xf9, 0x95, 0xc6, 0xbd, 0x29, 0x48, 0x2d, 0x1d, 0xdc, 0xba, 0xd3, 0xc5,
+  0x01, 0x1e, 0xa1, 0xd4, 0x8a, 0x16, 0xa5, 0x68, 0x64, 0x7d, 0x58, 0x81,
+  0x15, 0xca, 0x2e, 0x2c, 0x1a, 0x59, 0x26, 0xd0, 0x08, 0xb3, 0x97, 0x6a,
+  0x05, 0xe7, 0xd8, 0x24, 0x70, 0x0c, 0x48, 0xec, 0x6a, 0x64, 0xfe, 0x4e,
+  0x9b, 0x02, 0xcd, 0x22, 0xd7, 0x75, 0x2d, 0x5a, 0x8b, 0x2b, 0x18, 0xbf,
+  0x3c, 0xa9, 0x98, 0x03, 0x55, 0x27, 0xd6, 0x0a, 0xde, 0xb4, 0x0f, 0x60,
+  0x75, 0x2d, 0x0b, 0x78, 0x9d, 0xe7, 0x79, 0x02, 0xad, 0x28, 0x0a, 0xa9,
+  0xf6, 0x2b, 0x58, 0x46, 0xec, 0x97, 0xdf, 0x6f, 0x9d, 0x77, 0xc2, 0x07,
+  0x5a, 0x88, 0x5a, 0xee, 0x39, 0x5c, 0x8d, 0x25, 0x39, 0x57, 0x69, 0x3c,
+  0xe4, 0x99, 0xc6, 0x43, 0xc5, 0x2e, 0x61, 0x57, 0xff, 0x9b, 0x97, 0xcb,
+  0x63, 0x9c, 0xcb, 0xf7, 0x59, 0xca, 0xe2, 0x62, 0x62, 0x49, 0x90, 0x9d,
+  0x64, 0x5c, 0xb6, 0x83, 0x5c, 0xd9, 0xb9, 0x91, 0x2d, 0x65, 0x41, 0xd9,
+  0xa9, 0x9c, 0xa4, 0x56, 0x60, 0xf4, 0xfd, 0x54, 0x89, 0x06, 0xe7, 0x70,
+  0x27, 0xea, 0x0e, 0x67, 0xf0, 0x18, 0x00, 0x18, 0xa4, 0xce, 0x28, 0x08,
+  0x53, 0x32, 0x59, 0x4a, 0x55, 0x16, 0xc2, 0x19, 0x38, 0x12, 0x2f, 0x21,
+  0xfb, 0xaa, 0x18, 0x2c, 0x3c, 0xe8, 0x35, 0x03, 0x5a, 0xb8, 0x30, 0x26,
+  0x0b, 0x93, 0xe0, 0xf8, 0xe4, 0xbe, 0x6b, 0x0b, 0x41, 0x38, 0xed, 0xdd,
+  0x96, 0x48, 0x79, 0x35, 0x0d, 0x63, 0xd1, 0xca, 0xd8, 0x67, 0x16, 0xce,
+  0x22, 0xaa, 0x50, 0x4d, 0x47, 0xfa, 0xd4, 0xa0, 0x6d, 0xb5, 0xb2, 0x43,
+  0x1a, 0xa7, 0x44, 0x46, 0x38, 0xfa, 0x69, 0x99, 0x34, 0x4b, 0xd8, 0x76,
+  0xfc, 0x57, 0xea, 0x1d, 0x8e, 0xba, 0x3b, 0x61, 0xfc, 0xc0, 0xc0, 0x85,
+  0x2f, 0x30, 0xfc, 0xde, 0x92, 0x6c, 0x30, 0x9c, 0x83, 0x67, 0x45, 0x9d,
+  0xff, 0xbd, 0xb5, 0x2e, 0x73, 0xe0, 0x2c, 0x12, 0x2f, 0xf2, 0x82, 0xb3,
+  0x41, 0x71, 0xad, 0x75, 0xcb, 0xfc, 0x50, 0xdc, 0xed, 0xc1, 0x55, 0xda,
+  0x0b, 0x6b, 0x46, 0x23, 0x86, 0x6e, 0xbb, 0x5e, 0xdb, 0xd9, 0x39, 0x8f,
+  0xc8, 0x83, 0x63, 0x78, 0x17, 0xcf, 0x9f, 0x67, 0x0a, 0xa6, 0x3c, 0x29,
+  0x5e, 0x0c, 0x77, 0x85, 0xa2, 0x85, 0xd2, 0xe0, 0x53, 0x8e, 0xdc, 0xef,
+  0xf6, 0xd6, 0x21, 0x5e, 0xb6, 0x3b, 0x10, 0xbe, 0xac, 0x5c, 0xf3, 0x36,
+  0x18, 0x85, 0x04, 0x9b, 0x6f, 0x5f, 0xc1, 0xf0, 0x66, 0x9f, 0x3c, 0x20,
+  0x55, 0x91, 0x03, 0x9c, 0x83, 0xf8, 0x3f, 0x61, 0xb7, 0xdb, 0x1b, 0xde,
+  0xdd, 0xdf, 0x1d, 0x5a, 0xee, 0xc6, 0x29, 0x34, 0x51, 0x1b, 0x8d, 0xe8,
+  0x20, 0xeb, 0x2d, 0x52, 0x11, 0x9a, 0x52, 0xe4, 0x68, 0xa3, 0x52, 0x9b,
+  0xb5, 0xe0, 0x76, 0x9e, 0x1a, 0x20, 0x1d, 0x3e, 0x36, 0xe0, 0xef, 0x38,
+  0xde, 0x14, 0xf5, 0x63, 0x36, 0xfc, 0x74, 0x2d, 0xbc, 0x87, 0x90, 0xdf,
+  0x21, 0xac, 0x20, 0x2c, 0xf4, 0x3d, 0x8f, 0xdb, 0x8c, 0x33, 0xed, 0xad,
+  0x7c, 0x40, 0xb8, 0xe7, 0x63, 0xec, 0xe3, 0xb0, 0x16, 0x3a, 0xef, 0x1a,
+  0x54, 0x14, 0xed, 0x91, 0xd6, 0x35, 0xba, 0xcf, 0x0f, 0x87, 0x4d, 0x31,
+  0x0d, 0xc7, 0x61, 0x92, 0x4a, 0xa1, 0xb9, 0xda, 0x7e, 0xba, 0xe6, 0xbe,
+  0xbb, 0xf8, 0xfd, 0xa0, 0xb8, 0x81, 0x1c, 0xe7, 0x30, 0x09, 0xf8, 0xa6,
+  0xd8, 0xb8, 0x2a, 0x78, 0x74, 0xa7, 0x3d, 0x3a, 0x87, 0xf3, 0xe5, 0x72,
+  0xc9, 0x26, 0x3e, 0x6d, 0xc3, 0xf1, 0x48, 0xe3, 0xe1, 0x9c, 0xc5, 0xfd,
+  0x7d, 0xf3, 0x07, 0xd8, 0x54, 0xf0, 0x66, 0x87, 0x04, 0x00, 0x00,
+};
+
+const AppHTTPAsset app_http_assets[] = {
+  {"/index.htm", "text/html", g_asset_index_htm, sizeof(g_asset_index_htm)},
+};
+
+const int app_http_num_assets =
+    sizeof(app_http_assets) / sizeof(*app_http_assets);
@@ -0,0 +1,296 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_irq_latency.h"
+
+#include <string.h>
+
+#include "app_command.h"
+#include "app_profile.h"
+#include "app_trace.h"
+
+#define APP_IRQ_LATENCY_TICKS_PER_US (SYS_CLK_BUS_PERIPHERAL_1 / 1000000)
+
+typedef struct {
+  volatile bool is_running;
+  // Level the probe is fixed at, or 0 when cycling through all of them.
+  int fixed_level;
+  int level;
+  uint32_t num_level_samples;
+  // Current timer period and core timer tick of the last request.
+  uint32_t period;
+  uint32_t request_tick;
+  bool has_request_tick;
+  uint32_t random;
+  // Set by the handler in round trip mode.
+  volatile bool is_roundtrip_done;
+  AppIRQLatencyStats stats;
+} AppIRQLatency;
+
+static AppIRQLatency g_irq_latency;
+
+static uint32_t app_irq_latency_period_next(void) {
+  const uint32_t min_period =
+      APP_IRQ_LATENCY_MIN_INTERVAL * APP_IRQ_LATENCY_TICKS_PER_US;
+  // xorshift32, quality does not matter here.
+  uint32_t x = g_irq_latency.random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  g_irq_latency.random = x;
+  return min_period + x % min_period;
+}
+
+static uint32_t app_irq_latency_ticks_to_core(uint32_t ticks) {
+  return ticks * APP_PROFILE_CORE_TICKS_PER_US / APP_IRQ_LATENCY_TICKS_PER_US;
+}
+
+static void app_irq_latency_level_set(int level) {
+  g_irq_latency.level = level;
+  g_irq_latency.num_level_samples = 0;
+  SYS_INT_VectorPrioritySet(APP_IRQ_LATENCY_INT_VECTOR,
+                            (INT_PRIORITY_LEVEL)level);
+}
+
+static void app_irq_latency_sample(uint32_t ticks, uint32_t epc) {
+  const uint32_t tick = _CP0_GET_COUNT();
+  const uint32_t request_tick = tick - app_irq_latency_ticks_to_core(ticks);
+  const uint32_t cycles = ticks * APP_IRQ_LATENCY_CYCLES_PER_TICK;
+  AppIRQLatencyLevelStats* level_stats =
+      &g_irq_latency.stats.levels[g_irq_latency.level - 1];
+  int bucket = (cycles < 16) ? 0 : (32 - __builtin_clz(cycles) - 4);
+
+  // Counter restarts on every match, so a request which stayed pending for
+  // longer than the period is indistinguishable from a short one. Catch it
+  // by the distance between requests instead.
+  if (g_irq_latency.has_request_tick &&
+      request_tick - g_irq_latency.request_tick >
+          app_irq_latency_ticks_to_core(g_irq_latency.period +
+                                        g_irq_latency.period / 2)) {
+    ++g_irq_latency.stats.num_overruns;
+  }
+  g_irq_latency.request_tick = request_tick;
+  g_irq_latency.has_request_tick = true;
+
+  if (bucket >= APP_IRQ_LATENCY_HISTOGRAM_SIZE) {
+    bucket = APP_IRQ_LATENCY_HISTOGRAM_SIZE - 1;
+  }
+  ++level_stats->histogram[bucket];
+  ++level_stats->num_samples;
+  level_stats->total_cycles += cycles;
+  if (level_stats->num_samples == 1 || cycles < level_stats->min_cycles) {
+    level_stats->min_cycles = cycles;
+  }
+  if (cycles > level_stats->max_cycles) {
+    level_stats->max_cycles = cycles;
+    level_stats->max_epc = epc;
+  }
+  if (cycles >= APP_IRQ_LATENCY_TRACE_CYCLES) {
+    APP_TRACE_INSTANT(APP_TRACE_IRQ_LATENCY,
+                      (cycles > 0xffff) ? 0xffff : cycles);
+  }
+
+  // New period takes effect right away: the counter is far below it.
+  g_irq_latency.period = app_irq_latency_period_next();
+  PLIB_TMR_Period16BitSet(APP_IRQ_LATENCY_TIMER_ID, g_irq_latency.period);
+  if (g_irq_latency.fixed_level == 0 &&
+      ++g_irq_latency.num_level_samples >= APP_IRQ_LATENCY_SAMPLES_PER_LEVEL) {
+    app_irq_latency_level_set(
+        g_irq_latency.level % APP_IRQ_LATENCY_NUM_LEVELS + 1);
+    // Time between requests is not comparable across the switch.
+    g_irq_latency.has_request_tick = false;
+  }
+  SYS_INT_SourceStatusClear(APP_IRQ_LATENCY_INT_SOURCE);
+}
+
+bool APP_IRQ_Latency_Start(int level) {
+  if (level < 0 || level > APP_IRQ_LATENCY_NUM_LEVELS) {
+    return false;
+  }
+  APP_IRQ_Latency_Stop();
+  g_irq_latency.fixed_level = level;
+  g_irq_latency.has_request_tick = false;
+  if (g_irq_latency.random == 0) {
+    g_irq_latency.random = _CP0_GET_COUNT() | 1;
+  }
+  g_irq_latency.period = app_irq_latency_period_next();
+
+  PLIB_TMR_ClockSourceSelect(APP_IRQ_LATENCY_TIMER_ID,
+                             TMR_CLOCK_SOURCE_PERIPHERAL_CLOCK);
+  PLIB_TMR_PrescaleSelect(APP_IRQ_LATENCY_TIMER_ID, TMR_PRESCALE_VALUE_1);
+  PLIB_TMR_Mode16BitEnable(APP_IRQ_LATENCY_TIMER_ID);
+  PLIB_TMR_Counter16BitClear(APP_IRQ_LATENCY_TIMER_ID);
+  PLIB_TMR_Period16BitSet(APP_IRQ_LATENCY_TIMER_ID, g_irq_latency.period);
+  app_irq_latency_level_set(level != 0 ? level : 1);
+  SYS_INT_VectorSubprioritySet(APP_IRQ_LATENCY_INT_VECTOR,
+                               INT_SUBPRIORITY_LEVEL0);
+  SYS_INT_SourceStatusClear(APP_IRQ_LATENCY_INT_SOURCE);
+  g_irq_latency.is_running = true;
+  g_irq_latency.stats.is_running = true;
+  SYS_INT_SourceEnable(APP_IRQ_LATENCY_INT_SOURCE);
+  PLIB_TMR_Start(APP_IRQ_LATENCY_TIMER_ID);
+  return true;
+}
+
+void APP_IRQ_Latency_Stop(void) {
+  SYS_INT_SourceDisable(APP_IRQ_LATENCY_INT_SOURCE);
+  PLIB_TMR_Stop(APP_IRQ_LATENCY_TIMER_ID);
+  SYS_INT_SourceStatusClear(APP_IRQ_LATENCY_INT_SOURCE);
+  g_irq_latency.is_running = false;
+  g_irq_latency.stats.is_running = false;
+}
+
+bool APP_IRQ_Latency_IsRunning(void) {
+  return g_irq_latency.is_running;
+}
+
+bool APP_IRQ_Latency_RoundtripMeasure(
+    AppIRQLatencyRoundtrip results[APP_IRQ_LATENCY_NUM_LEVELS]) {
+  int level;
+  if (g_irq_latency.is_running) {
+    return false;
+  }
+  SYS_INT_VectorSubprioritySet(APP_IRQ_LATENCY_INT_VECTOR,
+                               INT_SUBPRIORITY_LEVEL0);
+  SYS_INT_SourceStatusClear(APP_IRQ_LATENCY_INT_SOURCE);
+  SYS_INT_SourceEnable(APP_IRQ_LATENCY_INT_SOURCE);
+  for (level = 1; level <= APP_IRQ_LATENCY_NUM_LEVELS; ++level) {
+    uint32_t min_ticks = UINT32_MAX;
+    uint32_t total_ticks = 0;
+    int i;
+    SYS_INT_VectorPrioritySet(APP_IRQ_LATENCY_INT_VECTOR,
+                              (INT_PRIORITY_LEVEL)level);
+    for (i = 0; i < APP_IRQ_LATENCY_ROUNDTRIP_SAMPLES; ++i) {
+      uint32_t start_tick, ticks;
+      g_irq_latency.is_roundtrip_done = false;
+      start_tick = _CP0_GET_COUNT();
+      SYS_INT_SourceStatusSet(APP_IRQ_LATENCY_INT_SOURCE);
+      while (!g_irq_latency.is_roundtrip_done) {
+      }
+      ticks = _CP0_GET_COUNT() - start_tick;
+      total_ticks += ticks;
+      if (ticks < min_ticks) {
+        min_ticks = ticks;
+      }
+    }
+    // Core timer runs at half of the CPU clock.
+    results[level - 1].min_cycles = min_ticks * 2;
+    results[level - 1].avg_cycles =
+        total_ticks * 2 / APP_IRQ_LATENCY_ROUNDTRIP_SAMPLES;
+  }
+  SYS_INT_SourceDisable(APP_IRQ_LATENCY_INT_SOURCE);
+  return true;
+}
+
+void APP_IRQ_Latency_RoundtripPrint(SYS_CMD_DEVICE_NODE* cmd_io) {
+  AppIRQLatencyRoundtrip results[APP_IRQ_LATENCY_NUM_LEVELS];
+  int i;
+  if (!APP_IRQ_Latency_RoundtripMeasure(results)) {
+    APP_CMD_PRINT(cmd_io, "Stop the latency probe first\r\n");
+    return;
+  }
+  APP_CMD_PRINT(cmd_io, "ISR round trip, cycles, shadow set at level %d:\r\n",
+                APP_ISR_SRS_PRIORITY_LEVEL);
+  APP_CMD_PRINT(cmd_io, "  %-5s %6s %6s\r\n", "level", "min", "avg");
+  for (i = 0; i < APP_IRQ_LATENCY_NUM_LEVELS; ++i) {
+    APP_CMD_PRINT(cmd_io, "  %-5d %6u %6u%s\r\n",
+                  i + 1,
+                  results[i].min_cycles,
+                  results[i].avg_cycles,
+                  (i + 1 == APP_ISR_SRS_PRIORITY_LEVEL) ? " srs" : "");
+  }
+}
+
+void APP_IRQ_Latency_ISR(uint32_t ticks, uint32_t epc) {
+  if (!g_irq_latency.is_running) {
+    // Round trip mode.
+    g_irq_latency.is_roundtrip_done = true;
+    SYS_INT_SourceStatusClear(APP_IRQ_LATENCY_INT_SOURCE);
+    return;
+  }
+  app_irq_latency_sample(ticks, epc);
+}
+
+void APP_IRQ_Latency_StatsGet(AppIRQLatencyStats* stats) {
+  const bool source_state =
+      SYS_INT_SourceDisable(APP_IRQ_LATENCY_INT_SOURCE);
+  *stats = g_irq_latency.stats;
+  if (source_state) {
+    SYS_INT_SourceEnable(APP_IRQ_LATENCY_INT_SOURCE);
+  }
+}
+
+void APP_IRQ_Latency_StatsReset(void) {
+  const bool source_state =
+      SYS_INT_SourceDisable(APP_IRQ_LATENCY_INT_SOURCE);
+  memset(&g_irq_latency.stats.levels, 0, sizeof(g_irq_latency.stats.levels));
+  g_irq_latency.stats.num_overruns = 0;
+  g_irq_latency.has_request_tick = false;
+  if (source_state) {
+    SYS_INT_SourceEnable(APP_IRQ_LATENCY_INT_SOURCE);
+  }
+}
+
+void APP_IRQ_Latency_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  AppIRQLatencyStats stats;
+  int i, j;
+  APP_IRQ_Latency_StatsGet(&stats);
+  APP_CMD_PRINT(cmd_io, "IRQ latency: %s, %u overruns, cycles at %u MHz\r\n",
+                stats.is_running ? "running" : "stopped",
+                stats.num_overruns,
+                (uint32_t)(SYS_CLK_FREQ / 1000000));
+  APP_CMD_PRINT(cmd_io, "  %-5s %8s %6s %6s %6s %10s\r\n",
+                "level", "samples", "min", "avg", "max", "worst epc");
+  for (i = 0; i < APP_IRQ_LATENCY_NUM_LEVELS; ++i) {
+    const AppIRQLatencyLevelStats* level_stats = &stats.levels[i];
+    if (level_stats->num_samples == 0) {
+      continue;
+    }
+    APP_CMD_PRINT(cmd_io, "  %-5d %8u %6u %6u %6u 0x%08x\r\n",
+                  i + 1,
+                  level_stats->num_samples,
+                  level_stats->min_cycles,
+                  (uint32_t)(level_stats->total_cycles /
+                             level_stats->num_samples),
+                  level_stats->max_cycles,
+                  level_stats->max_epc);
+  }
+  for (i = 0; i < APP_IRQ_LATENCY_NUM_LEVELS; ++i) {
+    const AppIRQLatencyLevelStats* level_stats = &stats.levels[i];
+    if (level_stats->num_samples == 0) {
+      continue;
+    }
+    APP_CMD_PRINT(cmd_io, "  level %d histogram:\r\n", i + 1);
+    for (j = 0; j < APP_IRQ_LATENCY_HISTOGRAM_SIZE; ++j) {
+      if (level_stats->histogram[j] == 0) {
+        continue;
+      }
+      if (j == APP_IRQ_LATENCY_HISTOGRAM_SIZE - 1) {
+        APP_CMD_PRINT(cmd_io, "    >= %5u cycles: %u\r\n",
+                      8u << j, level_stats->histogram[j]);
+      } else {
+        APP_CMD_PRINT(cmd_io, "    <  %5u cycles: %u\r\n",
+                      16u << j, level_stats->histogram[j]);
+      }
+    }
+  }
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_IRQ_LATENCY_H
+#define _APP_IRQ_LATENCY_H
+
+#include "system_definitions.h"
+
+// Interrupt latency measurement.
+//
+// A spare timer runs from the peripheral bus clock without prescaler and its
+// period match is the interrupt request: the match raises the flag and
+// restarts the counter from zero, so the counter value read first thing in
+// the handler is the time from the request to the handler entry. It covers
+// the hardware vectoring, the compiler generated prologue, and everything
+// which kept the request pending: ISRs at the same or higher priority and
+// code running with interrupts globally disabled.
+//
+// The probe cycles its priority through the enabled levels and keeps a
+// histogram per level. The minimum of a level is the fixed entry cost, the
+// tail is what other code adds. For the worst sample of every level EPC is
+// stored: it is where the CPU was when the request was finally taken, which
+// is usually the end of the critical section or the return of the ISR which
+// blocked it (feed it to addr2line). When a higher priority ISR nests into
+// the probe's own prologue EPC points into the probe, such samples only tell
+// about that ISR.
+//
+// Masking a single source (SYS_INT_SourceDisable) only delays that source,
+// so it does not show here; global critical sections and whole ISRs do.
+//
+// Round trip mode raises the probe's request from the super-loop and waits
+// for the handler to return, which adds the epilogue to the entry cost. The
+// probe handler is IPLxAUTO, so at the level which owns the shadow register
+// set (APP_ISR_SRS_PRIORITY_LEVEL) it skips the software context save and
+// restore: the difference to other levels is what the shadow set saves on
+// every interrupt.
+//
+// Samples slower than APP_IRQ_LATENCY_TRACE_CYCLES also go to the event
+// tracer, so they can be matched against the handlers which ran at the time.
+
+#define APP_IRQ_LATENCY_TIMER_ID TMR_ID_4
+#define APP_IRQ_LATENCY_INT_SOURCE INT_SOURCE_TIMER_4
+#define APP_IRQ_LATENCY_INT_VECTOR INT_VECTOR_T4
+#define APP_IRQ_LATENCY_CYCLES_PER_TICK \
+  (SYS_CLK_FREQ / SYS_CLK_BUS_PERIPHERAL_1)
+
+// Request interval is randomized between the minimum and twice of it, so the
+// probe does not lock to the phase of other periodic interrupts. Latency
+// longer than the interval can not be told from the timer and is only
+// counted as an overrun.
+#define APP_IRQ_LATENCY_MIN_INTERVAL 500 /* microseconds */
+// Samples taken at one priority level before moving to the next one.
+#define APP_IRQ_LATENCY_SAMPLES_PER_LEVEL 256
+#define APP_IRQ_LATENCY_TRACE_CYCLES 400
+#define APP_IRQ_LATENCY_ROUNDTRIP_SAMPLES 1000
+
+#define APP_IRQ_LATENCY_NUM_LEVELS 7
+
+// Power of two buckets in CPU cycles: [0, 16), [16, 32), [32, 64) and so on,
+// last bucket is open.
+#define APP_IRQ_LATENCY_HISTOGRAM_SIZE 12
+
+typedef struct {
+  uint32_t num_samples;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint64_t total_cycles;
+  // EPC of the worst sample.
+  uint32_t max_epc;
+  uint32_t histogram[APP_IRQ_LATENCY_HISTOGRAM_SIZE];
+} AppIRQLatencyLevelStats;
+
+typedef struct {
+  bool is_running;
+  uint32_t num_overruns;
+  // Indexed by priority level minus one.
+  AppIRQLatencyLevelStats levels[APP_IRQ_LATENCY_NUM_LEVELS];
+} AppIRQLatencyStats;
+
+// Start the probe at the given priority level, or cycling through all of
+// them when level is 0.
+bool APP_IRQ_Latency_Start(int level);
+void APP_IRQ_Latency_Stop(void);
+bool APP_IRQ_Latency_IsRunning(void);
+
+// Measure round trip cost at every priority level, the probe must be
+// stopped. Results are in CPU cycles and include the fixed cost of the
+// measurement itself.
+typedef struct {
+  uint32_t min_cycles;
+  uint32_t avg_cycles;
+} AppIRQLatencyRoundtrip;
+
+bool APP_IRQ_Latency_RoundtripMeasure(
+    AppIRQLatencyRoundtrip results[APP_IRQ_LATENCY_NUM_LEVELS]);
+void APP_IRQ_Latency_RoundtripPrint(SYS_CMD_DEVICE_NODE* cmd_io);
+
+// Is called from the timer interrupt handler with the timer counter and EPC
+// which are read before anything else in the handler.
+void APP_IRQ_Latency_ISR(uint32_t ticks, uint32_t epc);
+
+void APP_IRQ_Latency_StatsGet(AppIRQLatencyStats* stats);
+void APP_IRQ_Latency_StatsReset(void);
+void APP_IRQ_Latency_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_IRQ_LATENCY_H
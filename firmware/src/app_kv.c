@@ -0,0 +1,648 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_kv.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "app_checksum.h"
+#include "app_command.h"
+#include "app_log.h"
+#include "app_profile.h"
+
+// "KVS1" in little-endian.
+#define APP_KV_PAGE_MAGIC 0x3153564b
+// Page kinds, patterns of many bits so a partially programmed word is not
+// taken for either of them.
+#define APP_KV_PAGE_BASE 0x45534142 /* "BASE" */
+#define APP_KV_PAGE_NEXT 0x5458454e /* "NEXT" */
+
+// Record flags, a deleted key has a record with no value.
+#define APP_KV_RECORD_LIVE 0xff
+#define APP_KV_RECORD_DELETED 0x00
+
+#define APP_KV_ALIGN(size) (((size) + 3) & ~3u)
+#define APP_KV_MAX_RECORD_SIZE                               \
+  APP_KV_ALIGN(sizeof(AppKVRecordHeader) + APP_KV_MAX_KEY_SIZE + \
+               APP_KV_MAX_VALUE_SIZE)
+// Room for live records, which compaction copies into one page.
+#define APP_KV_PAGE_CAPACITY (APP_NVM_PAGE_SIZE - sizeof(AppKVPageHeader))
+// Room sets leave for a deletion, so a full store can still be emptied.
+#define APP_KV_DELETE_RESERVE \
+  APP_KV_ALIGN(sizeof(AppKVRecordHeader) + APP_KV_MAX_KEY_SIZE)
+
+// Magic is programmed last, a page without it is not a page of the store.
+typedef struct {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t erase_count;
+  uint32_t kind;
+} AppKVPageHeader;
+
+// Record is the header followed by the key and the value, padded to a word.
+// CRC covers the first header word, key and value, and is programmed last.
+typedef struct {
+  uint8_t key_size;
+  uint8_t flags;
+  uint16_t value_size;
+  uint32_t crc;
+} AppKVRecordHeader;
+
+typedef enum {
+  APP_KV_RECORD_OK,
+  // Erased flash, end of the log in this page.
+  APP_KV_RECORD_END,
+  // Record which didn't finish programming, its size is still good.
+  APP_KV_RECORD_BAD_CRC,
+  // Nothing after this point of the page can be trusted.
+  APP_KV_RECORD_BAD_HEADER,
+} AppKVRecordStatus;
+
+typedef struct {
+  // Record address, 0 for an unused entry.
+  uint32_t address;
+  uint32_t hash;
+} AppKVIndexEntry;
+
+typedef struct {
+  AppKVIndexEntry index[APP_KV_INDEX_SIZE];
+  // Used entries, including ones of deleted keys.
+  int num_entries;
+  // Page sequences, 0 for a page which is not valid.
+  uint32_t sequences[APP_KV_NUM_PAGES];
+  int base_page;
+  int active_page;
+  uint32_t write_address;
+  // Record being programmed or copied.
+  uint32_t record[APP_KV_MAX_RECORD_SIZE / 4];
+  AppKVStats stats;
+} AppKV;
+
+static AppKV g_kv;
+
+#ifdef __XC32
+// Reserves the store's pages at the end of program flash.
+static const uint8_t g_kv_flash[APP_KV_SIZE]
+    __attribute__((address(APP_KV_ADDRESS), space(prog), keep)) = {
+  [0 ... APP_KV_SIZE - 1] = 0xff,
+};
+#endif
+
+static uint32_t app_kv_page_address(int page) {
+  return APP_KV_ADDRESS + page * APP_NVM_PAGE_SIZE;
+}
+
+static uint32_t app_kv_page_end(int page) {
+  return app_kv_page_address(page) + APP_NVM_PAGE_SIZE;
+}
+
+static void app_kv_read(uint32_t address, void* buffer, size_t size) {
+  const volatile uint8_t* data = APP_NVM_READ_BYTES(address);
+  uint8_t* bytes = buffer;
+  size_t i;
+  for (i = 0; i < size; ++i) {
+    bytes[i] = data[i];
+  }
+}
+
+// FNV-1a.
+static uint32_t app_kv_hash(const char* key, size_t key_size) {
+  uint32_t hash = 2166136261u;
+  size_t i;
+  for (i = 0; i < key_size; ++i) {
+    hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t app_kv_record_size(const AppKVRecordHeader* header) {
+  return APP_KV_ALIGN(sizeof(*header) + header->key_size + header->value_size);
+}
+
+static uint32_t app_kv_record_crc(const AppKVRecordHeader* header,
+                                  const uint8_t* data) {
+  const uint32_t crc = APP_Checksum_CRC32(0, (const uint8_t*)header, 4);
+  return APP_Checksum_CRC32(crc, data, header->key_size + header->value_size);
+}
+
+// Check record at the address, record is read into the record buffer.
+static AppKVRecordStatus app_kv_record_read(uint32_t address,
+                                            uint32_t end_address,
+                                            AppKVRecordHeader* header) {
+  const uint8_t* data = (const uint8_t*)g_kv.record + sizeof(*header);
+  app_kv_read(address, header, sizeof(*header));
+  if (*(const uint32_t*)header == 0xffffffff) {
+    return APP_KV_RECORD_END;
+  }
+  if (header->key_size == 0 ||
+      header->key_size > APP_KV_MAX_KEY_SIZE ||
+      header->value_size > APP_KV_MAX_VALUE_SIZE ||
+      address + app_kv_record_size(header) > end_address) {
+    return APP_KV_RECORD_BAD_HEADER;
+  }
+  app_kv_read(address, g_kv.record, app_kv_record_size(header));
+  if (app_kv_record_crc(header, data) != header->crc) {
+    return APP_KV_RECORD_BAD_CRC;
+  }
+  return APP_KV_RECORD_OK;
+}
+
+static bool app_kv_key_matches(uint32_t address,
+                               const char* key,
+                               size_t key_size) {
+  const volatile uint8_t* data = APP_NVM_READ_BYTES(address);
+  size_t i;
+  if (data[0] != key_size) {
+    return false;
+  }
+  data += sizeof(AppKVRecordHeader);
+  for (i = 0; i < key_size; ++i) {
+    if (data[i] != (uint8_t)key[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool app_kv_is_deleted(uint32_t address) {
+  return APP_NVM_READ_BYTES(address)[1] == APP_KV_RECORD_DELETED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Index.
+
+// Entry of the key, or the unused entry it goes to. NULL when the key is not
+// there and the table is full.
+static AppKVIndexEntry* app_kv_index_find(const char* key, size_t key_size) {
+  const uint32_t hash = app_kv_hash(key, key_size);
+  int i, slot = hash & (APP_KV_INDEX_SIZE - 1);
+  for (i = 0; i < APP_KV_INDEX_SIZE; ++i) {
+    AppKVIndexEntry* entry = &g_kv.index[slot];
+    if (entry->address == 0) {
+      if (g_kv.num_entries >= APP_KV_MAX_KEYS) {
+        return NULL;
+      }
+      entry->hash = hash;
+      return entry;
+    }
+    if (entry->hash == hash &&
+        app_kv_key_matches(entry->address, key, key_size)) {
+      return entry;
+    }
+    slot = (slot + 1) & (APP_KV_INDEX_SIZE - 1);
+  }
+  return NULL;
+}
+
+static void app_kv_index_clear(void) {
+  memset(g_kv.index, 0, sizeof(g_kv.index));
+  g_kv.num_entries = 0;
+  g_kv.stats.num_keys = 0;
+  g_kv.stats.live_size = 0;
+}
+
+// Point the key's entry to the record. Record header and key are in the
+// record buffer.
+static bool app_kv_index_update(uint32_t address,
+                                const AppKVRecordHeader* header) {
+  const char* key = (const char*)g_kv.record + sizeof(*header);
+  AppKVIndexEntry* entry = app_kv_index_find(key, header->key_size);
+  AppKVStats* stats = &g_kv.stats;
+  if (entry == NULL) {
+    return false;
+  }
+  if (entry->address == 0) {
+    ++g_kv.num_entries;
+  } else if (!app_kv_is_deleted(entry->address)) {
+    AppKVRecordHeader old_header;
+    app_kv_read(entry->address, &old_header, sizeof(old_header));
+    --stats->num_keys;
+    stats->live_size -= app_kv_record_size(&old_header);
+  }
+  entry->address = address;
+  if (header->flags != APP_KV_RECORD_DELETED) {
+    ++stats->num_keys;
+    stats->live_size += app_kv_record_size(header);
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Mount.
+
+static void app_kv_page_scan(int page) {
+  const uint32_t end_address = app_kv_page_end(page);
+  uint32_t address = app_kv_page_address(page) + sizeof(AppKVPageHeader);
+  while (address + sizeof(AppKVRecordHeader) <= end_address) {
+    AppKVRecordHeader header;
+    const AppKVRecordStatus status =
+        app_kv_record_read(address, end_address, &header);
+    if (status == APP_KV_RECORD_END) {
+      break;
+    }
+    if (status == APP_KV_RECORD_BAD_HEADER) {
+      ++g_kv.stats.num_bad_records;
+      address = end_address;
+      break;
+    }
+    if (status == APP_KV_RECORD_BAD_CRC) {
+      ++g_kv.stats.num_bad_records;
+    } else if (!app_kv_index_update(address, &header)) {
+      APP_LOG("APP KV: Index is full\r\n");
+    }
+    ++g_kv.stats.num_mount_records;
+    address += app_kv_record_size(&header);
+  }
+  g_kv.stats.log_size += address - app_kv_page_address(page) -
+                         sizeof(AppKVPageHeader);
+  g_kv.write_address = address;
+}
+
+static bool app_kv_mount(void) {
+  AppKVPageHeader headers[APP_KV_NUM_PAGES];
+  int i, page;
+  g_kv.active_page = -1;
+  for (i = 0; i < APP_KV_NUM_PAGES; ++i) {
+    AppKVPageHeader* header = &headers[i];
+    app_kv_read(app_kv_page_address(i), header, sizeof(*header));
+    g_kv.sequences[i] = 0;
+    if (header->magic != APP_KV_PAGE_MAGIC ||
+        (header->kind != APP_KV_PAGE_BASE &&
+         header->kind != APP_KV_PAGE_NEXT)) {
+      continue;
+    }
+    g_kv.sequences[i] = header->sequence;
+    g_kv.stats.erase_counts[i] = header->erase_count;
+    if (g_kv.active_page < 0 ||
+        header->sequence > g_kv.sequences[g_kv.active_page]) {
+      g_kv.active_page = i;
+    }
+  }
+  if (g_kv.active_page < 0) {
+    return false;
+  }
+  // Walk back to the base, pages of the log are consecutive in the ring.
+  page = g_kv.active_page;
+  g_kv.stats.num_log_pages = 1;
+  while (headers[page].kind != APP_KV_PAGE_BASE &&
+         g_kv.stats.num_log_pages < APP_KV_NUM_PAGES) {
+    const int previous = (page + APP_KV_NUM_PAGES - 1) % APP_KV_NUM_PAGES;
+    if (g_kv.sequences[previous] != g_kv.sequences[page] - 1) {
+      break;
+    }
+    page = previous;
+    ++g_kv.stats.num_log_pages;
+  }
+  g_kv.base_page = page;
+  for (i = 0; i < (int)g_kv.stats.num_log_pages; ++i) {
+    app_kv_page_scan((g_kv.base_page + i) % APP_KV_NUM_PAGES);
+  }
+  return true;
+}
+
+// Rebuild the index and log state from flash.
+static bool app_kv_remount(void) {
+  app_kv_index_clear();
+  g_kv.stats.log_size = 0;
+  g_kv.stats.num_mount_records = 0;
+  g_kv.stats.num_bad_records = 0;
+  return app_kv_mount();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Flash.
+
+// Program words of the buffer, skipping erased ones. Header word with the
+// CRC is programmed last when asked to.
+static bool app_kv_program(uint32_t address,
+                           const uint32_t* words,
+                           uint32_t size,
+                           int last_word) {
+  uint32_t i;
+  for (i = 0; i < size / 4; ++i) {
+    if ((int)i != last_word && words[i] != 0xffffffff &&
+        !APP_NVM_Run(APP_NVM_OP_WORD_PROGRAM, address + i * 4, &words[i])) {
+      return false;
+    }
+  }
+  return last_word < 0 ||
+         APP_NVM_Run(APP_NVM_OP_WORD_PROGRAM,
+                     address + last_word * 4,
+                     &words[last_word]);
+}
+
+static bool app_kv_page_erase(int page) {
+  ++g_kv.stats.erase_counts[page];
+  g_kv.sequences[page] = 0;
+  return APP_NVM_Run(APP_NVM_OP_PAGE_ERASE, app_kv_page_address(page), NULL);
+}
+
+// Header is programmed with the magic last.
+static bool app_kv_page_header_write(int page, uint32_t sequence, uint32_t kind) {
+  AppKVPageHeader header;
+  header.magic = APP_KV_PAGE_MAGIC;
+  header.sequence = sequence;
+  header.erase_count = g_kv.stats.erase_counts[page];
+  header.kind = kind;
+  if (!app_kv_program(app_kv_page_address(page),
+                      (const uint32_t*)&header,
+                      sizeof(header),
+                      0)) {
+    return false;
+  }
+  g_kv.sequences[page] = sequence;
+  return true;
+}
+
+static bool app_kv_record_append(const AppKVRecordHeader* header) {
+  const uint32_t size = app_kv_record_size(header);
+  if (g_kv.write_address + size > app_kv_page_end(g_kv.active_page)) {
+    return false;
+  }
+  // Record buffer is word aligned, padding bytes stay erased.
+  memcpy(g_kv.record, header, sizeof(*header));
+  if (!app_kv_program(g_kv.write_address, g_kv.record, size, 1)) {
+    // Partially programmed record is skipped by the next mount, nothing
+    // more goes into this page.
+    g_kv.write_address = app_kv_page_end(g_kv.active_page);
+    return false;
+  }
+  if (!app_kv_index_update(g_kv.write_address, header)) {
+    return false;
+  }
+  g_kv.write_address += size;
+  g_kv.stats.log_size += size;
+  return true;
+}
+
+// Continue the log on the next page.
+static bool app_kv_page_next(void) {
+  const int page = (g_kv.active_page + 1) % APP_KV_NUM_PAGES;
+  const uint32_t sequence = g_kv.sequences[g_kv.active_page] + 1;
+  if (!app_kv_page_erase(page) ||
+      !app_kv_page_header_write(page, sequence, APP_KV_PAGE_NEXT)) {
+    return false;
+  }
+  g_kv.active_page = page;
+  g_kv.write_address = app_kv_page_address(page) + sizeof(AppKVPageHeader);
+  ++g_kv.stats.num_log_pages;
+  return true;
+}
+
+// Copy live records into the next page, which becomes the base of the log.
+// On failure the old log, which is still in flash, is mounted again.
+static bool app_kv_compact(void) {
+  const uint32_t start_tick = _CP0_GET_COUNT();
+  const int page = (g_kv.active_page + 1) % APP_KV_NUM_PAGES;
+  const uint32_t sequence = g_kv.sequences[g_kv.active_page] + 1;
+  uint32_t addresses[APP_KV_MAX_KEYS];
+  int i, num_records = 0;
+  uint32_t us;
+  for (i = 0; i < APP_KV_INDEX_SIZE; ++i) {
+    const uint32_t address = g_kv.index[i].address;
+    if (address != 0 && !app_kv_is_deleted(address)) {
+      addresses[num_records++] = address;
+    }
+  }
+  if (!app_kv_page_erase(page)) {
+    return false;
+  }
+  app_kv_index_clear();
+  g_kv.active_page = page;
+  g_kv.write_address = app_kv_page_address(page) + sizeof(AppKVPageHeader);
+  g_kv.stats.log_size = 0;
+  for (i = 0; i < num_records; ++i) {
+    AppKVRecordHeader header;
+    app_kv_read(addresses[i], &header, sizeof(header));
+    app_kv_read(addresses[i], g_kv.record, app_kv_record_size(&header));
+    if (!app_kv_record_append(&header)) {
+      app_kv_remount();
+      return false;
+    }
+  }
+  // Until this header is there, the old log is the one which mounts.
+  if (!app_kv_page_header_write(page, sequence, APP_KV_PAGE_BASE)) {
+    app_kv_remount();
+    return false;
+  }
+  g_kv.base_page = page;
+  g_kv.stats.num_log_pages = 1;
+  ++g_kv.stats.num_compactions;
+  us = (_CP0_GET_COUNT() - start_tick) / APP_PROFILE_CORE_TICKS_PER_US;
+  if (us > g_kv.stats.max_compaction_us) {
+    g_kv.stats.max_compaction_us = us;
+  }
+  return true;
+}
+
+// Make room for a record of the given size in the active page.
+static bool app_kv_reserve(uint32_t size, bool needs_entry) {
+  const bool is_index_full = needs_entry &&
+                             g_kv.num_entries >= APP_KV_MAX_KEYS;
+  if (g_kv.write_address + size <= app_kv_page_end(g_kv.active_page) &&
+      !is_index_full) {
+    return true;
+  }
+  if (g_kv.stats.num_log_pages < APP_KV_NUM_PAGES - 1 && !is_index_full) {
+    if (!app_kv_page_next()) {
+      return false;
+    }
+  } else if (!app_kv_compact()) {
+    APP_LOG("APP KV: Compaction failed\r\n");
+    return false;
+  }
+  return g_kv.write_address + size <= app_kv_page_end(g_kv.active_page) &&
+         !(needs_entry && g_kv.num_entries >= APP_KV_MAX_KEYS);
+}
+
+static bool app_kv_write(const char* key,
+                         uint8_t flags,
+                         const void* value,
+                         size_t size) {
+  const uint32_t start_tick = _CP0_GET_COUNT();
+  const size_t key_size = strlen(key);
+  uint8_t* data = (uint8_t*)g_kv.record + sizeof(AppKVRecordHeader);
+  AppKVIndexEntry* entry;
+  AppKVRecordHeader header;
+  uint32_t us;
+  if (key_size == 0 || key_size > APP_KV_MAX_KEY_SIZE ||
+      size > APP_KV_MAX_VALUE_SIZE) {
+    return false;
+  }
+  header.key_size = key_size;
+  header.flags = flags;
+  header.value_size = size;
+  // Compaction copies live records, the old one of the key included, before
+  // the new one goes in: all of them are to fit into a page.
+  if (g_kv.stats.live_size + app_kv_record_size(&header) +
+          (flags == APP_KV_RECORD_DELETED ? 0 : APP_KV_DELETE_RESERVE) >
+      APP_KV_PAGE_CAPACITY) {
+    return false;
+  }
+  entry = app_kv_index_find(key, key_size);
+  if (!app_kv_reserve(app_kv_record_size(&header),
+                      entry == NULL || entry->address == 0)) {
+    return false;
+  }
+  memset(g_kv.record, 0xff, sizeof(g_kv.record));
+  memcpy(data, key, key_size);
+  if (size != 0) {
+    memcpy(data + key_size, value, size);
+  }
+  header.crc = app_kv_record_crc(&header, data);
+  if (!app_kv_record_append(&header)) {
+    return false;
+  }
+  ++g_kv.stats.num_sets;
+  us = (_CP0_GET_COUNT() - start_tick) / APP_PROFILE_CORE_TICKS_PER_US;
+  if (us > g_kv.stats.max_set_us) {
+    g_kv.stats.max_set_us = us;
+  }
+  return true;
+}
+
+bool APP_KV_Initialize(void) {
+  const uint32_t start_tick = _CP0_GET_COUNT();
+  if (!app_kv_remount()) {
+    SYS_CONSOLE_MESSAGE("APP KV: No valid pages, formatting\r\n");
+    if (!APP_KV_Format()) {
+      return false;
+    }
+  }
+  g_kv.stats.mount_us =
+      (_CP0_GET_COUNT() - start_tick) / APP_PROFILE_CORE_TICKS_PER_US;
+  APP_Profile_BootMark(APP_BOOT_KV_MOUNTED);
+  return true;
+}
+
+int APP_KV_Get(const char* key, void* value, size_t size) {
+  const size_t key_size = strlen(key);
+  const AppKVIndexEntry* entry;
+  AppKVRecordHeader header;
+  if (key_size == 0 || key_size > APP_KV_MAX_KEY_SIZE) {
+    return -1;
+  }
+  entry = app_kv_index_find(key, key_size);
+  if (entry == NULL || entry->address == 0 ||
+      app_kv_is_deleted(entry->address)) {
+    return -1;
+  }
+  app_kv_read(entry->address, &header, sizeof(header));
+  app_kv_read(entry->address + sizeof(header) + key_size,
+              value,
+              size < header.value_size ? size : header.value_size);
+  return header.value_size;
+}
+
+bool APP_KV_Set(const char* key, const void* value, size_t size) {
+  uint8_t current[APP_KV_MAX_VALUE_SIZE];
+  // Same value again costs no flash wear.
+  if (size <= sizeof(current) &&
+      APP_KV_Get(key, current, sizeof(current)) == (int)size &&
+      memcmp(current, value, size) == 0) {
+    return true;
+  }
+  return app_kv_write(key, APP_KV_RECORD_LIVE, value, size);
+}
+
+bool APP_KV_Delete(const char* key) {
+  uint8_t value;
+  if (APP_KV_Get(key, &value, 0) < 0) {
+    return true;
+  }
+  return app_kv_write(key, APP_KV_RECORD_DELETED, NULL, 0);
+}
+
+bool APP_KV_Format(void) {
+  int i;
+  for (i = 0; i < APP_KV_NUM_PAGES; ++i) {
+    if (!app_kv_page_erase(i)) {
+      return false;
+    }
+  }
+  app_kv_index_clear();
+  if (!app_kv_page_header_write(0, 1, APP_KV_PAGE_BASE)) {
+    return false;
+  }
+  g_kv.base_page = 0;
+  g_kv.active_page = 0;
+  g_kv.write_address = app_kv_page_address(0) + sizeof(AppKVPageHeader);
+  g_kv.stats.log_size = 0;
+  g_kv.stats.num_log_pages = 1;
+  return true;
+}
+
+void APP_KV_StatsGet(AppKVStats* stats) {
+  *stats = g_kv.stats;
+}
+
+static void app_kv_print_entry(SYS_CMD_DEVICE_NODE* cmd_io,
+                               uint32_t address) {
+  char key[APP_KV_MAX_KEY_SIZE + 1];
+  uint8_t value[32];
+  AppKVRecordHeader header;
+  bool is_printable = true;
+  int i, size;
+  app_kv_read(address, &header, sizeof(header));
+  app_kv_read(address + sizeof(header), key, header.key_size);
+  key[header.key_size] = '\0';
+  size = header.value_size < sizeof(value) ? header.value_size : sizeof(value);
+  app_kv_read(address + sizeof(header) + header.key_size, value, size);
+  for (i = 0; i < size; ++i) {
+    is_printable &= isprint(value[i]) != 0;
+  }
+  APP_CMD_PRINT(cmd_io, "  %s (%d bytes) = ", key, header.value_size);
+  if (is_printable) {
+    APP_CMD_PRINT(cmd_io, "\"%.*s\"", size, value);
+  } else {
+    for (i = 0; i < size; ++i) {
+      APP_CMD_PRINT(cmd_io, "%02x", value[i]);
+    }
+  }
+  APP_CMD_PRINT(cmd_io, "%s\r\n", size < header.value_size ? "..." : "");
+}
+
+void APP_KV_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  const AppKVStats* stats = &g_kv.stats;
+  int i;
+  APP_CMD_PRINT(cmd_io, "KV: %d pages at 0x%08x, %u keys, live %u bytes, "
+                "log %u bytes in %u pages\r\n",
+                APP_KV_NUM_PAGES, APP_KV_ADDRESS, stats->num_keys,
+                stats->live_size, stats->log_size, stats->num_log_pages);
+  APP_CMD_PRINT(cmd_io, "  mount %u us (%u records, %u bad), sets %u "
+                "(max %u us), compactions %u (max %u us)\r\n",
+                stats->mount_us, stats->num_mount_records,
+                stats->num_bad_records, stats->num_sets, stats->max_set_us,
+                stats->num_compactions, stats->max_compaction_us);
+  APP_CMD_PRINT(cmd_io, "  page erases:");
+  for (i = 0; i < APP_KV_NUM_PAGES; ++i) {
+    APP_CMD_PRINT(cmd_io, " %u", stats->erase_counts[i]);
+  }
+  APP_CMD_PRINT(cmd_io, "\r\n");
+  for (i = 0; i < APP_KV_INDEX_SIZE; ++i) {
+    const uint32_t address = g_kv.index[i].address;
+    if (address != 0 && !app_kv_is_deleted(address)) {
+      app_kv_print_entry(cmd_io, address);
+    }
+  }
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_KV_H
+#define _APP_KV_H
+
+#include "app_nvm.h"
+#include "system_definitions.h"
+
+// Key-value store for runtime configuration, kept at the end of program
+// flash.
+//
+// The store is a log of records spread over a ring of flash pages. Setting
+// a key appends a record, so an update is atomic: the record is only valid
+// once its CRC, which is programmed last, matches. A record interrupted by
+// reset is skipped on the next boot and the previous value stays.
+//
+// RAM index is an open addressing hash table of key hashes to record
+// addresses, so a lookup reads flash only to compare the key it found.
+//
+// Pages carry a sequence number. When the log needs a new page and all but
+// one are in use, live records are compacted into that last page, which
+// becomes the new base of the log. Its header is programmed after the
+// records, so an interrupted compaction leaves the old log in effect. Pages
+// are taken in ring order, which spreads erases evenly.
+//
+// Mounting reads page headers and scans records of the log from its base
+// only, never erased or stale pages. Its time is kept in the statistics and
+// as a boot milestone.
+
+#define APP_KV_NUM_PAGES 4
+#define APP_KV_SIZE (APP_KV_NUM_PAGES * APP_NVM_PAGE_SIZE)
+#define APP_KV_ADDRESS (APP_NVM_FLASH_ADDRESS + APP_NVM_FLASH_SIZE - APP_KV_SIZE)
+
+#define APP_KV_MAX_KEY_SIZE 31
+#define APP_KV_MAX_VALUE_SIZE 256
+// Hash table size, power of two, and number of keys it takes.
+#define APP_KV_INDEX_SIZE 64
+#define APP_KV_MAX_KEYS 48
+
+typedef struct {
+  uint32_t num_keys;
+  // Bytes of live records, they are to fit into a page.
+  uint32_t live_size;
+  // Bytes appended to the log since its base.
+  uint32_t log_size;
+  uint32_t num_log_pages;
+  uint32_t mount_us;
+  uint32_t num_mount_records;
+  uint32_t num_sets;
+  uint32_t num_compactions;
+  uint32_t max_set_us;
+  uint32_t max_compaction_us;
+  // Records whose CRC didn't match, found by the last mount.
+  uint32_t num_bad_records;
+  uint32_t erase_counts[APP_KV_NUM_PAGES];
+} AppKVStats;
+
+// Mount the store, formatting it when flash holds no valid pages. Is called
+// early in system initialization, so TCP/IP stack configuration can be
+// restored from the store, and can be called again to re-mount.
+bool APP_KV_Initialize(void);
+
+// Copy value of the key into the buffer, up to the buffer size. Returns size
+// of the value, or -1 when there is no such key.
+int APP_KV_Get(const char* key, void* value, size_t size);
+
+// Set fails when the new record together with the live ones, the old value
+// of the key included, doesn't fit into a page with room left to delete a
+// key, so deletion never fails for lack of room.
+bool APP_KV_Set(const char* key, const void* value, size_t size);
+bool APP_KV_Delete(const char* key);
+
+// Erase all pages and start an empty store.
+bool APP_KV_Format(void);
+
+void APP_KV_StatsGet(AppKVStats* stats);
+void APP_KV_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_KV_H
@@ -0,0 +1,105 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_log.h"
+
+#include <xc.h>
+
+typedef struct {
+  uint32_t timestamp;
+  const char* format;
+  uint32_t args[APP_LOG_MAX_ARGS];
+} AppLogRecord;
+
+static AppLogRecord g_log_ring[APP_LOG_RING_SIZE];
+// Ring indices are free running, masked when accessing the ring.
+static volatile uint32_t g_log_head;
+static volatile uint32_t g_log_tail;
+static volatile uint32_t g_log_num_dropped;
+static uint32_t g_log_num_dropped_reported;
+static uint32_t g_log_max_pending;
+
+void APP_Log_Initialize(void) {
+  g_log_head = 0;
+  g_log_tail = 0;
+  g_log_num_dropped = 0;
+  g_log_num_dropped_reported = 0;
+  g_log_max_pending = 0;
+}
+
+void APP_Log_Write(const char* format,
+                   uint32_t a0, uint32_t a1, uint32_t a2,
+                   uint32_t a3, uint32_t a4, uint32_t a5) {
+  const bool interrupt_state = SYS_INT_Disable();
+  const uint32_t head = g_log_head;
+  const uint32_t num_pending = head - g_log_tail;
+  if (num_pending >= APP_LOG_RING_SIZE) {
+    ++g_log_num_dropped;
+    SYS_INT_Restore(interrupt_state);
+    return;
+  }
+  AppLogRecord* record = &g_log_ring[head & (APP_LOG_RING_SIZE - 1)];
+  record->timestamp = _CP0_GET_COUNT();
+  record->format = format;
+  record->args[0] = a0;
+  record->args[1] = a1;
+  record->args[2] = a2;
+  record->args[3] = a3;
+  record->args[4] = a4;
+  record->args[5] = a5;
+  g_log_head = head + 1;
+  if (num_pending + 1 > g_log_max_pending) {
+    g_log_max_pending = num_pending + 1;
+  }
+  SYS_INT_Restore(interrupt_state);
+}
+
+void APP_Log_Tasks(void) {
+  const uint32_t num_dropped = g_log_num_dropped;
+  if (num_dropped != g_log_num_dropped_reported) {
+    SYS_CONSOLE_PRINT("APP LOG: %u messages dropped\r\n",
+                      num_dropped - g_log_num_dropped_reported);
+    g_log_num_dropped_reported = num_dropped;
+  }
+  // Only one record is formatted per super-loop iteration, so burst of log
+  // messages does not stall networking.
+  const uint32_t tail = g_log_tail;
+  if (tail == g_log_head) {
+    return;
+  }
+  const AppLogRecord* record = &g_log_ring[tail & (APP_LOG_RING_SIZE - 1)];
+  SYS_CONSOLE_PRINT(record->format,
+                    record->args[0], record->args[1], record->args[2],
+                    record->args[3], record->args[4], record->args[5]);
+  // Record is released after it was formatted, producers never touch records
+  // in between of tail and head.
+  g_log_tail = tail + 1;
+}
+
+void APP_Log_StatsGet(AppLogStats* stats) {
+  const bool interrupt_state = SYS_INT_Disable();
+  stats->num_written = g_log_head;
+  stats->num_dropped = g_log_num_dropped;
+  stats->num_pending = g_log_head - g_log_tail;
+  stats->max_pending = g_log_max_pending;
+  SYS_INT_Restore(interrupt_state);
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_LOG_H
+#define _APP_LOG_H
+
+#include "system_definitions.h"
+
+// Deferred-formatting logger.
+//
+// Recording a message only stores pointer to its format string and raw
+// argument words into a RAM ring, which takes few cycles and is safe from
+// both tasks and interrupt context. Formatting and pushing text to the
+// console happens later from APP_Log_Tasks().
+//
+// NOTE: Arguments are stored as 32-bit words, so strings passed to the
+// logger must outlive the record (literals, interface names and so on).
+
+// Number of records in the ring, must be power of two.
+#define APP_LOG_RING_SIZE 32
+#define APP_LOG_MAX_ARGS 6
+
+// Usage: APP_LOG("%s IPv4 Address: %d\r\n", name, value);
+#define APP_LOG(...) _APP_LOG(__VA_ARGS__, 0, 0, 0, 0, 0, 0)
+#define _APP_LOG(format, a0, a1, a2, a3, a4, a5, ...)             \
+  APP_Log_Write(format,                                           \
+                (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2),   \
+                (uint32_t)(a3), (uint32_t)(a4), (uint32_t)(a5))
+
+typedef struct {
+  uint32_t num_written;
+  uint32_t num_dropped;
+  uint32_t num_pending;
+  uint32_t max_pending;
+} AppLogStats;
+
+void APP_Log_Initialize(void);
+
+// Format and print pending records to the console.
+// Is to be called from the super-loop.
+void APP_Log_Tasks(void);
+
+void APP_Log_Write(const char* format,
+                   uint32_t a0, uint32_t a1, uint32_t a2,
+                   uint32_t a3, uint32_t a4, uint32_t a5);
+
+void APP_Log_StatsGet(AppLogStats* stats);
+
+#endif  // _APP_LOG_H
@@ -0,0 +1,480 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_metrics.h"
+
+#include <stdio.h>
+
+#include "app_ethmac.h"
+#include "app_hid_bridge.h"
+#include "app_log.h"
+#include "app_profile.h"
+#include "app_udp_rx.h"
+
+// Renders sample with the given index into the buffer.
+// Returns number of characters the sample takes (which might be more than
+// the buffer size), or -1 if there are no more samples.
+typedef int (*AppMetricsSampleFunc)(AppHTTPGenerateCursor* cursor,
+                                    int index,
+                                    char* buffer,
+                                    int size);
+
+typedef struct {
+  const char* name;
+  const char* type;
+  const char* help;
+  AppMetricsSampleFunc sample;
+} AppMetricsFamily;
+
+static AppData* g_app_data;
+
+static int app_metrics_uptime(AppHTTPGenerateCursor* cursor,
+                              int index, char* buffer, int size) {
+  if (index != 0) {
+    return -1;
+  }
+  return snprintf(buffer, size, "app_uptime_seconds %u\n",
+                  SYS_TMR_TickCountGet() / SYS_TMR_TickCounterFrequencyGet());
+}
+
+static int app_metrics_net_up(AppHTTPGenerateCursor* cursor,
+                              int index, char* buffer, int size) {
+  TCPIP_NET_HANDLE net;
+  if (index >= TCPIP_STACK_NumberOfNetworksGet()) {
+    return -1;
+  }
+  net = TCPIP_STACK_IndexToNet(index);
+  return snprintf(buffer, size, "app_net_up{iface=\"%s\"} %d\n",
+                  TCPIP_STACK_NetNameGet(net),
+                  TCPIP_STACK_NetIsUp(net) ? 1 : 0);
+}
+
+// Counters of the receive hook, which are only available for interfaces
+// attached to it.
+static int app_metrics_net_rx(int index, char* buffer, int size,
+                              bool is_bytes) {
+  AppUDPRXNetStats stats;
+  if (index >= TCPIP_STACK_NumberOfNetworksGet()) {
+    return -1;
+  }
+  if (!APP_UDP_RX_NetStatsGet(index, &stats)) {
+    return 0;
+  }
+  return snprintf(buffer, size, "app_net_rx_%s_total{iface=\"%s\"} %u\n",
+                  is_bytes ? "bytes" : "frames",
+                  TCPIP_STACK_NetNameGet(TCPIP_STACK_IndexToNet(index)),
+                  is_bytes ? stats.num_bytes : stats.num_frames);
+}
+
+static int app_metrics_net_rx_frames(AppHTTPGenerateCursor* cursor,
+                                     int index, char* buffer, int size) {
+  return app_metrics_net_rx(index, buffer, size, false);
+}
+
+static int app_metrics_net_rx_bytes(AppHTTPGenerateCursor* cursor,
+                                    int index, char* buffer, int size) {
+  return app_metrics_net_rx(index, buffer, size, true);
+}
+
+// Every interface has four MAC counters, only some drivers provide them.
+static int app_metrics_net_mac(AppHTTPGenerateCursor* cursor,
+                               int index, char* buffer, int size) {
+  static const char* labels[] = {
+    "direction=\"rx\",result=\"ok\"",
+    "direction=\"rx\",result=\"error\"",
+    "direction=\"tx\",result=\"ok\"",
+    "direction=\"tx\",result=\"error\"",
+  };
+  TCPIP_MAC_RX_STATISTICS rx_stats;
+  TCPIP_MAC_TX_STATISTICS tx_stats;
+  TCPIP_NET_HANDLE net;
+  int value;
+  if (index / 4 >= TCPIP_STACK_NumberOfNetworksGet()) {
+    return -1;
+  }
+  net = TCPIP_STACK_IndexToNet(index / 4);
+  if (!TCPIP_STACK_NetMACStatisticsGet(net, &rx_stats, &tx_stats)) {
+    return 0;
+  }
+  switch (index % 4) {
+    case 0: value = rx_stats.nRxOkPackets; break;
+    case 1: value = rx_stats.nRxErrorPackets; break;
+    case 2: value = tx_stats.nTxOkPackets; break;
+    default: value = tx_stats.nTxErrorPackets; break;
+  }
+  return snprintf(buffer, size,
+                  "app_net_mac_packets_total{iface=\"%s\",%s} %d\n",
+                  TCPIP_STACK_NetNameGet(net), labels[index % 4], value);
+}
+
+static int app_metrics_eth_interrupts(AppHTTPGenerateCursor* cursor,
+                                      int index, char* buffer, int size) {
+  AppEthmacStats stats;
+  if (index != 0) {
+    return -1;
+  }
+  APP_ETHMAC_StatsGet(&stats);
+  return snprintf(buffer, size, "app_eth_interrupts_total %u\n",
+                  stats.num_interrupts);
+}
+
+static int app_metrics_eth_rx_overflows(AppHTTPGenerateCursor* cursor,
+                                        int index, char* buffer, int size) {
+  AppEthmacStats stats;
+  if (index != 0) {
+    return -1;
+  }
+  APP_ETHMAC_StatsGet(&stats);
+  return snprintf(buffer, size, "app_eth_rx_overflows_total %u\n",
+                  stats.num_rx_overflows);
+}
+
+// Three samples per socket: state, RX and TX FIFO sizes.
+static int app_metrics_tcp_socket(AppHTTPGenerateCursor* cursor,
+                                  int index, char* buffer, int size) {
+  TCP_SOCKET_INFO info;
+  if (index / 3 >= TCPIP_TCP_MAX_SOCKETS) {
+    return -1;
+  }
+  if (!TCPIP_TCP_SocketInfoGet(index / 3, &info)) {
+    return 0;
+  }
+  switch (index % 3) {
+    case 0:
+      return snprintf(buffer, size,
+                      "app_tcp_socket{socket=\"%d\",port=\"%u\","
+                      "value=\"state\"} %d\n",
+                      index / 3, info.localPort, info.state);
+    case 1:
+      return snprintf(buffer, size,
+                      "app_tcp_socket{socket=\"%d\",port=\"%u\","
+                      "value=\"rx_size\"} %u\n",
+                      index / 3, info.localPort, info.rxSize);
+  }
+  return snprintf(buffer, size,
+                  "app_tcp_socket{socket=\"%d\",port=\"%u\","
+                  "value=\"tx_size\"} %u\n",
+                  index / 3, info.localPort, info.txSize);
+}
+
+static int app_metrics_heap(AppHTTPGenerateCursor* cursor,
+                            int index, char* buffer, int size) {
+  TCPIP_STACK_HEAP_HANDLE heap =
+      TCPIP_STACK_HeapHandleGet(TCPIP_STACK_HEAP_TYPE_INTERNAL_HEAP, 0);
+  if (heap == NULL) {
+    return -1;
+  }
+  switch (index) {
+    case 0:
+      return snprintf(buffer, size, "app_heap_bytes{kind=\"size\"} %u\n",
+                      TCPIP_HEAP_Size(heap));
+    case 1:
+      return snprintf(buffer, size, "app_heap_bytes{kind=\"free\"} %u\n",
+                      TCPIP_HEAP_FreeSize(heap));
+  }
+  return -1;
+}
+
+// Buckets in microseconds, then +Inf, sum and count.
+// Histogram buckets are cumulative, so they all come from one snapshot taken
+// when rendering of the histogram starts.
+static int app_metrics_loop(AppHTTPGenerateCursor* cursor,
+                            int index, char* buffer, int size) {
+  uint32_t count = 0;
+  int i;
+  if (index == 0) {
+    APP_Profile_LoopStatsGet(&cursor->loop_stats);
+  }
+  if (index < APP_PROFILE_LOOP_HISTOGRAM_SIZE - 1) {
+    for (i = 0; i <= index; ++i) {
+      count += cursor->loop_stats.histogram[i];
+    }
+    return snprintf(buffer, size,
+                    "app_loop_duration_microseconds_bucket{le=\"%u\"} %u\n",
+                    1u << index, count);
+  }
+  switch (index - (APP_PROFILE_LOOP_HISTOGRAM_SIZE - 1)) {
+    case 0:
+      return snprintf(buffer, size,
+                      "app_loop_duration_microseconds_bucket{le=\"+Inf\"} "
+                      "%u\n",
+                      cursor->loop_stats.num_loops);
+    case 1:
+      return snprintf(buffer, size,
+                      "app_loop_duration_microseconds_sum %llu\n",
+                      (unsigned long long)(cursor->loop_stats.total_ticks /
+                                           APP_PROFILE_CORE_TICKS_PER_US));
+    case 2:
+      return snprintf(buffer, size,
+                      "app_loop_duration_microseconds_count %u\n",
+                      cursor->loop_stats.num_loops);
+  }
+  return -1;
+}
+
+static int app_metrics_log(AppHTTPGenerateCursor* cursor,
+                           int index, char* buffer, int size) {
+  AppLogStats stats;
+  APP_Log_StatsGet(&stats);
+  switch (index) {
+    case 0:
+      return snprintf(buffer, size, "app_log_records_total{result=\"written\"} "
+                      "%u\n", stats.num_written);
+    case 1:
+      return snprintf(buffer, size, "app_log_records_total{result=\"dropped\"} "
+                      "%u\n", stats.num_dropped);
+  }
+  return -1;
+}
+
+static int app_metrics_usb_hid(AppHTTPGenerateCursor* cursor,
+                               int index, char* buffer, int size) {
+  const AppUSBHIDData* usb_hid = &g_app_data->usb_hid;
+  switch (index) {
+    case 0:
+      return snprintf(buffer, size,
+                      "app_usb_hid_reports_total{direction=\"out\"} %u\n",
+                      usb_hid->num_reports_received);
+    case 1:
+      return snprintf(buffer, size,
+                      "app_usb_hid_reports_total{direction=\"in\"} %u\n",
+                      usb_hid->num_reports_sent);
+  }
+  return -1;
+}
+
+static const char* g_metrics_hid_bridge_lanes[APP_USB_HID_NUM_LANES] = {
+    "control", "bulk"};
+
+static int app_metrics_hid_bridge(AppHTTPGenerateCursor* cursor,
+                                  int index, char* buffer, int size) {
+  const int lane = index / 2;
+  const AppHIDBridgeLaneStats* lane_stats;
+  AppHIDBridgeStats stats;
+  if (lane >= APP_USB_HID_NUM_LANES) {
+    return -1;
+  }
+  APP_HID_Bridge_StatsGet(&stats);
+  lane_stats = &stats.lanes[lane];
+  if (index % 2 == 0) {
+    return snprintf(buffer, size,
+                    "app_hid_bridge_records{lane=\"%s\",kind=\"pending\"} "
+                    "%u\n",
+                    g_metrics_hid_bridge_lanes[lane],
+                    lane_stats->num_pending);
+  }
+  return snprintf(buffer, size,
+                  "app_hid_bridge_records{lane=\"%s\",kind=\"high_water\"} "
+                  "%u\n",
+                  g_metrics_hid_bridge_lanes[lane],
+                  lane_stats->high_water);
+}
+
+static int app_metrics_hid_bridge_dropped(AppHTTPGenerateCursor* cursor,
+                                          int index, char* buffer, int size) {
+  AppHIDBridgeStats stats;
+  if (index >= APP_USB_HID_NUM_LANES) {
+    return -1;
+  }
+  APP_HID_Bridge_StatsGet(&stats);
+  return snprintf(buffer, size,
+                  "app_hid_bridge_dropped_total{lane=\"%s\"} %u\n",
+                  g_metrics_hid_bridge_lanes[index],
+                  stats.lanes[index].num_dropped);
+}
+
+static int app_metrics_hid_bridge_latency(AppHTTPGenerateCursor* cursor,
+                                          int index, char* buffer, int size) {
+  AppHIDBridgeStats stats;
+  if (index != 0) {
+    return -1;
+  }
+  APP_HID_Bridge_StatsGet(&stats);
+  return snprintf(buffer, size,
+                  "app_hid_bridge_control_latency_max_microseconds %u\n",
+                  stats.control_latency_max_us);
+}
+
+static int app_metrics_wifi(AppHTTPGenerateCursor* cursor,
+                            int index, char* buffer, int size) {
+  const AppNetworkData* network = &g_app_data->network;
+  switch (index) {
+    case 0:
+      return snprintf(buffer, size,
+                      "app_wifi_reconnects_total{kind=\"reset\"} %u\n",
+                      network->num_wifi_resets);
+    case 1:
+      return snprintf(buffer, size,
+                      "app_wifi_reconnects_total{kind=\"reestablished\"} %u\n",
+                      network->num_wifi_reconnects);
+  }
+  return -1;
+}
+
+static int app_metrics_http_requests(AppHTTPGenerateCursor* cursor,
+                                     int index, char* buffer, int size) {
+  if (index != 0) {
+    return -1;
+  }
+  return snprintf(buffer, size, "app_http_requests_total %u\n",
+                  g_app_data->http.num_requests);
+}
+
+static int app_metrics_http_errors(AppHTTPGenerateCursor* cursor,
+                                   int index, char* buffer, int size) {
+  if (index != 0) {
+    return -1;
+  }
+  return snprintf(buffer, size, "app_http_errors_total %u\n",
+                  g_app_data->http.num_errors);
+}
+
+static int app_metrics_udp_rx(AppHTTPGenerateCursor* cursor,
+                              int index, char* buffer, int size) {
+  AppUDPRXStats stats;
+  APP_UDP_RX_StatsGet(&stats);
+  switch (index) {
+    case 0:
+      return snprintf(buffer, size,
+                      "app_udp_rx_packets_total{result=\"received\"} %u\n",
+                      stats.num_received);
+    case 1:
+      return snprintf(buffer, size,
+                      "app_udp_rx_packets_total{result=\"dropped\"} %u\n",
+                      stats.num_dropped);
+  }
+  return -1;
+}
+
+static int app_metrics_udp_rx_checksums(AppHTTPGenerateCursor* cursor,
+                                        int index, char* buffer, int size) {
+  AppUDPRXStats stats;
+  APP_UDP_RX_StatsGet(&stats);
+  switch (index) {
+    case 0:
+      return snprintf(buffer, size,
+                      "app_udp_rx_checksums_total{source=\"hardware\"} %u\n",
+                      stats.num_hw_checksums);
+    case 1:
+      return snprintf(buffer, size,
+                      "app_udp_rx_checksums_total{source=\"software\"} %u\n",
+                      stats.num_sw_checksums);
+  }
+  return -1;
+}
+
+static const AppMetricsFamily g_families[] = {
+  {"app_uptime_seconds", "gauge", "Time since boot.",
+   app_metrics_uptime},
+  {"app_net_up", "gauge", "Whether network interface is up.",
+   app_metrics_net_up},
+  {"app_net_rx_frames_total", "counter",
+   "Frames received on the interface.",
+   app_metrics_net_rx_frames},
+  {"app_net_rx_bytes_total", "counter",
+   "Bytes received on the interface, including link layer headers.",
+   app_metrics_net_rx_bytes},
+  {"app_net_mac_packets_total", "counter",
+   "MAC driver packet counters, for drivers which provide them.",
+   app_metrics_net_mac},
+  {"app_eth_interrupts_total", "counter",
+   "Ethernet controller interrupts which were serviced.",
+   app_metrics_eth_interrupts},
+  {"app_eth_rx_overflows_total", "counter",
+   "Frames lost due to Ethernet RX descriptors overflow.",
+   app_metrics_eth_rx_overflows},
+  {"app_tcp_socket", "gauge",
+   "TCP sockets, state is the TCPIP_TCP_STATE value.",
+   app_metrics_tcp_socket},
+  {"app_heap_bytes", "gauge", "TCP/IP heap size and free space.",
+   app_metrics_heap},
+  {"app_loop_duration_microseconds", "histogram",
+   "Duration of the super-loop iteration.",
+   app_metrics_loop},
+  {"app_log_records_total", "counter", "Deferred logger records.",
+   app_metrics_log},
+  {"app_usb_hid_reports_total", "counter",
+   "USB HID reports, out is host to device.",
+   app_metrics_usb_hid},
+  {"app_hid_bridge_records", "gauge",
+   "Records in the HID bridge ring, and the highest number of them.",
+   app_metrics_hid_bridge},
+  {"app_hid_bridge_dropped_total", "counter",
+   "Records dropped because of a full HID bridge ring.",
+   app_metrics_hid_bridge_dropped},
+  {"app_hid_bridge_control_latency_max_microseconds", "gauge",
+   "Longest time a control record waited in the HID bridge ring.",
+   app_metrics_hid_bridge_latency},
+  {"app_wifi_reconnects_total", "counter", "Wi-Fi connection recoveries.",
+   app_metrics_wifi},
+  {"app_http_requests_total", "counter", "HTTP requests served.",
+   app_metrics_http_requests},
+  {"app_http_errors_total", "counter", "HTTP requests answered with error.",
+   app_metrics_http_errors},
+  {"app_udp_rx_packets_total", "counter",
+   "UDP datagrams of the zero-copy receive ports.",
+   app_metrics_udp_rx},
+  {"app_udp_rx_checksums_total", "counter",
+   "UDP checksums of the zero-copy receive ports by where the sum came from.",
+   app_metrics_udp_rx_checksums},
+};
+
+#define APP_METRICS_NUM_FAMILIES (sizeof(g_families) / sizeof(*g_families))
+
+void APP_Metrics_Initialize(AppData* app_data) {
+  g_app_data = app_data;
+}
+
+// Position keeps index of the family in the upper half and index of the line
+// within the family in the lower one. Line zero is HELP and TYPE comments.
+int APP_Metrics_Render(AppHTTPGenerateCursor* cursor, char* buffer, int size) {
+  uint32_t* position = &cursor->position;
+  int length = 0;
+  while ((*position >> 16) < APP_METRICS_NUM_FAMILIES) {
+    const AppMetricsFamily* family = &g_families[*position >> 16];
+    const int line = *position & 0xffff;
+    int line_length;
+    if (line == 0) {
+      line_length = snprintf(buffer + length, size - length,
+                             "# HELP %s %s\n# TYPE %s %s\n",
+                             family->name, family->help,
+                             family->name, family->type);
+    } else {
+      line_length = family->sample(cursor, line - 1,
+                                   buffer + length, size - length);
+    }
+    if (line_length < 0) {
+      *position = ((*position >> 16) + 1) << 16;
+      continue;
+    }
+    if (line_length >= size - length) {
+      // Line is truncated, it goes to the next chunk.
+      break;
+    }
+    length += line_length;
+    ++*position;
+  }
+  if (length == 0 && (*position >> 16) == APP_METRICS_NUM_FAMILIES) {
+    return -1;
+  }
+  return length;
+}
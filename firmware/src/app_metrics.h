@@ -0,0 +1,42 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_METRICS_H
+#define _APP_METRICS_H
+
+#include "app.h"
+
+// Runtime metrics in the Prometheus text exposition format.
+//
+// Metrics are rendered incrementally: every call fills the given buffer with
+// as many complete lines as fit and advances the cursor, so a scrape never
+// needs more memory than a single chunk.
+
+void APP_Metrics_Initialize(AppData* app_data);
+
+// Render next lines into the buffer and advance the cursor.
+// Returns number of characters written, zero if the next line doesn't fit
+// into the buffer, or -1 when all metrics are rendered.
+// Every scrape needs its own zero-initialized cursor.
+int APP_Metrics_Render(AppHTTPGenerateCursor* cursor, char* buffer, int size);
+
+#endif  // _APP_METRICS_H
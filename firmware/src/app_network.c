@@ -22,10 +22,28 @@
 
 #include "app_network.h"
 
+#include <stdio.h>
+
 #include "app.h"
+#include "app_kv.h"
+#include "app_log.h"
 #include "app_network_utils.h"
+#include "app_profile.h"
 #include "system_definitions.h"
 
+#if defined(TCPIP_STACK_CONFIGURATION_SAVE_RESTORE) && \
+    TCPIP_STACK_CONFIGURATION_SAVE_RESTORE
+// Restored network configuration with the strings it points to, is used by
+// the stack after the restore.
+static uint32_t g_net_config_buffers[APP_NETWORK_MAX_IFACES]
+                                    [(sizeof(TCPIP_NETWORK_CONFIG) +
+                                      APP_KV_MAX_VALUE_SIZE) / 4];
+#endif
+
+static void app_network_config_key(int index, char key[16]) {
+  sprintf(key, "net%d.cfg", index);
+}
+
 static bool app_network_tcpip_init_wait(AppNetworkData* app_network_data) {
   SYS_STATUS tcpip_status =
       TCPIP_STACK_Status(app_network_data->system_objects->tcpip);
@@ -35,23 +53,30 @@ static bool app_network_tcpip_init_wait(AppNetworkData* app_network_data) {
     return true;
   } else if (tcpip_status == SYS_STATUS_READY) {
     SYS_CONSOLE_MESSAGE("TCP/IP stack initialization succeeded.\r\n");
-    // If we don't have WiFi configured, we skip corresponding
-    // initialization step.
-    bool has_wifi = false;
+    APP_Profile_BootMark(APP_BOOT_TCPIP_READY);
     int i, num_nets = TCPIP_STACK_NumberOfNetworksGet();
+    if (num_nets > APP_NETWORK_MAX_IFACES) {
+      num_nets = APP_NETWORK_MAX_IFACES;
+    }
     for (i = 0; i < num_nets; ++i) {
+      AppNetworkIface* iface = &app_network_data->ifaces[i];
       TCPIP_NET_HANDLE net = TCPIP_STACK_IndexToNet(i);
       const char *net_name = TCPIP_STACK_NetNameGet(net);
-      if (IS_WIFI_INTERFACE(net_name)) {
-        has_wifi = true;
+      iface->net_handle = net;
+      iface->is_wifi = IS_WIFI_INTERFACE(net_name);
+      iface->was_up = true;
+      iface->last_ip.Val = -1;
+      // Interfaces other than Wi-Fi have nothing to wait for.
+      iface->state = iface->is_wifi ? APP_NETWORK_IFACE_WAIT_READY
+                                    : APP_NETWORK_IFACE_MODULES_ENABLE;
+      if (iface->is_wifi) {
+        SYS_CONSOLE_MESSAGE("APP NETWORK: Waiting WiFI module to finish configuration\r\n");
+        app_network_data->wifi_iface = iface;
       }
     }
-    if (has_wifi) {
-      SYS_CONSOLE_MESSAGE("APP NETWORK: Waiting WiFI module to finish configuration\r\n");
-      app_network_data->state = APP_NETWORK_WIFI_CONFIG;
-    } else {
-      app_network_data->state = APP_NETWORK_TCPIP_MODULES_ENABLE;
-    }
+    app_network_data->num_ifaces = num_nets;
+    app_network_data->state = APP_NETWORK_TCPIP_TRANSACT;
+    APP_Profile_BootMark(APP_BOOT_TCPIP_TRANSACT);
     return true;
   }
   return false;
@@ -63,40 +88,59 @@ static bool app_network_wifi_config(AppNetworkData* app_network_data) {
   IWPRIV_GET_PARAM wifi_get_param;
   iwpriv_get(DRVSTATUS_GET, &wifi_get_param);
   if (wifi_get_param.driverStatus.isOpen) {
-    SYS_CONSOLE_MESSAGE("APP NETWORK: WiFi driver is open\r\n");
+    APP_LOG("APP NETWORK: WiFi driver is open\r\n");
+    APP_Profile_BootMark(APP_BOOT_WIFI_OPEN);
     wifi_get_param.devInfo.data = &app_network_data->wifi_device_info;
     iwpriv_get(DEVICEINFO_GET, &wifi_get_param);
     app_network_data->wifi_net_handle =
         TCPIP_STACK_NetHandleGet(WIFI_INTERFACE_NAME);
     app_network_data->wifi_default_ip.Val =
         TCPIP_STACK_NetAddress(app_network_data->wifi_net_handle);
-    app_network_data->state = APP_NETWORK_TCPIP_MODULES_ENABLE;
     return true;
   }
   return false;
 }
 
-static void app_network_tcpip_module_enable(AppNetworkData* app_network_data) {
-  int i, num_networks = TCPIP_STACK_NumberOfNetworksGet();
-  SYS_CONSOLE_PRINT("APP NETWORK: Enabling %d modules\r\n", num_networks);
-  for (i = 0; i < num_networks; ++i) {
-    app_network_tcpip_ifmodules_enable(TCPIP_STACK_IndexToNet(i));
+static void app_network_iface_modules_enable(AppNetworkData* app_network_data,
+                                             AppNetworkIface* iface) {
+  APP_LOG("APP NETWORK: Enabling modules on %s\r\n",
+          TCPIP_STACK_NetNameGet(iface->net_handle));
+  APP_Profile_BootMark(APP_BOOT_MODULES_ENABLE);
+  app_network_tcpip_ifmodules_enable(iface->net_handle);
+  if (iface->is_wifi) {
+    timestamp_dhcp_kickin(app_network_data->ip_wait);
   }
-  app_network_data->state = APP_NETWORK_TCPIP_TRANSACT;
+  iface->state = APP_NETWORK_IFACE_RUN;
 }
 
-static void app_network_run(AppNetworkData* app_network_data) {
-  // NOTE: This app supports 2 interfaces so far.
+static void app_network_iface_tasks(AppNetworkData* app_network_data,
+                                    AppNetworkIface* iface) {
+  switch (iface->state) {
+    case APP_NETWORK_IFACE_WAIT_READY:
+      if (iface->is_wifi && !app_network_wifi_config(app_network_data)) {
+        break;
+      }
+      iface->state = APP_NETWORK_IFACE_MODULES_ENABLE;
+    case APP_NETWORK_IFACE_MODULES_ENABLE:
+      app_network_iface_modules_enable(app_network_data, iface);
+      break;
+    case APP_NETWORK_IFACE_RUN:
+      break;
+  }
+}
+
+static void app_network_wifi_run(AppNetworkData* app_network_data) {
   // TODO(sergey): Move static variables to application state.
   static bool is_wifi_power_save_configured = false;
-  static bool was_net_up[2] = {true, true};
   static uint32_t reconn_retries = 0;
-  static uint32_t start_tick = 0;
-  static IPV4_ADDR last_ip[2] = { {-1}, {-1} };
-  int i, num_nets;
+  AppNetworkIface* wifi_iface = app_network_data->wifi_iface;
   TCPIP_NET_HANDLE wifi_net_handle = app_network_data->wifi_net_handle;
   IWPRIV_GET_PARAM wifi_get_param;
 
+  if (wifi_iface == NULL || wifi_iface->state != APP_NETWORK_IFACE_RUN) {
+    return;
+  }
+
   iwpriv_get(CONNSTATUS_GET, &wifi_get_param);
   switch (wifi_get_param.conn.status) {
     case IWPRIV_CONNECTION_SUCCESSFUL:
@@ -105,19 +149,23 @@ static void app_network_run(AppNetworkData* app_network_data) {
       break;
     case IWPRIV_CONNECTION_FAILED:
       if (reconn_retries++ < WIFI_RECONNECTION_RETRY_LIMIT) {
-        SYS_CONSOLE_PRINT("\r\nCouldn't connect to target AP, "
-                          "resetting Wi-Fi module and trying to reconnect, "
-                          "retries left: %u\r\n",
-                          WIFI_RECONNECTION_RETRY_LIMIT - reconn_retries);
+        ++app_network_data->num_wifi_resets;
+        APP_LOG("\r\nCouldn't connect to target AP, "
+                "resetting Wi-Fi module and trying to reconnect, "
+                "retries left: %u\r\n",
+                WIFI_RECONNECTION_RETRY_LIMIT - reconn_retries);
         app_network_tcpip_ifmodules_disable(wifi_net_handle);
         app_network_tcpip_iface_down(wifi_net_handle);
         app_network_tcpip_iface_up(wifi_net_handle);
         is_wifi_power_save_configured = false;
-        app_network_data->state = APP_NETWORK_WIFI_CONFIG;
+        // Only Wi-Fi goes through configuration again, other interfaces
+        // keep running.
+        wifi_iface->state = APP_NETWORK_IFACE_WAIT_READY;
         return;
       }
       break;
     case IWPRIV_CONNECTION_REESTABLISHED:
+      ++app_network_data->num_wifi_reconnects;
       // Restart DHCP client and config power save.
       TCPIP_DHCP_Disable(wifi_net_handle);
       TCPIP_DHCP_Enable(wifi_net_handle);
@@ -127,23 +175,9 @@ static void app_network_run(AppNetworkData* app_network_data) {
     default:
       break;
   }
-  // Following for loop is to deal with manually controlling interface down/up
-  // (for example, through console commands or web page).
-  num_nets = TCPIP_STACK_NumberOfNetworksGet();
-  for (i = 0; i < num_nets; ++i) {
-    TCPIP_NET_HANDLE net = TCPIP_STACK_IndexToNet(i);
-    if (!TCPIP_STACK_NetIsUp(net) && was_net_up[i]) {
-      const char *net_name = TCPIP_STACK_NetNameGet(net);
-      was_net_up[i] = false;
-      app_network_tcpip_ifmodules_disable(net);
-      if (IS_WIFI_INTERFACE(net_name)) {
-        is_wifi_power_save_configured = false;
-      }
-    }
-    if (TCPIP_STACK_NetIsUp(net) && !was_net_up[i]) {
-      was_net_up[i] = true;
-      app_network_tcpip_ifmodules_enable(net);
-    }
+
+  if (!wifi_iface->was_up) {
+    is_wifi_power_save_configured = false;
   }
 
   // If we get a new IP address that is different than the default one,
@@ -156,22 +190,59 @@ static void app_network_run(AppNetworkData* app_network_data) {
   }
 
   app_network_wifi_DHCPS_sync(wifi_net_handle);
+}
+
+static void app_network_run(AppNetworkData* app_network_data) {
+  static uint32_t start_tick = 0;
+  int i, num_ifaces = app_network_data->num_ifaces;
+
+  for (i = 0; i < num_ifaces; ++i) {
+    app_network_iface_tasks(app_network_data, &app_network_data->ifaces[i]);
+  }
+
+  app_network_wifi_run(app_network_data);
+
+  // Following for loop is to deal with manually controlling interface down/up
+  // (for example, through console commands or web page).
+  for (i = 0; i < num_ifaces; ++i) {
+    AppNetworkIface* iface = &app_network_data->ifaces[i];
+    TCPIP_NET_HANDLE net = iface->net_handle;
+    if (iface->state != APP_NETWORK_IFACE_RUN) {
+      continue;
+    }
+    if (!TCPIP_STACK_NetIsUp(net) && iface->was_up) {
+      iface->was_up = false;
+      app_network_tcpip_ifmodules_disable(net);
+    }
+    if (TCPIP_STACK_NetIsUp(net) && !iface->was_up) {
+      iface->was_up = true;
+      app_network_tcpip_ifmodules_enable(net);
+    }
+  }
 
   // If the IP address of an interface has changed, 
   // display the new value on console.
-  for (i = 0; i < num_nets; ++i) {
+  for (i = 0; i < num_ifaces; ++i) {
+    AppNetworkIface* iface = &app_network_data->ifaces[i];
     IPV4_ADDR ipAddr;
-    TCPIP_NET_HANDLE netH = TCPIP_STACK_IndexToNet(i);
+    TCPIP_NET_HANDLE netH = iface->net_handle;
     ipAddr.Val = TCPIP_STACK_NetAddress(netH);
-    if (last_ip[i].Val != ipAddr.Val) {
-      last_ip[i].Val = ipAddr.Val;
+    if (iface->last_ip.Val != ipAddr.Val) {
+      iface->last_ip.Val = ipAddr.Val;
       if (ipAddr.Val != 0) {
-        SYS_CONSOLE_PRINT("%s IPv4 Address: %d.%d.%d.%d \r\n",
-                          TCPIP_STACK_NetNameGet(netH),
-                          ipAddr.v[0], ipAddr.v[1], ipAddr.v[2], ipAddr.v[3]);
-        app_network_data->ip_wait = 0;
+        APP_LOG("%s IPv4 Address: %d.%d.%d.%d \r\n",
+                TCPIP_STACK_NetNameGet(netH),
+                ipAddr.v[0], ipAddr.v[1], ipAddr.v[2], ipAddr.v[3]);
+        if (iface->is_wifi) {
+          app_network_data->ip_wait = 0;
+        }
       }
     }
+    // Interface is considered connected once it got its final address.
+    if (ipAddr.Val != 0 &&
+        (!TCPIP_DHCP_IsEnabled(netH) || TCPIP_DHCP_IsBound(netH))) {
+      APP_Profile_BootMark(APP_BOOT_NET0_ADDRESS + i);
+    }
   }
 
   const uint32_t time_delta = SYS_TMR_TickCountGet() - start_tick;
@@ -179,9 +250,11 @@ static void app_network_run(AppNetworkData* app_network_data) {
   if (time_delta >= time_threshold) {
     if (app_network_data->ip_wait &&
         ++app_network_data->ip_wait > WIFI_DHCP_WAIT_THRESHOLD) {
+      IWPRIV_GET_PARAM wifi_get_param;
+      iwpriv_get(CONNSTATUS_GET, &wifi_get_param);
       app_network_data->ip_wait = 0;
       if (wifi_get_param.conn.status == IWPRIV_CONNECTION_SUCCESSFUL)
-        SYS_CONSOLE_MESSAGE(
+        APP_LOG(
             "\r\nFailed to obtain an IP address from DHCP server\r\n"
             "If WEP security is used, double-check if the key is valid\r\n");
     }
@@ -194,10 +267,14 @@ void APP_Network_Initialize(AppNetworkData* app_network_data,
   app_network_data->system_objects = system_objects;
 
   app_network_data->state = APP_NETWORK_TCPIP_WAIT_INIT;
+  app_network_data->num_ifaces = 0;
   app_network_data->ip_wait = 0;
   // Initialize WiFi networking.
+  app_network_data->wifi_iface = NULL;
   app_network_data->wifi_default_ip.Val = -1;
   app_network_data->wifi_net_handle = NULL;
+  app_network_data->num_wifi_resets = 0;
+  app_network_data->num_wifi_reconnects = 0;
   IWPRIV_SET_PARAM wifi_set_param;
   wifi_set_param.conn.initConnAllowed = true;
   iwpriv_set(INITCONN_OPTION_SET, &wifi_set_param);
@@ -209,14 +286,6 @@ void APP_Network_Tasks(AppNetworkData* app_network_data) {
       if (!app_network_tcpip_init_wait(app_network_data)) {
         break;
       }
-    case APP_NETWORK_WIFI_CONFIG:
-      if (!app_network_wifi_config(app_network_data)) {
-        break;
-      }
-    case APP_NETWORK_TCPIP_MODULES_ENABLE:
-      app_network_tcpip_module_enable(app_network_data);
-      timestamp_dhcp_kickin(app_network_data->ip_wait);
-      break;
     case APP_NETWORK_TCPIP_TRANSACT:
       // TODO(sergey): This perhaps belongs to an application-level tasks.
       SYS_CMD_READY_TO_READ();
@@ -228,8 +297,81 @@ void APP_Network_Tasks(AppNetworkData* app_network_data) {
   }
 }
 
+void APP_Network_ConfigRestore(TCPIP_NETWORK_CONFIG* net_config,
+                               const TCPIP_NETWORK_CONFIG* defaults,
+                               int num_nets) {
+  int i;
+  for (i = 0; i < num_nets; ++i) {
+    net_config[i] = defaults[i];
+  }
+#if defined(TCPIP_STACK_CONFIGURATION_SAVE_RESTORE) && \
+    TCPIP_STACK_CONFIGURATION_SAVE_RESTORE
+  for (i = 0; i < num_nets && i < APP_NETWORK_MAX_IFACES; ++i) {
+    uint8_t stored[APP_KV_MAX_VALUE_SIZE];
+    const TCPIP_NETWORK_CONFIG* restored;
+    char key[16];
+    app_network_config_key(i, key);
+    if (APP_KV_Get(key, stored, sizeof(stored)) <= 0) {
+      continue;
+    }
+    restored = TCPIP_STACK_NetConfigSet(stored,
+                                        g_net_config_buffers[i],
+                                        sizeof(g_net_config_buffers[i]),
+                                        NULL);
+    if (restored == NULL) {
+      SYS_CONSOLE_PRINT("APP NETWORK: Invalid stored configuration of "
+                        "interface %d\r\n", i);
+      continue;
+    }
+    net_config[i] = *restored;
+    // MAC driver and power mode always come from the build.
+    net_config[i].pMacObject = defaults[i].pMacObject;
+    net_config[i].powerMode = defaults[i].powerMode;
+  }
+#endif
+}
+
+bool APP_Network_ConfigSave(void) {
+#if defined(TCPIP_STACK_CONFIGURATION_SAVE_RESTORE) && \
+    TCPIP_STACK_CONFIGURATION_SAVE_RESTORE
+  int i, num_nets = TCPIP_STACK_NumberOfNetworksGet();
+  if (num_nets > APP_NETWORK_MAX_IFACES) {
+    num_nets = APP_NETWORK_MAX_IFACES;
+  }
+  for (i = 0; i < num_nets; ++i) {
+    uint8_t stored[APP_KV_MAX_VALUE_SIZE];
+    char key[16];
+    const size_t size = TCPIP_STACK_NetConfigGet(TCPIP_STACK_IndexToNet(i),
+                                                 stored,
+                                                 sizeof(stored),
+                                                 NULL);
+    app_network_config_key(i, key);
+    if (size == 0 || size > sizeof(stored) ||
+        !APP_KV_Set(key, stored, size)) {
+      return false;
+    }
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool APP_Network_ConfigForget(void) {
+  int i;
+  for (i = 0; i < APP_NETWORK_MAX_IFACES; ++i) {
+    char key[16];
+    app_network_config_key(i, key);
+    if (!APP_KV_Delete(key)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void APP_Network_PHY_Reset(const struct DRV_ETHPHY_OBJECT_BASE_TYPE* pBaseObj) {
   // TODO(sergey): Check whether it's LAN8720 PHY.
+  APP_Profile_BootMark(APP_BOOT_PHY_RESET);
   ETH_NRSTOff();
   ETH_NRSTOn();
 }
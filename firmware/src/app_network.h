@@ -33,35 +33,61 @@
 
 struct DRV_ETHPHY_OBJECT_BASE_TYPE;
 
+// NOTE: This app supports 2 interfaces so far.
+#define APP_NETWORK_MAX_IFACES 2
+
 typedef enum {
   // Wait for TCP/IP stack to finish initalization.
   APP_NETWORK_TCPIP_WAIT_INIT,
 
-  // Configure WiFi module.
-  APP_NETWORK_WIFI_CONFIG,
-
-  // Configure TCP/IP modules (like DHCP) for all interfaces.
-  APP_NETWORK_TCPIP_MODULES_ENABLE,
-
-  // Perform TCP/IP transaction.
+  // Bring up interfaces and perform TCP/IP transaction.
   APP_NETWORK_TCPIP_TRANSACT,
 
   // Error happened in the networking related area.
   APP_NETWORK_TCPIP_ERROR,
 } AppNetworkState;
 
+// Every interface is brought up independently from others, so slow Wi-Fi
+// association does not delay DHCP on Ethernet.
+typedef enum {
+  // Wait for interface's MAC driver to become ready.
+  APP_NETWORK_IFACE_WAIT_READY,
+
+  // Configure TCP/IP modules (like DHCP) for the interface.
+  APP_NETWORK_IFACE_MODULES_ENABLE,
+
+  // Interface is configured and is running.
+  APP_NETWORK_IFACE_RUN,
+} AppNetworkIfaceState;
+
+typedef struct {
+  TCPIP_NET_HANDLE net_handle;
+  AppNetworkIfaceState state;
+  bool is_wifi;
+  bool was_up;
+  IPV4_ADDR last_ip;
+} AppNetworkIface;
+
 typedef struct {
   SYSTEM_OBJECTS* system_objects;
 
   AppNetworkState state;
 
+  int num_ifaces;
+  AppNetworkIface ifaces[APP_NETWORK_MAX_IFACES];
+
   int16_t ip_wait;
 
   // WiFi-related fields.
+  AppNetworkIface* wifi_iface;
   IPV4_ADDR wifi_default_ip;
   TCPIP_NET_HANDLE wifi_net_handle;
   DRV_WIFI_CONFIG_DATA wifi_config;
   DRV_WIFI_DEVICE_INFO wifi_device_info;
+  // Module resets after failed connection, and connections re-established
+  // by the module itself.
+  uint32_t num_wifi_resets;
+  uint32_t num_wifi_reconnects;
 } AppNetworkData;
 
 // Initialize networking-related application routines.
@@ -71,6 +97,20 @@ void APP_Network_Initialize(AppNetworkData* app_network_data,
 // Perform all networking related tasks.
 void APP_Network_Tasks(AppNetworkData* app_network_data);
 
+// Fill in configuration of the interfaces for the TCP/IP stack: the defaults
+// the firmware is built with, overridden by the ones saved to the key-value
+// store. Is called before the stack is initialized.
+void APP_Network_ConfigRestore(TCPIP_NETWORK_CONFIG* net_config,
+                               const TCPIP_NETWORK_CONFIG* defaults,
+                               int num_nets);
+
+// Save current configuration of all interfaces (addresses, host name, start
+// flags) to the key-value store, so it is used from the next boot on.
+bool APP_Network_ConfigSave(void);
+
+// Delete saved configuration, the next boot uses defaults.
+bool APP_Network_ConfigForget(void);
+
 // Reset LAN8720 Eth PHY when it's requested.
 void APP_Network_PHY_Reset(const struct DRV_ETHPHY_OBJECT_BASE_TYPE* pBaseObj);
 
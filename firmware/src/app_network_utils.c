@@ -47,6 +47,8 @@
 
 #include "app_network_utils.h"
 
+#include "app_http.h"
+
 #include "driver/wifi/mrf24w/src/drv_wifi_iwpriv.h"
 
 void app_network_wifi_ipv6_multicast_filter_set(TCPIP_NET_HANDLE net) {
@@ -115,14 +117,14 @@ void app_network_tcpip_ifmodules_enable(TCPIP_NET_HANDLE net) {
                     netbios_name);
 #endif
 #if defined(TCPIP_STACK_USE_ZEROCONF_MDNS_SD)
-  // TODO(sergey): Skip this or support actual HTTP server.
+  // Advertise the status server, see app_http.h.
   // NOTE: Base name of the service Must not exceed 16 bytes long.
   char mdns_service_name[] = "MyWebServiceNameX ";
   // NOTE: The last digit will be incremented by interface.
   mdns_service_name[sizeof(mdns_service_name) - 2] = '1' + net_index;
   TCPIP_MDNS_ServiceRegister(net,
                              mdns_service_name,
-                             "_http._tcp.local", 80,
+                             "_http._tcp.local", APP_HTTP_PORT,
                              ((const uint8_t *)"path=/index.htm"),
                              1,
                              NULL, NULL);
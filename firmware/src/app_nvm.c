@@ -0,0 +1,64 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_nvm.h"
+
+#include <xc.h>
+
+void APP_NVM_Start(AppNVMOp op, uint32_t address, const void* data) {
+  const uint32_t tick = _CP0_GET_COUNT();
+  bool interrupt_state;
+  NVMADDR = KVA_TO_PA(address);
+  if (op == APP_NVM_OP_WORD_PROGRAM) {
+    NVMDATA = *(const uint32_t*)data;
+  } else if (op == APP_NVM_OP_ROW_PROGRAM) {
+    NVMSRCADDR = KVA_TO_PA(data);
+  }
+  NVMCON = _NVMCON_WREN_MASK | op;
+  while (_CP0_GET_COUNT() - tick < APP_NVM_SETTLE_TICKS) {
+  }
+  // Unlock sequence must not be interrupted.
+  interrupt_state = SYS_INT_Disable();
+  NVMKEY = APP_NVM_KEY1;
+  NVMKEY = APP_NVM_KEY2;
+  NVMCONSET = _NVMCON_WR_MASK;
+  SYS_INT_Restore(interrupt_state);
+}
+
+bool APP_NVM_IsBusy(void) {
+  return (NVMCON & _NVMCON_WR_MASK) != 0;
+}
+
+bool APP_NVM_Finish(void) {
+  const bool is_ok = (NVMCON & (_NVMCON_WRERR_MASK | _NVMCON_LVDERR_MASK)) == 0;
+  NVMCONCLR = _NVMCON_WREN_MASK;
+  return is_ok;
+}
+
+bool APP_NVM_Run(AppNVMOp op, uint32_t address, const void* data) {
+  while (APP_NVM_IsBusy()) {
+  }
+  APP_NVM_Start(op, address, data);
+  while (APP_NVM_IsBusy()) {
+  }
+  return APP_NVM_Finish();
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_NVM_H
+#define _APP_NVM_H
+
+#include <sys/kmem.h>
+
+#include "app_profile.h"
+#include "system_definitions.h"
+
+// Program flash erase and programming through the NVM controller.
+//
+// An operation can be started and polled, so the caller keeps running
+// between operations, or run to completion. Either way the CPU stalls on
+// instruction fetch while flash is busy. Operations are not queued: only
+// one can be in progress and it is to be finished before the next starts.
+
+// PIC32MX795F512L program flash, KSEG0 addresses.
+#define APP_NVM_FLASH_ADDRESS 0x9d000000
+#define APP_NVM_FLASH_SIZE (512 * 1024)
+#define APP_NVM_PAGE_SIZE 4096
+#define APP_NVM_ROW_SIZE 512
+
+// Flash contents read through KSEG1, bypassing the cache, so data just
+// programmed is seen.
+#define APP_NVM_READ_WORDS(address) \
+  ((const volatile uint32_t*)KVA0_TO_KVA1(address))
+#define APP_NVM_READ_BYTES(address) \
+  ((const volatile uint8_t*)KVA0_TO_KVA1(address))
+
+// Values of NVMCON.NVMOP.
+typedef enum {
+  APP_NVM_OP_NONE = 0x0,
+  APP_NVM_OP_WORD_PROGRAM = 0x1,
+  APP_NVM_OP_ROW_PROGRAM = 0x3,
+  APP_NVM_OP_PAGE_ERASE = 0x4,
+} AppNVMOp;
+
+#define APP_NVM_KEY1 0xaa996655
+#define APP_NVM_KEY2 0x556699aa
+// Low voltage detect needs 6 us to settle after WREN is set.
+#define APP_NVM_SETTLE_TICKS (7 * APP_PROFILE_CORE_TICKS_PER_US)
+
+// Start operation and return without waiting for it.
+//
+// Address is the KSEG0 address of the word, row or page. Data is the word
+// to program, or the row in RAM (row programming takes data from RAM only).
+void APP_NVM_Start(AppNVMOp op, uint32_t address, const void* data);
+
+bool APP_NVM_IsBusy(void);
+
+// Finish operation which is no longer busy. Returns false if it failed.
+bool APP_NVM_Finish(void);
+
+// Wait for the operation in progress, if any, start the given one and wait
+// for it to finish.
+bool APP_NVM_Run(AppNVMOp op, uint32_t address, const void* data);
+
+#endif  // _APP_NVM_H
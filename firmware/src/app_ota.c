@@ -0,0 +1,550 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_ota.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <xc.h>
+
+#include "app_checksum.h"
+#include "app_command.h"
+#include "app_log.h"
+#include "app_profile.h"
+#include "app_tcp_tuner.h"
+#include "app_trace.h"
+
+#ifdef __XC32
+#  include <sys/attribs.h>
+#  define APP_OTA_RAMFUNC __longramfunc__
+#else
+#  define APP_OTA_RAMFUNC
+#endif
+
+typedef enum {
+  APP_OTA_STATE_IDLE,
+  APP_OTA_STATE_LISTEN,
+  APP_OTA_STATE_HEADER,
+  APP_OTA_STATE_RECEIVE,
+  APP_OTA_STATE_VERIFY,
+  APP_OTA_STATE_CLOSE,
+  APP_OTA_STATE_INSTALL,
+} AppOTAState;
+
+typedef struct {
+  SYSTEM_OBJECTS* system_objects;
+  TCP_SOCKET socket;
+  AppOTAState state;
+  uint32_t arm_tick;
+  uint32_t arm_timeout;
+  // Tick of the last received data, or of the state change before install.
+  uint32_t tick;
+  AppOTAHeader header;
+  // Size of the whole image, boot flash part included.
+  uint32_t image_size;
+  uint32_t num_received;
+  uint32_t crc;
+  // Ring of received rows, rows are programmed straight from it.
+  uint8_t rows[APP_OTA_NUM_ROWS][APP_NVM_ROW_SIZE] __attribute__((aligned(4)));
+  int fill_row;
+  uint32_t fill_size;
+  int program_row;
+  int num_full_rows;
+  // Slot is programmed up to write_address and erased up to erase_address.
+  uint32_t write_address;
+  uint32_t erase_address;
+  AppNVMOp nvm_op;
+  uint32_t nvm_tick;
+  uint32_t start_tick;
+  uint32_t nvm_ticks;
+  AppOTAError error;
+  // Program flash size of the image in the slot which passed verification,
+  // 0 if none.
+  uint32_t staged_size;
+  AppOTAStats stats;
+} AppOTA;
+
+static AppOTA g_ota;
+
+static const char* g_ota_error_names[APP_OTA_NUM_ERRORS] = {
+  "none",
+  "header",
+  "timeout",
+  "disconnected",
+  "flash",
+  "crc",
+  "verify",
+  "config",
+};
+
+#ifdef __XC32
+// Reserves the staging slot, so the linker never places the running image
+// there.
+static const uint8_t g_ota_slot[APP_OTA_SLOT_SIZE]
+    __attribute__((address(APP_OTA_SLOT_ADDRESS), space(prog), keep)) = {
+  [0 ... APP_OTA_SLOT_SIZE - 1] = 0xff,
+};
+#endif
+
+static void app_ota_state_set(AppOTAState state) {
+  g_ota.state = state;
+  APP_TRACE_COUNTER(APP_TRACE_STATE_OTA, state);
+}
+
+static uint32_t app_ota_ms_since(uint32_t tick) {
+  const uint32_t delta = SYS_TMR_TickCountGet() - tick;
+  return (uint32_t)((uint64_t)delta * 1000 / SYS_TMR_TickCounterFrequencyGet());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Flash programming.
+
+static void app_ota_nvm_start(AppNVMOp op, uint32_t address, const void* row) {
+  g_ota.nvm_op = op;
+  g_ota.nvm_tick = _CP0_GET_COUNT();
+  APP_NVM_Start(op, address, row);
+}
+
+// Account finished operation. Returns false if it failed.
+static bool app_ota_nvm_finish(void) {
+  const bool is_ok = APP_NVM_Finish();
+  g_ota.nvm_ticks += _CP0_GET_COUNT() - g_ota.nvm_tick;
+  if (g_ota.nvm_op == APP_NVM_OP_ROW_PROGRAM) {
+    ++g_ota.stats.num_row_programs;
+    g_ota.program_row = (g_ota.program_row + 1) % APP_OTA_NUM_ROWS;
+    --g_ota.num_full_rows;
+    g_ota.write_address += APP_NVM_ROW_SIZE;
+  } else {
+    ++g_ota.stats.num_page_erases;
+    g_ota.erase_address += APP_NVM_PAGE_SIZE;
+  }
+  g_ota.nvm_op = APP_NVM_OP_NONE;
+  return is_ok;
+}
+
+// Keep flash busy: program the next complete row when its page is erased,
+// otherwise erase one page ahead of the row being programmed.
+static bool app_ota_nvm_tasks(void) {
+  const uint32_t end_address = APP_OTA_SLOT_ADDRESS + g_ota.image_size;
+  if (g_ota.nvm_op != APP_NVM_OP_NONE) {
+    if (APP_NVM_IsBusy()) {
+      return true;
+    }
+    if (!app_ota_nvm_finish()) {
+      return false;
+    }
+  }
+  if (g_ota.num_full_rows != 0 && g_ota.write_address < g_ota.erase_address) {
+    app_ota_nvm_start(APP_NVM_OP_ROW_PROGRAM,
+                      g_ota.write_address,
+                      g_ota.rows[g_ota.program_row]);
+  } else if (g_ota.erase_address < end_address &&
+             g_ota.erase_address - g_ota.write_address <= APP_NVM_PAGE_SIZE) {
+    app_ota_nvm_start(APP_NVM_OP_PAGE_ERASE, g_ota.erase_address, NULL);
+  }
+  return true;
+}
+
+static bool app_ota_nvm_is_idle(void) {
+  return g_ota.nvm_op == APP_NVM_OP_NONE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Installer, runs from RAM while the running image is being rewritten. It
+// touches nothing in flash but the slot: no calls, no constants, so it has
+// its own copy of the APP_NVM_Run() sequence.
+
+APP_OTA_RAMFUNC
+static bool app_ota_install_nvm(AppNVMOp op, uint32_t address, const void* row) {
+  const uint32_t tick = _CP0_GET_COUNT();
+  NVMADDR = KVA_TO_PA(address);
+  NVMSRCADDR = KVA_TO_PA(row);
+  NVMCON = _NVMCON_WREN_MASK | op;
+  while (_CP0_GET_COUNT() - tick < APP_NVM_SETTLE_TICKS) {
+  }
+  NVMKEY = APP_NVM_KEY1;
+  NVMKEY = APP_NVM_KEY2;
+  NVMCONSET = _NVMCON_WR_MASK;
+  while ((NVMCON & _NVMCON_WR_MASK) != 0) {
+  }
+  NVMCONCLR = _NVMCON_WREN_MASK;
+  return (NVMCON & (_NVMCON_WRERR_MASK | _NVMCON_LVDERR_MASK)) == 0;
+}
+
+// Copy page of the slot over the given page unless it holds the same data
+// already. Returns whether the page matches the slot.
+APP_OTA_RAMFUNC
+static bool app_ota_install_page(uint32_t address,
+                                 uint32_t slot_address,
+                                 uint32_t* row) {
+  const volatile uint32_t* source = APP_NVM_READ_WORDS(slot_address);
+  const volatile uint32_t* destination = APP_NVM_READ_WORDS(address);
+  uint32_t row_offset, i;
+  bool is_ok = true;
+  for (i = 0; i < APP_NVM_PAGE_SIZE / 4 && is_ok; ++i) {
+    is_ok = destination[i] == source[i];
+  }
+  if (is_ok) {
+    return true;
+  }
+  is_ok = app_ota_install_nvm(APP_NVM_OP_PAGE_ERASE, address, row);
+  // Row programming takes data from RAM only.
+  for (row_offset = 0;
+       row_offset < APP_NVM_PAGE_SIZE && is_ok;
+       row_offset += APP_NVM_ROW_SIZE) {
+    for (i = 0; i < APP_NVM_ROW_SIZE / 4; ++i) {
+      row[i] = source[row_offset / 4 + i];
+    }
+    is_ok = app_ota_install_nvm(APP_NVM_OP_ROW_PROGRAM,
+                                address + row_offset,
+                                row);
+  }
+  for (i = 0; i < APP_NVM_PAGE_SIZE / 4 && is_ok; ++i) {
+    is_ok = destination[i] == source[i];
+  }
+  return is_ok;
+}
+
+// Program flash part of the slot goes to the start of program flash, the
+// rest of it to boot flash.
+APP_OTA_RAMFUNC
+static void app_ota_install(uint32_t size, uint32_t* row) {
+  uint32_t offset;
+  __builtin_disable_interrupts();
+  for (offset = 0;
+       offset < size + APP_OTA_BOOT_SIZE;
+       offset += APP_NVM_PAGE_SIZE) {
+    const uint32_t address =
+        (offset < size) ? APP_NVM_FLASH_ADDRESS + offset
+                        : APP_OTA_BOOT_ADDRESS + (offset - size);
+    // There is nothing to fall back to once the image is partially
+    // replaced, a page which fails keeps being retried.
+    while (!app_ota_install_page(address,
+                                 APP_OTA_SLOT_ADDRESS + offset,
+                                 row)) {
+    }
+  }
+  SYSKEY = 0;
+  SYSKEY = APP_NVM_KEY1;
+  SYSKEY = APP_NVM_KEY2;
+  RSWRSTSET = _RSWRST_SWRST_MASK;
+  (void)RSWRST;
+  while (true) {
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Receiver.
+
+static bool app_ota_open(void) {
+  if (TCPIP_STACK_Status(g_ota.system_objects->tcpip) != SYS_STATUS_READY) {
+    return false;
+  }
+  g_ota.socket = TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE_IPV4, APP_OTA_PORT, NULL);
+  if (g_ota.socket == INVALID_SOCKET) {
+    APP_LOG("APP OTA: Failed to open socket\r\n");
+    return false;
+  }
+  APP_TCP_Tuner_Register(g_ota.socket);
+  return true;
+}
+
+static void app_ota_close(void) {
+  if (g_ota.socket != INVALID_SOCKET) {
+    APP_TCP_Tuner_Unregister(g_ota.socket);
+    TCPIP_TCP_Close(g_ota.socket);
+    g_ota.socket = INVALID_SOCKET;
+  }
+}
+
+static void app_ota_reply(const char* line, int length) {
+  if (TCPIP_TCP_PutIsReady(g_ota.socket) >= length) {
+    TCPIP_TCP_ArrayPut(g_ota.socket, (const uint8_t*)line, length);
+    TCPIP_TCP_Flush(g_ota.socket);
+  }
+}
+
+static void app_ota_fail(AppOTAError error) {
+  char line[48];
+  const int length = snprintf(line, sizeof(line), "OTA error=%s\r\n",
+                              g_ota_error_names[error]);
+  ++g_ota.stats.num_failed;
+  g_ota.stats.last_error = error;
+  APP_LOG("APP OTA: Update failed, error %d\r\n", error);
+  app_ota_reply(line, length);
+  app_ota_state_set(APP_OTA_STATE_CLOSE);
+}
+
+static void app_ota_send_ready(void) {
+  const volatile uint32_t* config = APP_NVM_READ_WORDS(APP_OTA_CONFIG_ADDRESS);
+  char line[64];
+  const int length = snprintf(line, sizeof(line),
+                              "OTA ready config=%08x,%08x,%08x,%08x\r\n",
+                              config[0], config[1], config[2], config[3]);
+  app_ota_reply(line, length);
+}
+
+static void app_ota_receive_header(void) {
+  AppOTAHeader* header = &g_ota.header;
+  const volatile uint32_t* config = APP_NVM_READ_WORDS(APP_OTA_CONFIG_ADDRESS);
+  int i;
+  if (TCPIP_TCP_GetIsReady(g_ota.socket) < sizeof(*header)) {
+    return;
+  }
+  TCPIP_TCP_ArrayGet(g_ota.socket, (uint8_t*)header, sizeof(*header));
+  if (header->magic != APP_OTA_MAGIC ||
+      header->size == 0 ||
+      header->size > APP_OTA_SLOT_SIZE - APP_OTA_BOOT_SIZE ||
+      header->size % APP_NVM_PAGE_SIZE != 0) {
+    app_ota_fail(APP_OTA_ERROR_HEADER);
+    return;
+  }
+  for (i = 0; i < APP_OTA_NUM_CONFIG_WORDS; ++i) {
+    if (header->config[i] != config[i]) {
+      app_ota_fail(APP_OTA_ERROR_CONFIG);
+      return;
+    }
+  }
+  // Slot is no longer holding a verified image from here on.
+  g_ota.staged_size = 0;
+  g_ota.image_size = header->size + APP_OTA_BOOT_SIZE;
+  g_ota.num_received = 0;
+  g_ota.crc = 0;
+  g_ota.fill_row = 0;
+  g_ota.fill_size = 0;
+  g_ota.program_row = 0;
+  g_ota.num_full_rows = 0;
+  g_ota.write_address = APP_OTA_SLOT_ADDRESS;
+  g_ota.erase_address = APP_OTA_SLOT_ADDRESS;
+  g_ota.nvm_ticks = 0;
+  g_ota.stats.num_page_erases = 0;
+  g_ota.stats.num_row_programs = 0;
+  g_ota.start_tick = _CP0_GET_COUNT();
+  g_ota.tick = SYS_TMR_TickCountGet();
+  app_ota_state_set(APP_OTA_STATE_RECEIVE);
+}
+
+// Move received data into free rows of the ring.
+static void app_ota_receive(void) {
+  uint32_t num_received = 0;
+  uint16_t num_ready;
+  while (g_ota.num_received < g_ota.image_size &&
+         g_ota.num_full_rows < APP_OTA_NUM_ROWS &&
+         (num_ready = TCPIP_TCP_GetIsReady(g_ota.socket)) != 0) {
+    uint8_t* data = g_ota.rows[g_ota.fill_row] + g_ota.fill_size;
+    uint32_t num_bytes = APP_NVM_ROW_SIZE - g_ota.fill_size;
+    if (num_bytes > num_ready) {
+      num_bytes = num_ready;
+    }
+    num_bytes = TCPIP_TCP_ArrayGet(g_ota.socket, data, num_bytes);
+    g_ota.crc = APP_Checksum_CRC32(g_ota.crc, data, num_bytes);
+    g_ota.fill_size += num_bytes;
+    g_ota.num_received += num_bytes;
+    num_received += num_bytes;
+    if (g_ota.fill_size == APP_NVM_ROW_SIZE) {
+      g_ota.fill_size = 0;
+      g_ota.fill_row = (g_ota.fill_row + 1) % APP_OTA_NUM_ROWS;
+      ++g_ota.num_full_rows;
+    }
+  }
+  if (num_received != 0) {
+    APP_TCP_Tuner_Account(g_ota.socket, 0, num_received);
+    g_ota.tick = SYS_TMR_TickCountGet();
+  }
+}
+
+static void app_ota_verify(void) {
+  AppOTAStats* stats = &g_ota.stats;
+  char line[96];
+  int length;
+  uint32_t crc = 0, offset;
+  if (g_ota.crc != g_ota.header.crc) {
+    app_ota_fail(APP_OTA_ERROR_CRC);
+    return;
+  }
+  for (offset = 0; offset < g_ota.image_size; offset += APP_NVM_ROW_SIZE) {
+    crc = APP_Checksum_CRC32(
+        crc,
+        (const uint8_t*)APP_NVM_READ_WORDS(APP_OTA_SLOT_ADDRESS + offset),
+        APP_NVM_ROW_SIZE);
+  }
+  if (crc != g_ota.header.crc) {
+    app_ota_fail(APP_OTA_ERROR_VERIFY);
+    return;
+  }
+  g_ota.staged_size = g_ota.header.size;
+  ++stats->num_updates;
+  stats->last_error = APP_OTA_ERROR_NONE;
+  stats->num_bytes = g_ota.image_size;
+  stats->total_us =
+      (_CP0_GET_COUNT() - g_ota.start_tick) / APP_PROFILE_CORE_TICKS_PER_US;
+  stats->nvm_us = g_ota.nvm_ticks / APP_PROFILE_CORE_TICKS_PER_US;
+  APP_LOG("APP OTA: Staged %u bytes in %u ms\r\n",
+          stats->num_bytes, stats->total_us / 1000);
+  length = snprintf(line, sizeof(line),
+                    "OTA staged bytes=%u us=%u nvm_us=%u crc=%08x\r\n",
+                    stats->num_bytes, stats->total_us, stats->nvm_us,
+                    g_ota.header.crc);
+  app_ota_reply(line, length);
+  if ((g_ota.header.flags & APP_OTA_FLAG_INSTALL) != 0) {
+    g_ota.tick = SYS_TMR_TickCountGet();
+    app_ota_state_set(APP_OTA_STATE_INSTALL);
+  } else {
+    app_ota_state_set(APP_OTA_STATE_CLOSE);
+  }
+}
+
+void APP_OTA_Initialize(SYSTEM_OBJECTS* system_objects) {
+  memset(&g_ota, 0, sizeof(g_ota));
+  g_ota.system_objects = system_objects;
+  g_ota.socket = INVALID_SOCKET;
+  app_ota_state_set(APP_OTA_STATE_IDLE);
+}
+
+void APP_OTA_Tasks(void) {
+  switch (g_ota.state) {
+    case APP_OTA_STATE_IDLE:
+      break;
+    case APP_OTA_STATE_LISTEN:
+      if (app_ota_ms_since(g_ota.arm_tick) > g_ota.arm_timeout * 1000) {
+        APP_LOG("APP OTA: Disarmed on timeout\r\n");
+        APP_OTA_Disarm();
+        break;
+      }
+      if (g_ota.socket == INVALID_SOCKET && !app_ota_open()) {
+        break;
+      }
+      if (TCPIP_TCP_IsConnected(g_ota.socket)) {
+        g_ota.tick = SYS_TMR_TickCountGet();
+        app_ota_send_ready();
+        app_ota_state_set(APP_OTA_STATE_HEADER);
+      }
+      break;
+    case APP_OTA_STATE_HEADER:
+    case APP_OTA_STATE_RECEIVE:
+      if (!TCPIP_TCP_IsConnected(g_ota.socket)) {
+        app_ota_fail(APP_OTA_ERROR_DISCONNECTED);
+        break;
+      }
+      if (app_ota_ms_since(g_ota.tick) > APP_OTA_RECEIVE_TIMEOUT) {
+        app_ota_fail(APP_OTA_ERROR_TIMEOUT);
+        break;
+      }
+      if (g_ota.state == APP_OTA_STATE_HEADER) {
+        app_ota_receive_header();
+        break;
+      }
+      // Flash first: finishing an operation frees a row to receive into.
+      if (!app_ota_nvm_tasks()) {
+        app_ota_fail(APP_OTA_ERROR_FLASH);
+        break;
+      }
+      app_ota_receive();
+      if (g_ota.num_received == g_ota.image_size &&
+          g_ota.num_full_rows == 0 &&
+          app_ota_nvm_is_idle()) {
+        app_ota_state_set(APP_OTA_STATE_VERIFY);
+      }
+      break;
+    case APP_OTA_STATE_VERIFY:
+      app_ota_verify();
+      break;
+    case APP_OTA_STATE_CLOSE:
+      // Flash operation could still be in progress after a failure.
+      if (!app_ota_nvm_is_idle()) {
+        if (APP_NVM_IsBusy()) {
+          break;
+        }
+        app_ota_nvm_finish();
+      }
+      APP_OTA_Disarm();
+      break;
+    case APP_OTA_STATE_INSTALL:
+      if (app_ota_ms_since(g_ota.tick) > APP_OTA_INSTALL_DELAY) {
+        APP_OTA_Install();
+      }
+      break;
+  }
+}
+
+void APP_OTA_Arm(uint32_t timeout) {
+  if (g_ota.state != APP_OTA_STATE_IDLE) {
+    return;
+  }
+  g_ota.arm_tick = SYS_TMR_TickCountGet();
+  g_ota.arm_timeout = timeout;
+  app_ota_state_set(APP_OTA_STATE_LISTEN);
+}
+
+void APP_OTA_Disarm(void) {
+  if (g_ota.state != APP_OTA_STATE_IDLE &&
+      g_ota.state != APP_OTA_STATE_LISTEN &&
+      g_ota.state != APP_OTA_STATE_CLOSE) {
+    // Update in progress, it is aborted and reported.
+    app_ota_fail(APP_OTA_ERROR_DISCONNECTED);
+    return;
+  }
+  app_ota_close();
+  app_ota_state_set(APP_OTA_STATE_IDLE);
+}
+
+bool APP_OTA_Install(void) {
+  if (g_ota.staged_size == 0 || !app_ota_nvm_is_idle()) {
+    return false;
+  }
+  SYS_CONSOLE_PRINT("APP OTA: Installing %u bytes\r\n", g_ota.staged_size);
+  app_ota_close();
+  app_ota_install(g_ota.staged_size, (uint32_t*)g_ota.rows[0]);
+  return true;
+}
+
+void APP_OTA_StatsGet(AppOTAStats* stats) {
+  *stats = g_ota.stats;
+}
+
+void APP_OTA_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  const AppOTAStats* stats = &g_ota.stats;
+  APP_CMD_PRINT(cmd_io, "OTA: port %d, %s, staged image %u bytes\r\n",
+                APP_OTA_PORT,
+                g_ota.state == APP_OTA_STATE_IDLE ? "disarmed" : "armed",
+                g_ota.staged_size);
+  APP_CMD_PRINT(cmd_io, "  updates %u, failed %u, last error %s\r\n",
+                stats->num_updates, stats->num_failed,
+                g_ota_error_names[stats->last_error]);
+  if (stats->num_updates != 0) {
+    APP_CMD_PRINT(cmd_io, "  last: %u bytes in %u ms (%u KB/s), flash busy "
+                  "%u ms (%u%%), %u page erases, %u row programs\r\n",
+                  stats->num_bytes,
+                  stats->total_us / 1000,
+                  stats->total_us
+                      ? (uint32_t)((uint64_t)stats->num_bytes * 1000000 /
+                                   1024 / stats->total_us)
+                      : 0,
+                  stats->nvm_us / 1000,
+                  stats->total_us
+                      ? (uint32_t)((uint64_t)stats->nvm_us * 100 /
+                                   stats->total_us)
+                      : 0,
+                  stats->num_page_erases,
+                  stats->num_row_programs);
+  }
+}
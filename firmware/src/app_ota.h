@@ -0,0 +1,151 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_OTA_H
+#define _APP_OTA_H
+
+#include "app_kv.h"
+#include "app_nvm.h"
+#include "system_definitions.h"
+
+// Firmware update over the network.
+//
+// Program flash is split in two halves: the running image in the lower one
+// and a staging slot in the upper one, which the linker keeps free. The
+// key-value store takes the very end of the upper half, so the slot, and
+// with it the largest image, is a bit smaller than half of flash. An update
+// is a TCP stream to APP_OTA_PORT of an AppOTAHeader followed by the image,
+// tools/ota_update.py sends it.
+//
+// Image is the program flash part of a build followed by the first two pages
+// of boot flash. The latter hold the startup code and exception vectors,
+// which refer to addresses of the build (_gp, _stack, data initialization
+// tables, interrupt handlers), so they are replaced together with program
+// flash. The last boot flash page holds the configuration words, which are
+// never rewritten: an image built with other configuration words is refused.
+// On connect the receiver sends "OTA ready config=..." with its words, so
+// the sender can refuse such an image before sending it.
+//
+// Image is programmed into the slot row by row while it is being received:
+// received rows are queued in a RAM ring, a row is programmed as soon as it
+// is complete and the page ahead of the programmed one is erased while rows
+// of the current page are still arriving. Flash is busy all the time data
+// keeps coming, so staging time is close to the raw erase and program time.
+// CPU stalls on instruction fetch while flash is busy, but the Ethernet DMA
+// keeps receiving and the TCP window (grown by the TCP tuner) keeps the peer
+// sending.
+//
+// CRC-32 is checked on the received stream and again on the slot read back
+// from flash. Any failure leaves the running image untouched. Only a staged
+// image which passed both checks is installed: a routine running from RAM
+// with interrupts disabled copies it over the running image page by page,
+// verifies every page against the slot, and resets the chip. Pages which
+// already hold the new contents are skipped. A page which doesn't match is
+// retried for as long as it takes: reset would boot a half-written image.
+// Power loss during the copy, which takes about as long as staging, is the
+// only window which leaves the board unbootable; closing it needs the
+// installer in a part of boot flash which is never rewritten.
+//
+// The receiver only listens while armed from the console, so nothing on the
+// network can replace firmware without physical access to the board.
+
+#define APP_OTA_PORT 5004
+
+#define APP_OTA_SLOT_ADDRESS (APP_NVM_FLASH_ADDRESS + APP_NVM_FLASH_SIZE / 2)
+#define APP_OTA_SLOT_SIZE (APP_KV_ADDRESS - APP_OTA_SLOT_ADDRESS)
+
+// Boot flash pages which are part of the image, KSEG0 address.
+#define APP_OTA_BOOT_ADDRESS 0x9fc00000
+#define APP_OTA_BOOT_SIZE (2 * APP_NVM_PAGE_SIZE)
+// DEVCFG3..DEVCFG0 at the end of the last boot flash page.
+#define APP_OTA_CONFIG_ADDRESS 0x9fc02ff0
+#define APP_OTA_NUM_CONFIG_WORDS 4
+
+// Received rows waiting to be programmed, a page worth of them.
+#define APP_OTA_NUM_ROWS (APP_NVM_PAGE_SIZE / APP_NVM_ROW_SIZE)
+#define APP_OTA_DEFAULT_ARM_TIMEOUT 60 /* seconds */
+// Peer is disconnected if no data comes for this long.
+#define APP_OTA_RECEIVE_TIMEOUT 5000 /* milliseconds */
+// Time given to the reply to leave before the installer takes the CPU.
+#define APP_OTA_INSTALL_DELAY 250 /* milliseconds */
+
+// "OTA2" in little-endian.
+#define APP_OTA_MAGIC 0x3241544f
+// Install the image and reset once it is staged.
+#define APP_OTA_FLAG_INSTALL (1 << 0)
+
+// All fields are little-endian.
+typedef struct {
+  uint32_t magic;
+  // Size of the program flash part of the image, multiple of
+  // APP_NVM_PAGE_SIZE and at most APP_OTA_SLOT_SIZE - APP_OTA_BOOT_SIZE.
+  // It starts at APP_NVM_FLASH_ADDRESS, and is followed by APP_OTA_BOOT_SIZE
+  // bytes of boot flash.
+  uint32_t size;
+  // CRC-32 (IEEE 802.3, same as zlib) of the whole image.
+  uint32_t crc;
+  uint32_t flags;
+  // Configuration words of the image, which are to match the running ones.
+  uint32_t config[APP_OTA_NUM_CONFIG_WORDS];
+} AppOTAHeader;
+
+typedef enum {
+  APP_OTA_ERROR_NONE,
+  APP_OTA_ERROR_HEADER,
+  APP_OTA_ERROR_TIMEOUT,
+  APP_OTA_ERROR_DISCONNECTED,
+  APP_OTA_ERROR_FLASH,
+  APP_OTA_ERROR_CRC,
+  APP_OTA_ERROR_VERIFY,
+  APP_OTA_ERROR_CONFIG,
+
+  APP_OTA_NUM_ERRORS,
+} AppOTAError;
+
+typedef struct {
+  uint32_t num_updates;
+  uint32_t num_failed;
+  AppOTAError last_error;
+  // Last update: image size, time from the header to the verified slot,
+  // and time flash was busy erasing and programming within it.
+  uint32_t num_bytes;
+  uint32_t total_us;
+  uint32_t nvm_us;
+  uint32_t num_page_erases;
+  uint32_t num_row_programs;
+} AppOTAStats;
+
+void APP_OTA_Initialize(SYSTEM_OBJECTS* system_objects);
+void APP_OTA_Tasks(void);
+
+// Accept one update within the given number of seconds.
+void APP_OTA_Arm(uint32_t timeout);
+void APP_OTA_Disarm(void);
+
+// Install the image staged by the last successful update. Doesn't return
+// unless there is no such image.
+bool APP_OTA_Install(void);
+
+void APP_OTA_StatsGet(AppOTAStats* stats);
+void APP_OTA_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_OTA_H
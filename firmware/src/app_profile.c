@@ -0,0 +1,208 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_profile.h"
+
+#include <string.h>
+
+#include "app_command.h"
+#include "app_stack.h"
+
+#define APP_BOOT_RECORD_MAGIC 0x426f6f54u  /* 'BooT' */
+
+typedef struct {
+  uint32_t magic;
+  // Bitmask of milestones which were reached.
+  uint32_t mask;
+  // Core timer value, counted from the reset vector.
+  uint32_t core_ticks[APP_BOOT_NUM_MILESTONES];
+  // System timer value, zero when system timer was not running yet.
+  uint32_t sys_ticks[APP_BOOT_NUM_MILESTONES];
+} AppBootRecord;
+
+// NOTE: Records are not touched by the C runtime startup, so the record of the
+// previous boot survives soft resets (watchdog, software reset, MCLR).
+static AppBootRecord g_boot_record __attribute__((persistent));
+static AppBootRecord g_prev_boot_record __attribute__((persistent));
+
+static AppLoopStats g_loop_stats;
+static uint32_t g_loop_last_tick;
+
+static const char* g_boot_milestone_names[APP_BOOT_NUM_MILESTONES] = {
+  "reset",
+  "clock ready",
+  "drivers ready",
+  "kv mounted",
+  "tcpip init",
+  "sys init done",
+  "phy reset",
+  "tcpip ready",
+  "wifi open",
+  "modules enable",
+  "tcpip transact",
+  "net0 address",
+  "net1 address",
+  "usb configured",
+};
+
+// Called by the C runtime startup code straight from the reset vector,
+// before any of the data sections are initialized.
+void _on_reset(void) {
+  int i;
+  _CP0_SET_COUNT(0);
+  if (g_boot_record.magic == APP_BOOT_RECORD_MAGIC) {
+    g_prev_boot_record = g_boot_record;
+  } else {
+    g_prev_boot_record.magic = 0;
+  }
+  g_boot_record.magic = APP_BOOT_RECORD_MAGIC;
+  g_boot_record.mask = (1u << APP_BOOT_RESET);
+  for (i = 0; i < APP_BOOT_NUM_MILESTONES; ++i) {
+    g_boot_record.core_ticks[i] = 0;
+    g_boot_record.sys_ticks[i] = 0;
+  }
+  APP_Stack_Paint();
+}
+
+void APP_Profile_BootMark(AppBootMilestone milestone) {
+  const uint32_t bit = (1u << milestone);
+  if (g_boot_record.mask & bit) {
+    return;
+  }
+  g_boot_record.core_ticks[milestone] = _CP0_GET_COUNT();
+  if (SYS_TMR_Status(sysObj.sysTmr) == SYS_STATUS_READY) {
+    g_boot_record.sys_ticks[milestone] = SYS_TMR_TickCountGet();
+  }
+  g_boot_record.mask |= bit;
+}
+
+// Core timer wraps around, so once both milestones have system timer value
+// it decides, core timer only orders milestones within the same system tick.
+static bool app_profile_boot_is_before(const AppBootRecord* record,
+                                       int a,
+                                       int b) {
+  if (record->sys_ticks[a] != 0 && record->sys_ticks[b] != 0 &&
+      record->sys_ticks[a] != record->sys_ticks[b]) {
+    return record->sys_ticks[a] < record->sys_ticks[b];
+  }
+  return record->core_ticks[a] < record->core_ticks[b];
+}
+
+static void app_profile_boot_record_print(SYS_CMD_DEVICE_NODE* cmd_io,
+                                          const AppBootRecord* record) {
+  const uint32_t sys_tick_freq = SYS_TMR_TickCounterFrequencyGet();
+  // Milestones are not necessarily reached in the order of the enum (the
+  // interfaces and USB come up in whichever order they manage to), so they
+  // are printed sorted by time and the delta is from the previous one.
+  int order[APP_BOOT_NUM_MILESTONES];
+  int num_milestones = 0;
+  uint32_t prev_us = 0;
+  int i, j;
+  for (i = 0; i < APP_BOOT_NUM_MILESTONES; ++i) {
+    if ((record->mask & (1u << i)) == 0) {
+      continue;
+    }
+    for (j = num_milestones;
+         j > 0 && app_profile_boot_is_before(record, i, order[j - 1]);
+         --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+    ++num_milestones;
+  }
+  APP_CMD_PRINT(cmd_io, "  %-16s %10s %10s %10s\r\n",
+                "milestone", "time, us", "delta, us", "tick, ms");
+  for (j = 0; j < num_milestones; ++j) {
+    i = order[j];
+    // NOTE: Core timer wraps around every ~107 seconds, for later milestones
+    // system timer column is to be used.
+    const uint32_t us =
+        record->core_ticks[i] / APP_PROFILE_CORE_TICKS_PER_US;
+    const uint32_t ms = (sys_tick_freq != 0)
+        ? (uint32_t)((uint64_t)record->sys_ticks[i] * 1000 / sys_tick_freq)
+        : 0;
+    APP_CMD_PRINT(cmd_io, "  %-16s %10u %10u %10u\r\n",
+                  g_boot_milestone_names[i], us,
+                  (us >= prev_us) ? us - prev_us : 0, ms);
+    prev_us = us;
+  }
+}
+
+void APP_Profile_BootPrint(SYS_CMD_DEVICE_NODE* cmd_io) {
+  APP_CMD_PRINT(cmd_io, "Boot timing:\r\n");
+  app_profile_boot_record_print(cmd_io, &g_boot_record);
+  if (g_prev_boot_record.magic == APP_BOOT_RECORD_MAGIC) {
+    APP_CMD_PRINT(cmd_io, "Previous boot timing:\r\n");
+    app_profile_boot_record_print(cmd_io, &g_prev_boot_record);
+  }
+}
+
+void APP_Profile_LoopTick(void) {
+  const uint32_t tick = _CP0_GET_COUNT();
+  const uint32_t delta = tick - g_loop_last_tick;
+  const uint32_t us = delta / APP_PROFILE_CORE_TICKS_PER_US;
+  int bucket = (us == 0) ? 0 : (32 - __builtin_clz(us));
+  g_loop_last_tick = tick;
+  if (bucket >= APP_PROFILE_LOOP_HISTOGRAM_SIZE) {
+    bucket = APP_PROFILE_LOOP_HISTOGRAM_SIZE - 1;
+  }
+  ++g_loop_stats.histogram[bucket];
+  ++g_loop_stats.num_loops;
+  g_loop_stats.total_ticks += delta;
+  if (delta > g_loop_stats.max_ticks) {
+    g_loop_stats.max_ticks = delta;
+  }
+}
+
+void APP_Profile_LoopStatsGet(AppLoopStats* stats) {
+  *stats = g_loop_stats;
+}
+
+void APP_Profile_LoopStatsReset(void) {
+  memset(&g_loop_stats, 0, sizeof(g_loop_stats));
+  // Don't account time spent before the reset.
+  g_loop_last_tick = _CP0_GET_COUNT();
+}
+
+uint32_t APP_Profile_LoopAverageTicks(const AppLoopStats* stats) {
+  if (stats->num_loops == 0) {
+    return 0;
+  }
+  return (uint32_t)(stats->total_ticks / stats->num_loops);
+}
+
+void APP_Profile_LoopPrint(SYS_CMD_DEVICE_NODE* cmd_io) {
+  AppLoopStats stats;
+  int i;
+  APP_Profile_LoopStatsGet(&stats);
+  APP_CMD_PRINT(cmd_io, "Loop: %u iterations, avg %u us, max %u us\r\n",
+                stats.num_loops,
+                APP_Profile_LoopAverageTicks(&stats) /
+                    APP_PROFILE_CORE_TICKS_PER_US,
+                stats.max_ticks / APP_PROFILE_CORE_TICKS_PER_US);
+  for (i = 0; i < APP_PROFILE_LOOP_HISTOGRAM_SIZE; ++i) {
+    if (stats.histogram[i] == 0) {
+      continue;
+    }
+    APP_CMD_PRINT(cmd_io, "  < %6u us: %u\r\n", 1u << i, stats.histogram[i]);
+  }
+}
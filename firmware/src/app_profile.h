@@ -0,0 +1,95 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_PROFILE_H
+#define _APP_PROFILE_H
+
+#include <xc.h>
+
+#include "system_definitions.h"
+
+// Core timer runs at half of the system clock.
+#define APP_PROFILE_CORE_TICKS_PER_US (SYS_CLK_FREQ / 2ul / 1000000ul)
+
+typedef enum {
+  // Reset vector, before C runtime initialization.
+  APP_BOOT_RESET,
+  // Oscillator is switched and system clock is stable.
+  APP_BOOT_CLOCK_READY,
+  // Peripheral drivers and system services are initialized.
+  APP_BOOT_DRIVERS_READY,
+  // Key-value store with the runtime configuration is mounted.
+  APP_BOOT_KV_MOUNTED,
+  // TCP/IP stack initialization is started.
+  APP_BOOT_TCPIP_INIT,
+  // SYS_Initialize() is finished.
+  APP_BOOT_SYS_INIT_DONE,
+  // Ethernet PHY reset is requested by the PHY driver.
+  APP_BOOT_PHY_RESET,
+  // TCP/IP stack reported it is ready.
+  APP_BOOT_TCPIP_READY,
+  // Wi-Fi driver is open.
+  APP_BOOT_WIFI_OPEN,
+  // TCP/IP modules are enabled on the first interface which is ready.
+  APP_BOOT_MODULES_ENABLE,
+  // Networking is in the transaction state.
+  APP_BOOT_TCPIP_TRANSACT,
+  // First non-zero IP address on interface 0 and 1.
+  APP_BOOT_NET0_ADDRESS,
+  APP_BOOT_NET1_ADDRESS,
+  // USB device is configured by the host.
+  APP_BOOT_USB_CONFIGURED,
+
+  APP_BOOT_NUM_MILESTONES,
+} AppBootMilestone;
+
+// Super-loop iteration duration histogram has power of two buckets in
+// microseconds: [0, 1), [1, 2), [2, 4) and so on, last bucket is open.
+#define APP_PROFILE_LOOP_HISTOGRAM_SIZE 16
+
+typedef struct {
+  uint32_t num_loops;
+  uint64_t total_ticks;
+  uint32_t max_ticks;
+  uint32_t histogram[APP_PROFILE_LOOP_HISTOGRAM_SIZE];
+} AppLoopStats;
+
+// Remember time of the given boot milestone.
+// Only the first occurrence of every milestone is stored.
+void APP_Profile_BootMark(AppBootMilestone milestone);
+
+// Print boot timing table.
+// When cmd_io is NULL the table goes to the system console.
+void APP_Profile_BootPrint(SYS_CMD_DEVICE_NODE* cmd_io);
+
+// Account one iteration of the super-loop, to be called once per iteration.
+void APP_Profile_LoopTick(void);
+
+void APP_Profile_LoopStatsGet(AppLoopStats* stats);
+void APP_Profile_LoopStatsReset(void);
+
+// Average super-loop iteration duration in core timer ticks.
+uint32_t APP_Profile_LoopAverageTicks(const AppLoopStats* stats);
+
+void APP_Profile_LoopPrint(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_PROFILE_H
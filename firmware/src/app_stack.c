@@ -0,0 +1,130 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_stack.h"
+
+#include "app_command.h"
+
+// "STCK" in little-endian.
+#define APP_STACK_PAINT 0x4b435453
+// Stack right below the stack pointer of the painting function which is
+// left alone, it is where the function itself and its callees live.
+#define APP_STACK_PAINT_MARGIN 128
+// Words painted with interrupts disabled, between chunks ISRs run on the
+// stack below the current stack pointer and leave it before painting goes
+// on.
+#define APP_STACK_PAINT_CHUNK 256
+
+// Set by the linker script.
+extern uint32_t _stack[];
+extern uint32_t _splim[];
+extern char _min_stack_size[];
+
+static uint32_t g_stack_isr_max_depths[APP_STACK_NUM_ISRS];
+static uint32_t g_stack_isr_num_samples[APP_STACK_NUM_ISRS];
+
+static const char* g_stack_isr_names[APP_STACK_NUM_ISRS] = {
+  "wifi",
+  "tmr2",
+  "uart1",
+  "dma0",
+  "usb",
+  "eth",
+  "eth_coalesce",
+  "irq_latency",
+};
+
+// NOTE: Runs before the C runtime is initialized, so it is not to touch any
+// global variables.
+void APP_Stack_Paint(void) {
+  volatile uint32_t* word = _splim;
+  volatile uint32_t* end = (volatile uint32_t*)
+      ((APP_Stack_Pointer() - APP_STACK_PAINT_MARGIN) & ~3u);
+  while (word < end) {
+    *word++ = APP_STACK_PAINT;
+  }
+}
+
+void APP_Stack_ISRSample(AppStackISR isr, uint32_t sp) {
+  const uint32_t depth = (uint32_t)_stack - sp;
+  // Same vector never nests with itself, so its entry is only written here.
+  if (depth > g_stack_isr_max_depths[isr]) {
+    g_stack_isr_max_depths[isr] = depth;
+  }
+  ++g_stack_isr_num_samples[isr];
+}
+
+void APP_Stack_Reset(void) {
+  volatile uint32_t* word = _splim;
+  volatile uint32_t* end = (volatile uint32_t*)
+      ((APP_Stack_Pointer() - APP_STACK_PAINT_MARGIN) & ~3u);
+  int isr;
+  while (word < end) {
+    const bool interrupt_state = SYS_INT_Disable();
+    int i;
+    for (i = 0; i < APP_STACK_PAINT_CHUNK && word < end; ++i) {
+      *word++ = APP_STACK_PAINT;
+    }
+    SYS_INT_Restore(interrupt_state);
+  }
+  for (isr = 0; isr < APP_STACK_NUM_ISRS; ++isr) {
+    g_stack_isr_max_depths[isr] = 0;
+    g_stack_isr_num_samples[isr] = 0;
+  }
+}
+
+void APP_Stack_StatsGet(AppStackStats* stats) {
+  const volatile uint32_t* word = _splim;
+  int isr;
+  while (word < _stack && *word == APP_STACK_PAINT) {
+    ++word;
+  }
+  stats->top = (uint32_t)_stack;
+  stats->limit = (uint32_t)_splim;
+  stats->used = (uint32_t)_stack - (uint32_t)word;
+  stats->loop_depth = (uint32_t)_stack - APP_Stack_Pointer();
+  for (isr = 0; isr < APP_STACK_NUM_ISRS; ++isr) {
+    stats->isr_max_depths[isr] = g_stack_isr_max_depths[isr];
+    stats->isr_num_samples[isr] = g_stack_isr_num_samples[isr];
+  }
+}
+
+void APP_Stack_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  AppStackStats stats;
+  int isr;
+  APP_Stack_StatsGet(&stats);
+  APP_CMD_PRINT(cmd_io, "Stack: 0x%08x-0x%08x, %u bytes (minimum %u)\r\n",
+                stats.limit, stats.top, stats.top - stats.limit,
+                (uint32_t)_min_stack_size);
+  APP_CMD_PRINT(cmd_io, "  high-water %u bytes, never used %u bytes, "
+                "command depth %u bytes\r\n",
+                stats.used, stats.top - stats.limit - stats.used,
+                stats.loop_depth);
+  APP_CMD_PRINT(cmd_io, "  %-14s %10s %10s\r\n",
+                "isr", "max depth", "samples");
+  for (isr = 0; isr < APP_STACK_NUM_ISRS; ++isr) {
+    APP_CMD_PRINT(cmd_io, "  %-14s %10u %10u\r\n",
+                  g_stack_isr_names[isr],
+                  stats.isr_max_depths[isr],
+                  stats.isr_num_samples[isr]);
+  }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_STACK_H
+#define _APP_STACK_H
+
+#include "system_definitions.h"
+
+// Stack usage measurement.
+//
+// Super-loop and all ISRs share a single stack: it grows down from _stack
+// to _splim, which are set by the linker. Nested ISRs push their context
+// onto whatever the super-loop and the ISRs they preempted have used.
+//
+// Free part of the stack is painted with a pattern right from the reset
+// vector, before the C runtime is initialized, and the high-water mark is
+// where the lowest overwritten word is. Every ISR samples stack pointer at
+// entry (after its prologue has saved the context), so the worst depth each
+// of them was entered at is known as well.
+//
+// "stack" command reports both, which tells how much of the stack has never
+// been touched and can go to heap and packet buffers instead.
+
+typedef enum {
+  APP_STACK_ISR_WIFI,
+  APP_STACK_ISR_TMR2,
+  APP_STACK_ISR_UART1,
+  APP_STACK_ISR_DMA0,
+  APP_STACK_ISR_USB,
+  APP_STACK_ISR_ETH,
+  APP_STACK_ISR_ETH_COALESCE,
+  APP_STACK_ISR_IRQ_LATENCY,
+
+  APP_STACK_NUM_ISRS,
+} AppStackISR;
+
+typedef struct {
+  uint32_t top;
+  uint32_t limit;
+  // Bytes of the stack which were ever used since the stack was painted.
+  uint32_t used;
+  // Depth of the super-loop when the statistics are taken.
+  uint32_t loop_depth;
+  // Deepest stack at entry of every ISR, including context it saved.
+  uint32_t isr_max_depths[APP_STACK_NUM_ISRS];
+  uint32_t isr_num_samples[APP_STACK_NUM_ISRS];
+} AppStackStats;
+
+static inline uint32_t APP_Stack_Pointer(void) {
+  uint32_t sp;
+  __asm__ volatile("move %0, $sp" : "=r"(sp));
+  return sp;
+}
+
+// Usage: first statement of an ISR.
+#define APP_STACK_ISR_SAMPLE(isr) APP_Stack_ISRSample((isr), APP_Stack_Pointer())
+
+// Is called from the reset vector, see _on_reset().
+void APP_Stack_Paint(void);
+
+void APP_Stack_ISRSample(AppStackISR isr, uint32_t sp);
+
+// Re-paint free part of the stack and forget ISR samples.
+void APP_Stack_Reset(void);
+
+void APP_Stack_StatsGet(AppStackStats* stats);
+void APP_Stack_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_STACK_H
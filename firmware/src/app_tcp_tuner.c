@@ -0,0 +1,274 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_tcp_tuner.h"
+
+#include "app_command.h"
+#include "app_log.h"
+
+typedef struct {
+  TCP_SOCKET socket;
+  uint16_t tx_size;
+  uint16_t rx_size;
+  // Bytes moved during the current period.
+  uint32_t num_tx_bytes;
+  uint32_t num_rx_bytes;
+  uint16_t num_idle_periods;
+} AppTCPTunerSocket;
+
+typedef struct {
+  bool is_enabled;
+  uint32_t period_tick;
+  // Memory given to sockets on top of their default sizes.
+  uint32_t budget_used;
+  uint32_t num_grows;
+  uint32_t num_shrinks;
+  uint32_t num_failures;
+  uint32_t num_register_failures;
+  AppTCPTunerSocket sockets[APP_TCP_TUNER_MAX_SOCKETS];
+} AppTCPTuner;
+
+static AppTCPTuner g_tuner;
+
+static AppTCPTunerSocket* app_tcp_tuner_socket_find(TCP_SOCKET socket) {
+  int i;
+  for (i = 0; i < APP_TCP_TUNER_MAX_SOCKETS; ++i) {
+    if (g_tuner.sockets[i].socket == socket) {
+      return &g_tuner.sockets[i];
+    }
+  }
+  return NULL;
+}
+
+static size_t app_tcp_tuner_heap_free(void) {
+  TCPIP_STACK_HEAP_HANDLE heap =
+      TCPIP_STACK_HeapHandleGet(TCPIP_STACK_HEAP_TYPE_INTERNAL_HEAP, 0);
+  if (heap == NULL) {
+    return 0;
+  }
+  return TCPIP_HEAP_FreeSize(heap);
+}
+
+static uint32_t app_tcp_tuner_extra_size(uint16_t tx_size, uint16_t rx_size) {
+  return (tx_size - APP_TCP_TUNER_MIN_SIZE) + (rx_size - APP_TCP_TUNER_MIN_SIZE);
+}
+
+// Resize socket FIFOs, data which is already in the FIFOs is preserved.
+static bool app_tcp_tuner_resize(AppTCPTunerSocket* tuner_socket,
+                                 uint16_t tx_size,
+                                 uint16_t rx_size) {
+  const uint32_t old_extra =
+      app_tcp_tuner_extra_size(tuner_socket->tx_size, tuner_socket->rx_size);
+  const uint32_t new_extra = app_tcp_tuner_extra_size(tx_size, rx_size);
+  if (new_extra > old_extra) {
+    const uint32_t growth = new_extra - old_extra;
+    if (g_tuner.budget_used + growth > APP_TCP_TUNER_BUDGET ||
+        app_tcp_tuner_heap_free() < growth + APP_TCP_TUNER_HEAP_RESERVE) {
+      return false;
+    }
+  }
+  if (!TCPIP_TCP_FifoSizeAdjust(tuner_socket->socket,
+                                rx_size, tx_size,
+                                TCP_ADJUST_PRESERVE_RX |
+                                TCP_ADJUST_PRESERVE_TX)) {
+    // Most likely there is more data in the FIFO than the new size, or the
+    // heap is fragmented. Will try again on the next period.
+    ++g_tuner.num_failures;
+    return false;
+  }
+  g_tuner.budget_used = g_tuner.budget_used - old_extra + new_extra;
+  tuner_socket->tx_size = tx_size;
+  tuner_socket->rx_size = rx_size;
+  return true;
+}
+
+static void app_tcp_tuner_shrink_all(void) {
+  int i;
+  for (i = 0; i < APP_TCP_TUNER_MAX_SOCKETS; ++i) {
+    AppTCPTunerSocket* tuner_socket = &g_tuner.sockets[i];
+    if (tuner_socket->socket == INVALID_SOCKET ||
+        (tuner_socket->tx_size == APP_TCP_TUNER_MIN_SIZE &&
+         tuner_socket->rx_size == APP_TCP_TUNER_MIN_SIZE)) {
+      continue;
+    }
+    if (app_tcp_tuner_resize(tuner_socket,
+                             APP_TCP_TUNER_MIN_SIZE,
+                             APP_TCP_TUNER_MIN_SIZE)) {
+      ++g_tuner.num_shrinks;
+    }
+  }
+}
+
+static uint16_t app_tcp_tuner_grow_size(uint16_t size) {
+  return (size * 2 > APP_TCP_TUNER_MAX_SIZE) ? APP_TCP_TUNER_MAX_SIZE
+                                             : size * 2;
+}
+
+static void app_tcp_tuner_socket_update(AppTCPTunerSocket* tuner_socket) {
+  const TCP_SOCKET socket = tuner_socket->socket;
+  uint16_t tx_size = tuner_socket->tx_size;
+  uint16_t rx_size = tuner_socket->rx_size;
+  if (tuner_socket->num_tx_bytes == 0 && tuner_socket->num_rx_bytes == 0) {
+    if (++tuner_socket->num_idle_periods >= APP_TCP_TUNER_IDLE_PERIODS &&
+        (tx_size > APP_TCP_TUNER_MIN_SIZE || rx_size > APP_TCP_TUNER_MIN_SIZE)) {
+      if (app_tcp_tuner_resize(tuner_socket,
+                               APP_TCP_TUNER_MIN_SIZE,
+                               APP_TCP_TUNER_MIN_SIZE)) {
+        ++g_tuner.num_shrinks;
+      }
+    }
+    return;
+  }
+  tuner_socket->num_idle_periods = 0;
+  // Socket is window limited if application pushes through it several
+  // FIFOs worth of data per period, and (for TX) keeps the FIFO full.
+  if (tuner_socket->num_tx_bytes >= 2u * tx_size &&
+      TCPIP_TCP_PutIsReady(socket) < tx_size / 4) {
+    tx_size = app_tcp_tuner_grow_size(tx_size);
+  }
+  if (tuner_socket->num_rx_bytes >= 2u * rx_size) {
+    rx_size = app_tcp_tuner_grow_size(rx_size);
+  }
+  if (tx_size != tuner_socket->tx_size || rx_size != tuner_socket->rx_size) {
+    if (app_tcp_tuner_resize(tuner_socket, tx_size, rx_size)) {
+      ++g_tuner.num_grows;
+    }
+  }
+  tuner_socket->num_tx_bytes = 0;
+  tuner_socket->num_rx_bytes = 0;
+}
+
+void APP_TCP_Tuner_Initialize(void) {
+  int i;
+  g_tuner.is_enabled = true;
+  g_tuner.period_tick = 0;
+  g_tuner.budget_used = 0;
+  g_tuner.num_grows = 0;
+  g_tuner.num_shrinks = 0;
+  g_tuner.num_failures = 0;
+  g_tuner.num_register_failures = 0;
+  for (i = 0; i < APP_TCP_TUNER_MAX_SOCKETS; ++i) {
+    g_tuner.sockets[i].socket = INVALID_SOCKET;
+  }
+}
+
+void APP_TCP_Tuner_Tasks(void) {
+  int i;
+  const uint32_t period_ticks =
+      SYS_TMR_TickCounterFrequencyGet() * APP_TCP_TUNER_PERIOD / 1000;
+  if (SYS_TMR_TickCountGet() - g_tuner.period_tick < period_ticks) {
+    return;
+  }
+  g_tuner.period_tick = SYS_TMR_TickCountGet();
+  if (!g_tuner.is_enabled) {
+    // Sockets which could not be shrunk right away (too much data in their
+    // FIFOs) are retried until they are all back to defaults.
+    app_tcp_tuner_shrink_all();
+    return;
+  }
+  for (i = 0; i < APP_TCP_TUNER_MAX_SOCKETS; ++i) {
+    if (g_tuner.sockets[i].socket != INVALID_SOCKET) {
+      app_tcp_tuner_socket_update(&g_tuner.sockets[i]);
+    }
+  }
+}
+
+void APP_TCP_Tuner_Enable(bool enable) {
+  g_tuner.is_enabled = enable;
+  if (!enable) {
+    app_tcp_tuner_shrink_all();
+  }
+}
+
+bool APP_TCP_Tuner_IsEnabled(void) {
+  return g_tuner.is_enabled;
+}
+
+bool APP_TCP_Tuner_Register(TCP_SOCKET socket) {
+  AppTCPTunerSocket* tuner_socket = app_tcp_tuner_socket_find(INVALID_SOCKET);
+  if (tuner_socket == NULL) {
+    ++g_tuner.num_register_failures;
+    APP_LOG("APP TCP tuner: No free slot for socket %d\r\n", socket);
+    return false;
+  }
+  tuner_socket->socket = socket;
+  tuner_socket->tx_size = APP_TCP_TUNER_MIN_SIZE;
+  tuner_socket->rx_size = APP_TCP_TUNER_MIN_SIZE;
+  tuner_socket->num_tx_bytes = 0;
+  tuner_socket->num_rx_bytes = 0;
+  tuner_socket->num_idle_periods = 0;
+  return true;
+}
+
+void APP_TCP_Tuner_Unregister(TCP_SOCKET socket) {
+  AppTCPTunerSocket* tuner_socket;
+  if (socket == INVALID_SOCKET) {
+    return;
+  }
+  tuner_socket = app_tcp_tuner_socket_find(socket);
+  if (tuner_socket == NULL) {
+    return;
+  }
+  if (app_tcp_tuner_extra_size(tuner_socket->tx_size,
+                               tuner_socket->rx_size) != 0 &&
+      app_tcp_tuner_resize(tuner_socket,
+                           APP_TCP_TUNER_MIN_SIZE,
+                           APP_TCP_TUNER_MIN_SIZE)) {
+    ++g_tuner.num_shrinks;
+  }
+  // Otherwise socket buffers are freed by the stack when socket is closed.
+  g_tuner.budget_used -=
+      app_tcp_tuner_extra_size(tuner_socket->tx_size, tuner_socket->rx_size);
+  tuner_socket->socket = INVALID_SOCKET;
+}
+
+void APP_TCP_Tuner_Account(TCP_SOCKET socket,
+                           uint32_t num_tx_bytes,
+                           uint32_t num_rx_bytes) {
+  AppTCPTunerSocket* tuner_socket = app_tcp_tuner_socket_find(socket);
+  if (tuner_socket == NULL) {
+    return;
+  }
+  tuner_socket->num_tx_bytes += num_tx_bytes;
+  tuner_socket->num_rx_bytes += num_rx_bytes;
+}
+
+void APP_TCP_Tuner_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  int i;
+  APP_CMD_PRINT(cmd_io, "TCP tuner: %s, budget %u/%u, heap free %u, "
+                "grows %u, shrinks %u, failures %u, "
+                "register failures %u\r\n",
+                g_tuner.is_enabled ? "enabled" : "disabled",
+                g_tuner.budget_used, APP_TCP_TUNER_BUDGET,
+                app_tcp_tuner_heap_free(),
+                g_tuner.num_grows, g_tuner.num_shrinks, g_tuner.num_failures,
+                g_tuner.num_register_failures);
+  for (i = 0; i < APP_TCP_TUNER_MAX_SOCKETS; ++i) {
+    const AppTCPTunerSocket* tuner_socket = &g_tuner.sockets[i];
+    if (tuner_socket->socket == INVALID_SOCKET) {
+      continue;
+    }
+    APP_CMD_PRINT(cmd_io, "  socket %d: tx %u, rx %u\r\n",
+                  tuner_socket->socket,
+                  tuner_socket->tx_size, tuner_socket->rx_size);
+  }
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_TCP_TUNER_H
+#define _APP_TCP_TUNER_H
+
+#include "tcpip/tcpip.h"
+
+#include "system_definitions.h"
+
+// Adaptive sizing of TCP socket FIFOs.
+//
+// Every socket starts with the stack's default 512 byte buffers, which caps
+// bulk transfer at about one segment in flight. Sockets registered with the
+// tuner grow their FIFOs while they are streaming and go back to defaults
+// once they are idle. Sum of all the growth is limited by a global budget and
+// by the amount of free TCP/IP heap.
+
+// Any socket of the stack can be registered: HTTP, HID bridge subscribers,
+// OTA and benchmark together take most of them.
+#define APP_TCP_TUNER_MAX_SOCKETS TCPIP_TCP_MAX_SOCKETS
+#define APP_TCP_TUNER_MIN_SIZE TCPIP_TCP_SOCKET_DEFAULT_TX_SIZE
+// Bandwidth-delay product of 100 Mbps Ethernet on a LAN (~0.3 ms RTT) and of
+// MRF24W Wi-Fi (~5 Mbps, ~5 ms RTT) both fit into this size.
+#define APP_TCP_TUNER_MAX_SIZE 4096
+// Maximum amount of memory given to all sockets on top of default sizes.
+#define APP_TCP_TUNER_BUDGET 8192
+// Growing buffers never leaves less than this amount of free heap.
+#define APP_TCP_TUNER_HEAP_RESERVE 8192
+#define APP_TCP_TUNER_PERIOD 100 /* milliseconds */
+// Number of idle periods after which buffers are shrunk.
+#define APP_TCP_TUNER_IDLE_PERIODS 20
+
+void APP_TCP_Tuner_Initialize(void);
+void APP_TCP_Tuner_Tasks(void);
+
+// Disabling shrinks all grown sockets back to the default sizes (as soon as
+// their FIFOs are drained enough to allow it).
+void APP_TCP_Tuner_Enable(bool enable);
+bool APP_TCP_Tuner_IsEnabled(void);
+
+// Start managing buffer sizes of the given socket.
+// Failure is logged, socket keeps working with default sizes then.
+bool APP_TCP_Tuner_Register(TCP_SOCKET socket);
+// Stop managing the socket, is to be called before socket is closed or
+// before a server socket goes back to listening for the next client. Grown
+// FIFOs are shrunk back to defaults, so a reused socket doesn't keep memory
+// outside of the budget.
+void APP_TCP_Tuner_Unregister(TCP_SOCKET socket);
+
+// Report amount of data application moved through the socket.
+void APP_TCP_Tuner_Account(TCP_SOCKET socket,
+                           uint32_t num_tx_bytes,
+                           uint32_t num_rx_bytes);
+
+void APP_TCP_Tuner_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_TCP_TUNER_H
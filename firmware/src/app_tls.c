@@ -0,0 +1,253 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_tls.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "app_command.h"
+#include "app_kv.h"
+#include "app_log.h"
+#include "app_profile.h"
+#include "app_trace.h"
+#include "framework/net/pres/net_pres_enc_glue.h"
+
+// Key-value store entry of the pre-shared key: identity, its terminating
+// zero and the key.
+#define APP_TLS_PSK_KV_KEY "tls.psk"
+
+typedef enum {
+  APP_TLS_STATE_LISTEN,
+  APP_TLS_STATE_NEGOTIATE,
+  APP_TLS_STATE_CLOSE,
+} AppTLSState;
+
+typedef struct {
+  SYSTEM_OBJECTS* system_objects;
+  NET_PRES_SKT_HANDLE_T socket;
+  AppTLSState state;
+  uint32_t start_tick;
+  // Resumed handshakes done by the glue before this one.
+  uint32_t num_resumed_before;
+  AppTLSStats stats;
+} AppTLS;
+
+static AppTLS g_tls;
+
+static void app_tls_state_set(AppTLSState state) {
+  g_tls.state = state;
+  APP_TRACE_COUNTER(APP_TRACE_STATE_TLS, state);
+}
+
+static bool app_tls_open(void) {
+  NET_PRES_SKT_ERROR_T error;
+  if (TCPIP_STACK_Status(g_tls.system_objects->tcpip) != SYS_STATUS_READY) {
+    return false;
+  }
+  g_tls.socket = NET_PRES_SocketOpen(0,
+                                     NET_PRES_SKT_ENCRYPTED_STREAM_SERVER,
+                                     NET_PRES_SKT_ADDR_IPV4,
+                                     APP_TLS_PORT,
+                                     NULL,
+                                     &error);
+  if (g_tls.socket == NET_PRES_INVALID_SOCKET) {
+    return false;
+  }
+  app_tls_state_set(APP_TLS_STATE_LISTEN);
+  return true;
+}
+
+static void app_tls_close(void) {
+  NET_PRES_SocketClose(g_tls.socket);
+  g_tls.socket = NET_PRES_INVALID_SOCKET;
+}
+
+static void app_tls_handshake_done(void) {
+  NET_PRES_EncGlueStats glue_stats;
+  AppTLSStats* stats = &g_tls.stats;
+  char line[48];
+  const uint32_t us =
+      (_CP0_GET_COUNT() - g_tls.start_tick) / APP_PROFILE_CORE_TICKS_PER_US;
+  bool is_resumed;
+  int length;
+  NET_PRES_EncGlue_StatsGet(&glue_stats);
+  is_resumed = glue_stats.numResumedHandshakes != g_tls.num_resumed_before;
+  if (is_resumed) {
+    ++stats->num_resumed;
+    stats->resumed_total_us += us;
+    if (us > stats->resumed_max_us) {
+      stats->resumed_max_us = us;
+    }
+  } else {
+    ++stats->num_full;
+    stats->full_total_us += us;
+    if (us > stats->full_max_us) {
+      stats->full_max_us = us;
+    }
+  }
+  length = snprintf(line, sizeof(line), "TLS handshake_us=%u resumed=%d\r\n",
+                    us, is_resumed);
+  if (NET_PRES_SocketWriteIsReady(g_tls.socket, length, 0) >= length) {
+    NET_PRES_SocketWrite(g_tls.socket, line, length);
+    NET_PRES_SocketFlush(g_tls.socket);
+  }
+}
+
+static void app_tls_psk_restore(void) {
+  char psk[NET_PRES_ENC_GLUE_PSK_IDENTITY_MAX + 1 +
+           NET_PRES_ENC_GLUE_PSK_KEY_MAX];
+  const int size = APP_KV_Get(APP_TLS_PSK_KV_KEY, psk, sizeof(psk));
+  size_t identity_length;
+  if (size <= 0 || size > (int)sizeof(psk)) {
+    return;
+  }
+  identity_length = strnlen(psk, size);
+  if (identity_length == (size_t)size ||
+      !NET_PRES_EncGlue_PSKSet(psk,
+                               (const uint8_t*)psk + identity_length + 1,
+                               size - identity_length - 1)) {
+    APP_LOG("APP TLS: Stored key is invalid\r\n");
+  }
+}
+
+void APP_TLS_Initialize(SYSTEM_OBJECTS* system_objects) {
+  memset(&g_tls, 0, sizeof(g_tls));
+  g_tls.system_objects = system_objects;
+  g_tls.socket = NET_PRES_INVALID_SOCKET;
+  // Store is mounted during system initialization, before the applications.
+  app_tls_psk_restore();
+}
+
+void APP_TLS_Tasks(void) {
+  if (g_tls.socket == NET_PRES_INVALID_SOCKET && !app_tls_open()) {
+    return;
+  }
+  switch (g_tls.state) {
+    case APP_TLS_STATE_LISTEN:
+      if (NET_PRES_SocketIsConnected(g_tls.socket)) {
+        NET_PRES_EncGlueStats glue_stats;
+        NET_PRES_EncGlue_StatsGet(&glue_stats);
+        g_tls.num_resumed_before = glue_stats.numResumedHandshakes;
+        g_tls.start_tick = _CP0_GET_COUNT();
+        app_tls_state_set(APP_TLS_STATE_NEGOTIATE);
+      }
+      break;
+    case APP_TLS_STATE_NEGOTIATE:
+      if (!NET_PRES_SocketIsConnected(g_tls.socket)) {
+        ++g_tls.stats.num_failed;
+        APP_LOG("APP TLS: Connection closed during handshake\r\n");
+        app_tls_close();
+        break;
+      }
+      if (NET_PRES_SocketIsNegotiatingEncryption(g_tls.socket)) {
+        break;
+      }
+      if (NET_PRES_SocketIsSecure(g_tls.socket)) {
+        app_tls_handshake_done();
+      } else {
+        ++g_tls.stats.num_failed;
+        APP_LOG("APP TLS: Handshake failed\r\n");
+      }
+      app_tls_state_set(APP_TLS_STATE_CLOSE);
+      break;
+    case APP_TLS_STATE_CLOSE:
+      // Reply is in the socket, a fresh socket takes the next connection.
+      app_tls_close();
+      break;
+  }
+}
+
+static int app_tls_hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+static bool app_tls_psk_save(const char* identity,
+                             const uint8_t* key,
+                             size_t key_size) {
+  char psk[NET_PRES_ENC_GLUE_PSK_IDENTITY_MAX + 1 +
+           NET_PRES_ENC_GLUE_PSK_KEY_MAX];
+  const size_t identity_size = strlen(identity) + 1;
+  memcpy(psk, identity, identity_size);
+  memcpy(psk + identity_size, key, key_size);
+  return APP_KV_Set(APP_TLS_PSK_KV_KEY, psk, identity_size + key_size);
+}
+
+bool APP_TLS_PSKSet(const char* identity, const char* key_hex) {
+  uint8_t key[NET_PRES_ENC_GLUE_PSK_KEY_MAX];
+  const size_t length = strlen(key_hex);
+  size_t i;
+  if (length % 2 != 0 || length / 2 > sizeof(key)) {
+    return false;
+  }
+  for (i = 0; i < length / 2; ++i) {
+    const int high = app_tls_hex_digit(key_hex[i * 2]);
+    const int low = app_tls_hex_digit(key_hex[i * 2 + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    key[i] = (high << 4) | low;
+  }
+  if (!NET_PRES_EncGlue_PSKSet(identity, key, length / 2)) {
+    return false;
+  }
+  return app_tls_psk_save(identity, key, length / 2);
+}
+
+void APP_TLS_StatsGet(AppTLSStats* stats) {
+  *stats = g_tls.stats;
+}
+
+void APP_TLS_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  const AppTLSStats* stats = &g_tls.stats;
+  NET_PRES_EncGlueStats glue_stats;
+  NET_PRES_EncGlue_StatsGet(&glue_stats);
+  APP_CMD_PRINT(cmd_io, "TLS: port %d, key %s\r\n",
+                APP_TLS_PORT,
+                NET_PRES_EncGlue_PSKIsSet() ? "set" : "not set");
+  APP_CMD_PRINT(cmd_io, "  full %u (avg %u us, max %u us), "
+                "resumed %u (avg %u us, max %u us), failed %u\r\n",
+                stats->num_full,
+                stats->num_full
+                    ? (uint32_t)(stats->full_total_us / stats->num_full) : 0,
+                stats->full_max_us,
+                stats->num_resumed,
+                stats->num_resumed
+                    ? (uint32_t)(stats->resumed_total_us / stats->num_resumed)
+                    : 0,
+                stats->resumed_max_us,
+                stats->num_failed);
+  APP_CMD_PRINT(cmd_io, "  provider: full %u, resumed %u, failed %u, "
+                "tickets issued %u, tickets rejected %u\r\n",
+                glue_stats.numFullHandshakes, glue_stats.numResumedHandshakes,
+                glue_stats.numFailedHandshakes, glue_stats.numTicketsIssued,
+                glue_stats.numTicketsRejected);
+}
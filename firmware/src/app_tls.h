@@ -0,0 +1,66 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_TLS_H
+#define _APP_TLS_H
+
+#include "system_definitions.h"
+
+// TLS handshake endpoint.
+//
+// Accepts TLS connections through the presentation layer on APP_TLS_PORT,
+// waits for the handshake to complete, replies with a single line of
+// "TLS handshake_us=<time> resumed=<0|1>" and closes the connection. It
+// is what tools/bench_tls.py measures full and resumed handshakes against.
+//
+// Connections are served one at a time, so a single TLS session worth of
+// heap is used.
+//
+// Cipher suites are pre-shared key ones (see net_pres_enc_glue.h), the key
+// is set with APP_TLS_PSKSet() before any handshake can succeed. The key is
+// kept in the key-value store and is restored on boot.
+
+#define APP_TLS_PORT 4433
+
+typedef struct {
+  uint32_t num_full;
+  uint32_t num_resumed;
+  uint32_t num_failed;
+  // Handshake time measured from the TCP connection, sums and maximums
+  // of full and resumed handshakes.
+  uint64_t full_total_us;
+  uint64_t resumed_total_us;
+  uint32_t full_max_us;
+  uint32_t resumed_max_us;
+} AppTLSStats;
+
+void APP_TLS_Initialize(SYSTEM_OBJECTS* system_objects);
+void APP_TLS_Tasks(void);
+
+// Key is given as a hex string. It is saved to the key-value store, false is
+// returned when it is invalid or could not be saved.
+bool APP_TLS_PSKSet(const char* identity, const char* key_hex);
+
+void APP_TLS_StatsGet(AppTLSStats* stats);
+void APP_TLS_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_TLS_H
@@ -0,0 +1,279 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_trace.h"
+
+#include <stdio.h>
+
+#include <xc.h>
+
+#include "app_command.h"
+#include "app_profile.h"
+
+// Console is paced, so the UART write queue keeps up with the dump.
+#define APP_TRACE_CONSOLE_LINE_MS 2
+#define APP_TRACE_RECORDS_PER_LINE 8
+#define APP_TRACE_MAX_LINE_SIZE 160
+#define APP_TRACE_DATAGRAM_SIZE 1024
+
+typedef struct {
+  uint32_t timestamp;
+  uint16_t arg;
+  uint8_t event;
+  uint8_t phase;
+} AppTraceRecord;
+
+typedef enum {
+  APP_TRACE_DUMP_BEGIN,
+  APP_TRACE_DUMP_EVENTS,
+  APP_TRACE_DUMP_DATA,
+  APP_TRACE_DUMP_END,
+  APP_TRACE_DUMP_DONE,
+} AppTraceDumpStage;
+
+typedef struct {
+  // Recording as requested, it is paused during dump regardless.
+  bool is_enabled;
+  bool is_dumping;
+  AppTraceDumpStage stage;
+  // Ring indices of the records to dump, and the next one.
+  uint32_t first;
+  uint32_t last;
+  uint32_t next;
+  int next_event;
+  // Console when invalid.
+  UDP_SOCKET socket;
+  uint32_t line_tick;
+} AppTrace;
+
+static AppTraceRecord g_trace_ring[APP_TRACE_RING_SIZE];
+// Free running, masked when accessing the ring.
+static volatile uint32_t g_trace_head;
+// Recording starts at reset, so boot is traced too.
+static volatile bool g_trace_is_recording = true;
+static AppTrace g_trace;
+
+static const char* g_trace_event_names[APP_TRACE_NUM_EVENTS] = {
+  "isr.wifi",
+  "isr.tmr2",
+  "isr.uart1",
+  "isr.dma0",
+  "isr.usb",
+  "isr.eth",
+  "isr.eth_coalesce",
+  "task.sys",
+  "task.tcpip",
+  "task.usb_device",
+  "task.app",
+  "task.network",
+  "task.ethmac",
+  "task.usb_hid",
+  "task.hid_bridge",
+  "task.bench",
+  "task.http",
+  "task.tls",
+  "task.ota",
+  "task.tcp_tuner",
+  "task.log",
+  "hid.out_received",
+  "hid.out_pushed",
+  "hid.in_submitted",
+  "hid.in_sent",
+  "state.bench",
+  "state.tls",
+  "state.ota",
+  "irq.latency",
+};
+
+void APP_Trace_Record(AppTraceEvent event, AppTracePhase phase, uint16_t arg) {
+  AppTraceRecord* record;
+  if (!g_trace_is_recording) {
+    return;
+  }
+  record = &g_trace_ring[__sync_fetch_and_add(&g_trace_head, 1) &
+                         (APP_TRACE_RING_SIZE - 1)];
+  record->timestamp = _CP0_GET_COUNT();
+  record->arg = arg;
+  record->event = event;
+  record->phase = phase;
+}
+
+void APP_Trace_Initialize(void) {
+  g_trace.is_enabled = g_trace_is_recording;
+  g_trace.is_dumping = false;
+  g_trace.socket = INVALID_SOCKET;
+}
+
+// Next line of the dump, 0 when there is nothing more.
+static int app_trace_dump_line(char* line) {
+  int length = 0;
+  switch (g_trace.stage) {
+    case APP_TRACE_DUMP_BEGIN:
+      g_trace.stage = APP_TRACE_DUMP_EVENTS;
+      return sprintf(line, "TRACE BEGIN records=%u lost=%u ticks_per_us=%u\r\n",
+                     g_trace.last - g_trace.first, g_trace.first,
+                     (uint32_t)APP_PROFILE_CORE_TICKS_PER_US);
+    case APP_TRACE_DUMP_EVENTS:
+      length = sprintf(line, "TRACE EVENT %d %s\r\n",
+                       g_trace.next_event,
+                       g_trace_event_names[g_trace.next_event]);
+      if (++g_trace.next_event == APP_TRACE_NUM_EVENTS) {
+        g_trace.stage = APP_TRACE_DUMP_DATA;
+      }
+      return length;
+    case APP_TRACE_DUMP_DATA:
+      if (g_trace.next != g_trace.last) {
+        int i;
+        length = sprintf(line, "TRACE DATA");
+        for (i = 0; i < APP_TRACE_RECORDS_PER_LINE &&
+                    g_trace.next != g_trace.last; ++i) {
+          const AppTraceRecord* record =
+              &g_trace_ring[g_trace.next++ & (APP_TRACE_RING_SIZE - 1)];
+          length += sprintf(line + length, " %08x%04x%02x%02x",
+                            record->timestamp, record->arg,
+                            record->event, record->phase);
+        }
+        return length + sprintf(line + length, "\r\n");
+      }
+      g_trace.stage = APP_TRACE_DUMP_END;
+      // Fall through.
+    case APP_TRACE_DUMP_END:
+      g_trace.stage = APP_TRACE_DUMP_DONE;
+      return sprintf(line, "TRACE END\r\n");
+    case APP_TRACE_DUMP_DONE:
+      break;
+  }
+  return 0;
+}
+
+static void app_trace_dump_finish(void) {
+  if (g_trace.socket != INVALID_SOCKET) {
+    TCPIP_UDP_Close(g_trace.socket);
+    g_trace.socket = INVALID_SOCKET;
+  }
+  g_trace.is_dumping = false;
+  g_trace_is_recording = g_trace.is_enabled;
+}
+
+static void app_trace_dump_console(void) {
+  char line[APP_TRACE_MAX_LINE_SIZE];
+  const uint32_t tick = SYS_TMR_TickCountGet();
+  if (tick - g_trace.line_tick < APP_TRACE_CONSOLE_LINE_MS *
+                                 SYS_TMR_TickCounterFrequencyGet() / 1000) {
+    return;
+  }
+  g_trace.line_tick = tick;
+  if (app_trace_dump_line(line) == 0) {
+    app_trace_dump_finish();
+    return;
+  }
+  SYS_CONSOLE_MESSAGE(line);
+}
+
+// Datagrams carry whole lines.
+static void app_trace_dump_udp(void) {
+  char line[APP_TRACE_MAX_LINE_SIZE];
+  int length;
+  if (TCPIP_UDP_TxPutIsReady(g_trace.socket, APP_TRACE_DATAGRAM_SIZE) <
+      APP_TRACE_DATAGRAM_SIZE) {
+    return;
+  }
+  if (g_trace.stage == APP_TRACE_DUMP_DONE) {
+    app_trace_dump_finish();
+    return;
+  }
+  while (TCPIP_UDP_PutIsReady(g_trace.socket) >= APP_TRACE_MAX_LINE_SIZE &&
+         (length = app_trace_dump_line(line)) != 0) {
+    TCPIP_UDP_ArrayPut(g_trace.socket, (const uint8_t*)line, length);
+  }
+  TCPIP_UDP_Flush(g_trace.socket);
+}
+
+void APP_Trace_Tasks(void) {
+  if (!g_trace.is_dumping) {
+    return;
+  }
+  if (g_trace.socket == INVALID_SOCKET) {
+    app_trace_dump_console();
+  } else {
+    app_trace_dump_udp();
+  }
+}
+
+void APP_Trace_Enable(bool enable) {
+  g_trace.is_enabled = enable;
+  if (!g_trace.is_dumping) {
+    g_trace_is_recording = enable;
+  }
+}
+
+void APP_Trace_Clear(void) {
+  if (!g_trace.is_dumping) {
+    g_trace_head = 0;
+  }
+}
+
+bool APP_Trace_DumpStart(const IPV4_ADDR* address, uint16_t port) {
+  if (g_trace.is_dumping) {
+    return false;
+  }
+  if (address != NULL) {
+    IP_MULTI_ADDRESS peer_address;
+    peer_address.v4Add = *address;
+    g_trace.socket =
+        TCPIP_UDP_ClientOpen(IP_ADDRESS_TYPE_IPV4, port, &peer_address);
+    if (g_trace.socket == INVALID_SOCKET) {
+      return false;
+    }
+    TCPIP_UDP_OptionsSet(g_trace.socket,
+                         UDP_OPTION_TX_BUFF,
+                         (void*)(uintptr_t)APP_TRACE_DATAGRAM_SIZE);
+  }
+  // Record which was started right before this point may still be written,
+  // which is harmless for a flight recorder.
+  g_trace_is_recording = false;
+  g_trace.is_dumping = true;
+  g_trace.stage = APP_TRACE_DUMP_BEGIN;
+  g_trace.last = g_trace_head;
+  g_trace.first = (g_trace.last > APP_TRACE_RING_SIZE)
+                      ? g_trace.last - APP_TRACE_RING_SIZE
+                      : 0;
+  g_trace.next = g_trace.first;
+  g_trace.next_event = 0;
+  g_trace.line_tick = SYS_TMR_TickCountGet();
+  return true;
+}
+
+void APP_Trace_StatsGet(AppTraceStats* stats) {
+  stats->num_records = g_trace_head;
+  stats->is_enabled = g_trace.is_enabled;
+  stats->is_dumping = g_trace.is_dumping;
+}
+
+void APP_Trace_Print(SYS_CMD_DEVICE_NODE* cmd_io) {
+  AppTraceStats stats;
+  APP_Trace_StatsGet(&stats);
+  APP_CMD_PRINT(cmd_io, "Trace: %s%s, %u records written, ring of %u\r\n",
+                stats.is_enabled ? "on" : "off",
+                stats.is_dumping ? " (dumping)" : "",
+                stats.num_records, APP_TRACE_RING_SIZE);
+}
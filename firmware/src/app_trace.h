@@ -0,0 +1,164 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_TRACE_H
+#define _APP_TRACE_H
+
+#include "tcpip/tcpip.h"
+
+#include "system_definitions.h"
+
+// Binary event tracer.
+//
+// Every event is a record of core timer timestamp, event, phase and a 16 bit
+// argument, written into a RAM ring. A slot of the ring is claimed with an
+// atomic increment (LL/SC), so records are written without disabling
+// interrupts, from the super-loop and from interrupts of any priority alike,
+// and an interrupt which preempts a record in progress simply takes the next
+// slot. The ring is a flight recorder: it keeps the last APP_TRACE_RING_SIZE
+// records and overwrites older ones.
+//
+// ISRs, super-loop tasks, HID report traffic and state transitions of
+// application modules are traced, so the ordering of what ran on the CPU
+// around a latency spike is visible.
+//
+// Dumping stops recording, so the ring stays consistent while it is being
+// read, and streams it as text lines either to the console or in UDP
+// datagrams. tools/trace_convert.py turns a dump into Chrome trace JSON,
+// which chrome://tracing and ui.perfetto.dev open. A dump is:
+//
+//   TRACE BEGIN records=<n> lost=<n> ticks_per_us=<n>
+//   TRACE EVENT <event> <name>
+//   TRACE DATA <record>...
+//   TRACE END
+//
+// where a record is 16 hex digits: 32 bit timestamp, 16 bit argument, event
+// and phase.
+//
+// Define APP_TRACE_ENABLED to 0 to compile the tracing out.
+
+#ifndef APP_TRACE_ENABLED
+#  define APP_TRACE_ENABLED 1
+#endif
+
+// Number of records in the ring, must be power of two.
+#define APP_TRACE_RING_SIZE 512
+#define APP_TRACE_DEFAULT_PORT 5005
+
+typedef enum {
+  // Interrupt service routines.
+  APP_TRACE_ISR_WIFI,
+  APP_TRACE_ISR_TMR2,
+  APP_TRACE_ISR_UART1,
+  APP_TRACE_ISR_DMA0,
+  APP_TRACE_ISR_USB,
+  APP_TRACE_ISR_ETH,
+  APP_TRACE_ISR_ETH_COALESCE,
+
+  // Super-loop.
+  APP_TRACE_TASK_SYS,
+  APP_TRACE_TASK_TCPIP,
+  APP_TRACE_TASK_USB_DEVICE,
+  APP_TRACE_TASK_APP,
+  APP_TRACE_TASK_NETWORK,
+  APP_TRACE_TASK_ETHMAC,
+  APP_TRACE_TASK_USB_HID,
+  APP_TRACE_TASK_HID_BRIDGE,
+  APP_TRACE_TASK_BENCH,
+  APP_TRACE_TASK_HTTP,
+  APP_TRACE_TASK_TLS,
+  APP_TRACE_TASK_OTA,
+  APP_TRACE_TASK_TCP_TUNER,
+  APP_TRACE_TASK_LOG,
+
+  // HID report traffic, argument is the report length or lane.
+  APP_TRACE_HID_OUT_RECEIVED,
+  APP_TRACE_HID_OUT_PUSHED,
+  APP_TRACE_HID_IN_SUBMITTED,
+  APP_TRACE_HID_IN_SENT,
+
+  // Module states, argument is the new state.
+  APP_TRACE_STATE_BENCH,
+  APP_TRACE_STATE_TLS,
+  APP_TRACE_STATE_OTA,
+
+  // Interrupt latency probe sample above the threshold, argument is the
+  // latency in CPU cycles.
+  APP_TRACE_IRQ_LATENCY,
+
+  APP_TRACE_NUM_EVENTS,
+} AppTraceEvent;
+
+typedef enum {
+  APP_TRACE_PHASE_INSTANT,
+  APP_TRACE_PHASE_BEGIN,
+  APP_TRACE_PHASE_END,
+  // Argument is a value to be plotted.
+  APP_TRACE_PHASE_COUNTER,
+} AppTracePhase;
+
+#if APP_TRACE_ENABLED
+#  define APP_TRACE(event, phase, arg) \
+    APP_Trace_Record((event), (phase), (uint16_t)(arg))
+#else
+#  define APP_TRACE(event, phase, arg) ((void)0)
+#endif
+
+#define APP_TRACE_BEGIN(event) APP_TRACE(event, APP_TRACE_PHASE_BEGIN, 0)
+#define APP_TRACE_END(event) APP_TRACE(event, APP_TRACE_PHASE_END, 0)
+#define APP_TRACE_INSTANT(event, arg) \
+  APP_TRACE(event, APP_TRACE_PHASE_INSTANT, arg)
+#define APP_TRACE_COUNTER(event, value) \
+  APP_TRACE(event, APP_TRACE_PHASE_COUNTER, value)
+
+// Usage: APP_TRACE_CALL(APP_TRACE_TASK_LOG, APP_Log_Tasks());
+#define APP_TRACE_CALL(event, call) \
+  do {                              \
+    APP_TRACE_BEGIN(event);         \
+    call;                           \
+    APP_TRACE_END(event);           \
+  } while (0)
+
+typedef struct {
+  // Records written since the ring was cleared.
+  uint32_t num_records;
+  bool is_enabled;
+  bool is_dumping;
+} AppTraceStats;
+
+// Is safe to be called from any context.
+void APP_Trace_Record(AppTraceEvent event, AppTracePhase phase, uint16_t arg);
+
+void APP_Trace_Initialize(void);
+void APP_Trace_Tasks(void);
+
+void APP_Trace_Enable(bool enable);
+void APP_Trace_Clear(void);
+
+// Start dump of the ring to the console, or to the UDP peer when address is
+// given. Recording is resumed once the dump is finished, if it was enabled.
+bool APP_Trace_DumpStart(const IPV4_ADDR* address, uint16_t port);
+
+void APP_Trace_StatsGet(AppTraceStats* stats);
+void APP_Trace_Print(SYS_CMD_DEVICE_NODE* cmd_io);
+
+#endif  // _APP_TRACE_H
@@ -0,0 +1,351 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_udp_rx.h"
+
+#include <string.h>
+
+#include "app_checksum.h"
+#include "app_ethmac.h"
+#include "app_log.h"
+#include "app_network.h"
+
+#define APP_UDP_RX_ETH_HEADER_SIZE 14
+#define APP_UDP_RX_ETH_TYPE_IPV4 0x0800
+#define APP_UDP_RX_IPV4_HEADER_SIZE 20
+#define APP_UDP_RX_IPV4_PROTOCOL_UDP 17
+#define APP_UDP_RX_UDP_HEADER_SIZE 8
+
+typedef struct {
+  uint16_t port;
+  // Ring of queued packets.
+  TCPIP_MAC_PACKET* packets[APP_UDP_RX_QUEUE_SIZE];
+  // Payload offset within packet segment and payload length.
+  uint16_t offsets[APP_UDP_RX_QUEUE_SIZE];
+  uint16_t lengths[APP_UDP_RX_QUEUE_SIZE];
+  TCPIP_NET_HANDLE nets[APP_UDP_RX_QUEUE_SIZE];
+  int head;
+  int num_packets;
+} AppUDPRXPort;
+
+typedef struct {
+  AppUDPRXPort ports[APP_UDP_RX_MAX_PORTS];
+  TCPIP_STACK_PROCESS_HANDLE handles[APP_NETWORK_MAX_IFACES];
+  AppUDPRXNetStats net_stats[APP_NETWORK_MAX_IFACES];
+  AppUDPRXStats stats;
+  // Controller sums which matched software ones, offload is trusted once
+  // there are APP_UDP_RX_CHECKSUM_PROBES of them.
+  int num_checksum_probes;
+  bool is_checksum_offload_off;
+} AppUDPRX;
+
+static AppUDPRX g_udp_rx;
+
+static uint16_t app_udp_rx_get16(const uint8_t* data) {
+  return ((uint16_t)data[0] << 8) | data[1];
+}
+
+static AppUDPRXPort* app_udp_rx_port_find(uint16_t port) {
+  int i;
+  for (i = 0; i < APP_UDP_RX_MAX_PORTS; ++i) {
+    if (g_udp_rx.ports[i].port == port) {
+      return &g_udp_rx.ports[i];
+    }
+  }
+  return NULL;
+}
+
+static void app_udp_rx_packet_ack(TCPIP_MAC_PACKET* packet) {
+  packet->ackRes = TCPIP_MAC_PKT_ACK_RX_OK;
+  if (packet->ackFunc != NULL) {
+    (*packet->ackFunc)(packet, packet->ackParam);
+  }
+}
+
+static bool app_udp_rx_address_is_local(TCPIP_NET_HANDLE net,
+                                        const uint8_t* address) {
+  IPV4_ADDR destination;
+  memcpy(&destination, address, sizeof(destination));
+  return destination.Val == TCPIP_STACK_NetAddress(net) ||
+         destination.Val == TCPIP_STACK_NetAddressBcast(net) ||
+         destination.Val == 0xffffffff;
+}
+
+// Checksum of the whole network layer from the controller, when the packet
+// came through it and the offload is trusted.
+static bool app_udp_rx_offload_get(const TCPIP_MAC_PACKET* packet,
+                                   const uint8_t* data,
+                                   uint16_t size,
+                                   uint16_t* total) {
+  uint16_t expected;
+  if (g_udp_rx.is_checksum_offload_off ||
+      !APP_ETHMAC_RxChecksumGet(packet, total)) {
+    return false;
+  }
+  if (g_udp_rx.num_checksum_probes == APP_UDP_RX_CHECKSUM_PROBES) {
+    return true;
+  }
+  expected = APP_Checksum_Calc(data, size, 0);
+  if (*total != expected) {
+    APP_LOG("APP UDP RX: Controller checksum 0x%04x, expected 0x%04x, "
+            "offload is off\r\n", *total, expected);
+    g_udp_rx.is_checksum_offload_off = true;
+    return false;
+  }
+  ++g_udp_rx.num_checksum_probes;
+  return true;
+}
+
+// UDP checksum over pseudo-header, header and payload. Zero checksum means
+// sender did not calculate it.
+static bool app_udp_rx_checksum_is_valid(const TCPIP_MAC_PACKET* packet,
+                                         const uint8_t* ip_header,
+                                         uint16_t net_length,
+                                         const uint8_t* udp_header,
+                                         uint16_t udp_length) {
+  uint8_t pseudo_header[12];
+  uint16_t checksum, total;
+  if (app_udp_rx_get16(udp_header + 6) == 0) {
+    return true;
+  }
+  memcpy(pseudo_header, ip_header + 12, 8);
+  pseudo_header[8] = 0;
+  pseudo_header[9] = APP_UDP_RX_IPV4_PROTOCOL_UDP;
+  memcpy(pseudo_header + 10, udp_header + 4, 2);
+  checksum = ~APP_Checksum_Calc(pseudo_header, sizeof(pseudo_header), 0);
+  if (app_udp_rx_offload_get(packet, ip_header, net_length, &total)) {
+    ++g_udp_rx.stats.num_hw_checksums;
+    return APP_Checksum_FromTotal(total, ip_header, net_length,
+                                  udp_header - ip_header, udp_length,
+                                  checksum) == 0;
+  }
+  ++g_udp_rx.stats.num_sw_checksums;
+  return APP_Checksum_Calc(udp_header, udp_length, checksum) == 0;
+}
+
+// Called by the stack for every received frame, before it is dispatched to
+// the protocol layers. Returning true means the packet is taken over.
+// Parameter is the index of the interface.
+static bool app_udp_rx_packet_handler(TCPIP_NET_HANDLE net,
+                                      TCPIP_MAC_PACKET* packet,
+                                      uint16_t frame_type,
+                                      const void* param) {
+  AppUDPRXNetStats* net_stats = &g_udp_rx.net_stats[(uintptr_t)param];
+  const uint8_t* ip_header = packet->pNetLayer;
+  const uint8_t* udp_header;
+  // By the time the handler is called the stack has taken the Ethernet
+  // header off the segment and pointed the network layer past it, so this
+  // is the IP datagram and possibly padding of short frames. Lengths of the datagram and payload
+  // come from the IP and UDP headers, this only bounds them.
+  const uint16_t net_length = packet->pDSeg->segLen;
+  uint16_t ip_header_length, ip_length, udp_length;
+  AppUDPRXPort* rx_port;
+  int index;
+  ++net_stats->num_frames;
+  net_stats->num_bytes += net_length + APP_UDP_RX_ETH_HEADER_SIZE;
+  if (frame_type != APP_UDP_RX_ETH_TYPE_IPV4 ||
+      net_length < APP_UDP_RX_IPV4_HEADER_SIZE + APP_UDP_RX_UDP_HEADER_SIZE ||
+      packet->pDSeg->next != NULL) {
+    return false;
+  }
+  // Version 4, no fragmentation, UDP.
+  ip_header_length = (ip_header[0] & 0x0f) * 4;
+  ip_length = app_udp_rx_get16(ip_header + 2);
+  if ((ip_header[0] >> 4) != 4 ||
+      ip_header_length < APP_UDP_RX_IPV4_HEADER_SIZE ||
+      (app_udp_rx_get16(ip_header + 6) & 0x3fff) != 0 ||
+      ip_header[9] != APP_UDP_RX_IPV4_PROTOCOL_UDP ||
+      ip_length > net_length ||
+      ip_length < ip_header_length + APP_UDP_RX_UDP_HEADER_SIZE) {
+    return false;
+  }
+  udp_header = ip_header + ip_header_length;
+  rx_port = app_udp_rx_port_find(app_udp_rx_get16(udp_header + 2));
+  if (rx_port == NULL ||
+      !app_udp_rx_address_is_local(net, ip_header + 16)) {
+    return false;
+  }
+  udp_length = app_udp_rx_get16(udp_header + 4);
+  if (udp_length < APP_UDP_RX_UDP_HEADER_SIZE ||
+      udp_length > ip_length - ip_header_length ||
+      APP_Checksum_Calc(ip_header, ip_header_length, 0) != 0 ||
+      !app_udp_rx_checksum_is_valid(packet, ip_header, net_length,
+                                    udp_header, udp_length)) {
+    // Malformed datagram for our port, nobody else is interested in it.
+    ++g_udp_rx.stats.num_bad_checksum;
+    app_udp_rx_packet_ack(packet);
+    return true;
+  }
+  if (rx_port->num_packets == APP_UDP_RX_QUEUE_SIZE) {
+    ++g_udp_rx.stats.num_dropped;
+    app_udp_rx_packet_ack(packet);
+    return true;
+  }
+  index = (rx_port->head + rx_port->num_packets) % APP_UDP_RX_QUEUE_SIZE;
+  rx_port->packets[index] = packet;
+  rx_port->offsets[index] =
+      udp_header + APP_UDP_RX_UDP_HEADER_SIZE - packet->pDSeg->segLoad;
+  rx_port->lengths[index] = udp_length - APP_UDP_RX_UDP_HEADER_SIZE;
+  rx_port->nets[index] = net;
+  ++rx_port->num_packets;
+  ++g_udp_rx.stats.num_received;
+  return true;
+}
+
+static void app_udp_rx_handlers_deregister(void) {
+  int i;
+  for (i = 0; i < APP_NETWORK_MAX_IFACES; ++i) {
+    if (g_udp_rx.handles[i] != NULL) {
+      TCPIP_STACK_PacketHandlerDeregister(TCPIP_STACK_IndexToNet(i),
+                                          g_udp_rx.handles[i]);
+      g_udp_rx.handles[i] = NULL;
+    }
+  }
+}
+
+// Register packet handler with all interfaces, either all of them get it or
+// none.
+static bool app_udp_rx_handlers_register(void) {
+  int i;
+  const int num_nets = TCPIP_STACK_NumberOfNetworksGet();
+  for (i = 0; i < num_nets && i < APP_NETWORK_MAX_IFACES; ++i) {
+    TCPIP_NET_HANDLE net = TCPIP_STACK_IndexToNet(i);
+    g_udp_rx.handles[i] = TCPIP_STACK_PacketHandlerRegister(
+        net, app_udp_rx_packet_handler, (const void*)(uintptr_t)i);
+    if (g_udp_rx.handles[i] == NULL) {
+      APP_LOG("APP UDP RX: Packet handler of interface %d is taken\r\n", i);
+      app_udp_rx_handlers_deregister();
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool app_udp_rx_has_ports(void) {
+  int i;
+  for (i = 0; i < APP_UDP_RX_MAX_PORTS; ++i) {
+    if (g_udp_rx.ports[i].port != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void APP_UDP_RX_Initialize(void) {
+  int i;
+  for (i = 0; i < APP_UDP_RX_MAX_PORTS; ++i) {
+    g_udp_rx.ports[i].port = 0;
+    g_udp_rx.ports[i].head = 0;
+    g_udp_rx.ports[i].num_packets = 0;
+  }
+  for (i = 0; i < APP_NETWORK_MAX_IFACES; ++i) {
+    g_udp_rx.handles[i] = NULL;
+    g_udp_rx.net_stats[i].num_frames = 0;
+    g_udp_rx.net_stats[i].num_bytes = 0;
+  }
+  g_udp_rx.stats.num_received = 0;
+  g_udp_rx.stats.num_dropped = 0;
+  g_udp_rx.stats.num_bad_checksum = 0;
+  g_udp_rx.stats.num_hw_checksums = 0;
+  g_udp_rx.stats.num_sw_checksums = 0;
+  g_udp_rx.num_checksum_probes = 0;
+  g_udp_rx.is_checksum_offload_off = false;
+}
+
+bool APP_UDP_RX_Open(uint16_t port) {
+  AppUDPRXPort* rx_port;
+  if (port == 0 || app_udp_rx_port_find(port) != NULL) {
+    return false;
+  }
+  rx_port = app_udp_rx_port_find(0);
+  if (rx_port == NULL ||
+      (!app_udp_rx_has_ports() && !app_udp_rx_handlers_register())) {
+    return false;
+  }
+  rx_port->head = 0;
+  rx_port->num_packets = 0;
+  rx_port->port = port;
+  return true;
+}
+
+void APP_UDP_RX_Close(uint16_t port) {
+  AppUDPRXPort* rx_port;
+  if (port == 0 || (rx_port = app_udp_rx_port_find(port)) == NULL) {
+    return;
+  }
+  while (rx_port->num_packets != 0) {
+    app_udp_rx_packet_ack(rx_port->packets[rx_port->head]);
+    rx_port->head = (rx_port->head + 1) % APP_UDP_RX_QUEUE_SIZE;
+    --rx_port->num_packets;
+  }
+  rx_port->port = 0;
+  // Interfaces go back to the stack once the last port is closed.
+  if (!app_udp_rx_has_ports()) {
+    app_udp_rx_handlers_deregister();
+  }
+}
+
+bool APP_UDP_RX_Get(uint16_t port, AppUDPView* view) {
+  AppUDPRXPort* rx_port;
+  TCPIP_MAC_PACKET* packet;
+  const uint8_t* ip_header;
+  const uint8_t* udp_header;
+  if (port == 0 || (rx_port = app_udp_rx_port_find(port)) == NULL ||
+      rx_port->num_packets == 0) {
+    return false;
+  }
+  packet = rx_port->packets[rx_port->head];
+  view->packet = packet;
+  view->data = packet->pDSeg->segLoad + rx_port->offsets[rx_port->head];
+  view->length = rx_port->lengths[rx_port->head];
+  view->net = rx_port->nets[rx_port->head];
+  ip_header = packet->pNetLayer;
+  udp_header = view->data - APP_UDP_RX_UDP_HEADER_SIZE;
+  memcpy(&view->remote_address, ip_header + 12, sizeof(view->remote_address));
+  view->remote_port = app_udp_rx_get16(udp_header);
+  rx_port->head = (rx_port->head + 1) % APP_UDP_RX_QUEUE_SIZE;
+  --rx_port->num_packets;
+  return true;
+}
+
+void APP_UDP_RX_Release(AppUDPView* view) {
+  if (view->packet == NULL) {
+    return;
+  }
+  app_udp_rx_packet_ack(view->packet);
+  view->packet = NULL;
+  view->data = NULL;
+  view->length = 0;
+}
+
+void APP_UDP_RX_StatsGet(AppUDPRXStats* stats) {
+  *stats = g_udp_rx.stats;
+}
+
+bool APP_UDP_RX_NetStatsGet(int net_index, AppUDPRXNetStats* stats) {
+  if (net_index < 0 || net_index >= APP_NETWORK_MAX_IFACES ||
+      g_udp_rx.handles[net_index] == NULL) {
+    return false;
+  }
+  *stats = g_udp_rx.net_stats[net_index];
+  return true;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_UDP_RX_H
+#define _APP_UDP_RX_H
+
+#include "tcpip/tcpip.h"
+
+#include "system_definitions.h"
+
+// Zero-copy UDP receive.
+//
+// Datagrams which arrive on a port opened here are taken from the stack
+// before the UDP layer copies them anywhere. Application gets a view of the
+// payload right in the MAC RX buffer, parses it in place and releases the
+// view, which returns the buffer to the driver.
+//
+// Views hold MAC RX buffers, which are a scarce resource, so they are to be
+// released as soon as possible. Up to APP_UDP_RX_QUEUE_SIZE datagrams are
+// queued per port, further ones are dropped.
+//
+// Only unfragmented IPv4 datagrams are supported, which covers command and
+// telemetry traffic.
+//
+// On the internal Ethernet controller UDP checksums come from the payload sum
+// the controller gives with every frame (see app_ethmac.h), only the IP
+// header and padding are summed in software. The first
+// APP_UDP_RX_CHECKSUM_PROBES frames are summed in software as well, and a
+// single mismatch switches the offload off. Other interfaces (MRF24W) are
+// always checked in software.
+//
+// The stack has a single packet handler per interface. Opening the first
+// port registers one with every interface, closing the last one gives them
+// back. Nothing else in the application is to register one, failure to do
+// so is logged and the port is not opened.
+
+#define APP_UDP_RX_MAX_PORTS 4
+#define APP_UDP_RX_QUEUE_SIZE 4
+#define APP_UDP_RX_CHECKSUM_PROBES 16
+
+typedef struct {
+  const uint8_t* data;
+  uint16_t length;
+
+  TCPIP_NET_HANDLE net;
+  IPV4_ADDR remote_address;
+  uint16_t remote_port;
+
+  // Packet the view is lent from.
+  TCPIP_MAC_PACKET* packet;
+} AppUDPView;
+
+typedef struct {
+  uint32_t num_received;
+  // Datagrams dropped because of a full port queue.
+  uint32_t num_dropped;
+  uint32_t num_bad_checksum;
+  // Datagrams whose checksum came from the controller's sum, and ones which
+  // were summed in software.
+  uint32_t num_hw_checksums;
+  uint32_t num_sw_checksums;
+} AppUDPRXStats;
+
+// Every frame received while a port is open passes the receive hook, which
+// is a cheap place to count them.
+typedef struct {
+  uint32_t num_frames;
+  uint32_t num_bytes;
+} AppUDPRXNetStats;
+
+void APP_UDP_RX_Initialize(void);
+
+// Start receiving datagrams sent to the given local port on all interfaces,
+// the stack is to be up.
+bool APP_UDP_RX_Open(uint16_t port);
+// Stop receiving, datagrams which are still queued are dropped.
+void APP_UDP_RX_Close(uint16_t port);
+
+// Get next datagram received on the port. Returns false if there is none.
+bool APP_UDP_RX_Get(uint16_t port, AppUDPView* view);
+// Return buffer of the view to the driver, view data is invalid afterwards.
+void APP_UDP_RX_Release(AppUDPView* view);
+
+void APP_UDP_RX_StatsGet(AppUDPRXStats* stats);
+bool APP_UDP_RX_NetStatsGet(int net_index, AppUDPRXNetStats* stats);
+
+#endif  // _APP_UDP_RX_H
@@ -22,15 +22,20 @@
 
 #include "app_usb_hid.h"
 
+#include <string.h>
+
 #include "app.h"
+#include "app_hid_bridge.h"
+#include "app_log.h"
+#include "app_trace.h"
 #include "app_usb_hid_utils.h"
 
 #define BUFFER_DMA_READY
 
 AppUSBHIDData* g_app_usb_hid_data;
 
-static uint8_t receiveDataBuffer[64] BUFFER_DMA_READY;
-static uint8_t transmitDataBuffer[64] BUFFER_DMA_READY;
+static uint8_t receiveDataBuffer[APP_USB_HID_REPORT_SIZE] BUFFER_DMA_READY;
+static uint8_t transmitDataBuffer[APP_USB_HID_REPORT_SIZE] BUFFER_DMA_READY;
 
 void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data) {
   app_usb_hid_data->state = APP_USB_HID_STATE_INIT;
@@ -42,11 +47,44 @@ void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data) {
   app_usb_hid_data->is_hid_data_received = false;
   app_usb_hid_data->is_hid_data_transmitted = true;
   app_usb_hid_data->receive_data_buffer = &receiveDataBuffer[0];
+  app_usb_hid_data->receive_data_length = 0;
   app_usb_hid_data->transmit_data_buffer = &transmitDataBuffer[0];
+  app_usb_hid_data->num_reports_received = 0;
+  app_usb_hid_data->num_reports_sent = 0;
+  memset(app_usb_hid_data->send_queues, 0,
+         sizeof(app_usb_hid_data->send_queues));
 
   g_app_usb_hid_data = app_usb_hid_data;
 }
 
+static void app_usb_hid_report_send(AppUSBHIDData* app_usb_hid_data) {
+  AppUSBHIDSendQueue* queue =
+      &app_usb_hid_data->send_queues[APP_USB_HID_LANE_CONTROL];
+  if (!app_usb_hid_data->is_hid_data_transmitted) {
+    return;
+  }
+  // Strict priority: bulk reports only go out while there are no control
+  // ones, so a control report waits for one report at most.
+  if (queue->count == 0) {
+    queue = &app_usb_hid_data->send_queues[APP_USB_HID_LANE_BULK];
+    if (queue->count == 0) {
+      return;
+    }
+  }
+  APP_TRACE_INSTANT(APP_TRACE_HID_IN_SUBMITTED,
+                    queue - app_usb_hid_data->send_queues);
+  memcpy(app_usb_hid_data->transmit_data_buffer,
+         queue->reports[queue->tail],
+         APP_USB_HID_REPORT_SIZE);
+  queue->tail = (queue->tail + 1) % APP_USB_HID_SEND_QUEUE_SIZE;
+  --queue->count;
+  app_usb_hid_data->is_hid_data_transmitted = false;
+  USB_DEVICE_HID_ReportSend(USB_DEVICE_HID_INDEX_0,
+                            &app_usb_hid_data->tx_transfer_handle,
+                            app_usb_hid_data->transmit_data_buffer,
+                            APP_USB_HID_REPORT_SIZE);
+}
+
 void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data) {
   switch (app_usb_hid_data->state) {
     case APP_USB_HID_STATE_INIT:
@@ -54,7 +92,7 @@ void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data) {
       app_usb_hid_data->us_handle =
           USB_DEVICE_Open(USB_DEVICE_INDEX_0, DRV_IO_INTENT_READWRITE);
       if (app_usb_hid_data->us_handle != USB_DEVICE_HANDLE_INVALID) {
-        SYS_CONSOLE_MESSAGE("APP USB: USB device opened\r\n");
+        APP_LOG("APP USB: USB device opened\r\n");
         // Register a callback with device layer to get event notification
         // (for end point 0).
         USB_DEVICE_EventHandlerSet(app_usb_hid_data->us_handle,
@@ -68,7 +106,7 @@ void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data) {
       break;
     case APP_USB_HID_STATE_WAIT_FOR_CONFIGURATION:
       if (app_usb_hid_data->is_device_configured == true) {
-        SYS_CONSOLE_MESSAGE("APP USB: USB device configured\r\n");
+        APP_LOG("APP USB: USB device configured\r\n");
         // Device is ready to run the main task.
         app_usb_hid_data->is_hid_data_received = false;
         app_usb_hid_data->is_hid_data_transmitted = true;
@@ -77,24 +115,66 @@ void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data) {
         USB_DEVICE_HID_ReportReceive(USB_DEVICE_HID_INDEX_0,
                                      &app_usb_hid_data->rx_transfer_handle,
                                      app_usb_hid_data->receive_data_buffer,
-                                     64);
+                                     APP_USB_HID_REPORT_SIZE);
       }
       break;
     case APP_USB_HID_STATE_MAIN_TASK:
       if (!app_usb_hid_data->is_device_configured) {
-        SYS_CONSOLE_MESSAGE("APP USB: Waiting for configuration\r\n");
+        APP_LOG("APP USB: Waiting for configuration\r\n");
         app_usb_hid_data->state = APP_USB_HID_STATE_WAIT_FOR_CONFIGURATION;
-      } else if (app_usb_hid_data->is_hid_data_received) {
-        SYS_CONSOLE_MESSAGE("APP USB: Got received data\r\n");
+        break;
+      }
+      // Report stays in the receive buffer and the endpoint is not re-armed
+      // until the bridge takes the report, so the host is throttled by NAKs
+      // rather than reports being lost.
+      if (app_usb_hid_data->is_hid_data_received &&
+          APP_HID_Bridge_Push(app_usb_hid_data->receive_data_buffer,
+                              app_usb_hid_data->receive_data_length)) {
+        APP_LOG("APP USB: Got received data\r\n");
+        APP_TRACE_INSTANT(APP_TRACE_HID_OUT_PUSHED,
+                          app_usb_hid_data->receive_data_length);
         app_usb_hid_data->is_hid_data_received = false;
         // Place a new read request.
         USB_DEVICE_HID_ReportReceive(USB_DEVICE_HID_INDEX_0,
                                      &app_usb_hid_data->rx_transfer_handle,
                                      app_usb_hid_data->receive_data_buffer,
-                                     64);
+                                     APP_USB_HID_REPORT_SIZE);
       }
+      app_usb_hid_report_send(app_usb_hid_data);
       break;
     case APP_USB_HID_STATE_ERROR:
       break;
   }
 }
+
+AppUSBHIDLane APP_USB_HID_ReportLane(const uint8_t* data, uint16_t length) {
+  if (length != 0 && (data[0] & APP_USB_HID_CONTROL_FLAG)) {
+    return APP_USB_HID_LANE_CONTROL;
+  }
+  return APP_USB_HID_LANE_BULK;
+}
+
+int APP_USB_HID_SendCredits(AppUSBHIDLane lane) {
+  if (g_app_usb_hid_data->state != APP_USB_HID_STATE_MAIN_TASK) {
+    return 0;
+  }
+  return APP_USB_HID_SEND_QUEUE_SIZE -
+         g_app_usb_hid_data->send_queues[lane].count;
+}
+
+bool APP_USB_HID_SendQueue(AppUSBHIDLane lane,
+                           const uint8_t* data,
+                           uint16_t length) {
+  AppUSBHIDSendQueue* queue = &g_app_usb_hid_data->send_queues[lane];
+  uint8_t* report;
+  if (APP_USB_HID_SendCredits(lane) == 0 ||
+      length > APP_USB_HID_REPORT_SIZE) {
+    return false;
+  }
+  report = queue->reports[queue->head];
+  memcpy(report, data, length);
+  memset(report + length, 0, APP_USB_HID_REPORT_SIZE - length);
+  queue->head = (queue->head + 1) % APP_USB_HID_SEND_QUEUE_SIZE;
+  ++queue->count;
+  return true;
+}
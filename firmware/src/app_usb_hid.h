@@ -25,6 +25,22 @@
 
 #include "system_definitions.h"
 
+// Size of reports of both interrupt endpoints, as in the report descriptor.
+#define APP_USB_HID_REPORT_SIZE 64
+// Reports of every lane which are waiting to be sent to the host.
+#define APP_USB_HID_SEND_QUEUE_SIZE 8
+// Reports with this bit set in their first byte are control ones. They go
+// through their own lane here and in the HID bridge ring, and overtake bulk
+// reports queued before them. Records the HID bridge receives from a client
+// are queued in stream order, see app_hid_bridge.h.
+#define APP_USB_HID_CONTROL_FLAG 0x80
+
+typedef enum {
+  APP_USB_HID_LANE_CONTROL,
+  APP_USB_HID_LANE_BULK,
+  APP_USB_HID_NUM_LANES,
+} AppUSBHIDLane;
+
 typedef enum {
   // USB HID is initializing.
   APP_USB_HID_STATE_INIT,
@@ -36,6 +52,13 @@ typedef enum {
   APP_USB_HID_STATE_ERROR,
 } AppUSBHIDState;
 
+typedef struct {
+  // Reports to be sent, zero-padded to the report size.
+  uint8_t reports[APP_USB_HID_SEND_QUEUE_SIZE][APP_USB_HID_REPORT_SIZE];
+  uint8_t head;
+  uint8_t tail;
+  uint8_t count;
+} AppUSBHIDSendQueue;
 
 typedef struct {
   AppUSBHIDState state;
@@ -44,6 +67,8 @@ typedef struct {
 
   uint8_t* receive_data_buffer;
   uint8_t* transmit_data_buffer;
+  // Size of the last received report.
+  uint16_t receive_data_length;
 
   bool is_device_configured;
 
@@ -56,10 +81,29 @@ typedef struct {
   bool is_hid_data_transmitted;
 
   uint8_t idle_rate;
+
+  uint32_t num_reports_received;
+  uint32_t num_reports_sent;
+
+  // Control queue is always sent first.
+  AppUSBHIDSendQueue send_queues[APP_USB_HID_NUM_LANES];
 } AppUSBHIDData;
 
 
 void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data);
 void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data);
 
+// Lane of the report, empty reports are bulk ones.
+AppUSBHIDLane APP_USB_HID_ReportLane(const uint8_t* data, uint16_t length);
+
+// Number of reports which can be queued to the lane for sending to the host
+// right now. It is zero while the device is not configured, so producers
+// hold their data instead of queueing it for nobody.
+int APP_USB_HID_SendCredits(AppUSBHIDLane lane);
+
+// Queue report for sending to the host, fails if the lane has no credits.
+bool APP_USB_HID_SendQueue(AppUSBHIDLane lane,
+                           const uint8_t* data,
+                           uint16_t length);
+
 #endif  // _APP_USB_HID_H
@@ -47,7 +47,10 @@
 
 #include "app_usb_hid_utils.h"
 
+#include "app_log.h"
 #include "app_usb_hid.h"
+#include "app_profile.h"
+#include "app_trace.h"
 
 extern AppUSBHIDData* g_app_usb_hid_data;
 
@@ -66,6 +69,8 @@ USB_DEVICE_HID_EVENT_RESPONSE app_usb_device_hid_event_handler(
       if (report_sent->handle == g_app_usb_hid_data->tx_transfer_handle) {
         // Transfer progressed.
         g_app_usb_hid_data->is_hid_data_transmitted = true;
+        ++g_app_usb_hid_data->num_reports_sent;
+        APP_TRACE_INSTANT(APP_TRACE_HID_IN_SENT, report_sent->length);
       }
       break;
 
@@ -76,6 +81,10 @@ USB_DEVICE_HID_EVENT_RESPONSE app_usb_device_hid_event_handler(
       if (report_received->handle == g_app_usb_hid_data->rx_transfer_handle ){
         // Transfer progressed.
         g_app_usb_hid_data->is_hid_data_received = true;
+        g_app_usb_hid_data->receive_data_length = report_received->length;
+        ++g_app_usb_hid_data->num_reports_received;
+        APP_TRACE_INSTANT(APP_TRACE_HID_OUT_RECEIVED,
+                          report_received->length);
       }
       break;
 
@@ -118,12 +127,13 @@ void app_usb_device_event_handler(USB_DEVICE_EVENT event,
       // Device layer is going to de-initialize all function drivers.
       // Hence close handles to all function drivers (Only if they are
       // opened previously.
-      SYS_CONSOLE_MESSAGE("APP USB: Device reset/de-configured\r\n");
+      APP_LOG("APP USB: Device reset/de-configured\r\n");
       g_app_usb_hid_data->is_device_configured = false;
       g_app_usb_hid_data->state = APP_USB_HID_STATE_WAIT_FOR_CONFIGURATION;
       break;
     case USB_DEVICE_EVENT_CONFIGURED:
-      SYS_CONSOLE_MESSAGE("APP USB: Configured event\r\n");
+      APP_LOG("APP USB: Configured event\r\n");
+      APP_Profile_BootMark(APP_BOOT_USB_CONFIGURED);
       // Set the flag indicating device is configured.
       g_app_usb_hid_data->is_device_configured = true;
       // Save the other details for later use.
@@ -140,13 +150,13 @@ void app_usb_device_event_handler(USB_DEVICE_EVENT event,
 
     case USB_DEVICE_EVENT_POWER_DETECTED:
       // VBUS was detected. We can attach the device.
-      SYS_CONSOLE_MESSAGE("APP USB: Power detected\r\n");
+      APP_LOG("APP USB: Power detected\r\n");
       USB_DEVICE_Attach(g_app_usb_hid_data->us_handle);
       break;
 
     case USB_DEVICE_EVENT_POWER_REMOVED:
       // VBUS is not available.
-      SYS_CONSOLE_MESSAGE("APP USB: Power removed\r\n");
+      APP_LOG("APP USB: Power removed\r\n");
       USB_DEVICE_Detach(g_app_usb_hid_data->us_handle);
       break;
 
@@ -27,6 +27,8 @@
 
 #include "system_definitions.h"
 #include "app.h"
+#include "app_profile.h"
+#include "app_trace.h"
 
 int main(void) {
   AppData app_data;
@@ -34,11 +36,14 @@ int main(void) {
   SYS_Initialize(NULL);
   // Initialize application specific modules.
   APP_Initialize(&app_data, &sysObj);
+  // First iteration is to be measured from here, not from the reset.
+  APP_Profile_LoopStatsReset();
   while (true) {
     // Maintain state machines of all polled MPLAB Harmony modules.
-    SYS_Tasks();
+    APP_TRACE_CALL(APP_TRACE_TASK_SYS, SYS_Tasks());
     // Maintain the application's state machine.
-    APP_Tasks(&app_data);
+    APP_TRACE_CALL(APP_TRACE_TASK_APP, APP_Tasks(&app_data));
+    APP_Profile_LoopTick();
   }
   // Execution should not come here during normal operation.
   return EXIT_FAILURE;
@@ -34,8 +34,458 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 (INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR COSTS.
 *******************************************************************************/
 
+#include <string.h>
+
 #include "net_pres_enc_glue.h"
 #include "net/pres/net_pres_transportapi.h"
 #include "net/pres/net_pres_certstore.h"
 
+#include "wolfssl/ssl.h"
+#include "wolfssl/wolfcrypt/random.h"
+
+#include "app_crypto.h"
+
+
+
+#define NET_PRES_ENC_GLUE_CIPHER_LIST "PSK-AES128-GCM-SHA256:PSK-AES128-CBC-SHA256"
+#define NET_PRES_ENC_GLUE_TICKET_KEY_SIZE APP_CRYPTO_CHACHA20_KEY_SIZE
+
+typedef struct
+{
+    WOLFSSL_CTX* context;
+    NET_PRES_TransportObject * transObject;
+    bool isInited;
+} net_pres_wolfsslInfo;
+
+static net_pres_wolfsslInfo net_pres_wolfSSL_info_StreamServer0;
+static net_pres_wolfsslInfo net_pres_wolfSSL_info_StreamClient0;
+
+static char net_pres_pskIdentity[NET_PRES_ENC_GLUE_PSK_IDENTITY_MAX + 1];
+static uint8_t net_pres_pskKey[NET_PRES_ENC_GLUE_PSK_KEY_MAX];
+static uint16_t net_pres_pskKeySize;
+
+/* Tickets are encrypted with a key generated at boot, so they don't survive
+   a reset, sessions are then established with a full handshake. The RNG is
+   seeded by APP_Entropy_Seed() (see user_settings.h). */
+static WC_RNG net_pres_ticketRng;
+static uint8_t net_pres_ticketKeyName[WOLFSSL_TICKET_NAME_SZ];
+static uint8_t net_pres_ticketKey[NET_PRES_ENC_GLUE_TICKET_KEY_SIZE];
+
+static NET_PRES_EncGlueStats net_pres_glueStats;
+
+bool NET_PRES_EncGlue_PSKSet(const char * identity, const uint8_t * key, uint16_t keySize)
+{
+    if (strlen(identity) > NET_PRES_ENC_GLUE_PSK_IDENTITY_MAX ||
+        keySize == 0 || keySize > NET_PRES_ENC_GLUE_PSK_KEY_MAX)
+    {
+        return false;
+    }
+    strcpy(net_pres_pskIdentity, identity);
+    memcpy(net_pres_pskKey, key, keySize);
+    net_pres_pskKeySize = keySize;
+    return true;
+}
+
+bool NET_PRES_EncGlue_PSKIsSet(void)
+{
+    return net_pres_pskKeySize != 0;
+}
+
+void NET_PRES_EncGlue_StatsGet(NET_PRES_EncGlueStats * stats)
+{
+    *stats = net_pres_glueStats;
+}
+
+static unsigned int NET_PRES_EncGlue_ServerPSKCb(WOLFSSL* ssl, const char* identity,
+                                                 unsigned char* key, unsigned int keyMaxSize)
+{
+    if (net_pres_pskKeySize == 0 || net_pres_pskKeySize > keyMaxSize ||
+        strcmp(identity, net_pres_pskIdentity) != 0)
+    {
+        return 0;
+    }
+    memcpy(key, net_pres_pskKey, net_pres_pskKeySize);
+    return net_pres_pskKeySize;
+}
+
+static unsigned int NET_PRES_EncGlue_ClientPSKCb(WOLFSSL* ssl, const char* hint,
+                                                 char* identity, unsigned int identityMaxSize,
+                                                 unsigned char* key, unsigned int keyMaxSize)
+{
+    if (net_pres_pskKeySize == 0 || net_pres_pskKeySize > keyMaxSize ||
+        strlen(net_pres_pskIdentity) >= identityMaxSize)
+    {
+        return 0;
+    }
+    strcpy(identity, net_pres_pskIdentity);
+    memcpy(key, net_pres_pskKey, net_pres_pskKeySize);
+    return net_pres_pskKeySize;
+}
+
+/* Session ticket protection: ChaCha20-Poly1305 with key name, IV and ticket
+   length as additional authenticated data. Nonce is the first 12 bytes of
+   the IV. The tag is shorter than the MAC field, the rest of it is zero and
+   checked as well. */
+static int NET_PRES_EncGlue_TicketEncCb(WOLFSSL* ssl,
+                                        unsigned char keyName[WOLFSSL_TICKET_NAME_SZ],
+                                        unsigned char iv[WOLFSSL_TICKET_IV_SZ],
+                                        unsigned char mac[WOLFSSL_TICKET_MAC_SZ],
+                                        int enc, unsigned char* ticket, int inLen, int* outLen,
+                                        void* userCtx)
+{
+    uint8_t aad[WOLFSSL_TICKET_NAME_SZ + WOLFSSL_TICKET_IV_SZ + 2];
+    if (enc)
+    {
+        memcpy(keyName, net_pres_ticketKeyName, WOLFSSL_TICKET_NAME_SZ);
+        if (wc_RNG_GenerateBlock(&net_pres_ticketRng, iv, WOLFSSL_TICKET_IV_SZ) != 0)
+        {
+            return WOLFSSL_TICKET_RET_REJECT;
+        }
+    }
+    else if (memcmp(keyName, net_pres_ticketKeyName, WOLFSSL_TICKET_NAME_SZ) != 0)
+    {
+        ++net_pres_glueStats.numTicketsRejected;
+        return WOLFSSL_TICKET_RET_REJECT;
+    }
+    memcpy(aad, keyName, WOLFSSL_TICKET_NAME_SZ);
+    memcpy(aad + WOLFSSL_TICKET_NAME_SZ, iv, WOLFSSL_TICKET_IV_SZ);
+    aad[WOLFSSL_TICKET_NAME_SZ + WOLFSSL_TICKET_IV_SZ] = inLen >> 8;
+    aad[WOLFSSL_TICKET_NAME_SZ + WOLFSSL_TICKET_IV_SZ + 1] = inLen;
+    if (enc)
+    {
+        APP_Crypto_AEADSeal(net_pres_ticketKey, iv, aad, sizeof(aad),
+                            ticket, inLen, mac, WOLFSSL_TICKET_MAC_SZ);
+        ++net_pres_glueStats.numTicketsIssued;
+    }
+    else if (!APP_Crypto_AEADOpen(net_pres_ticketKey, iv, aad, sizeof(aad),
+                                  ticket, inLen, mac, WOLFSSL_TICKET_MAC_SZ))
+    {
+        ++net_pres_glueStats.numTicketsRejected;
+        return WOLFSSL_TICKET_RET_REJECT;
+    }
+    *outLen = inLen;
+    return WOLFSSL_TICKET_RET_OK;
+}
+
+static int NET_PRES_EncGlue_Receive(NET_PRES_TransportObject * transObject, char *buf, int sz, void *ctx)
+{
+    int fd = *(int*)ctx;
+    uint16_t bufferSize;
+    bufferSize = (*transObject->fpReadyToRead)((uintptr_t)fd);
+    if (bufferSize == 0)
+    {
+        return WOLFSSL_CBIO_ERR_WANT_READ;
+    }
+    return (*transObject->fpRead)((uintptr_t)fd, (uint8_t*)buf, sz);
+}
+
+static int NET_PRES_EncGlue_Send(NET_PRES_TransportObject * transObject, char *buf, int sz, void *ctx)
+{
+    int fd = *(int*)ctx;
+    uint16_t bufferSize;
+    bufferSize = (*transObject->fpWrite)((uintptr_t)fd, (uint8_t*)buf, sz);
+    if (bufferSize == 0)
+    {
+        return WOLFSSL_CBIO_ERR_WANT_WRITE;
+    }
+    // Handshake flights are sent right away instead of waiting for the
+    // transport to coalesce them.
+    (*transObject->fpFlush)((uintptr_t)fd);
+    return bufferSize;
+}
+
+static int NET_PRES_EncGlue_StreamServerReceiveCb0(WOLFSSL* ssl, char *buf, int sz, void *ctx)
+{
+    return NET_PRES_EncGlue_Receive(net_pres_wolfSSL_info_StreamServer0.transObject, buf, sz, ctx);
+}
+
+static int NET_PRES_EncGlue_StreamServerSendCb0(WOLFSSL* ssl, char *buf, int sz, void *ctx)
+{
+    return NET_PRES_EncGlue_Send(net_pres_wolfSSL_info_StreamServer0.transObject, buf, sz, ctx);
+}
+
+static int NET_PRES_EncGlue_StreamClientReceiveCb0(WOLFSSL* ssl, char *buf, int sz, void *ctx)
+{
+    return NET_PRES_EncGlue_Receive(net_pres_wolfSSL_info_StreamClient0.transObject, buf, sz, ctx);
+}
+
+static int NET_PRES_EncGlue_StreamClientSendCb0(WOLFSSL* ssl, char *buf, int sz, void *ctx)
+{
+    return NET_PRES_EncGlue_Send(net_pres_wolfSSL_info_StreamClient0.transObject, buf, sz, ctx);
+}
+
+static bool NET_PRES_EncGlue_ContextInit(net_pres_wolfsslInfo * info, NET_PRES_TransportObject * transObject,
+                                         WOLFSSL_METHOD * method,
+                                         CallbackIORecv receiveCb, CallbackIOSend sendCb)
+{
+    info->transObject = transObject;
+    info->context = wolfSSL_CTX_new(method);
+    if (info->context == 0)
+    {
+        return false;
+    }
+    wolfSSL_SetIORecv(info->context, receiveCb);
+    wolfSSL_SetIOSend(info->context, sendCb);
+    if (wolfSSL_CTX_set_cipher_list(info->context, NET_PRES_ENC_GLUE_CIPHER_LIST) != SSL_SUCCESS)
+    {
+        wolfSSL_CTX_free(info->context);
+        return false;
+    }
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamServerInit0(NET_PRES_TransportObject * transObject)
+{
+    net_pres_wolfsslInfo * info = &net_pres_wolfSSL_info_StreamServer0;
+    if (wolfSSL_Init() != SSL_SUCCESS)
+    {
+        return false;
+    }
+    if (wc_InitRng(&net_pres_ticketRng) != 0 ||
+        wc_RNG_GenerateBlock(&net_pres_ticketRng, net_pres_ticketKeyName, sizeof(net_pres_ticketKeyName)) != 0 ||
+        wc_RNG_GenerateBlock(&net_pres_ticketRng, net_pres_ticketKey, sizeof(net_pres_ticketKey)) != 0)
+    {
+        return false;
+    }
+    if (!NET_PRES_EncGlue_ContextInit(info, transObject, wolfTLSv1_2_server_method(),
+                                      &NET_PRES_EncGlue_StreamServerReceiveCb0,
+                                      &NET_PRES_EncGlue_StreamServerSendCb0))
+    {
+        return false;
+    }
+    wolfSSL_CTX_set_psk_server_callback(info->context, &NET_PRES_EncGlue_ServerPSKCb);
+    wolfSSL_CTX_set_TicketEncCb(info->context, &NET_PRES_EncGlue_TicketEncCb);
+    info->isInited = true;
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamServerDeinit0(void)
+{
+    wolfSSL_CTX_free(net_pres_wolfSSL_info_StreamServer0.context);
+    wc_FreeRng(&net_pres_ticketRng);
+    net_pres_wolfSSL_info_StreamServer0.isInited = false;
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamServerOpen0(uintptr_t transHandle, void * providerData)
+{
+    WOLFSSL* ssl = wolfSSL_new(net_pres_wolfSSL_info_StreamServer0.context);
+    if (ssl == NULL)
+    {
+        return false;
+    }
+    if (wolfSSL_set_fd(ssl, transHandle) != SSL_SUCCESS)
+    {
+        wolfSSL_free(ssl);
+        return false;
+    }
+    memcpy(providerData, &ssl, sizeof(WOLFSSL*));
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamServerIsInited0(void)
+{
+    return net_pres_wolfSSL_info_StreamServer0.isInited;
+}
+
+static NET_PRES_EncSessionStatus NET_PRES_EncGlue_HandshakeStatus(WOLFSSL* ssl, int result,
+                                                                  NET_PRES_EncSessionStatus negotiating)
+{
+    int error;
+    if (result == SSL_SUCCESS)
+    {
+        if (wolfSSL_session_reused(ssl))
+        {
+            ++net_pres_glueStats.numResumedHandshakes;
+        }
+        else
+        {
+            ++net_pres_glueStats.numFullHandshakes;
+        }
+        return NET_PRES_ENC_SS_OPEN;
+    }
+    error = wolfSSL_get_error(ssl, result);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+    {
+        return negotiating;
+    }
+    ++net_pres_glueStats.numFailedHandshakes;
+    return NET_PRES_ENC_SS_FAILED;
+}
+
+NET_PRES_EncSessionStatus NET_PRES_EncProviderServerAccept0(void * providerData)
+{
+    WOLFSSL* ssl;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    return NET_PRES_EncGlue_HandshakeStatus(ssl, wolfSSL_accept(ssl),
+                                            NET_PRES_ENC_SS_SERVER_NEGOTIATING);
+}
+
+bool NET_PRES_EncProviderStreamClientInit0(NET_PRES_TransportObject * transObject)
+{
+    net_pres_wolfsslInfo * info = &net_pres_wolfSSL_info_StreamClient0;
+    if (wolfSSL_Init() != SSL_SUCCESS)
+    {
+        return false;
+    }
+    if (!NET_PRES_EncGlue_ContextInit(info, transObject, wolfTLSv1_2_client_method(),
+                                      &NET_PRES_EncGlue_StreamClientReceiveCb0,
+                                      &NET_PRES_EncGlue_StreamClientSendCb0))
+    {
+        return false;
+    }
+    wolfSSL_CTX_set_psk_client_callback(info->context, &NET_PRES_EncGlue_ClientPSKCb);
+    info->isInited = true;
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamClientDeinit0(void)
+{
+    wolfSSL_CTX_free(net_pres_wolfSSL_info_StreamClient0.context);
+    net_pres_wolfSSL_info_StreamClient0.isInited = false;
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamClientOpen0(uintptr_t transHandle, void * providerData)
+{
+    NET_PRES_TransportObject * transObject = net_pres_wolfSSL_info_StreamClient0.transObject;
+    WOLFSSL* ssl = wolfSSL_new(net_pres_wolfSSL_info_StreamClient0.context);
+    TCP_SOCKET_INFO socketInfo;
+    uint8_t serverId[6];
+    if (ssl == NULL)
+    {
+        return false;
+    }
+    if (wolfSSL_set_fd(ssl, transHandle) != SSL_SUCCESS)
+    {
+        wolfSSL_free(ssl);
+        return false;
+    }
+    // Sessions are kept in the client cache by the server address and port,
+    // so reconnecting to the same server (for example after the link went
+    // down) resumes the previous session.
+    if ((*transObject->fpSocketInfoGet)(transHandle, &socketInfo))
+    {
+        memcpy(serverId, socketInfo.remoteIPaddress.v4Add.v, 4);
+        serverId[4] = socketInfo.remotePort >> 8;
+        serverId[5] = socketInfo.remotePort;
+        wolfSSL_SetServerID(ssl, serverId, sizeof(serverId), 0);
+    }
+    wolfSSL_UseSessionTicket(ssl);
+    memcpy(providerData, &ssl, sizeof(WOLFSSL*));
+    return true;
+}
+
+bool NET_PRES_EncProviderStreamClientIsInited0(void)
+{
+    return net_pres_wolfSSL_info_StreamClient0.isInited;
+}
+
+NET_PRES_EncSessionStatus NET_PRES_EncProviderClientConnect0(void * providerData)
+{
+    WOLFSSL* ssl;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    return NET_PRES_EncGlue_HandshakeStatus(ssl, wolfSSL_connect(ssl),
+                                            NET_PRES_ENC_SS_CLIENT_NEGOTIATING);
+}
+
+NET_PRES_EncSessionStatus NET_PRES_EncProviderConnectionClose0(void * providerData)
+{
+    WOLFSSL* ssl;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    wolfSSL_free(ssl);
+    return NET_PRES_ENC_SS_CLOSED;
+}
+
+int32_t NET_PRES_EncProviderWrite0(void * providerData, const uint8_t * buffer, uint16_t size)
+{
+    WOLFSSL* ssl;
+    int ret;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    ret = wolfSSL_write(ssl, buffer, size);
+    if (ret < 0)
+    {
+        return 0;
+    }
+    return ret;
+}
+
+uint16_t NET_PRES_EncProviderWriteReady0(void * providerData, uint16_t reqSize, uint16_t minSize)
+{
+    WOLFSSL* ssl;
+    NET_PRES_TransportObject * transObject;
+    int outSize;
+    uint16_t transSpace;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    transObject = (wolfSSL_GetSide(ssl) == WOLFSSL_SERVER_END)
+        ? net_pres_wolfSSL_info_StreamServer0.transObject
+        : net_pres_wolfSSL_info_StreamClient0.transObject;
+    transSpace = (*transObject->fpReadyToWrite)((uintptr_t)wolfSSL_get_fd(ssl));
+    outSize = wolfSSL_GetOutputSize(ssl, reqSize);
+    if (outSize > 0 && outSize <= transSpace)
+    {
+        return reqSize;
+    }
+    if (minSize != 0)
+    {
+        outSize = wolfSSL_GetOutputSize(ssl, minSize);
+        if (outSize > 0 && outSize <= transSpace)
+        {
+            return minSize;
+        }
+    }
+    return 0;
+}
+
+int32_t NET_PRES_EncProviderRead0(void * providerData, uint8_t * buffer, uint16_t size)
+{
+    WOLFSSL* ssl;
+    int ret;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    ret = wolfSSL_read(ssl, buffer, size);
+    if (ret < 0)
+    {
+        return 0;
+    }
+    return ret;
+}
+
+int32_t NET_PRES_EncProviderReadReady0(void * providerData)
+{
+    WOLFSSL* ssl;
+    uint8_t buffer;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    if (wolfSSL_pending(ssl) == 0)
+    {
+        // Decrypt the next record, if there is a complete one.
+        wolfSSL_peek(ssl, &buffer, 1);
+    }
+    return wolfSSL_pending(ssl);
+}
+
+int32_t NET_PRES_EncProviderPeek0(void * providerData, uint8_t * buffer, uint16_t size)
+{
+    WOLFSSL* ssl;
+    int ret;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    ret = wolfSSL_peek(ssl, buffer, size);
+    if (ret < 0)
+    {
+        return 0;
+    }
+    return ret;
+}
+
+int NET_PRES_EncProviderOutputSize0(void * providerData, int inSize)
+{
+    WOLFSSL* ssl;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    return wolfSSL_GetOutputSize(ssl, inSize);
+}
 
+int NET_PRES_EncProviderMaxOutputSize0(void * providerData)
+{
+    WOLFSSL* ssl;
+    memcpy(&ssl, providerData, sizeof(WOLFSSL*));
+    return wolfSSL_GetMaxOutputSize(ssl);
+}
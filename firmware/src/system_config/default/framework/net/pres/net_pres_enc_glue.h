@@ -43,6 +43,54 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #ifdef __CPLUSPLUS
 extern "C" {
 #endif
+
+/* wolfSSL provider for stream sockets, both server and client.
+
+   Only TLS 1.2 with pre-shared key cipher suites is enabled, so there are no
+   certificates and no public key operations. Server resumes sessions from
+   session tickets and from its session ID cache, client resumes sessions
+   of the server it has talked to before, looked up by the server address
+   and port. Resumed handshake is a single round trip with a few hashes. */
+
+#define NET_PRES_ENC_GLUE_PSK_IDENTITY_MAX 32
+#define NET_PRES_ENC_GLUE_PSK_KEY_MAX 32
+
+typedef struct
+{
+    uint32_t numFullHandshakes;
+    uint32_t numResumedHandshakes;
+    uint32_t numFailedHandshakes;
+    uint32_t numTicketsIssued;
+    uint32_t numTicketsRejected;
+} NET_PRES_EncGlueStats;
+
+/* Set identity and key used by both the server and the client. Without a
+   key all handshakes fail. */
+bool NET_PRES_EncGlue_PSKSet(const char * identity, const uint8_t * key, uint16_t keySize);
+bool NET_PRES_EncGlue_PSKIsSet(void);
+void NET_PRES_EncGlue_StatsGet(NET_PRES_EncGlueStats * stats);
+
+bool NET_PRES_EncProviderStreamServerInit0(struct _NET_PRES_TransportObject * transObject);
+bool NET_PRES_EncProviderStreamServerDeinit0(void);
+bool NET_PRES_EncProviderStreamServerOpen0(uintptr_t transHandle, void * providerData);
+bool NET_PRES_EncProviderStreamServerIsInited0(void);
+NET_PRES_EncSessionStatus NET_PRES_EncProviderServerAccept0(void * providerData);
+
+bool NET_PRES_EncProviderStreamClientInit0(struct _NET_PRES_TransportObject * transObject);
+bool NET_PRES_EncProviderStreamClientDeinit0(void);
+bool NET_PRES_EncProviderStreamClientOpen0(uintptr_t transHandle, void * providerData);
+bool NET_PRES_EncProviderStreamClientIsInited0(void);
+NET_PRES_EncSessionStatus NET_PRES_EncProviderClientConnect0(void * providerData);
+
+NET_PRES_EncSessionStatus NET_PRES_EncProviderConnectionClose0(void * providerData);
+int32_t NET_PRES_EncProviderWrite0(void * providerData, const uint8_t * buffer, uint16_t size);
+uint16_t NET_PRES_EncProviderWriteReady0(void * providerData, uint16_t reqSize, uint16_t minSize);
+int32_t NET_PRES_EncProviderRead0(void * providerData, uint8_t * buffer, uint16_t size);
+int32_t NET_PRES_EncProviderReadReady0(void * providerData);
+int32_t NET_PRES_EncProviderPeek0(void * providerData, uint8_t * buffer, uint16_t size);
+int NET_PRES_EncProviderOutputSize0(void * providerData, int inSize);
+int NET_PRES_EncProviderMaxOutputSize0(void * providerData);
+
 #ifdef __CPLUSPLUS
 }
 #endif
@@ -78,6 +78,11 @@ extern "C" {
 #define SYS_VERSION_STR           "2.02"
 #define SYS_VERSION               20200
 
+// *****************************************************************************
+/* DMA System Service Configuration Options
+*/
+#define SYS_DMA_INTERRUPT_MODE                  true
+
 // *****************************************************************************
 /* Clock System Service Configuration Options
 */
@@ -259,7 +264,9 @@ extern "C" {
 #define DRV_USART_INIT_FLAG_STOP_IN_IDLE_IDX0       false
 #define DRV_USART_INIT_FLAGS_IDX0                   0
 #define DRV_USART_BRG_CLOCK_IDX0                    40000000
-#define DRV_USART_BAUD_RATE_IDX0                    115200
+// NOTE: With BRGH set 921600 baud is 909090 actual (-1.4% error), which is
+// well within what USB-UART bridges accept.
+#define DRV_USART_BAUD_RATE_IDX0                    921600
 #define DRV_USART_LINE_CNTRL_IDX0                   DRV_USART_LINE_CONTROL_8NONE1
 #define DRV_USART_HANDSHAKE_MODE_IDX0               DRV_USART_HANDSHAKE_NONE
 #define DRV_USART_XMIT_INT_SRC_IDX0                 INT_SOURCE_USART_1_TRANSMIT
@@ -269,6 +276,15 @@ extern "C" {
 #define DRV_USART_INT_PRIORITY_IDX0                 INT_PRIORITY_LEVEL1
 #define DRV_USART_INT_SUB_PRIORITY_IDX0             INT_SUBPRIORITY_LEVEL0
 
+// Transmit goes via DMA, so every queued console buffer costs one DMA
+// interrupt instead of one UART interrupt per byte.
+#define DRV_USART_SUPPORT_TRANSMIT_DMA
+#define DRV_USART_XMIT_DMA_CH_IDX0                  DMA_CHANNEL_0
+#define DRV_USART_XMIT_DMA_INT_SRC_IDX0             INT_SOURCE_DMA_0
+#define DRV_USART_XMIT_DMA_INT_VECTOR_IDX0          INT_VECTOR_DMA0
+#define DRV_USART_XMIT_DMA_INT_PRIORITY_IDX0        INT_PRIORITY_LEVEL1
+#define DRV_USART_XMIT_DMA_INT_SUB_PRIORITY_IDX0    INT_SUBPRIORITY_LEVEL1
+
 #define DRV_USART_XMIT_QUEUE_SIZE_IDX0              10
 #define DRV_USART_RCV_QUEUE_SIZE_IDX0               10
 
@@ -341,6 +357,44 @@ extern "C" {
 #define NET_PRES_NUM_INSTANCE 1
 #define NET_PRES_NUM_SOCKETS 10
 
+/*** wolfSSL TLS Layer Configuration ***/
+/* Picked up by wolfSSL sources through user_settings.h. */
+#define MICROCHIP_PIC32
+#define MICROCHIP_TCPIP
+#define WOLFSSL_USER_IO
+#define NO_FILESYSTEM
+#define NO_WRITEV
+#define NO_DEV_RANDOM
+#define NO_MAIN_DRIVER
+#define SINGLE_THREADED
+#define SIZEOF_LONG_LONG 8
+#define WOLFSSL_SMALL_STACK
+#define NO_ERROR_STRINGS
+/* TLS 1.2 with pre-shared keys only: no certificates and no public key
+ * math, which takes seconds per handshake on this core. */
+#define WOLFSSL_STATIC_PSK
+#define NO_CERTS
+#define NO_RSA
+#define NO_DH
+#define NO_DSA
+#define NO_OLD_TLS
+#define NO_MD4
+#define NO_MD5
+#define NO_DES3
+#define NO_RC4
+#define NO_HC128
+#define NO_RABBIT
+#define NO_PWDBASED
+#define HAVE_AESGCM
+#define GCM_SMALL
+/* Session resumption: server side session ID cache and session tickets,
+ * client side cache of sessions by server. Tickets are protected with
+ * the application's ChaCha20-Poly1305 (app_crypto), so wolfCrypt doesn't
+ * need its own. */
+#define SMALL_SESSION_CACHE
+#define HAVE_TLS_EXTENSIONS
+#define HAVE_SESSION_TICKET
+
 
 
 // *****************************************************************************
@@ -362,6 +416,7 @@ extern "C" {
 #define TCPIP_STACK_IF_UP_DOWN_OPERATION   true
 #define TCPIP_STACK_MAC_DOWN_OPERATION  true
 #define TCPIP_STACK_CONFIGURATION_SAVE_RESTORE   true
+#define TCPIP_STACK_EXTERN_PACKET_PROCESS   true
 /*** TCPIP Heap Configuration ***/
 #define TCPIP_STACK_USE_INTERNAL_HEAP
 #define TCPIP_STACK_DRAM_SIZE                       42000
@@ -485,11 +540,11 @@ extern "C" {
 
 /*** TCPIP MAC Configuration ***/
 #define TCPIP_EMAC_TX_DESCRIPTORS				8
-#define TCPIP_EMAC_RX_DESCRIPTORS				10
+#define TCPIP_EMAC_RX_DESCRIPTORS				16
 #define TCPIP_EMAC_RX_DEDICATED_BUFFERS				4
 #define TCPIP_EMAC_RX_INIT_BUFFERS				    0
-#define TCPIP_EMAC_RX_LOW_THRESHOLD				    1
-#define TCPIP_EMAC_RX_LOW_FILL				        2
+#define TCPIP_EMAC_RX_LOW_THRESHOLD				    3
+#define TCPIP_EMAC_RX_LOW_FILL				        6
 #define TCPIP_EMAC_RX_BUFF_SIZE		    			1536
 #define TCPIP_EMAC_RX_MAX_FRAME		    			1536
 #define TCPIP_EMAC_RX_FILTERS                       \
@@ -606,7 +661,8 @@ extern "C" {
 													TCPIP_NETWORK_CONFIG_DHCP_CLIENT_ON |\
 													TCPIP_NETWORK_CONFIG_DNS_CLIENT_ON |\
 													TCPIP_NETWORK_CONFIG_IP_STATIC
-#define TCPIP_NETWORK_DEFAULT_MAC_DRIVER			DRV_ETHMAC_PIC32MACObject
+/* Driver's MAC object with receive checksums kept, see app_ethmac.h */
+#define TCPIP_NETWORK_DEFAULT_MAC_DRIVER			APP_ETHMAC_MACObject
 #define TCPIP_NETWORK_DEFAULT_IPV6_ADDRESS			0
 #define TCPIP_NETWORK_DEFAULT_IPV6_PREFIX_LENGTH	0
 #define TCPIP_NETWORK_DEFAULT_IPV6_GATEWAY			0
@@ -730,6 +786,61 @@ extern "C" {
 
 /*** Application Instance 0 Configuration ***/
 
+/*** Interrupt Shadow Register Set ***/
+/* PIC32MX has a single shadow register set, FSRSSEL gives it to every
+   interrupt of one priority level. Handlers of that level are declared
+   IPLxSRS and don't save general purpose registers in software, handlers of
+   other levels stay IPLxAUTO. A handler must be declared with APP_ISR_IPLx
+   of the level its vector is configured at, otherwise it runs on the wrong
+   register set.
+
+   Level 5 is Ethernet and its coalescing timer, which are the hottest
+   handlers under packet floods. 0 leaves the shadow set unused. */
+#define APP_ISR_SRS_PRIORITY_LEVEL          5
+
+#if APP_ISR_SRS_PRIORITY_LEVEL == 1
+#define APP_ISR_IPL1                        IPL1SRS
+#else
+#define APP_ISR_IPL1                        IPL1AUTO
+#endif
+#if APP_ISR_SRS_PRIORITY_LEVEL == 2
+#define APP_ISR_IPL2                        IPL2SRS
+#else
+#define APP_ISR_IPL2                        IPL2AUTO
+#endif
+#if APP_ISR_SRS_PRIORITY_LEVEL == 3
+#define APP_ISR_IPL3                        IPL3SRS
+#else
+#define APP_ISR_IPL3                        IPL3AUTO
+#endif
+#if APP_ISR_SRS_PRIORITY_LEVEL == 4
+#define APP_ISR_IPL4                        IPL4SRS
+#else
+#define APP_ISR_IPL4                        IPL4AUTO
+#endif
+#if APP_ISR_SRS_PRIORITY_LEVEL == 5
+#define APP_ISR_IPL5                        IPL5SRS
+#else
+#define APP_ISR_IPL5                        IPL5AUTO
+#endif
+#if APP_ISR_SRS_PRIORITY_LEVEL == 6
+#define APP_ISR_IPL6                        IPL6SRS
+#else
+#define APP_ISR_IPL6                        IPL6AUTO
+#endif
+#if APP_ISR_SRS_PRIORITY_LEVEL == 7
+#define APP_ISR_IPL7                        IPL7SRS
+#else
+#define APP_ISR_IPL7                        IPL7AUTO
+#endif
+
+/* DEVCFG3 as programmed, through KSEG1, FSRSSEL is its bits 18:16.
+   SYS_Initialize halts before enabling interrupts when it doesn't match
+   APP_ISR_SRS_PRIORITY_LEVEL. */
+#define APP_ISR_DEVCFG3_ADDRESS             0xBFC02FF0
+#define APP_ISR_FSRSSEL_MASK                0x00070000
+#define APP_ISR_FSRSSEL_POSITION            16
+
 //DOM-IGNORE-BEGIN
 #ifdef __cplusplus
 }
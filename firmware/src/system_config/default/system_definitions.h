@@ -54,6 +54,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "system/common/sys_module.h"
 #include "system/devcon/sys_devcon.h"
 #include "system/clk/sys_clk.h"
+#include "system/dma/sys_dma.h"
 #include "system/int/sys_int.h"
 #include "system/console/sys_console.h"
 #include "system/random/sys_random.h"
@@ -113,6 +114,7 @@ extern "C" {
 
 typedef struct
 {
+    SYS_MODULE_OBJ  sysDma;
     SYS_MODULE_OBJ  sysTmr;
     SYS_MODULE_OBJ  drvTmr0;
     SYS_MODULE_OBJ  drvUsart0;
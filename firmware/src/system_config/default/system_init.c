@@ -46,8 +46,13 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 // *****************************************************************************
 // *****************************************************************************
 
+#include <stdio.h>
 #include "system_config.h"
 #include "system_definitions.h"
+#include "app_profile.h"
+#include "app_ethmac.h"
+#include "app_kv.h"
+#include "app_network.h"
 
 
 // ****************************************************************************
@@ -86,7 +91,25 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /*** DEVCFG3 ***/
 
 #pragma config USERID =     0xffff
+#if APP_ISR_SRS_PRIORITY_LEVEL == 0
+#pragma config FSRSSEL =    PRIORITY_0
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 1
+#pragma config FSRSSEL =    PRIORITY_1
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 2
+#pragma config FSRSSEL =    PRIORITY_2
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 3
+#pragma config FSRSSEL =    PRIORITY_3
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 4
+#pragma config FSRSSEL =    PRIORITY_4
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 5
+#pragma config FSRSSEL =    PRIORITY_5
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 6
+#pragma config FSRSSEL =    PRIORITY_6
+#elif APP_ISR_SRS_PRIORITY_LEVEL == 7
 #pragma config FSRSSEL =    PRIORITY_7
+#else
+#error "APP_ISR_SRS_PRIORITY_LEVEL must be 0..7"
+#endif
 #pragma config FMIIEN =     OFF
 #pragma config FETHIO =     ON
 #pragma config FCANIO =     OFF
@@ -158,12 +181,20 @@ const DRV_USART_INIT drvUsart0InitData =
     .interruptError = DRV_USART_ERR_INT_SRC_IDX0,
     .queueSizeTransmit = DRV_USART_XMIT_QUEUE_SIZE_IDX0,
     .queueSizeReceive = DRV_USART_RCV_QUEUE_SIZE_IDX0,
-    .dmaChannelTransmit = DMA_CHANNEL_NONE,
-    .dmaInterruptTransmit = DRV_USART_XMIT_INT_SRC_IDX0,    
+    .dmaChannelTransmit = DRV_USART_XMIT_DMA_CH_IDX0,
+    .dmaInterruptTransmit = DRV_USART_XMIT_DMA_INT_SRC_IDX0,    
     .dmaChannelReceive = DMA_CHANNEL_NONE,
     .dmaInterruptReceive = DRV_USART_RCV_INT_SRC_IDX0,    
 };
 // </editor-fold>
+// <editor-fold defaultstate="collapsed" desc="SYS_DMA Initialization Data">
+/*** System DMA Initialization Data ***/
+
+const SYS_DMA_INIT sysDmaInit =
+{
+    .sidl = SYS_DMA_SIDL_DISABLE,
+};
+// </editor-fold>
 // <editor-fold defaultstate="collapsed" desc="DRV_USB Initialization Data">
 /******************************************************
  * USB Driver Initialization
@@ -307,6 +338,38 @@ static const NET_PRES_TransportObject netPresTransObject0DC = {
     .fpReadyToWrite      = (NET_PRES_TransReady)TCPIP_UDP_PutIsReady,
     .fpIsPortDefaultSecure = (NET_PRES_TransIsPortDefaultSecured)TCPIP_Helper_UDPSecurePortGet,
 };
+static const NET_PRES_EncProviderObject net_pres_EncProviderStreamServer0 =
+{
+    .fpInit =    NET_PRES_EncProviderStreamServerInit0,
+    .fpDeinit =  NET_PRES_EncProviderStreamServerDeinit0,
+    .fpOpen =    NET_PRES_EncProviderStreamServerOpen0,
+    .fpConnect = NET_PRES_EncProviderServerAccept0,
+    .fpClose =   NET_PRES_EncProviderConnectionClose0,
+    .fpWrite =   NET_PRES_EncProviderWrite0,
+    .fpWriteReady = NET_PRES_EncProviderWriteReady0,
+    .fpRead =    NET_PRES_EncProviderRead0,
+    .fpReadReady = NET_PRES_EncProviderReadReady0,
+    .fpPeek =    NET_PRES_EncProviderPeek0,
+    .fpIsInited = NET_PRES_EncProviderStreamServerIsInited0,
+    .fpOutputSize = NET_PRES_EncProviderOutputSize0,
+    .fpMaxOutputSize = NET_PRES_EncProviderMaxOutputSize0,
+};
+static const NET_PRES_EncProviderObject net_pres_EncProviderStreamClient0 =
+{
+    .fpInit =    NET_PRES_EncProviderStreamClientInit0,
+    .fpDeinit =  NET_PRES_EncProviderStreamClientDeinit0,
+    .fpOpen =    NET_PRES_EncProviderStreamClientOpen0,
+    .fpConnect = NET_PRES_EncProviderClientConnect0,
+    .fpClose =   NET_PRES_EncProviderConnectionClose0,
+    .fpWrite =   NET_PRES_EncProviderWrite0,
+    .fpWriteReady = NET_PRES_EncProviderWriteReady0,
+    .fpRead =    NET_PRES_EncProviderRead0,
+    .fpReadReady = NET_PRES_EncProviderReadReady0,
+    .fpPeek =    NET_PRES_EncProviderPeek0,
+    .fpIsInited = NET_PRES_EncProviderStreamClientIsInited0,
+    .fpOutputSize = NET_PRES_EncProviderOutputSize0,
+    .fpMaxOutputSize = NET_PRES_EncProviderMaxOutputSize0,
+};
 static const NET_PRES_INST_DATA netPresCfgs[] = 
 {
     {
@@ -314,8 +377,8 @@ static const NET_PRES_INST_DATA netPresCfgs[] =
         .pTransObject_sc = &netPresTransObject0SC,
         .pTransObject_ds = &netPresTransObject0DS,
         .pTransObject_dc = &netPresTransObject0DC,
-        .pProvObject_ss = NULL,
-        .pProvObject_sc = NULL,
+        .pProvObject_ss = &net_pres_EncProviderStreamServer0,
+        .pProvObject_sc = &net_pres_EncProviderStreamClient0,
         .pProvObject_ds = NULL,
         .pProvObject_dc = NULL,
     },
@@ -598,10 +661,15 @@ const TCPIP_STACK_MODULE_CONFIG TCPIP_STACK_MODULE_CONFIG_TBL [] =
 SYS_MODULE_OBJ TCPIP_STACK_Init()
 {
     TCPIP_STACK_INIT    tcpipInit;
+    /* Configuration saved to the key-value store overrides the defaults */
+    static TCPIP_NETWORK_CONFIG netConfig[sizeof (TCPIP_HOSTS_CONFIGURATION) / sizeof (*TCPIP_HOSTS_CONFIGURATION)];
 
+    /* Internal MAC runs on a copy of the driver object, see app_ethmac.h */
+    APP_ETHMAC_MACObjectInitialize();
     tcpipInit.moduleInit.sys.powerState = SYS_MODULE_POWER_RUN_FULL;
-    tcpipInit.pNetConf = TCPIP_HOSTS_CONFIGURATION;
     tcpipInit.nNets = sizeof (TCPIP_HOSTS_CONFIGURATION) / sizeof (*TCPIP_HOSTS_CONFIGURATION);
+    APP_Network_ConfigRestore(netConfig, TCPIP_HOSTS_CONFIGURATION, tcpipInit.nNets);
+    tcpipInit.pNetConf = netConfig;
     tcpipInit.pModConfig = TCPIP_STACK_MODULE_CONFIG_TBL;
     tcpipInit.nModules = sizeof (TCPIP_STACK_MODULE_CONFIG_TBL) / sizeof (*TCPIP_STACK_MODULE_CONFIG_TBL);
 
@@ -883,15 +951,66 @@ const USB_DEVICE_INIT usbDevInitData =
     See prototype in system/common/sys_module.h.
  */
 
+/* Write the message straight into the console UART, busy waiting for room:
+   interrupts are still disabled, so the buffered console would never send
+   it. */
+static void SYS_SRS_ConsoleWrite ( const char * message )
+{
+    while (*message != '\0')
+    {
+        while (PLIB_USART_TransmitterBufferIsFull(DRV_USART_PERIPHERAL_ID_IDX0))
+        {
+        }
+        PLIB_USART_TransmitterByteSend(DRV_USART_PERIPHERAL_ID_IDX0, *message++);
+    }
+    while (!PLIB_USART_TransmitterIsEmpty(DRV_USART_PERIPHERAL_ID_IDX0))
+    {
+    }
+}
+
+/* Handlers of APP_ISR_SRS_PRIORITY_LEVEL are declared IPLxSRS and don't save
+   general purpose registers: at a level which doesn't own the shadow set
+   they corrupt the code they interrupt. FSRSSEL comes from the configuration
+   words actually programmed, which the pragma above only sets when the whole
+   device is programmed from this build. */
+static void SYS_SRS_ConfigCheck ( void )
+{
+    const uint32_t devcfg3 = *(const volatile uint32_t *)APP_ISR_DEVCFG3_ADDRESS;
+    const int level = (devcfg3 & APP_ISR_FSRSSEL_MASK) >> APP_ISR_FSRSSEL_POSITION;
+    char message[80];
+
+    if (level == APP_ISR_SRS_PRIORITY_LEVEL)
+    {
+        return;
+    }
+    snprintf(message, sizeof(message),
+             "\r\nSYS: Shadow register set is at level %d, handlers "
+             "expect level %d, halted\r\n",
+             level, APP_ISR_SRS_PRIORITY_LEVEL);
+    SYS_SRS_ConsoleWrite(message);
+    /* Interrupts are never enabled. */
+    while (true)
+    {
+        SYS_DEBUG_BreakPoint();
+    }
+}
+
 void SYS_Initialize ( void* data )
 {
     /* Core Processor Initialization */
     SYS_CLK_Initialize( NULL );
+    APP_Profile_BootMark(APP_BOOT_CLOCK_READY);
     SYS_DEVCON_Initialize(SYS_DEVCON_INDEX_0, (SYS_MODULE_INIT*)NULL);
     SYS_DEVCON_PerformanceConfig(SYS_CLK_SystemFrequencyGet());
     SYS_DEVCON_JTAGDisable();
     SYS_PORTS_Initialize();
 
+    /*** System DMA Initialization Code ***/
+    sysObj.sysDma = SYS_DMA_Initialize((SYS_MODULE_INIT *)&sysDmaInit);
+    SYS_INT_VectorPrioritySet(DRV_USART_XMIT_DMA_INT_VECTOR_IDX0, DRV_USART_XMIT_DMA_INT_PRIORITY_IDX0);
+    SYS_INT_VectorSubprioritySet(DRV_USART_XMIT_DMA_INT_VECTOR_IDX0, DRV_USART_XMIT_DMA_INT_SUB_PRIORITY_IDX0);
+    SYS_INT_SourceEnable(DRV_USART_XMIT_DMA_INT_SRC_IDX0);
+
     /* Initialize Drivers */
 
     /*** SPI Driver Index 0 initialization***/
@@ -942,6 +1061,11 @@ void SYS_Initialize ( void* data )
     /*** TMR Service Initialization Code ***/
     sysObj.sysTmr  = SYS_TMR_Initialize(SYS_TMR_INDEX_0, (const SYS_MODULE_INIT  * const)&sysTmrInitData);
   
+    APP_Profile_BootMark(APP_BOOT_DRIVERS_READY);
+
+    /* Key-value store, holds configuration of the middleware */
+    APP_KV_Initialize();
+
     /* Initialize Middleware */
     sysObj.netPres = NET_PRES_Initialize(0, (SYS_MODULE_INIT*)&netPresInitData);
 
@@ -952,6 +1076,7 @@ void SYS_Initialize ( void* data )
     SYS_INT_VectorSubprioritySet(INT_VECTOR_ETH, INT_SUBPRIORITY_LEVEL0);
     
     /* TCPIP Stack Initialization */
+    APP_Profile_BootMark(APP_BOOT_TCPIP_INIT);
     sysObj.tcpip = TCPIP_STACK_Init();
     SYS_ASSERT(sysObj.tcpip != SYS_MODULE_OBJ_INVALID, "TCPIP_STACK_Init Failed" );
 
@@ -965,8 +1090,13 @@ void SYS_Initialize ( void* data )
     /* Initialize the USB device layer */
     sysObj.usbDevObject0 = USB_DEVICE_Initialize (USB_DEVICE_INDEX_0 , ( SYS_MODULE_INIT* ) & usbDevInitData);
 
+    /* Refuse to run handlers on the wrong register set */
+    SYS_SRS_ConfigCheck();
+
     /* Enable Global Interrupts */
     SYS_INT_Enable();
+
+    APP_Profile_BootMark(APP_BOOT_SYS_INIT_DONE);
 }
 
 
@@ -61,6 +61,10 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 #include "system/common/sys_common.h"
 #include "app.h"
+#include "app_ethmac.h"
+#include "app_irq_latency.h"
+#include "app_stack.h"
+#include "app_trace.h"
 #include "system_definitions.h"
 
 // *****************************************************************************
@@ -68,22 +72,39 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 // Section: System Interrupt Vector Functions
 // *****************************************************************************
 // *****************************************************************************
-void __ISR(_EXTERNAL_4_VECTOR, IPL3AUTO) _IntHandlerExternalInterruptInstance0(void)
+void __ISR(_EXTERNAL_4_VECTOR, APP_ISR_IPL3) _IntHandlerExternalInterruptInstance0(void)
 {
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_WIFI);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_WIFI);
     PLIB_INT_SourceFlagClear(INT_ID_0, INT_SOURCE_EXTERNAL_4);
     DRV_WIFI_MRF24W_ISR((SYS_MODULE_OBJ)0);
+    APP_TRACE_END(APP_TRACE_ISR_WIFI);
 }
 
     
-void __ISR(_TIMER_2_VECTOR, ipl4AUTO) IntHandlerDrvTmrInstance0(void)
+void __ISR(_TIMER_2_VECTOR, APP_ISR_IPL4) IntHandlerDrvTmrInstance0(void)
 {
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_TMR2);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_TMR2);
     DRV_TMR_Tasks(sysObj.drvTmr0);
+    APP_TRACE_END(APP_TRACE_ISR_TMR2);
 }
- void __ISR(_UART_1_VECTOR, ipl1AUTO) _IntHandlerDrvUsartInstance0(void)
+ void __ISR(_UART_1_VECTOR, APP_ISR_IPL1) _IntHandlerDrvUsartInstance0(void)
 {
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_UART1);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_UART1);
     DRV_USART_TasksTransmit(sysObj.drvUsart0);
     DRV_USART_TasksError(sysObj.drvUsart0);
     DRV_USART_TasksReceive(sysObj.drvUsart0);
+    APP_TRACE_END(APP_TRACE_ISR_UART1);
+}
+
+void __ISR(_DMA0_VECTOR, APP_ISR_IPL1) _IntHandlerSysDmaCh0(void)
+{
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_DMA0);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_DMA0);
+    SYS_DMA_TasksISR(sysObj.sysDma, DMA_CHANNEL_0);
+    APP_TRACE_END(APP_TRACE_ISR_DMA0);
 }
  
  
@@ -102,16 +123,46 @@ void __ISR(_TIMER_2_VECTOR, ipl4AUTO) IntHandlerDrvTmrInstance0(void)
 	
 	
 	
-void __ISR(_USB_1_VECTOR, ipl4AUTO) _IntHandlerUSBInstance0(void)
+void __ISR(_USB_1_VECTOR, APP_ISR_IPL4) _IntHandlerUSBInstance0(void)
 {
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_USB);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_USB);
     DRV_USBFS_Tasks_ISR(sysObj.drvUSBObject);
+    APP_TRACE_END(APP_TRACE_ISR_USB);
 }
 
 
 
-void __ISR(_ETH_VECTOR, ipl5AUTO) _IntHandler_ETHMAC(void)
+void __ISR(_ETH_VECTOR, APP_ISR_IPL5) _IntHandler_ETHMAC(void)
+{
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_ETH);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_ETH);
+    if (APP_ETHMAC_ISR())
+    {
+        DRV_ETHMAC_Tasks_ISR((SYS_MODULE_OBJ)0);
+    }
+    APP_TRACE_END(APP_TRACE_ISR_ETH);
+}
+
+void __ISR(_TIMER_3_VECTOR, APP_ISR_IPL5) _IntHandler_ETHMACCoalesce(void)
+{
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_ETH_COALESCE);
+    APP_TRACE_BEGIN(APP_TRACE_ISR_ETH_COALESCE);
+    APP_ETHMAC_TimerISR();
+    APP_TRACE_END(APP_TRACE_ISR_ETH_COALESCE);
+}
+
+/* Latency probe changes its priority at runtime. The prologue raises IPL to
+   the requested level taken from Cause.RIPL, and AUTO checks which register
+   set is in use, so the declared level only matters for the vector. Timer
+   counter and EPC are read first, and the handler is not traced as a slice
+   to keep the probe cheap and the trace ring free of it. */
+void __ISR(_TIMER_4_VECTOR, IPL7AUTO) _IntHandler_IRQLatency(void)
 {
-    DRV_ETHMAC_Tasks_ISR((SYS_MODULE_OBJ)0);
+    const uint32_t ticks = PLIB_TMR_Counter16BitGet(APP_IRQ_LATENCY_TIMER_ID);
+    const uint32_t epc = _CP0_GET_EPC();
+    APP_STACK_ISR_SAMPLE(APP_STACK_ISR_IRQ_LATENCY);
+    APP_IRQ_Latency_ISR(ticks, epc);
 }
 
 /* This function is used by ETHMAC driver */
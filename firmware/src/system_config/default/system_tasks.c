@@ -53,6 +53,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 #include "system_config.h"
 #include "system_definitions.h"
+#include "app_trace.h"
 
 
 // *****************************************************************************
@@ -84,14 +85,18 @@ void SYS_Tasks ( void )
     /* Maintain Middleware & Other Libraries */
     NET_PRES_Tasks(sysObj.netPres);
     /* Maintain the TCP/IP Stack*/
+    APP_TRACE_BEGIN(APP_TRACE_TASK_TCPIP);
     TCPIP_STACK_Task(sysObj.tcpip);
+    APP_TRACE_END(APP_TRACE_TASK_TCPIP);
 
  
     /* USB FS Driver Task Routine */ 
      DRV_USBFS_Tasks(sysObj.drvUSBObject);
      
     /* USB Device layer tasks routine */ 
+    APP_TRACE_BEGIN(APP_TRACE_TASK_USB_DEVICE);
     USB_DEVICE_Tasks(sysObj.usbDevObject0);
+    APP_TRACE_END(APP_TRACE_TASK_USB_DEVICE);
 
 }
 
@@ -0,0 +1,29 @@
+/*******************************************************************************
+  wolfSSL User Settings
+
+  File Name:
+    user_settings.h
+
+  Summary:
+    wolfSSL build options, included by wolfSSL when WOLFSSL_USER_SETTINGS is
+    defined.
+
+  Description:
+    Options themselves live in the wolfSSL section of system_config.h, this
+    file only adds what wolfSSL needs from the application.
+*******************************************************************************/
+
+#ifndef _USER_SETTINGS_H
+#define _USER_SETTINGS_H
+
+#include "system_config.h"
+
+/* Harmony port of wolfSSL: PIC32 specific code paths of wolfCrypt. */
+#define MICROCHIP_MPLAB_HARMONY
+
+/* There is no hardware RNG, DRBG seed comes from ADC clock jitter mixed with
+   a seed kept in the KV store, see app_entropy.h. */
+int APP_Entropy_Seed(unsigned char* output, unsigned int size);
+#define CUSTOM_RAND_GENERATE_SEED APP_Entropy_Seed
+
+#endif // _USER_SETTINGS_H
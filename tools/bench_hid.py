@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+
+# Host side latency benchmark of the HID bridge priority lanes.
+#
+# Floods the bridge with bulk reports and measures how long control reports
+# sent in between take to come out on the other side, in both directions:
+#
+#   up:   USB HID OUT report -> board -> bridge TCP subscriber
+#   down: bridge TCP client -> board -> USB HID IN report
+#
+# Down direction sends control records over a connection of their own, so
+# they don't queue behind bulk ones in the TCP stream. With --no-lanes probes
+# go without the control flag, which shows latency of a single shared queue
+# for comparison.
+#
+# Needs the board connected over USB and the cython-hidapi module.
+#
+# Usage:
+#   bench_hid.py --host 192.168.1.20
+#   bench_hid.py --host 192.168.1.20 --direction up --no-lanes
+
+import argparse
+import socket
+import struct
+import sys
+import threading
+import time
+
+import hid
+
+from hid_bridge_client import (BRIDGE_PORT, CONTROL_FLAG, FLAG_COMPRESSED,
+                               LANE_BULK, LANE_CONTROL, MAGIC, VERSION,
+                               Decompressor, RecordParser, frame,
+                               read_exactly)
+
+VENDOR_ID = 0x04d8
+PRODUCT_ID = 0x003f
+REPORT_SIZE = 64
+
+# First byte of bulk and probe reports, control flag is added to the latter.
+BULK_MARKER = 0x01
+PROBE_MARKER = 0x02
+PROBE = struct.Struct('<BI')
+
+
+def make_report(marker, number):
+    return PROBE.pack(marker, number).ljust(REPORT_SIZE, b'\0')
+
+
+def probe_marker(args):
+    return PROBE_MARKER | (0 if args.no_lanes else CONTROL_FLAG)
+
+
+def connect(args):
+    connection = socket.create_connection((args.host, args.port))
+    connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    preamble = read_exactly(connection, 6)
+    if preamble[:4] != MAGIC or preamble[4] != VERSION:
+        raise RuntimeError('Unexpected preamble {}'.format(preamble.hex()))
+    return connection, bool(preamble[5] & FLAG_COMPRESSED)
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+def report_latency(direction, latencies, num_bulk, duration, num_probes):
+    if not latencies:
+        print('BENCH ERROR direction={} reason=no_probes'.format(direction))
+        return
+    latencies_us = [int(latency * 1000000) for latency in latencies]
+    print('BENCH HID direction={} probes={} lost={} p50_us={} p99_us={} '
+          'max_us={} bulk_kbps={}'.format(
+              direction, len(latencies_us), num_probes - len(latencies_us),
+              percentile(latencies_us, 0.5), percentile(latencies_us, 0.99),
+              max(latencies_us),
+              int(num_bulk * REPORT_SIZE * 8 / duration / 1000)))
+
+
+def bench_up(args, device):
+    """Bulk and probe OUT reports, probes are timed on a bridge subscriber."""
+    connection, is_compressed = connect(args)
+    decompressor = Decompressor() if is_compressed else None
+    parser = RecordParser()
+    marker = probe_marker(args)
+    sent = {}
+    latencies = []
+    is_running = True
+
+    def receive():
+        while is_running:
+            data = connection.recv(65536)
+            if not data:
+                break
+            now = time.perf_counter()
+            if decompressor is not None:
+                data = decompressor.feed(data)
+            for _, _, payload in parser.feed(data):
+                if not payload or payload[0] != marker:
+                    continue
+                number = PROBE.unpack_from(payload)[1]
+                if number in sent:
+                    latencies.append(now - sent.pop(number))
+
+    receiver = threading.Thread(target=receive, daemon=True)
+    receiver.start()
+    num_bulk = num_probes = 0
+    start = time.perf_counter()
+    next_probe = start + args.interval
+    while time.perf_counter() - start < args.duration:
+        now = time.perf_counter()
+        if now >= next_probe:
+            sent[num_probes] = now
+            # Report ID 0, the descriptor has no report IDs.
+            device.write(b'\0' + make_report(marker, num_probes))
+            num_probes += 1
+            next_probe = now + args.interval
+        else:
+            device.write(b'\0' + make_report(BULK_MARKER, num_bulk))
+            num_bulk += 1
+    time.sleep(1)
+    is_running = False
+    connection.close()
+    report_latency('up', latencies, num_bulk, args.duration, num_probes)
+
+
+def bench_down(args, device):
+    """Bulk and probe records to the bridge, probes are timed on USB IN."""
+    bulk_connection, _ = connect(args)
+    probe_connection, _ = connect(args)
+    probe_lane = LANE_BULK if args.no_lanes else LANE_CONTROL
+    marker = probe_marker(args)
+    sent = {}
+    latencies = []
+    num_bulk = [0]
+    is_running = True
+
+    def send_bulk():
+        while is_running:
+            bulk_connection.sendall(frame(
+                LANE_BULK, num_bulk[0], make_report(BULK_MARKER, num_bulk[0])))
+            num_bulk[0] += 1
+
+    def receive():
+        while is_running:
+            report = bytes(device.read(REPORT_SIZE, 100))
+            if not report or report[0] != marker:
+                continue
+            number = PROBE.unpack_from(report)[1]
+            if number in sent:
+                latencies.append(time.perf_counter() - sent.pop(number))
+
+    threads = [threading.Thread(target=send_bulk, daemon=True),
+               threading.Thread(target=receive, daemon=True)]
+    for thread in threads:
+        thread.start()
+    num_probes = 0
+    start = time.perf_counter()
+    while time.perf_counter() - start < args.duration:
+        time.sleep(args.interval)
+        sent[num_probes] = time.perf_counter()
+        probe_connection.sendall(frame(probe_lane, num_probes,
+                                       make_report(marker, num_probes)))
+        num_probes += 1
+    time.sleep(1)
+    is_running = False
+    # Bulk records queued in the socket are not delivered in time, the count
+    # is of what the bridge accepted.
+    report_latency('down', latencies, num_bulk[0], args.duration, num_probes)
+    bulk_connection.close()
+    probe_connection.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Measure control latency of the HID bridge under bulk load')
+    parser.add_argument('--host', required=True, help='Address of the board')
+    parser.add_argument('--port', type=int, default=BRIDGE_PORT)
+    parser.add_argument('--direction', choices=('up', 'down', 'both'),
+                        default='both')
+    parser.add_argument('--duration', type=int, default=10,
+                        help='Duration of every direction, seconds')
+    parser.add_argument('--interval', type=float, default=0.05,
+                        help='Interval between control probes, seconds')
+    parser.add_argument('--no-lanes', action='store_true',
+                        help='Send probes as bulk reports')
+    args = parser.parse_args()
+
+    device = hid.device()
+    device.open(VENDOR_ID, PRODUCT_ID)
+    try:
+        if args.direction in ('up', 'both'):
+            bench_up(args, device)
+        if args.direction in ('down', 'both'):
+            bench_down(args, device)
+    finally:
+        device.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+# HTTP load generator for the board's status server.
+#
+# Every worker keeps one persistent connection and issues requests back to
+# back, reports requests per second and latency percentiles.
+#
+# Usage:
+#   bench_http.py --host 192.168.1.20
+#   bench_http.py --host 192.168.1.20 --path /api/stats --connections 2
+
+import argparse
+import http.client
+import sys
+import threading
+import time
+
+
+def worker(args, deadline, latencies, errors):
+    connection = None
+    while time.time() < deadline:
+        try:
+            if connection is None:
+                connection = http.client.HTTPConnection(
+                    args.host, args.port, timeout=5)
+            start = time.perf_counter()
+            connection.request('GET', args.path,
+                               headers={'Accept-Encoding': 'gzip'})
+            response = connection.getresponse()
+            response.read()
+            latencies.append(time.perf_counter() - start)
+            if response.status != 200:
+                errors.append(response.status)
+            if response.will_close:
+                connection.close()
+                connection = None
+        except (OSError, http.client.HTTPException) as e:
+            errors.append(str(e))
+            if connection is not None:
+                connection.close()
+            connection = None
+    if connection is not None:
+        connection.close()
+
+
+def percentile(values, fraction):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark board HTTP server')
+    parser.add_argument('--host', required=True)
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--path', default='/index.htm')
+    parser.add_argument('--connections', type=int, default=2,
+                        help='Number of concurrent keep-alive connections')
+    parser.add_argument('--duration', type=int, default=10,
+                        help='Duration of the test, seconds')
+    args = parser.parse_args()
+
+    latencies = []
+    errors = []
+    deadline = time.time() + args.duration
+    threads = [threading.Thread(target=worker,
+                                args=(args, deadline, latencies, errors))
+               for _ in range(args.connections)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    print('requests: {}'.format(len(latencies)))
+    print('errors: {}'.format(len(errors)))
+    print('requests/s: {:.1f}'.format(len(latencies) / args.duration))
+    for name, fraction in (('p50', 0.5), ('p90', 0.9), ('p99', 0.99)):
+        print('latency {}: {:.2f} ms'.format(
+            name, percentile(latencies, fraction) * 1000))
+    return 0 if not errors else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
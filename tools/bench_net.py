@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+# Host side runner of the board's network benchmark.
+#
+# Runs iperf (version 2) servers for the board's transmit tests, starts iperf
+# clients when the board reports it is ready for receive tests, collects
+# "BENCH RESULT" lines from the console and compares them against a stored
+# baseline.
+#
+# Usage:
+#   bench_net.py --port /dev/ttyUSB0 --peer 192.168.1.10
+#   bench_net.py --port /dev/ttyUSB0 --peer 192.168.1.10 --update-baseline
+#   bench_net.py --port /dev/ttyUSB0 --peer 192.168.1.10 --compare-tuner
+#
+# With --compare-tuner the benchmark runs twice, with the TCP buffer tuner
+# disabled and enabled, and TCP throughput of both runs is reported side by
+# side instead of being compared against the baseline.
+
+import argparse
+import json
+import subprocess
+import sys
+import time
+
+import serial
+
+BOARD_LOCAL_PORT = 5002
+PEER_PORT = 5001
+
+
+def parse_fields(line):
+    fields = {}
+    for token in line.split()[2:]:
+        if '=' in token:
+            key, value = token.split('=', 1)
+            fields[key] = int(value) if value.isdigit() else value
+    return fields
+
+
+def start_client(iperf, fields, duration):
+    command = [iperf, '-c', fields['address'],
+               '-p', str(fields['port']),
+               '-t', str(duration + 2)]
+    if fields['test'] == 'udp_rx':
+        command += ['-u', '-b', '100M']
+    elif fields['test'] == 'udp_pps':
+        command += ['-u', '-l', '64', '-b', '100M']
+    return subprocess.Popen(command,
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.DEVNULL)
+
+
+def run_benchmark(args, setup_commands=()):
+    servers = [
+        subprocess.Popen([args.iperf, '-s', '-p', str(PEER_PORT)],
+                         stdout=subprocess.DEVNULL,
+                         stderr=subprocess.DEVNULL),
+        subprocess.Popen([args.iperf, '-s', '-u', '-p', str(PEER_PORT)],
+                         stdout=subprocess.DEVNULL,
+                         stderr=subprocess.DEVNULL),
+    ]
+    clients = []
+    results = {}
+    try:
+        console = serial.Serial(args.port, args.baud, timeout=1)
+        for command in setup_commands:
+            console.write('{}\r\n'.format(command).encode())
+            time.sleep(0.5)
+        console.reset_input_buffer()
+        console.write('bench net {} {}\r\n'.format(
+            args.peer, args.duration).encode())
+        deadline = time.time() + args.timeout
+        while time.time() < deadline:
+            line = console.readline().decode(errors='replace').strip()
+            if not line.startswith('BENCH '):
+                continue
+            if args.verbose:
+                print(line, file=sys.stderr)
+            kind = line.split()[1]
+            fields = parse_fields(line)
+            if kind == 'READY':
+                clients.append(start_client(args.iperf, fields, args.duration))
+            elif kind == 'RESULT':
+                key = '{}/{}'.format(fields['iface'], fields['test'])
+                results[key] = {'kbps': fields['kbps'], 'cpu': fields['cpu']}
+                for extra in ('us_per_mb', 'pps', 'lost', 'irq'):
+                    if extra in fields:
+                        results[key][extra] = fields[extra]
+            elif kind == 'ERROR':
+                key = '{}/{}'.format(fields['iface'], fields['test'])
+                results[key] = {'error': fields.get('reason', 'unknown')}
+            elif kind == 'DONE':
+                break
+        else:
+            print('Timeout waiting for benchmark to finish', file=sys.stderr)
+    finally:
+        for process in servers + clients:
+            process.terminate()
+    return results
+
+
+def compare(results, baseline, tolerance):
+    is_ok = True
+    for key in sorted(baseline.keys()):
+        expected = baseline[key]
+        actual = results.get(key)
+        if actual is None or 'error' in actual:
+            print('{}: MISSING'.format(key))
+            is_ok = False
+            continue
+        if 'kbps' not in expected:
+            continue
+        threshold = expected['kbps'] * (100 - tolerance) / 100
+        status = 'OK'
+        if actual['kbps'] < threshold:
+            status = 'REGRESSION'
+            is_ok = False
+        print('{}: {} kbps (baseline {} kbps, cpu {}%) {}'.format(
+            key, actual['kbps'], expected['kbps'], actual['cpu'], status))
+    return is_ok
+
+
+def compare_tuner(args):
+    before = run_benchmark(args, ['tcptune off'])
+    after = run_benchmark(args, ['tcptune on'])
+    print('{:<16} {:>14} {:>14} {:>8}'.format('test', 'tuner off, kbps',
+                                               'tuner on, kbps', 'gain'))
+    for key in sorted(set(before) | set(after)):
+        if '/tcp_' not in key:
+            continue
+        off = before.get(key, {}).get('kbps')
+        on = after.get(key, {}).get('kbps')
+        gain = '{:+.0f}%'.format((on - off) * 100 / off) if off and on else '-'
+        print('{:<16} {:>14} {:>14} {:>8}'.format(
+            key, off if off is not None else '-',
+            on if on is not None else '-', gain))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run board network benchmark')
+    parser.add_argument('--port', required=True, help='Console serial port')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--peer', required=True,
+                        help='Address of this host as seen from the board')
+    parser.add_argument('--duration', type=int, default=10,
+                        help='Duration of every test, seconds')
+    parser.add_argument('--timeout', type=int, default=600,
+                        help='Timeout of the whole run, seconds')
+    parser.add_argument('--iperf', default='iperf', help='iperf2 executable')
+    parser.add_argument('--baseline', default='bench_net_baseline.json')
+    parser.add_argument('--update-baseline', action='store_true')
+    parser.add_argument('--tolerance', type=int, default=10,
+                        help='Allowed throughput drop, percent')
+    parser.add_argument('--compare-tuner', action='store_true',
+                        help='Report TCP throughput with tuner off and on')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    if args.compare_tuner:
+        return compare_tuner(args)
+
+    results = run_benchmark(args)
+    print(json.dumps(results, indent=2, sort_keys=True))
+
+    if args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        return 0
+    try:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    except FileNotFoundError:
+        print('No baseline found, run with --update-baseline first',
+              file=sys.stderr)
+        return 1
+    return 0 if compare(results, baseline, args.tolerance) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+
+# Host side benchmark of TLS handshakes with the board.
+#
+# Connects to the board's TLS endpoint with openssl s_client several times:
+# the first connection does a full handshake, the following ones resume its
+# session. Host side time covers process start and connection setup as well,
+# so the same run against a local openssl s_server (--local) gives the floor
+# to compare with. The board reports its own handshake time in the reply.
+#
+# Board needs the same key set with "tls psk <identity> <hex key>".
+#
+# Usage:
+#   bench_tls.py --host 192.168.1.20 --key 00112233445566778899aabbccddeeff
+#   bench_tls.py --local --key 00112233445566778899aabbccddeeff
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+TLS_PORT = 4433
+LOCAL_PORT = 14433
+CIPHERS = 'PSK-AES128-GCM-SHA256:PSK-AES128-CBC-SHA256'
+
+
+def handshake(args, host, port, session_path, is_resumed):
+    """Returns host time, whether session was reused and board time."""
+    command = [args.openssl, 's_client',
+               '-connect', '{}:{}'.format(host, port),
+               '-tls1_2', '-cipher', CIPHERS,
+               '-psk_identity', args.identity, '-psk', args.key,
+               '-sess_out', session_path]
+    if is_resumed:
+        command += ['-sess_in', session_path]
+    start = time.perf_counter()
+    process = subprocess.Popen(command,
+                               stdin=subprocess.PIPE,
+                               stdout=subprocess.PIPE,
+                               stderr=subprocess.DEVNULL,
+                               universal_newlines=True)
+    host_us = None
+    is_reused = False
+    board_us = None
+    try:
+        for line in process.stdout:
+            if host_us is None and re.match(r'^(New|Reused), ', line):
+                host_us = int((time.perf_counter() - start) * 1000000)
+                is_reused = line.startswith('Reused')
+                if args.local:
+                    break
+            match = re.search(r'handshake_us=(\d+)', line)
+            if match:
+                board_us = int(match.group(1))
+                break
+    finally:
+        process.stdin.close()
+        process.wait(timeout=args.timeout)
+    return host_us, is_reused, board_us
+
+
+def median(values):
+    values = sorted(values)
+    return values[len(values) // 2] if values else 0
+
+
+def report(name, results):
+    host = [result[0] for result in results if result[0] is not None]
+    board = [result[2] for result in results if result[2] is not None]
+    print('BENCH TLS mode={} count={} host_us_p50={} host_us_max={} '
+          'board_us_p50={} board_us_max={}'.format(
+              name, len(host), median(host), max(host or [0]),
+              median(board), max(board or [0])))
+
+
+def run(args, host, port):
+    full = []
+    resumed = []
+    num_not_reused = 0
+    with tempfile.TemporaryDirectory() as directory:
+        session_path = os.path.join(directory, 'session.pem')
+        for _ in range(args.count):
+            full.append(handshake(args, host, port, session_path, False))
+            result = handshake(args, host, port, session_path, True)
+            if not result[1]:
+                num_not_reused += 1
+            resumed.append(result)
+    report('full', full)
+    report('resumed', resumed)
+    if num_not_reused:
+        print('{} of {} sessions were not resumed'.format(
+            num_not_reused, args.count), file=sys.stderr)
+        return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure TLS handshake time')
+    parser.add_argument('--host', help='Address of the board')
+    parser.add_argument('--port', type=int, default=TLS_PORT)
+    parser.add_argument('--local', action='store_true',
+                        help='Measure against a local openssl s_server')
+    parser.add_argument('--identity', default='bench')
+    parser.add_argument('--key', required=True, help='Pre-shared key, hex')
+    parser.add_argument('--count', type=int, default=10,
+                        help='Number of full and resumed handshakes')
+    parser.add_argument('--timeout', type=int, default=10)
+    parser.add_argument('--openssl', default='openssl')
+    args = parser.parse_args()
+
+    if not args.local:
+        if not args.host:
+            parser.error('--host or --local is required')
+        return run(args, args.host, args.port)
+    server = subprocess.Popen([args.openssl, 's_server',
+                               '-accept', str(LOCAL_PORT),
+                               '-nocert', '-tls1_2', '-cipher', CIPHERS,
+                               '-psk_identity', args.identity,
+                               '-psk', args.key, '-quiet'],
+                              stdin=subprocess.DEVNULL,
+                              stdout=subprocess.DEVNULL,
+                              stderr=subprocess.DEVNULL)
+    try:
+        time.sleep(0.5)
+        return run(args, '127.0.0.1', LOCAL_PORT)
+    finally:
+        server.terminate()
+
+
+if __name__ == '__main__':
+    sys.exit(main())
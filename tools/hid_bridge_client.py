@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+
+# Receiver of the board's HID bridge stream.
+#
+# Connects to the bridge, decompresses the stream when the board compresses
+# it, and prints received records. Gaps in sequence numbers of every lane are
+# reported as records dropped by the board. Reports given with --send are sent
+# to the board, which forwards them to the USB host, those with the control
+# flag in the first byte go through the control lane of the USB send queue.
+# Records of one connection reach USB in the order they were sent, control
+# records which must not wait behind bulk ones need a connection of their own
+# (see bench_hid.py). With --udp the reports go as datagrams to the same port
+# instead, one record each, which the board parses without copying them.
+#
+# Usage:
+#   hid_bridge_client.py --host 192.168.1.20
+#   hid_bridge_client.py --host 192.168.1.20 --quiet
+#   hid_bridge_client.py --host 192.168.1.20 --send 0102 --send 0103
+#   hid_bridge_client.py --host 192.168.1.20 --udp --send 8001
+#   hid_bridge_client.py --decode stream.bin
+
+import argparse
+import socket
+import struct
+import sys
+
+BRIDGE_PORT = 5003
+MAGIC = b'HIDB'
+VERSION = 2
+FLAG_COMPRESSED = 1 << 0
+HEADER = struct.Struct('<IH')
+FRAME_CONTROL = 0x8000
+
+# Must match app_usb_hid.h.
+CONTROL_FLAG = 0x80
+LANE_CONTROL = 0
+LANE_BULK = 1
+LANE_NAMES = ('control', 'bulk')
+
+# Must match app_compress.h.
+MIN_MATCH = 3
+
+
+class Decompressor:
+    """Streaming decoder of app_compress.h streams.
+
+    Data can be fed in arbitrary pieces, decoder keeps state of the group
+    which is being decoded between calls.
+    """
+
+    def __init__(self):
+        self.history = bytearray()
+        self.pending = bytearray()
+        self.flags = None
+        self.item = 0
+
+    def feed(self, data):
+        self.pending += data
+        output = bytearray()
+        i = 0
+        pending = self.pending
+        while i < len(pending):
+            if self.flags is None:
+                self.flags = pending[i]
+                self.item = 0
+                i += 1
+                continue
+            if not self.flags & (1 << self.item):
+                output.append(pending[i])
+                self.history.append(pending[i])
+                i += 1
+            else:
+                if i + 2 > len(pending):
+                    break
+                value = (pending[i] << 8) | pending[i + 1]
+                i += 2
+                distance = value >> 5
+                length = (value & 31) + MIN_MATCH
+                if distance == 0:
+                    # Sync marker terminates the group.
+                    self.flags = None
+                    continue
+                if distance > len(self.history):
+                    raise ValueError('Match distance is out of history')
+                for _ in range(length):
+                    byte = self.history[-distance]
+                    self.history.append(byte)
+                    output.append(byte)
+            self.item += 1
+            if self.item == 8:
+                self.flags = None
+        del pending[:i]
+        # Only the window is ever referenced.
+        if len(self.history) > 65536:
+            del self.history[:-4096]
+        return bytes(output)
+
+
+def report_lane(report):
+    if report and report[0] & CONTROL_FLAG:
+        return LANE_CONTROL
+    return LANE_BULK
+
+
+def frame(lane, sequence, payload):
+    length = len(payload)
+    if lane == LANE_CONTROL:
+        length |= FRAME_CONTROL
+    return HEADER.pack(sequence & 0xffffffff, length) + payload
+
+
+class RecordParser:
+    """Splits the stream into (lane, sequence, payload) records."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.next_sequence = [None, None]
+        self.num_records = 0
+        self.num_dropped = 0
+
+    def feed(self, data):
+        self.buffer += data
+        records = []
+        while len(self.buffer) >= HEADER.size:
+            sequence, length = HEADER.unpack_from(self.buffer)
+            lane = LANE_CONTROL if length & FRAME_CONTROL else LANE_BULK
+            length &= ~FRAME_CONTROL
+            if len(self.buffer) < HEADER.size + length:
+                break
+            payload = bytes(self.buffer[HEADER.size:HEADER.size + length])
+            del self.buffer[:HEADER.size + length]
+            next_sequence = self.next_sequence[lane]
+            if next_sequence is not None:
+                self.num_dropped += (sequence - next_sequence) & 0xffffffff
+            self.next_sequence[lane] = (sequence + 1) & 0xffffffff
+            self.num_records += 1
+            records.append((lane, sequence, payload))
+        return records
+
+
+def read_exactly(connection, size):
+    data = b''
+    while len(data) < size:
+        chunk = connection.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError('Connection closed by the board')
+        data += chunk
+    return data
+
+
+def receive(args):
+    connection = socket.create_connection((args.host, args.port))
+    preamble = read_exactly(connection, 6)
+    if preamble[:4] != MAGIC or preamble[4] != VERSION:
+        print('Unexpected preamble {}'.format(preamble.hex()),
+              file=sys.stderr)
+        return 1
+    is_compressed = bool(preamble[5] & FLAG_COMPRESSED)
+    print('Connected, compression {}'.format(
+        'on' if is_compressed else 'off'), file=sys.stderr)
+    sequences = [0, 0]
+    if args.udp:
+        datagrams = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    for report in args.send:
+        payload = bytes.fromhex(report)
+        lane = report_lane(payload)
+        record = frame(lane, sequences[lane], payload)
+        if args.udp:
+            datagrams.sendto(record, (args.host, args.port))
+        else:
+            connection.sendall(record)
+        sequences[lane] += 1
+    decompressor = Decompressor() if is_compressed else None
+    parser = RecordParser()
+    num_stream_bytes = 0
+    try:
+        while True:
+            data = connection.recv(4096)
+            if not data:
+                break
+            num_stream_bytes += len(data)
+            if decompressor is not None:
+                data = decompressor.feed(data)
+            for lane, sequence, payload in parser.feed(data):
+                if not args.quiet:
+                    print('{:7s} {:10d} {}'.format(
+                        LANE_NAMES[lane], sequence, payload.hex()))
+    except KeyboardInterrupt:
+        pass
+    print('Records: {}, dropped: {}, stream bytes: {}'.format(
+        parser.num_records, parser.num_dropped, num_stream_bytes),
+        file=sys.stderr)
+    return 0
+
+
+def decode_file(path):
+    with open(path, 'rb') as f:
+        sys.stdout.buffer.write(Decompressor().feed(f.read()))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Receive HID bridge stream')
+    parser.add_argument('--host', help='Address of the board')
+    parser.add_argument('--port', type=int, default=BRIDGE_PORT)
+    parser.add_argument('--quiet', action='store_true',
+                        help='Only print summary on exit')
+    parser.add_argument('--send', metavar='HEX', action='append', default=[],
+                        help='Report to send to the USB host, up to 64 bytes')
+    parser.add_argument('--udp', action='store_true',
+                        help='Send reports as UDP datagrams')
+    parser.add_argument('--decode', metavar='FILE',
+                        help='Decompress raw compressed stream from the file '
+                             'to stdout')
+    args = parser.parse_args()
+    if args.decode:
+        return decode_file(args.decode)
+    if not args.host:
+        parser.error('--host is required')
+    return receive(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,209 @@
+#include "host_nvm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <xc.h>
+
+HostNVM g_host_nvm;
+
+volatile uintptr_t NVMADDR;
+volatile uintptr_t NVMSRCADDR;
+
+static volatile uint32_t g_registers[HOST_NUM_REGISTERS];
+static int g_last_register = -1;
+static uint32_t g_nvm_keys[2];
+static uint32_t g_sys_keys[3];
+static bool g_is_reset_pending;
+static uint32_t g_core_timer;
+
+void HOST_NVM_Reset(void) {
+  memset((void*)g_registers, 0, sizeof(g_registers));
+  g_last_register = -1;
+  memset(g_nvm_keys, 0, sizeof(g_nvm_keys));
+  memset(g_sys_keys, 0, sizeof(g_sys_keys));
+  g_is_reset_pending = false;
+  g_host_nvm.fail_skip = 0;
+  g_host_nvm.fail_count = 0;
+  g_host_nvm.power_loss_op = 0;
+  g_host_nvm.num_ops = 0;
+  g_host_nvm.num_failures = 0;
+  g_host_nvm.num_erases = 0;
+}
+
+static uint8_t* flash_pointer(uint32_t pa, uint32_t size) {
+  if (pa >= HOST_FLASH_PA && pa + size <= HOST_FLASH_PA + APP_NVM_FLASH_SIZE) {
+    return g_host_nvm.flash + (pa - HOST_FLASH_PA);
+  }
+  if (pa >= HOST_BOOT_PA && pa + size <= HOST_BOOT_PA + HOST_BOOT_FLASH_SIZE) {
+    return g_host_nvm.boot + (pa - HOST_BOOT_PA);
+  }
+  return NULL;
+}
+
+uintptr_t HOST_KVA_ToPA(uintptr_t address) {
+  const uintptr_t pa = address & 0x1fffffff;
+  if ((address >> 29) != 4 && (address >> 29) != 5) {
+    return address;
+  }
+  if ((pa >= HOST_FLASH_PA && pa < HOST_FLASH_PA + APP_NVM_FLASH_SIZE) ||
+      (pa >= HOST_BOOT_PA && pa < HOST_BOOT_PA + HOST_BOOT_FLASH_SIZE)) {
+    return pa;
+  }
+  return address;
+}
+
+void* HOST_KVA_ToPointer(uintptr_t address) {
+  const uintptr_t pa = HOST_KVA_ToPA(address);
+  if (pa != address) {
+    return flash_pointer((uint32_t)pa, 1);
+  }
+  return (void*)address;
+}
+
+static bool nvm_should_fail(uint32_t pa) {
+  HostNVM* nvm = &g_host_nvm;
+  if (nvm->fail_count == 0 ||
+      pa / APP_NVM_PAGE_SIZE != nvm->fail_address / APP_NVM_PAGE_SIZE) {
+    return false;
+  }
+  if (nvm->fail_skip > 0) {
+    --nvm->fail_skip;
+    return false;
+  }
+  if (nvm->fail_count > 0) {
+    --nvm->fail_count;
+  }
+  if (++nvm->num_failures >= HOST_NVM_MAX_FAILURES) {
+    longjmp(nvm->jump, HOST_JUMP_STUCK);
+  }
+  return true;
+}
+
+// Power loss leaves some bits of the operation done.
+static void nvm_interrupt(AppNVMOp op, uint8_t* flash, const uint8_t* data,
+                          uint32_t size) {
+  uint32_t i;
+  for (i = 0; i < size; ++i) {
+    if (op == APP_NVM_OP_PAGE_ERASE) {
+      flash[i] |= (uint8_t)(rand() & rand());
+    } else {
+      flash[i] &= data[i] | (uint8_t)(rand() | rand());
+    }
+  }
+  longjmp(g_host_nvm.jump, HOST_JUMP_POWER_LOSS);
+}
+
+static void nvm_run(void) {
+  HostNVM* nvm = &g_host_nvm;
+  const uint32_t nvmcon = g_registers[HOST_REGISTER_NVMCON];
+  const uint32_t pa = (uint32_t)NVMADDR;
+  const AppNVMOp op = nvmcon & _NVMCON_NVMOP_MASK;
+  uint32_t data_word = g_registers[HOST_REGISTER_NVMDATA];
+  const uint8_t* data = NULL;
+  uint32_t size = 0, i;
+  uint8_t* flash;
+  if ((nvmcon & _NVMCON_WREN_MASK) == 0 ||
+      g_nvm_keys[0] != APP_NVM_KEY1 ||
+      g_nvm_keys[1] != APP_NVM_KEY2) {
+    g_registers[HOST_REGISTER_NVMCON] |= _NVMCON_WRERR_MASK;
+    return;
+  }
+  g_nvm_keys[0] = g_nvm_keys[1] = 0;
+  g_registers[HOST_REGISTER_NVMCON] &= ~_NVMCON_WRERR_MASK;
+  switch (op) {
+    case APP_NVM_OP_WORD_PROGRAM:
+      size = 4;
+      data = (const uint8_t*)&data_word;
+      break;
+    case APP_NVM_OP_ROW_PROGRAM:
+      size = APP_NVM_ROW_SIZE;
+      data = (const uint8_t*)NVMSRCADDR;
+      break;
+    case APP_NVM_OP_PAGE_ERASE:
+      size = APP_NVM_PAGE_SIZE;
+      break;
+    default:
+      break;
+  }
+  flash = flash_pointer(pa, size);
+  if (size == 0 || pa % size != 0 || flash == NULL || nvm_should_fail(pa)) {
+    g_registers[HOST_REGISTER_NVMCON] |= _NVMCON_WRERR_MASK;
+    return;
+  }
+  if (++nvm->num_ops == nvm->power_loss_op) {
+    nvm_interrupt(op, flash, data, size);
+  }
+  if (op == APP_NVM_OP_PAGE_ERASE) {
+    memset(flash, 0xff, size);
+    ++nvm->num_erases;
+  } else {
+    for (i = 0; i < size; ++i) {
+      flash[i] &= data[i];
+    }
+  }
+}
+
+// Writes are seen on the next register access: apply the previous one.
+static void register_commit(void) {
+  const int index = g_last_register;
+  uint32_t value;
+  if (index < 0) {
+    return;
+  }
+  value = g_registers[index];
+  switch (index) {
+    case HOST_REGISTER_NVMCONSET:
+      g_registers[HOST_REGISTER_NVMCON] |= value;
+      if ((value & _NVMCON_WR_MASK) != 0) {
+        nvm_run();
+        // Operation is done at once.
+        g_registers[HOST_REGISTER_NVMCON] &= ~_NVMCON_WR_MASK;
+      }
+      break;
+    case HOST_REGISTER_NVMCONCLR:
+      g_registers[HOST_REGISTER_NVMCON] &= ~value;
+      break;
+    case HOST_REGISTER_NVMKEY:
+      g_nvm_keys[0] = g_nvm_keys[1];
+      g_nvm_keys[1] = value;
+      break;
+    case HOST_REGISTER_SYSKEY:
+      g_sys_keys[0] = g_sys_keys[1];
+      g_sys_keys[1] = g_sys_keys[2];
+      g_sys_keys[2] = value;
+      break;
+    case HOST_REGISTER_RSWRSTSET:
+      if ((value & _RSWRST_SWRST_MASK) != 0 &&
+          g_sys_keys[0] == 0 &&
+          g_sys_keys[1] == APP_NVM_KEY1 &&
+          g_sys_keys[2] == APP_NVM_KEY2) {
+        g_is_reset_pending = true;
+      }
+      break;
+    default:
+      return;
+  }
+  g_registers[index] = 0;
+}
+
+volatile uint32_t* HOST_Register(int index) {
+  register_commit();
+  g_last_register = index;
+  // Reset happens on the read of RSWRST which follows setting SWRST.
+  if (index == HOST_REGISTER_RSWRST && g_is_reset_pending) {
+    longjmp(g_host_nvm.jump, HOST_JUMP_RESET);
+  }
+  return &g_registers[index];
+}
+
+bool SYS_INT_Disable(void) {
+  return true;
+}
+
+void SYS_INT_Restore(bool state) {
+}
+
+uint32_t HOST_CoreTimer(void) {
+  g_core_timer += 1 + APP_PROFILE_CORE_TICKS_PER_US;
+  return g_core_timer;
+}
@@ -0,0 +1,57 @@
+// Simulated program and boot flash behind the NVM controller and reset
+// registers of stubs/xc.h, shared by the tests of modules which program
+// flash.
+//
+// Operations only run after the unlock sequence, erase sets bits and
+// programming can only clear them, as on the chip. Faults are injected per
+// page or as power loss in the middle of an operation.
+
+#ifndef _HOST_NVM_H
+#define _HOST_NVM_H
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_nvm.h"
+
+#define HOST_FLASH_PA 0x1d000000u
+#define HOST_BOOT_PA 0x1fc00000u
+#define HOST_BOOT_FLASH_SIZE (3 * APP_NVM_PAGE_SIZE)
+// Failures after which a page is taken as never working.
+#define HOST_NVM_MAX_FAILURES 100
+
+// Values HostNVM.jump is taken with.
+typedef enum {
+  HOST_JUMP_NONE,
+  // Software reset.
+  HOST_JUMP_RESET,
+  // Operation interrupted by power loss.
+  HOST_JUMP_POWER_LOSS,
+  // HOST_NVM_MAX_FAILURES failed operations.
+  HOST_JUMP_STUCK,
+} HostJump;
+
+typedef struct {
+  uint8_t flash[APP_NVM_FLASH_SIZE];
+  uint8_t boot[HOST_BOOT_FLASH_SIZE];
+  // Operations on the page of fail_address succeed fail_skip times, then
+  // fail fail_count times, forever if negative.
+  uint32_t fail_address;
+  int fail_skip;
+  int fail_count;
+  // Operation which power loss interrupts half done, counted from the last
+  // HOST_NVM_Reset(), 0 for none.
+  int power_loss_op;
+  int num_ops;
+  int num_failures;
+  int num_erases;
+  jmp_buf jump;
+} HostNVM;
+
+extern HostNVM g_host_nvm;
+
+// Clear registers, fault injection and counters. Flash is left as is.
+void HOST_NVM_Reset(void);
+
+#endif  // _HOST_NVM_H
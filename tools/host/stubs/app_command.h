@@ -0,0 +1,15 @@
+// Host build stand-in for the application command header, which pulls in
+// the whole application. Firmware sources find the real header next to them
+// first, so this one is force-included (-include) and its guard skips the
+// real one. Command output goes to stdout.
+
+#ifndef _APP_COMMAND_H
+#define _APP_COMMAND_H
+
+#include <stdio.h>
+
+#include "system_definitions.h"
+
+#define APP_CMD_PRINT(cmd_io, ...) printf(__VA_ARGS__)
+
+#endif  // _APP_COMMAND_H
@@ -0,0 +1,16 @@
+// Host build stand-in for the XC32 address translation macros. Flash
+// addresses map to the simulated flash of stubs/xc.h, anything else is
+// a host pointer and is left as is.
+
+#ifndef _HOST_SYS_KMEM_H
+#define _HOST_SYS_KMEM_H
+
+#include <stdint.h>
+
+uintptr_t HOST_KVA_ToPA(uintptr_t address);
+void* HOST_KVA_ToPointer(uintptr_t address);
+
+#define KVA_TO_PA(v) HOST_KVA_ToPA((uintptr_t)(v))
+#define KVA0_TO_KVA1(v) HOST_KVA_ToPointer((uintptr_t)(v))
+
+#endif  // _HOST_SYS_KMEM_H
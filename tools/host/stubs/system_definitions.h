@@ -0,0 +1,41 @@
+// Host build stand-in for the Harmony system definitions: system objects,
+// timer and console services the firmware modules under test use. Tests
+// provide the functions.
+
+#ifndef _HOST_SYSTEM_DEFINITIONS_H
+#define _HOST_SYSTEM_DEFINITIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "tcpip/tcpip.h"
+
+#define SYS_CLK_FREQ 80000000ul
+
+typedef enum {
+  SYS_STATUS_ERROR = -1,
+  SYS_STATUS_UNINITIALIZED = 0,
+  SYS_STATUS_BUSY = 1,
+  SYS_STATUS_READY = 2,
+} SYS_STATUS;
+
+typedef uintptr_t SYS_MODULE_OBJ;
+
+typedef struct {
+  SYS_MODULE_OBJ tcpip;
+} SYSTEM_OBJECTS;
+
+typedef struct SYS_CMD_DEVICE_NODE SYS_CMD_DEVICE_NODE;
+
+uint32_t SYS_TMR_TickCountGet(void);
+uint32_t SYS_TMR_TickCounterFrequencyGet(void);
+
+bool SYS_INT_Disable(void);
+void SYS_INT_Restore(bool state);
+
+#define SYS_CONSOLE_MESSAGE(message) fputs((message), stdout)
+#define SYS_CONSOLE_PRINT(...) printf(__VA_ARGS__)
+
+#endif  // _HOST_SYSTEM_DEFINITIONS_H
@@ -0,0 +1,53 @@
+// Host build stand-in for the Harmony TCP/IP stack header, only the types
+// and functions which the firmware modules under test use. Tests provide the
+// functions.
+
+#ifndef _HOST_TCPIP_H
+#define _HOST_TCPIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _TCPIP_MAC_DATA_SEGMENT {
+  struct _TCPIP_MAC_DATA_SEGMENT* next;
+  uint8_t* segLoad;
+  uint16_t segLen;
+  uint16_t segSize;
+  uint16_t segFlags;
+} TCPIP_MAC_DATA_SEGMENT;
+
+typedef struct {
+  TCPIP_MAC_DATA_SEGMENT* pDSeg;
+} TCPIP_MAC_PACKET;
+
+typedef union {
+  uint32_t Val;
+  uint8_t v[4];
+} IPV4_ADDR;
+
+typedef int16_t TCP_SOCKET;
+#define INVALID_SOCKET (-1)
+
+typedef enum {
+  IP_ADDRESS_TYPE_ANY,
+  IP_ADDRESS_TYPE_IPV4,
+  IP_ADDRESS_TYPE_IPV6,
+} IP_ADDRESS_TYPE;
+
+int TCPIP_STACK_Status(uintptr_t object);
+
+TCP_SOCKET TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE address_type,
+                                uint16_t port,
+                                const void* address);
+bool TCPIP_TCP_Close(TCP_SOCKET socket);
+bool TCPIP_TCP_IsConnected(TCP_SOCKET socket);
+bool TCPIP_TCP_Flush(TCP_SOCKET socket);
+uint16_t TCPIP_TCP_GetIsReady(TCP_SOCKET socket);
+uint16_t TCPIP_TCP_ArrayGet(TCP_SOCKET socket, uint8_t* buffer, uint16_t size);
+uint16_t TCPIP_TCP_PutIsReady(TCP_SOCKET socket);
+uint16_t TCPIP_TCP_ArrayPut(TCP_SOCKET socket,
+                            const uint8_t* data,
+                            uint16_t size);
+
+#endif  // _HOST_TCPIP_H
@@ -0,0 +1,49 @@
+// Host build stand-in for the XC32 device header: core timer, NVM controller
+// and software reset registers. Register accesses go through functions of
+// the test, so it can run flash operations and catch the reset.
+
+#ifndef _HOST_XC_H
+#define _HOST_XC_H
+
+#include <stdint.h>
+
+uint32_t HOST_CoreTimer(void);
+volatile uint32_t* HOST_Register(int index);
+
+enum {
+  HOST_REGISTER_NVMCON,
+  HOST_REGISTER_NVMCONSET,
+  HOST_REGISTER_NVMCONCLR,
+  HOST_REGISTER_NVMKEY,
+  HOST_REGISTER_NVMDATA,
+  HOST_REGISTER_SYSKEY,
+  HOST_REGISTER_RSWRST,
+  HOST_REGISTER_RSWRSTSET,
+
+  HOST_NUM_REGISTERS,
+};
+
+// Address registers hold host pointers of the source data.
+extern volatile uintptr_t NVMADDR;
+extern volatile uintptr_t NVMSRCADDR;
+
+#define NVMCON (*HOST_Register(HOST_REGISTER_NVMCON))
+#define NVMCONSET (*HOST_Register(HOST_REGISTER_NVMCONSET))
+#define NVMCONCLR (*HOST_Register(HOST_REGISTER_NVMCONCLR))
+#define NVMKEY (*HOST_Register(HOST_REGISTER_NVMKEY))
+#define NVMDATA (*HOST_Register(HOST_REGISTER_NVMDATA))
+#define SYSKEY (*HOST_Register(HOST_REGISTER_SYSKEY))
+#define RSWRST (*HOST_Register(HOST_REGISTER_RSWRST))
+#define RSWRSTSET (*HOST_Register(HOST_REGISTER_RSWRSTSET))
+
+#define _NVMCON_WR_MASK 0x8000
+#define _NVMCON_WREN_MASK 0x4000
+#define _NVMCON_WRERR_MASK 0x2000
+#define _NVMCON_LVDERR_MASK 0x1000
+#define _NVMCON_NVMOP_MASK 0x000f
+#define _RSWRST_SWRST_MASK 0x0001
+
+#define _CP0_GET_COUNT() HOST_CoreTimer()
+#define __builtin_disable_interrupts() ((void)0)
+
+#endif  // _HOST_XC_H
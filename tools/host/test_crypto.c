@@ -0,0 +1,344 @@
+// Crypto kernels: the firmware's known answer tests, consistency of streams
+// split into pieces against one-shot calls on random data, and speed of
+// every kernel.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_crypto.h"
+
+#define NUM_CASES 2000
+#define MAX_LENGTH 1024
+
+static uint8_t g_input[MAX_LENGTH];
+static uint8_t g_expected[MAX_LENGTH];
+static uint8_t g_actual[MAX_LENGTH];
+
+static void fill_random(uint8_t* buffer, size_t size) {
+  size_t i;
+  for (i = 0; i < size; ++i) {
+    buffer[i] = (uint8_t)rand();
+  }
+}
+
+static int check(const char* name, int num_failures) {
+  printf("%s: %s\n", name, num_failures == 0 ? "ok" : "FAIL");
+  return num_failures;
+}
+
+// NIST SP 800-38A section F.5.3, the self-test covers the other key sizes.
+static int test_aes192(void) {
+  static const uint8_t key[24] = {
+    0x8e, 0x73, 0xb0, 0xf7, 0xda, 0x0e, 0x64, 0x52,
+    0xc8, 0x10, 0xf3, 0x2b, 0x80, 0x90, 0x79, 0xe5,
+    0x62, 0xf8, 0xea, 0xd2, 0x52, 0x2c, 0x6b, 0x7b,
+  };
+  static const uint8_t plaintext[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+  };
+  static const uint8_t ciphertext[64] = {
+    0x1a, 0xbc, 0x93, 0x24, 0x17, 0x52, 0x1c, 0xa2,
+    0x4f, 0x2b, 0x04, 0x59, 0xfe, 0x7e, 0x6e, 0x0b,
+    0x09, 0x03, 0x39, 0xec, 0x0a, 0xa6, 0xfa, 0xef,
+    0xd5, 0xcc, 0xc2, 0xc6, 0xf4, 0xce, 0x8e, 0x94,
+    0x1e, 0x36, 0xb2, 0x6b, 0xd1, 0xeb, 0xc6, 0x70,
+    0xd1, 0xbd, 0x1d, 0x66, 0x56, 0x20, 0xab, 0xf7,
+    0x4f, 0x78, 0xa7, 0xf6, 0xd2, 0x98, 0x09, 0x58,
+    0x5a, 0x97, 0xda, 0xec, 0x58, 0xc6, 0xb0, 0x50,
+  };
+  uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff,
+  };
+  uint8_t output[sizeof(plaintext)];
+  AppCryptoAES aes;
+  if (!APP_Crypto_AESKeySet(&aes, key, sizeof(key))) {
+    return 1;
+  }
+  APP_Crypto_AESCTR(&aes, counter, plaintext, output, sizeof(output));
+  return memcmp(output, ciphertext, sizeof(output)) != 0;
+}
+
+// Stream split at block boundaries, with the counter carried over.
+static int test_chacha20_split(void) {
+  uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE];
+  uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE];
+  int i, num_failures = 0;
+  for (i = 0; i < NUM_CASES; ++i) {
+    const size_t size = rand() % (MAX_LENGTH + 1);
+    const size_t split = (rand() % (size / 64 + 1)) * 64;
+    const uint32_t counter = (uint32_t)rand();
+    fill_random(key, sizeof(key));
+    fill_random(nonce, sizeof(nonce));
+    fill_random(g_input, size);
+    APP_Crypto_ChaCha20(key, nonce, counter, g_input, g_expected, size);
+    memcpy(g_actual, g_input, size);
+    APP_Crypto_ChaCha20(key, nonce, counter, g_actual, g_actual, split);
+    APP_Crypto_ChaCha20(key, nonce, counter + split / 64,
+                        g_actual + split, g_actual + split, size - split);
+    num_failures += memcmp(g_expected, g_actual, size) != 0;
+  }
+  return num_failures;
+}
+
+// Message fed in random pieces gives the same tag as fed at once.
+static int test_poly1305_split(void) {
+  uint8_t key[APP_CRYPTO_POLY1305_KEY_SIZE];
+  uint8_t expected[APP_CRYPTO_POLY1305_TAG_SIZE];
+  uint8_t actual[APP_CRYPTO_POLY1305_TAG_SIZE];
+  AppCryptoPoly1305 poly;
+  int i, num_failures = 0;
+  for (i = 0; i < NUM_CASES; ++i) {
+    const size_t size = rand() % (MAX_LENGTH + 1);
+    size_t offset = 0;
+    fill_random(key, sizeof(key));
+    fill_random(g_input, size);
+    APP_Crypto_Poly1305Init(&poly, key);
+    APP_Crypto_Poly1305Update(&poly, g_input, size);
+    APP_Crypto_Poly1305Final(&poly, expected);
+    APP_Crypto_Poly1305Init(&poly, key);
+    while (offset < size) {
+      size_t piece = 1 + rand() % 40;
+      if (piece > size - offset) {
+        piece = size - offset;
+      }
+      APP_Crypto_Poly1305Update(&poly, g_input + offset, piece);
+      offset += piece;
+    }
+    APP_Crypto_Poly1305Final(&poly, actual);
+    num_failures += memcmp(expected, actual, sizeof(actual)) != 0;
+  }
+  return num_failures;
+}
+
+// In-place encrypt and decrypt give the plaintext back, any flipped bit of
+// the tag, ciphertext or AAD is rejected and leaves the output untouched.
+static int test_aead_round_trip(void) {
+  uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE];
+  uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE];
+  uint8_t aad[32];
+  uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE];
+  int i, num_failures = 0;
+  for (i = 0; i < NUM_CASES; ++i) {
+    const size_t size = 1 + rand() % MAX_LENGTH;
+    const size_t aad_size = rand() % (sizeof(aad) + 1);
+    fill_random(key, sizeof(key));
+    fill_random(nonce, sizeof(nonce));
+    fill_random(aad, sizeof(aad));
+    fill_random(g_input, size);
+    memcpy(g_actual, g_input, size);
+    APP_Crypto_AEADEncrypt(key, nonce, aad, aad_size,
+                           g_actual, g_actual, size, tag);
+    switch (rand() % 3) {
+      case 0: tag[rand() % sizeof(tag)] ^= 1 << (rand() % 8); break;
+      case 1: g_actual[rand() % size] ^= 1 << (rand() % 8); break;
+      default:
+        if (aad_size != 0) {
+          aad[rand() % aad_size] ^= 1 << (rand() % 8);
+        } else {
+          tag[0] ^= 0x80;
+        }
+        break;
+    }
+    memcpy(g_expected, g_actual, size);
+    if (APP_Crypto_AEADDecrypt(key, nonce, aad, aad_size,
+                               g_actual, g_actual, size, tag) ||
+        memcmp(g_expected, g_actual, size) != 0) {
+      ++num_failures;
+    }
+  }
+  for (i = 0; i < NUM_CASES; ++i) {
+    const size_t size = rand() % (MAX_LENGTH + 1);
+    fill_random(key, sizeof(key));
+    fill_random(nonce, sizeof(nonce));
+    fill_random(g_input, size);
+    memcpy(g_actual, g_input, size);
+    APP_Crypto_AEADEncrypt(key, nonce, aad, sizeof(aad),
+                           g_actual, g_actual, size, tag);
+    if (!APP_Crypto_AEADDecrypt(key, nonce, aad, sizeof(aad),
+                                g_actual, g_actual, size, tag) ||
+        memcmp(g_input, g_actual, size) != 0) {
+      ++num_failures;
+    }
+  }
+  return num_failures;
+}
+
+// Session tickets as sealed by the TLS glue: key name, IV and length as
+// AAD, tag in a 32 byte MAC field. Sealing zeroes the unused part of the
+// field, a round trip gives the ticket back and a flipped bit anywhere in
+// the ticket, including the unused MAC bytes, is rejected.
+static int test_ticket_round_trip(void) {
+  enum { NAME_SIZE = 16, IV_SIZE = 16, MAC_SIZE = 32 };
+  static const uint8_t zero[MAC_SIZE - APP_CRYPTO_POLY1305_TAG_SIZE] = {0};
+  uint8_t key[APP_CRYPTO_CHACHA20_KEY_SIZE];
+  uint8_t aad[NAME_SIZE + IV_SIZE + 2];
+  uint8_t mac[MAC_SIZE];
+  int i, num_failures = 0;
+  for (i = 0; i < NUM_CASES; ++i) {
+    const size_t size = 1 + rand() % 256;
+    const uint8_t* iv = aad + NAME_SIZE;
+    fill_random(key, sizeof(key));
+    fill_random(aad, NAME_SIZE + IV_SIZE);
+    aad[NAME_SIZE + IV_SIZE] = size >> 8;
+    aad[NAME_SIZE + IV_SIZE + 1] = size;
+    fill_random(g_input, size);
+    fill_random(mac, sizeof(mac));
+    memcpy(g_actual, g_input, size);
+    APP_Crypto_AEADSeal(key, iv, aad, sizeof(aad), g_actual, size,
+                        mac, sizeof(mac));
+    num_failures += memcmp(mac + APP_CRYPTO_POLY1305_TAG_SIZE, zero,
+                           sizeof(zero)) != 0;
+    if (i % 2 == 0) {
+      num_failures += !APP_Crypto_AEADOpen(key, iv, aad, sizeof(aad),
+                                           g_actual, size, mac, sizeof(mac)) ||
+                      memcmp(g_input, g_actual, size) != 0;
+      continue;
+    }
+    switch (rand() % 4) {
+      case 0: mac[rand() % APP_CRYPTO_POLY1305_TAG_SIZE] ^= 1 << (rand() % 8);
+        break;
+      case 1:
+        mac[APP_CRYPTO_POLY1305_TAG_SIZE +
+            rand() % (MAC_SIZE - APP_CRYPTO_POLY1305_TAG_SIZE)] ^=
+            1 << (rand() % 8);
+        break;
+      case 2: g_actual[rand() % size] ^= 1 << (rand() % 8); break;
+      default: aad[rand() % sizeof(aad)] ^= 1 << (rand() % 8); break;
+    }
+    num_failures += APP_Crypto_AEADOpen(key, iv, aad, sizeof(aad),
+                                        g_actual, size, mac, sizeof(mac));
+  }
+  return num_failures;
+}
+
+// CTR stream split at block boundaries, for every key size.
+static int test_aes_ctr_split(void) {
+  static const size_t key_sizes[] = {16, 24, 32};
+  uint8_t key[32];
+  uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE];
+  uint8_t start[APP_CRYPTO_AES_BLOCK_SIZE];
+  AppCryptoAES aes;
+  int i, num_failures = 0;
+  for (i = 0; i < NUM_CASES; ++i) {
+    const size_t size = rand() % (MAX_LENGTH + 1);
+    const size_t split = (rand() % (size / 16 + 1)) * 16;
+    fill_random(key, sizeof(key));
+    fill_random(start, sizeof(start));
+    // Low bytes all ones exercise the carry into the upper ones.
+    if (rand() % 2) {
+      memset(start + 12, 0xff, 4);
+    }
+    fill_random(g_input, size);
+    APP_Crypto_AESKeySet(&aes, key, key_sizes[i % 3]);
+    memcpy(counter, start, sizeof(counter));
+    APP_Crypto_AESCTR(&aes, counter, g_input, g_expected, size);
+    memcpy(counter, start, sizeof(counter));
+    APP_Crypto_AESCTR(&aes, counter, g_input, g_actual, split);
+    APP_Crypto_AESCTR(&aes, counter, g_input + split, g_actual + split,
+                      size - split);
+    num_failures += memcmp(g_expected, g_actual, size) != 0;
+  }
+  return num_failures;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define CYCLES_GET() __rdtsc()
+#else
+#  define CYCLES_GET() 0
+#endif
+
+typedef enum {
+  KERNEL_CHACHA20,
+  KERNEL_POLY1305,
+  KERNEL_AEAD,
+  KERNEL_AES128_CTR,
+  KERNEL_AES256_CTR,
+
+  NUM_KERNELS,
+} Kernel;
+
+static const char* g_kernel_names[NUM_KERNELS] = {
+  "chacha20",
+  "poly1305",
+  "chacha20_poly1305",
+  "aes128_ctr",
+  "aes256_ctr",
+};
+
+// Same loop as "bench crypto" on the target. Host cycles are TSC ones, they
+// only compare kernels with each other.
+static void benchmark(Kernel kernel) {
+  enum { BLOCK_SIZE = 1024, NUM_BYTES = 32 * 1024 * 1024 };
+  static const uint8_t key[32] = {0};
+  static const uint8_t nonce[APP_CRYPTO_CHACHA20_NONCE_SIZE] = {0};
+  uint8_t counter[APP_CRYPTO_AES_BLOCK_SIZE] = {0};
+  uint8_t tag[APP_CRYPTO_POLY1305_TAG_SIZE];
+  struct timespec start, end;
+  unsigned long long start_cycles, cycles;
+  AppCryptoPoly1305 poly;
+  AppCryptoAES aes;
+  double seconds;
+  size_t num_bytes;
+  if (kernel == KERNEL_AES128_CTR) {
+    APP_Crypto_AESKeySet(&aes, key, 16);
+  } else if (kernel == KERNEL_AES256_CTR) {
+    APP_Crypto_AESKeySet(&aes, key, 32);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  start_cycles = CYCLES_GET();
+  for (num_bytes = 0; num_bytes < NUM_BYTES; num_bytes += BLOCK_SIZE) {
+    switch (kernel) {
+      case KERNEL_CHACHA20:
+        APP_Crypto_ChaCha20(key, nonce, 1, g_input, g_input, BLOCK_SIZE);
+        break;
+      case KERNEL_POLY1305:
+        APP_Crypto_Poly1305Init(&poly, key);
+        APP_Crypto_Poly1305Update(&poly, g_input, BLOCK_SIZE);
+        APP_Crypto_Poly1305Final(&poly, tag);
+        break;
+      case KERNEL_AEAD:
+        APP_Crypto_AEADEncrypt(key, nonce, NULL, 0, g_input, g_input,
+                               BLOCK_SIZE, tag);
+        break;
+      case KERNEL_AES128_CTR:
+      case KERNEL_AES256_CTR:
+        APP_Crypto_AESCTR(&aes, counter, g_input, g_input, BLOCK_SIZE);
+        break;
+      case NUM_KERNELS:
+        break;
+    }
+  }
+  cycles = CYCLES_GET() - start_cycles;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("%-18s %8.1f MB/s %6.2f cycles/byte\n", g_kernel_names[kernel],
+         (double)num_bytes / seconds / 1e6, (double)cycles / num_bytes);
+}
+
+int main(void) {
+  int num_failures = 0;
+  int kernel;
+  srand((unsigned)time(NULL));
+  num_failures += check("self-test", !APP_Crypto_SelfTest());
+  num_failures += check("aes192", test_aes192());
+  num_failures += check("chacha20 split", test_chacha20_split());
+  num_failures += check("poly1305 split", test_poly1305_split());
+  num_failures += check("aead round trip", test_aead_round_trip());
+  num_failures += check("ticket round trip", test_ticket_round_trip());
+  num_failures += check("aes ctr split", test_aes_ctr_split());
+  for (kernel = 0; kernel < NUM_KERNELS; ++kernel) {
+    benchmark(kernel);
+  }
+  return num_failures == 0 ? 0 : 1;
+}
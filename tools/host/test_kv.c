@@ -0,0 +1,250 @@
+// Key-value store against simulated flash: random workload checked against
+// a model and across re-mounts, a full store, failed flash operations
+// (compaction included) and power loss in the middle of a set.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_kv.h"
+#include "app_log.h"
+#include "app_profile.h"
+#include "host_nvm.h"
+
+#define NUM_KEYS 40
+#define MAX_LENGTH 60
+#define NUM_OPS 5000
+
+#define KV_PA (HOST_FLASH_PA + APP_KV_ADDRESS - APP_NVM_FLASH_ADDRESS)
+
+// Expected values, empty string for a missing key.
+static char g_model[NUM_KEYS][APP_KV_MAX_VALUE_SIZE + 1];
+
+void APP_Profile_BootMark(AppBootMilestone milestone) {
+}
+
+void APP_Log_Write(const char* format,
+                   uint32_t a0, uint32_t a1, uint32_t a2,
+                   uint32_t a3, uint32_t a4, uint32_t a5) {
+}
+
+static void key_name(int index, char* key) {
+  sprintf(key, "key%d", index);
+}
+
+static int random_value(char* value, int max_length) {
+  const int length = 1 + rand() % max_length;
+  int i;
+  for (i = 0; i < length; ++i) {
+    value[i] = 'a' + rand() % 26;
+  }
+  value[length] = '\0';
+  return length;
+}
+
+static void store_reset(void) {
+  memset(g_host_nvm.flash, 0xff, sizeof(g_host_nvm.flash));
+  memset(g_model, 0, sizeof(g_model));
+  HOST_NVM_Reset();
+  APP_KV_Initialize();
+}
+
+static int check_model(const char* name) {
+  int i, num_failures = 0;
+  for (i = 0; i < NUM_KEYS; ++i) {
+    char key[16], value[APP_KV_MAX_VALUE_SIZE + 1];
+    int size;
+    key_name(i, key);
+    size = APP_KV_Get(key, value, sizeof(value));
+    if (size >= 0) {
+      value[size] = '\0';
+    }
+    if (g_model[i][0] == '\0' ? size >= 0
+                              : size < 0 || strcmp(value, g_model[i]) != 0) {
+      if (num_failures++ < 10) {
+        printf("%s: %s is %s, expected %s\n", name, key,
+               size < 0 ? "missing" : value,
+               g_model[i][0] == '\0' ? "missing" : g_model[i]);
+      }
+    }
+  }
+  return num_failures;
+}
+
+// Check the store, and again after mounting it from flash.
+static int check_store(const char* name) {
+  int num_failures = check_model(name);
+  if (!APP_KV_Initialize()) {
+    printf("%s: mount failed\n", name);
+    return num_failures + 1;
+  }
+  return num_failures + check_model(name);
+}
+
+static int test_workload(void) {
+  AppKVStats stats;
+  int i, num_failures = 0;
+  store_reset();
+  for (i = 0; i < NUM_OPS && num_failures == 0; ++i) {
+    const int index = rand() % NUM_KEYS;
+    char key[16];
+    key_name(index, key);
+    if (rand() % 8 == 0) {
+      num_failures += !APP_KV_Delete(key);
+      g_model[index][0] = '\0';
+    } else {
+      const int length = random_value(g_model[index], MAX_LENGTH);
+      num_failures += !APP_KV_Set(key, g_model[index], length);
+    }
+    if (i % 500 == 0) {
+      num_failures += check_store("workload");
+    }
+  }
+  num_failures += check_store("workload");
+  APP_KV_StatsGet(&stats);
+  printf("workload: %u sets, %u compactions, %d failures\n",
+         stats.num_sets, stats.num_compactions, num_failures);
+  return num_failures;
+}
+
+// Largest values until the store refuses: live records still fit a page,
+// and everything can still be deleted.
+static int test_full(void) {
+  char value[APP_KV_MAX_VALUE_SIZE + 1];
+  AppKVStats stats;
+  int i, num_keys, num_failures = 0;
+  store_reset();
+  for (num_keys = 0; num_keys < NUM_KEYS; ++num_keys) {
+    char key[16];
+    key_name(num_keys, key);
+    memset(value, 'a' + num_keys % 26, APP_KV_MAX_VALUE_SIZE);
+    value[APP_KV_MAX_VALUE_SIZE] = '\0';
+    if (!APP_KV_Set(key, value, APP_KV_MAX_VALUE_SIZE)) {
+      break;
+    }
+    strcpy(g_model[num_keys], value);
+  }
+  APP_KV_StatsGet(&stats);
+  if (num_keys == NUM_KEYS ||
+      stats.live_size > APP_NVM_PAGE_SIZE - 16 /* page header */) {
+    printf("full: %d keys, %u live bytes\n", num_keys, stats.live_size);
+    ++num_failures;
+  }
+  num_failures += check_store("full");
+  // A value is rewritten while the old one is live, with two keys less there
+  // is room for both. Rewrites take compactions.
+  num_failures += !APP_KV_Delete("key0") + !APP_KV_Delete("key1");
+  g_model[0][0] = g_model[1][0] = '\0';
+  for (i = 0; i < 100; ++i) {
+    const int index = 2 + rand() % (num_keys - 2);
+    char key[16];
+    key_name(index, key);
+    memset(g_model[index], 'a' + rand() % 26, APP_KV_MAX_VALUE_SIZE);
+    num_failures += !APP_KV_Set(key, g_model[index], APP_KV_MAX_VALUE_SIZE);
+  }
+  num_failures += check_store("full rewritten");
+  for (i = 0; i < num_keys; ++i) {
+    char key[16];
+    key_name(i, key);
+    num_failures += !APP_KV_Delete(key);
+    g_model[i][0] = '\0';
+  }
+  num_failures += check_store("full deleted");
+  printf("full: %d keys fit, %d failures\n", num_keys, num_failures);
+  return num_failures;
+}
+
+// Sets with erase or programming of a store page failing: a failed set
+// keeps the old value, and the store keeps working once flash does.
+static int test_flash_failure(void) {
+  AppKVStats stats;
+  int i, num_failed_sets = 0, num_failures = 0;
+  store_reset();
+  for (i = 0; i < NUM_OPS && num_failures == 0; ++i) {
+    const int index = rand() % NUM_KEYS;
+    char key[16], value[MAX_LENGTH + 1];
+    const int length = random_value(value, MAX_LENGTH);
+    key_name(index, key);
+    if (rand() % 4 == 0) {
+      g_host_nvm.fail_address = KV_PA + (rand() % APP_KV_NUM_PAGES) *
+                                            APP_NVM_PAGE_SIZE;
+      g_host_nvm.fail_skip = rand() % 20;
+      g_host_nvm.fail_count = 1 + rand() % 3;
+    }
+    if (APP_KV_Set(key, value, length)) {
+      strcpy(g_model[index], value);
+    } else {
+      ++num_failed_sets;
+    }
+    HOST_NVM_Reset();
+    num_failures += check_model("flash failure");
+    if (i % 100 == 0) {
+      num_failures += check_store("flash failure");
+    }
+  }
+  num_failures += check_store("flash failure");
+  APP_KV_StatsGet(&stats);
+  printf("flash failure: %d failed sets, %u compactions, %d failures\n",
+         num_failed_sets, stats.num_compactions, num_failures);
+  return num_failures;
+}
+
+// Set the key with power lost at the given flash operation. Returns whether
+// it was lost.
+static bool set_interrupted(int index,
+                            const char* key,
+                            const char* value,
+                            int length,
+                            int power_loss_op) {
+  HOST_NVM_Reset();
+  g_host_nvm.power_loss_op = power_loss_op;
+  if (setjmp(g_host_nvm.jump) != HOST_JUMP_NONE) {
+    HOST_NVM_Reset();
+    return true;
+  }
+  if (APP_KV_Set(key, value, length)) {
+    strcpy(g_model[index], value);
+  }
+  return false;
+}
+
+// Power lost at a random flash operation of a set: the next mount has
+// either the old or the new value of the key, and all other keys.
+static int test_power_loss(void) {
+  int i, num_interrupted = 0, num_failures = 0;
+  store_reset();
+  for (i = 0; i < NUM_OPS / 2 && num_failures == 0; ++i) {
+    const int index = rand() % NUM_KEYS;
+    char key[16], value[MAX_LENGTH + 1];
+    const int length = random_value(value, MAX_LENGTH);
+    key_name(index, key);
+    // Compaction takes hundreds of operations, a set few.
+    if (!set_interrupted(index, key, value, length,
+                         1 + rand() % (i % 2 ? 40 : 800))) {
+      continue;
+    }
+    ++num_interrupted;
+    if (!APP_KV_Initialize()) {
+      printf("power loss: mount failed\n");
+      return num_failures + 1;
+    }
+    if (APP_KV_Get(key, value, sizeof(value)) == length) {
+      strcpy(g_model[index], value);
+    }
+    num_failures += check_store("power loss");
+  }
+  printf("power loss: %d interrupted sets, %d failures\n",
+         num_interrupted, num_failures);
+  return num_failures;
+}
+
+int main(void) {
+  int num_failures = 0;
+  srand((unsigned)time(NULL));
+  num_failures += test_workload();
+  num_failures += test_full();
+  num_failures += test_flash_failure();
+  num_failures += test_power_loss();
+  return num_failures == 0 ? 0 : 1;
+}
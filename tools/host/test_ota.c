@@ -0,0 +1,355 @@
+// Firmware update: staging of a streamed image into the slot, refusal of
+// broken and foreign images, and the installer, against simulated flash and
+// a simulated TCP connection.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_checksum.h"
+#include "app_log.h"
+#include "app_ota.h"
+#include "app_tcp_tuner.h"
+#include "host_nvm.h"
+
+#define CONFIG_OFFSET (APP_OTA_CONFIG_ADDRESS - APP_OTA_BOOT_ADDRESS)
+#define SOCKET 1
+#define MAX_TASKS 1000000
+
+static uint32_t g_tick;
+
+// Connection: stream sent to the board, and replies from it.
+static const uint8_t* g_input;
+static size_t g_input_size;
+static size_t g_input_position;
+static bool g_is_connected;
+static bool g_is_open;
+static char g_output[1024];
+static size_t g_output_size;
+
+////////////////////////////////////////////////////////////////////////////////
+// System and stack services.
+
+uint32_t SYS_TMR_TickCountGet(void) {
+  return g_tick;
+}
+
+uint32_t SYS_TMR_TickCounterFrequencyGet(void) {
+  return 1000;
+}
+
+void APP_Log_Write(const char* format,
+                   uint32_t a0, uint32_t a1, uint32_t a2,
+                   uint32_t a3, uint32_t a4, uint32_t a5) {
+}
+
+bool APP_TCP_Tuner_Register(TCP_SOCKET socket) {
+  return true;
+}
+
+void APP_TCP_Tuner_Unregister(TCP_SOCKET socket) {
+}
+
+void APP_TCP_Tuner_Account(TCP_SOCKET socket,
+                           uint32_t num_tx_bytes,
+                           uint32_t num_rx_bytes) {
+}
+
+int TCPIP_STACK_Status(uintptr_t object) {
+  return SYS_STATUS_READY;
+}
+
+TCP_SOCKET TCPIP_TCP_ServerOpen(IP_ADDRESS_TYPE address_type,
+                                uint16_t port,
+                                const void* address) {
+  g_is_open = true;
+  return SOCKET;
+}
+
+bool TCPIP_TCP_Close(TCP_SOCKET socket) {
+  g_is_open = false;
+  return true;
+}
+
+bool TCPIP_TCP_IsConnected(TCP_SOCKET socket) {
+  return g_is_open && g_is_connected;
+}
+
+bool TCPIP_TCP_Flush(TCP_SOCKET socket) {
+  return true;
+}
+
+// Data arrives in random pieces, so rows fill across several reads.
+uint16_t TCPIP_TCP_GetIsReady(TCP_SOCKET socket) {
+  const size_t num_left = g_input_size - g_input_position;
+  const size_t num_ready = (size_t)(rand() % 1500);
+  return (uint16_t)(num_ready < num_left ? num_ready : num_left);
+}
+
+uint16_t TCPIP_TCP_ArrayGet(TCP_SOCKET socket, uint8_t* buffer, uint16_t size) {
+  const size_t num_left = g_input_size - g_input_position;
+  if (size > num_left) {
+    size = (uint16_t)num_left;
+  }
+  memcpy(buffer, g_input + g_input_position, size);
+  g_input_position += size;
+  return size;
+}
+
+uint16_t TCPIP_TCP_PutIsReady(TCP_SOCKET socket) {
+  return (uint16_t)(sizeof(g_output) - 1 - g_output_size);
+}
+
+uint16_t TCPIP_TCP_ArrayPut(TCP_SOCKET socket,
+                            const uint8_t* data,
+                            uint16_t size) {
+  memcpy(g_output + g_output_size, data, size);
+  g_output_size += size;
+  g_output[g_output_size] = '\0';
+  return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tests.
+
+static const uint32_t g_config[APP_OTA_NUM_CONFIG_WORDS] = {
+  0x6ff8ffff, 0xfff8f95b, 0xff7ff9d9, 0x7ffffff3,
+};
+
+static void fill_random(uint8_t* buffer, size_t size) {
+  size_t i;
+  for (i = 0; i < size; ++i) {
+    buffer[i] = (uint8_t)rand();
+  }
+}
+
+// Running image and random leftovers in the slot.
+static void flash_reset(void) {
+  fill_random(g_host_nvm.flash, sizeof(g_host_nvm.flash));
+  fill_random(g_host_nvm.boot, sizeof(g_host_nvm.boot));
+  memcpy(g_host_nvm.boot + CONFIG_OFFSET, g_config, sizeof(g_config));
+  HOST_NVM_Reset();
+}
+
+// Stream of the header and image of the given program flash size, which
+// is followed by the boot flash part.
+static uint8_t* stream_create(uint32_t size,
+                              uint32_t flags,
+                              const uint32_t* config,
+                              size_t* stream_size) {
+  const uint32_t image_size = size + APP_OTA_BOOT_SIZE;
+  uint8_t* stream = malloc(sizeof(AppOTAHeader) + image_size);
+  AppOTAHeader header;
+  fill_random(stream + sizeof(header), image_size);
+  header.magic = APP_OTA_MAGIC;
+  header.size = size;
+  header.crc = APP_Checksum_CRC32(0, stream + sizeof(header), image_size);
+  header.flags = flags;
+  memcpy(header.config, config, sizeof(header.config));
+  memcpy(stream, &header, sizeof(header));
+  *stream_size = sizeof(header) + image_size;
+  return stream;
+}
+
+// Arm, connect, send the stream and run the receiver until it disarms.
+static void stream_send(const uint8_t* stream, size_t stream_size) {
+  SYSTEM_OBJECTS system_objects = {0};
+  int i;
+  g_input = stream;
+  g_input_size = stream_size;
+  g_input_position = 0;
+  g_output_size = 0;
+  g_output[0] = '\0';
+  APP_OTA_Initialize(&system_objects);
+  APP_OTA_Arm(APP_OTA_DEFAULT_ARM_TIMEOUT);
+  g_is_connected = true;
+  APP_OTA_Tasks();
+  for (i = 0; i < MAX_TASKS && g_is_open; ++i) {
+    APP_OTA_Tasks();
+  }
+  g_is_connected = false;
+}
+
+static int check(bool condition, const char* name, const char* what) {
+  if (!condition) {
+    printf("%s: %s\n", name, what);
+    printf("%s: replies: %s", name, g_output);
+    return 1;
+  }
+  return 0;
+}
+
+static int check_ready(const char* name) {
+  char expected[64];
+  snprintf(expected, sizeof(expected),
+           "OTA ready config=%08x,%08x,%08x,%08x\r\n",
+           g_config[0], g_config[1], g_config[2], g_config[3]);
+  return check(strncmp(g_output, expected, strlen(expected)) == 0,
+               name, "no ready line with config words");
+}
+
+static int check_reply(const char* name, const char* reply) {
+  return check(strstr(g_output, reply) != NULL, name, reply);
+}
+
+static bool slot_holds(const uint8_t* image, uint32_t image_size) {
+  const uint32_t offset = APP_OTA_SLOT_ADDRESS - APP_NVM_FLASH_ADDRESS;
+  return memcmp(g_host_nvm.flash + offset, image, image_size) == 0;
+}
+
+static int test_stage(void) {
+  const uint32_t size = 40 * APP_NVM_PAGE_SIZE;
+  const uint32_t image_size = size + APP_OTA_BOOT_SIZE;
+  AppOTAStats stats;
+  size_t stream_size;
+  uint8_t* stream = stream_create(size, 0, g_config, &stream_size);
+  char reply[48];
+  int num_failures = 0;
+  flash_reset();
+  stream_send(stream, stream_size);
+  APP_OTA_StatsGet(&stats);
+  snprintf(reply, sizeof(reply), "OTA staged bytes=%u ", image_size);
+  num_failures += check_ready("stage");
+  num_failures += check_reply("stage", reply);
+  num_failures += check(slot_holds(stream + sizeof(AppOTAHeader), image_size),
+                        "stage", "slot doesn't hold the image");
+  num_failures += check(stats.num_page_erases == image_size /
+                                                 APP_NVM_PAGE_SIZE &&
+                        stats.num_row_programs == image_size /
+                                                  APP_NVM_ROW_SIZE,
+                        "stage", "wrong number of flash operations");
+  free(stream);
+  printf("stage: %d failures\n", num_failures);
+  return num_failures;
+}
+
+static int test_refuse(void) {
+  const uint32_t size = 8 * APP_NVM_PAGE_SIZE;
+  uint32_t config[APP_OTA_NUM_CONFIG_WORDS];
+  AppOTAStats stats;
+  size_t stream_size;
+  uint8_t* stream;
+  int num_failures = 0;
+
+  // Corrupted on the way.
+  flash_reset();
+  stream = stream_create(size, APP_OTA_FLAG_INSTALL, g_config, &stream_size);
+  stream[stream_size - 100] ^= 0x10;
+  stream_send(stream, stream_size);
+  APP_OTA_StatsGet(&stats);
+  num_failures += check_reply("crc", "OTA error=crc\r\n");
+  num_failures += check(stats.last_error == APP_OTA_ERROR_CRC &&
+                        !APP_OTA_Install(),
+                        "crc", "broken image can be installed");
+  free(stream);
+
+  // Built with other configuration words: nothing is written.
+  flash_reset();
+  memcpy(config, g_config, sizeof(config));
+  config[3] ^= 0x00000001;
+  stream = stream_create(size, APP_OTA_FLAG_INSTALL, config, &stream_size);
+  stream_send(stream, stream_size);
+  num_failures += check_ready("config");
+  num_failures += check_reply("config", "OTA error=config\r\n");
+  num_failures += check(g_host_nvm.num_erases == 0 && !APP_OTA_Install(),
+                        "config", "foreign image is written");
+  free(stream);
+
+  // Program flash part which is not whole pages.
+  flash_reset();
+  stream = stream_create(size + APP_NVM_ROW_SIZE, 0, g_config, &stream_size);
+  stream_send(stream, stream_size);
+  num_failures += check_reply("header", "OTA error=header\r\n");
+  free(stream);
+
+  printf("refuse: %d failures\n", num_failures);
+  return num_failures;
+}
+
+// Stage an image, make some pages of the running image already match it,
+// then install with the given page failing fail_count times.
+static int run_install(const char* name,
+                       uint32_t fail_offset,
+                       int fail_count,
+                       int* jump) {
+  const uint32_t size = 16 * APP_NVM_PAGE_SIZE;
+  static uint8_t flash_before[APP_NVM_FLASH_SIZE];
+  static uint8_t config_page[APP_NVM_PAGE_SIZE];
+  HostNVM* nvm = &g_host_nvm;
+  const uint8_t* image;
+  size_t stream_size;
+  uint8_t* stream = stream_create(size, 0, g_config, &stream_size);
+  int num_failures = 0;
+  flash_reset();
+  image = stream + sizeof(AppOTAHeader);
+  memcpy(nvm->flash + 3 * APP_NVM_PAGE_SIZE,
+         image + 3 * APP_NVM_PAGE_SIZE,
+         2 * APP_NVM_PAGE_SIZE);
+  stream_send(stream, stream_size);
+  num_failures += check_reply(name, "OTA staged");
+  memcpy(flash_before, nvm->flash, sizeof(flash_before));
+  memcpy(config_page, nvm->boot + 2 * APP_NVM_PAGE_SIZE, sizeof(config_page));
+  nvm->fail_address = (fail_offset < size ? HOST_FLASH_PA + fail_offset
+                                          : HOST_BOOT_PA + fail_offset - size);
+  nvm->fail_count = fail_count;
+  nvm->num_erases = 0;
+  *jump = setjmp(nvm->jump);
+  if (*jump == HOST_JUMP_NONE) {
+    APP_OTA_Install();
+    num_failures += check(false, name, "installer returned");
+  } else if (*jump == HOST_JUMP_RESET) {
+    num_failures += check(memcmp(nvm->flash, image, size) == 0,
+                          name, "program flash doesn't hold the image");
+    num_failures += check(memcmp(nvm->boot, image + size,
+                                 APP_OTA_BOOT_SIZE) == 0,
+                          name, "boot flash doesn't hold the image");
+    num_failures += check(memcmp(nvm->flash + size,
+                                 flash_before + size,
+                                 sizeof(nvm->flash) - size) == 0,
+                          name, "flash past the image is changed");
+    num_failures += check(memcmp(nvm->boot + 2 * APP_NVM_PAGE_SIZE,
+                                 config_page,
+                                 sizeof(config_page)) == 0,
+                          name, "configuration words page is changed");
+    // Two program flash pages already match and are skipped.
+    num_failures += check(nvm->num_erases ==
+                              (int)((size + APP_OTA_BOOT_SIZE) /
+                                    APP_NVM_PAGE_SIZE) - 2 &&
+                          nvm->num_failures == fail_count,
+                          name, "wrong number of page erases");
+  } else {
+    // Everything before the failing page is installed, no reset.
+    num_failures += check(memcmp(nvm->flash, image, fail_offset) == 0,
+                          name, "pages before the failing one differ");
+  }
+  free(stream);
+  return num_failures;
+}
+
+static int test_install(void) {
+  int num_failures = 0, jump;
+  num_failures += run_install("install", 0, 0, &jump);
+  num_failures += check(jump == HOST_JUMP_RESET, "install", "no reset");
+  // Page erase fails few times, in program flash and boot flash.
+  num_failures += run_install("retry", 7 * APP_NVM_PAGE_SIZE, 3, &jump);
+  num_failures += check(jump == HOST_JUMP_RESET, "retry", "no reset");
+  num_failures += run_install("retry boot", 17 * APP_NVM_PAGE_SIZE, 2, &jump);
+  num_failures += check(jump == HOST_JUMP_RESET, "retry boot", "no reset");
+  // Page which never programs: installer keeps trying and never resets into
+  // a partial image.
+  num_failures += run_install("stuck", 9 * APP_NVM_PAGE_SIZE, -1, &jump);
+  num_failures += check(jump == HOST_JUMP_STUCK,
+                        "stuck", "reset after failures");
+  printf("install: %d failures\n", num_failures);
+  return num_failures;
+}
+
+int main(void) {
+  int num_failures = 0;
+  srand((unsigned)time(NULL));
+  num_failures += test_stage();
+  num_failures += test_refuse();
+  num_failures += test_install();
+  return num_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+# Generate firmware/src/app_http_assets.c from files in firmware/web.
+#
+# Every file is gzip compressed, so the HTTP server sends it as-is with
+# "Content-Encoding: gzip". Output is deterministic, so regenerating
+# unchanged assets gives no diff.
+#
+# Usage:
+#   http_assets.py [--web firmware/web] [--output firmware/src/app_http_assets.c]
+
+import argparse
+import gzip
+import os
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+CONTENT_TYPES = {
+    '.htm': 'text/html',
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.png': 'image/png',
+    '.ico': 'image/x-icon',
+    '.svg': 'image/svg+xml',
+    '.txt': 'text/plain',
+}
+
+
+def read_license():
+    with open(os.path.join(ROOT, 'firmware', 'src', 'app.c')) as f:
+        lines = f.readlines()
+    return ''.join(lines[:21])
+
+
+def c_identifier(path):
+    return 'g_asset_' + ''.join(c if c.isalnum() else '_'
+                                for c in path.lstrip('/'))
+
+
+def collect_assets(web_dir):
+    assets = []
+    for directory, _, files in sorted(os.walk(web_dir)):
+        for name in sorted(files):
+            filepath = os.path.join(directory, name)
+            extension = os.path.splitext(name)[1].lower()
+            if extension not in CONTENT_TYPES:
+                print('Skipping {}: unknown content type'.format(filepath),
+                      file=sys.stderr)
+                continue
+            path = '/' + os.path.relpath(filepath, web_dir).replace(os.sep, '/')
+            with open(filepath, 'rb') as f:
+                data = gzip.compress(f.read(), compresslevel=9, mtime=0)
+            assets.append((path, CONTENT_TYPES[extension], data))
+    return assets
+
+
+def write_assets(assets, output):
+    with open(output, 'w') as f:
+        f.write(read_license())
+        f.write('\n// Generated by tools/http_assets.py, do not edit.\n\n')
+        f.write('#include "app_http_assets.h"\n')
+        for path, _, data in assets:
+            f.write('\n// {}\n'.format(path))
+            f.write('static const uint8_t {}[{}] = {{\n'.format(
+                c_identifier(path), len(data)))
+            for i in range(0, len(data), 12):
+                chunk = data[i:i + 12]
+                f.write('  ' + ' '.join('0x{:02x},'.format(b)
+                                        for b in chunk) + '\n')
+            f.write('};\n')
+        f.write('\nconst AppHTTPAsset app_http_assets[] = {\n')
+        for path, content_type, data in assets:
+            f.write('  {{"{}", "{}", {}, sizeof({})}},\n'.format(
+                path, content_type, c_identifier(path), c_identifier(path)))
+        f.write('};\n\n')
+        f.write('const int app_http_num_assets =\n'
+                '    sizeof(app_http_assets) / sizeof(*app_http_assets);\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate HTTP assets table')
+    parser.add_argument('--web', default=os.path.join(ROOT, 'firmware', 'web'))
+    parser.add_argument('--output', default=os.path.join(
+        ROOT, 'firmware', 'src', 'app_http_assets.c'))
+    args = parser.parse_args()
+    assets = collect_assets(args.web)
+    write_assets(assets, args.output)
+    for path, _, data in assets:
+        print('{}: {} bytes'.format(path, len(data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
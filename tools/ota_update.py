@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+
+# Host side of the board's network firmware update.
+#
+# Takes the hex file MPLAB X builds: program flash padded with erased flash
+# to whole pages, followed by the first two pages of boot flash, which hold
+# the startup code and exception vectors of the build. Both are streamed to
+# the board together with their CRC-32. Configuration words can't be updated:
+# the board reports the ones it runs with, and an image built with different
+# ones is refused. The board needs to be armed first, with "ota arm" on its
+# console or with --console here.
+#
+# Usage:
+#   ota_update.py --host 192.168.1.20 \
+#       firmware/HarmonyPicNetwork.X/dist/default/production/HarmonyPicNetwork.X.production.hex
+#   ota_update.py --host 192.168.1.20 --console /dev/ttyUSB0 --install image.hex
+
+import argparse
+import socket
+import struct
+import sys
+import time
+import zlib
+
+OTA_PORT = 5004
+OTA_MAGIC = 0x3241544f
+OTA_FLAG_INSTALL = 1 << 0
+
+# Physical addresses, as they are in the hex file.
+FLASH_ADDRESS = 0x1d000000
+FLASH_SIZE = 512 * 1024
+BOOT_ADDRESS = 0x1fc00000
+BOOT_SIZE = 12 * 1024
+# Boot flash pages which are part of the image, see APP_OTA_BOOT_SIZE. The
+# last page is debug executive and configuration words.
+BOOT_IMAGE_SIZE = 8 * 1024
+CONFIG_ADDRESS = 0x1fc02ff0
+NUM_CONFIG_WORDS = 4
+# Upper half of flash is the staging slot followed by the key-value store,
+# see APP_OTA_SLOT_SIZE.
+SLOT_SIZE = 240 * 1024
+PAGE_SIZE = 4096
+
+
+def read_hex(path):
+    """Returns program flash and boot flash images from an Intel HEX file."""
+    flash = bytearray()
+    boot = bytearray(b'\xff' * BOOT_SIZE)
+    base = 0
+    with open(path) as f:
+        for line_number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            record = bytes.fromhex(line[1:])
+            if line[0] != ':' or sum(record) & 0xff != 0:
+                raise ValueError('{}: bad record'.format(line_number))
+            size, address, kind = record[0], (record[1] << 8) | record[2], \
+                record[3]
+            data = record[4:4 + size]
+            if kind == 0x00:
+                address += base
+                if BOOT_ADDRESS <= address < BOOT_ADDRESS + BOOT_SIZE:
+                    offset = address - BOOT_ADDRESS
+                    if offset + size > BOOT_SIZE:
+                        raise ValueError('{}: record crosses the end of boot '
+                                         'flash'.format(line_number))
+                    boot[offset:offset + size] = data
+                    continue
+                offset = address - FLASH_ADDRESS
+                if offset < 0 or offset + size > FLASH_SIZE:
+                    raise ValueError('{}: address {:08x} is neither program '
+                                     'nor boot flash'.format(line_number,
+                                                             address))
+                if offset + size > SLOT_SIZE - BOOT_IMAGE_SIZE:
+                    if any(byte != 0xff for byte in data):
+                        raise ValueError('Image does not fit into {} KB'.format(
+                            (SLOT_SIZE - BOOT_IMAGE_SIZE) // 1024))
+                    # Reserved staging slot and key-value store.
+                    continue
+                if offset + size > len(flash):
+                    flash.extend(b'\xff' * (offset + size - len(flash)))
+                flash[offset:offset + size] = data
+            elif kind == 0x01:
+                break
+            elif kind == 0x02:
+                base = ((data[0] << 8) | data[1]) << 4
+            elif kind == 0x04:
+                base = ((data[0] << 8) | data[1]) << 16
+    return flash, boot
+
+
+def config_words(boot):
+    offset = CONFIG_ADDRESS - BOOT_ADDRESS
+    return struct.unpack_from('<{}I'.format(NUM_CONFIG_WORDS), boot, offset)
+
+
+def read_line(connection):
+    line = b''
+    while not line.endswith(b'\n'):
+        data = connection.recv(1)
+        if not data:
+            break
+        line += data
+    return line.decode(errors='replace').strip()
+
+
+def arm(args):
+    import serial
+    console = serial.Serial(args.console, args.baud, timeout=1)
+    console.write(b'ota arm\r\n')
+    console.close()
+    # Receiver opens its socket on the next super-loop pass.
+    time.sleep(0.5)
+
+
+def update(args, flash, boot):
+    image = flash + boot[:BOOT_IMAGE_SIZE]
+    config = config_words(boot)
+    crc = zlib.crc32(image) & 0xffffffff
+    flags = OTA_FLAG_INSTALL if args.install else 0
+    header = struct.pack('<IIII{}I'.format(NUM_CONFIG_WORDS), OTA_MAGIC,
+                         len(flash), crc, flags, *config)
+    start_time = time.time()
+    with socket.create_connection((args.host, args.port),
+                                  timeout=args.timeout) as connection:
+        ready = read_line(connection)
+        expected = 'OTA ready config=' + ','.join(
+            '{:08x}'.format(word) for word in config)
+        if ready != expected:
+            # Startup code of the image would run with configuration words
+            # it wasn't built for.
+            return ('Refusing image: board reports "{}", image has "{}"'
+                    .format(ready, expected)), 0
+        connection.sendall(header)
+        connection.sendall(image)
+        reply = read_line(connection)
+    elapsed = time.time() - start_time
+    return reply, elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Update board firmware')
+    parser.add_argument('image', help='Intel HEX file')
+    parser.add_argument('--host', required=True, help='Board address')
+    parser.add_argument('--port', type=int, default=OTA_PORT)
+    parser.add_argument('--install', action='store_true',
+                        help='Install the image and reset the board once it '
+                        'is verified')
+    parser.add_argument('--console', help='Serial port to arm the board through')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--timeout', type=int, default=30,
+                        help='Timeout of the whole transfer, seconds')
+    args = parser.parse_args()
+
+    flash, boot = read_hex(args.image)
+    flash.extend(b'\xff' * (-len(flash) % PAGE_SIZE))
+    if not flash or all(byte == 0xff for byte in boot[:BOOT_IMAGE_SIZE]):
+        print('Image has no program or boot flash contents', file=sys.stderr)
+        return 1
+
+    if args.console:
+        arm(args)
+    try:
+        reply, elapsed = update(args, flash, boot)
+    except OSError as e:
+        print('Transfer failed: {} (is the board armed?)'.format(e),
+              file=sys.stderr)
+        return 1
+    print(reply)
+    if not reply.startswith('OTA staged'):
+        return 1
+    size = len(flash) + BOOT_IMAGE_SIZE
+    print('{} bytes in {:.2f} s, {:.1f} KB/s'.format(
+        size, elapsed, size / 1024 / elapsed))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
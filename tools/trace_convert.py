@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2017, Sergey Sharybin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to
+# deal in the Software without restriction, including without limitation the
+# rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+# sell copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+#
+# Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+# Converter of the board's event trace dump to Chrome trace JSON.
+#
+# The dump is read from a file with a captured console log, from the console
+# (the dump is requested and read back), or from UDP datagrams which the
+# board sends on "trace dump <host address>". The result opens in
+# chrome://tracing and ui.perfetto.dev: ISRs and super-loop tasks are slices
+# of a single CPU track, so an ISR shows up nested in the task it preempted,
+# HID traffic is instant events and module states are counter tracks.
+#
+# Usage:
+#   trace_convert.py console.log -o trace.json
+#   trace_convert.py --serial /dev/ttyUSB0 -o trace.json
+#   trace_convert.py --udp -o trace.json --summary
+
+import argparse
+import json
+import socket
+import sys
+
+TRACE_PORT = 5005
+
+# Must match AppTracePhase in app_trace.h.
+PHASE_INSTANT = 0
+PHASE_BEGIN = 1
+PHASE_END = 2
+PHASE_COUNTER = 3
+
+PID = 1
+TID = 1
+
+
+class Dump:
+    def __init__(self):
+        self.header = None
+        self.names = {}
+        self.records = []
+        self.is_complete = False
+
+    def feed(self, line):
+        """Takes a line of the dump, returns False once the dump is over."""
+        start = line.find('TRACE ')
+        if start < 0:
+            return True
+        tokens = line[start:].split()
+        kind = tokens[1]
+        if kind == 'BEGIN':
+            self.__init__()
+            self.header = dict(token.split('=', 1) for token in tokens[2:])
+        elif kind == 'EVENT':
+            self.names[int(tokens[2])] = tokens[3]
+        elif kind == 'DATA':
+            for token in tokens[2:]:
+                self.records.append((int(token[0:8], 16),
+                                     int(token[8:12], 16),
+                                     int(token[12:14], 16),
+                                     int(token[14:16], 16)))
+        elif kind == 'END':
+            self.is_complete = self.header is not None
+            return not self.is_complete
+        return True
+
+
+def read_file(path):
+    dump = Dump()
+    with open(path, errors='replace') as f:
+        for line in f:
+            if not dump.feed(line):
+                break
+    return dump
+
+
+def read_serial(args):
+    import serial
+    dump = Dump()
+    console = serial.Serial(args.serial, args.baud, timeout=args.timeout)
+    console.reset_input_buffer()
+    console.write(b'trace dump\r\n')
+    while True:
+        line = console.readline()
+        if not line:
+            break
+        if not dump.feed(line.decode(errors='replace')):
+            break
+    return dump
+
+
+def read_udp(args):
+    dump = Dump()
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', args.port))
+    sock.settimeout(args.timeout)
+    print('Waiting for dump on UDP port {}, run "trace dump <this host> {}" '
+          'on the board'.format(args.port, args.port), file=sys.stderr)
+    try:
+        while True:
+            datagram, _ = sock.recvfrom(2048)
+            lines = datagram.decode(errors='replace').splitlines()
+            if not all(dump.feed(line) for line in lines):
+                break
+    except socket.timeout:
+        pass
+    return dump
+
+
+def unwrap(records):
+    """Core timer is 32 bit, timestamps are made monotonic ring order wise.
+
+    Records which are slightly out of order (one claimed its slot before an
+    interrupt, took its timestamp after it) give a small negative delta."""
+    time = 0
+    last = None
+    result = []
+    for index, (timestamp, arg, event, phase) in enumerate(records):
+        if last is not None:
+            delta = (timestamp - last) & 0xffffffff
+            if delta >= 1 << 31:
+                delta -= 1 << 32
+            time += delta
+        last = timestamp
+        result.append((time, index, arg, event, phase))
+    result.sort()
+    return result
+
+
+def convert(dump):
+    ticks_per_us = int(dump.header['ticks_per_us'])
+    events = [
+        {'ph': 'M', 'pid': PID, 'name': 'process_name',
+         'args': {'name': 'board'}},
+        {'ph': 'M', 'pid': PID, 'tid': TID, 'name': 'thread_name',
+         'args': {'name': 'cpu'}},
+    ]
+    # Slices whose begin was overwritten in the ring are skipped, slices
+    # which didn't end before the dump are closed by the viewer.
+    stack = []
+    slices = {}
+    for time, _, arg, event, phase in unwrap(dump.records):
+        name = dump.names.get(event, 'event.{}'.format(event))
+        common = {'name': name, 'cat': name.split('.')[0], 'pid': PID,
+                  'tid': TID, 'ts': time / ticks_per_us}
+        if phase == PHASE_BEGIN:
+            stack.append((event, time))
+            events.append(dict(common, ph='B'))
+        elif phase == PHASE_END:
+            if not any(open_event == event for open_event, _ in stack):
+                continue
+            while stack:
+                open_event, start = stack.pop()
+                if open_event == event:
+                    break
+            events.append(dict(common, ph='E'))
+            count, total, longest = slices.get(name, (0, 0, 0))
+            duration = (time - start) / ticks_per_us
+            slices[name] = (count + 1, total + duration,
+                            max(longest, duration))
+        elif phase == PHASE_COUNTER:
+            events.append(dict(common, ph='C', args={'state': arg}))
+        else:
+            events.append(dict(common, ph='i', s='t', args={'arg': arg}))
+    return {'traceEvents': events, 'displayTimeUnit': 'ns'}, slices
+
+
+def print_summary(dump, slices):
+    ticks_per_us = int(dump.header['ticks_per_us'])
+    records = unwrap(dump.records)
+    span = (records[-1][0] - records[0][0]) / ticks_per_us if records else 0
+    print('{} records ({} lost) over {:.0f} us'.format(
+        len(dump.records), dump.header['lost'], span))
+    print('{:<20} {:>8} {:>12} {:>10}'.format('slice', 'count', 'avg, us',
+                                              'max, us'))
+    for name, (count, total, longest) in sorted(
+            slices.items(), key=lambda item: -item[1][2]):
+        print('{:<20} {:>8} {:>12.1f} {:>10.1f}'.format(
+            name, count, total / count, longest))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert board event trace to Chrome trace JSON')
+    parser.add_argument('input', nargs='?', help='Captured console log')
+    parser.add_argument('--serial', help='Console serial port to dump from')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--udp', action='store_true',
+                        help='Receive dump sent by the board over UDP')
+    parser.add_argument('--port', type=int, default=TRACE_PORT,
+                        help='UDP port to receive dump on')
+    parser.add_argument('--timeout', type=int, default=10,
+                        help='Timeout of the dump, seconds')
+    parser.add_argument('-o', '--output', default='trace.json')
+    parser.add_argument('--summary', action='store_true',
+                        help='Print count and duration of slices')
+    args = parser.parse_args()
+
+    if args.udp:
+        dump = read_udp(args)
+    elif args.serial:
+        dump = read_serial(args)
+    elif args.input:
+        dump = read_file(args.input)
+    else:
+        parser.error('One of input, --serial or --udp is required')
+    if not dump.is_complete:
+        print('No complete trace dump found', file=sys.stderr)
+        return 1
+
+    trace, slices = convert(dump)
+    with open(args.output, 'w') as f:
+        json.dump(trace, f)
+    if args.summary:
+        print_summary(dump, slices)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())